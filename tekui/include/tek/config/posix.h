@@ -104,6 +104,19 @@ typedef union {
 
 #define TINLINE __inline
 
+/*****************************************************************************/
+/*
+**	Atomic operations
+*/
+
+#if defined(__GNUC__) && ((__GNUC__*100 + __GNUC_MINOR__) >= 401)
+#define TSYS_HAVE_ATOMICS
+#define TATOMIC_CAS(p, o, n)	__sync_bool_compare_and_swap(p, o, n)
+#define TATOMIC_ADD(p, v)		__sync_add_and_fetch(p, v)
+#define TATOMIC_SWAP(p, v)		__sync_lock_test_and_set(p, v)
+#define TATOMIC_BARRIER()		__sync_synchronize()
+#endif
+
 /*****************************************************************************/
 /* 
 **	Calling conventions and visibility
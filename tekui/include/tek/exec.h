@@ -352,6 +352,8 @@ struct TModInitNode
 #define TMMUT_Pooled	0x00000004
 /* Leak-tracking on top of a parent MMU */
 #define TMMUT_Tracking	0x00000008
+/* Put MMU on top of a size-class slab allocator */
+#define TMMUT_Slab		0x00000010
 /* Thread-safety on top of a parent MMU */
 #define TMMUT_TaskSafe	0x00000100
 /* Msg allocator on parent msg MMU */
@@ -377,6 +379,104 @@ struct TModInitNode
 #define	TPool_AutoAdapt		(TEXECTAGS_ + 69)
 #define TPool_Static		(TEXECTAGS_ + 70)
 #define TPool_StaticSize	(TEXECTAGS_ + 71)
+/* Size of slabs */
+#define TSlab_SlabSize		(TEXECTAGS_ + 72)
+/* Largest allocation served from slabs */
+#define TSlab_MaxSize		(TEXECTAGS_ + 73)
+/* Name under which the MMU can be found; task-safe MMUs only */
+#define TMem_Name			(TEXECTAGS_ + 74)
+
+/*
+**	Tags for message ports
+*/
+
+/* Lock-free port; only the creating task may get messages from it */
+#define TPort_LockFree		(TEXECTAGS_ + 75)
+
+/*
+**	Tags for worker pools
+*/
+
+/* Number of worker tasks */
+#define TWorkerPool_NumWorkers	(TEXECTAGS_ + 76)
+
+/*
+**	Memory manager statistics, as returned by TExecGetMMUStats() and
+**	TExecGetNamedMMUStats().
+**	Allocation counts are kept by tracking and slab MMUs. Sizes are
+**	counted in powers of two, starting with allocations of up to 16 bytes;
+**	the last slot counts all larger allocations. In MMUs with per-task
+**	caches, blocks held in the caches count as allocated, with the size
+**	of their class.
+*/
+
+#define TMMUSTATS_NUMSIZES	16
+
+struct TMMUStats
+{
+	/* Number of bytes currently allocated */
+	TUINT tms_Bytes;
+	/* Highest number of bytes allocated at a time */
+	TUINT tms_PeakBytes;
+	/* Number of allocations */
+	TUINT tms_NumAllocs;
+	/* Number of frees */
+	TUINT tms_NumFrees;
+	/* Number of current allocations, per size */
+	TUINT tms_Sizes[TMMUSTATS_NUMSIZES];
+	/* Number of times a task had to wait for the MMU's lock */
+	TUINT tms_LockWaits;
+	/* Allocations served from per-task caches */
+	TUINT tms_CacheHits;
+	/* Allocations passed on from per-task caches */
+	TUINT tms_CacheMisses;
+};
+
+/*****************************************************************************/
+/*
+**	Worker pool job, as passed to TExecSubmitJob(). The function is
+**	invoked in one of the pool's worker tasks. On completion, the job is
+**	returned to tjb_ReplyPort like a replied message, or with the status
+**	TMSG_STATUS_FAILED if it was cancelled; jobs with a reply port must
+**	therefore be allocated with TExecAllocMsg(). Independently, the task
+**	in tjb_SigTask receives tjb_Signals. Once the job is completed, the
+**	pool no longer accesses it.
+*/
+
+struct TJob;
+
+typedef TTASKENTRY void (*TJOBFUNC)(TAPTR task, struct TJob *job);
+
+struct TJob
+{
+	/* Node header, used by the pool */
+	struct TNode tjb_Node;
+	/* Function to be invoked in a worker task */
+	TJOBFUNC tjb_Func;
+	/* User data */
+	TAPTR tjb_UserData;
+	/* Port to which the job is returned on completion, or TNULL */
+	TAPTR tjb_ReplyPort;
+	/* Task to be signalled on completion, or TNULL */
+	TAPTR tjb_SigTask;
+	/* Signals to appear in sigtask */
+	TUINT tjb_Signals;
+	/* Job status, see below */
+	volatile TUINT tjb_Status;
+	/* Set when a running job is asked to cancel; may be polled by tjb_Func */
+	volatile TBOOL tjb_Cancel;
+	/* Worker in whose queue the job was placed, private */
+	TAPTR tjb_Worker;
+};
+
+/* Job is queued in the pool */
+#define TJOB_QUEUED			1
+/* Job function is running */
+#define TJOB_RUNNING		2
+/* Job function has returned */
+#define TJOB_DONE			3
+/* Job was cancelled before it was run */
+#define TJOB_CANCELLED		4
 
 /*****************************************************************************/
 /*
@@ -203,4 +203,22 @@
 #define TRemModules(im,flags) \
 	(*(((TMODCALL TBOOL(**)(TAPTR,struct TModInitNode *,TUINT))(TExecBase))[-74]))(TExecBase,im,flags)
 
+#define TFindMMU(name) \
+	(*(((TMODCALL TAPTR(**)(TAPTR,TSTRPTR))(TExecBase))[-75]))(TExecBase,name)
+
+#define TGetMMUStats(mmu,stats) \
+	(*(((TMODCALL TBOOL(**)(TAPTR,TAPTR,struct TMMUStats *))(TExecBase))[-76]))(TExecBase,mmu,stats)
+
+#define TCreateWorkerPool(tags) \
+	(*(((TMODCALL TAPTR(**)(TAPTR,TTAGITEM *))(TExecBase))[-77]))(TExecBase,tags)
+
+#define TSubmitJob(pool,job) \
+	(*(((TMODCALL TBOOL(**)(TAPTR,TAPTR,struct TJob *))(TExecBase))[-78]))(TExecBase,pool,job)
+
+#define TCancelJob(pool,job) \
+	(*(((TMODCALL TBOOL(**)(TAPTR,TAPTR,struct TJob *))(TExecBase))[-79]))(TExecBase,pool,job)
+
+#define TGetNamedMMUStats(name,stats) \
+	(*(((TMODCALL TINT(**)(TAPTR,TSTRPTR,struct TMMUStats *))(TExecBase))[-80]))(TExecBase,name,stats)
+
 #endif /* _TEK_INLINE_EXEC_H */
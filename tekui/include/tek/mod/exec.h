@@ -119,6 +119,34 @@ struct TMemPool
 	TUINT16 tpl_Flags;
 };
 
+/*****************************************************************************/
+/*
+**	Slab allocator
+**	Small allocations are served from free lists per size class, which
+**	are refilled by dividing slabs into chunks of the class' size.
+*/
+
+/* Granularity of size classes */
+#define TSLAB_GRAIN			16
+/* Maximum number of size classes */
+#define TSLAB_NUMCLASSES	32
+
+struct TSlabAlloc
+{
+	/* Exec object handle */
+	struct THandle tsa_Handle;
+	/* List of slabs */
+	struct TList tsa_List;
+	/* Parent allocator */
+	TAPTR tsa_MMU;
+	/* Size of slabs */
+	TUINT tsa_SlabSize;
+	/* Largest allocation served from slabs, incl. mmuinfo */
+	TUINT tsa_MaxSize;
+	/* Free chunks per size class */
+	TAPTR tsa_Free[TSLAB_NUMCLASSES];
+};
+
 /*****************************************************************************/
 /*
 **	Locking object
@@ -138,6 +166,8 @@ struct TLock
 	TUINT16 tlk_NestCount;
 	/* Number of waiters */
 	TUINT16 tlk_WaitCount;
+	/* Number of times a task had to wait for the lock */
+	TUINT tlk_Contended;
 };
 
 /*
@@ -172,8 +202,16 @@ struct TMsgPort
 	struct THook *tmp_Hook;
 	/* Signal to appear in sigtask */
 	TUINT tmp_Signal;
+	/* Messages not yet taken over by a lock-free port, newest first */
+	struct TNode * volatile tmp_Incoming;
+	/* Port flags, see below */
+	TUINT tmp_Flags;
 };
 
+/* Port is lock-free: senders push to tmp_Incoming, and tmp_MsgList
+** is accessed by the owner only */
+#define TMSGPORTF_LOCKFREE	0x0001
+
 /*****************************************************************************/
 /*
 **	Memory manager, aka 'MMU'
@@ -221,6 +259,106 @@ struct TMemManager
 	struct TLock tmm_Lock;
 	/* MMU type and capability flags */
 	TUINT tmm_Type;
+	/* Per-task caches of task-safe managers */
+	struct TMMUCache * volatile tmm_Caches;
+	/* Allocation statistics */
+	struct TMMUStats tmm_Stats;
+};
+
+/*****************************************************************************/
+/*
+**	Per-task cache in front of a task-safe memory manager. Small blocks
+**	freed by the owner are kept in per-class magazines, from which they
+**	are allocated again without locking. Blocks freed by other tasks are
+**	returned to their owner through a lock-free stack. When the owner
+**	exits, its magazines are returned to the memory manager, and the
+**	cache is left for reuse by another task.
+*/
+
+#define TMMUCACHE_GRAIN			16
+#define TMMUCACHE_NUMCLASSES	16
+#define TMMUCACHE_DEPTH			32
+
+struct TMMUCache
+{
+	/* Next cache of the same memory manager */
+	struct TMMUCache *tmc_Next;
+	/* Next cache of the same task */
+	struct TMMUCache *tmc_TaskNext;
+	/* Memory manager, TNULL when it was destroyed */
+	struct TMemManager *tmc_MMU;
+	/* Memory manager's underlying allocator functions */
+	TAPTR tmc_Depot;
+	/* Owner task, TNULL when the owner has exited */
+	struct TTask * volatile tmc_Task;
+	/* Blocks freed by other tasks */
+	union TMMUCacheNode * volatile tmc_Remote;
+	/* Number of blocks on the remote stack */
+	volatile TUINT tmc_NumRemote;
+	/* Magazines of free blocks per size class */
+	union TMMUCacheNode *tmc_Free[TMMUCACHE_NUMCLASSES];
+	/* Number of blocks per magazine */
+	TUINT tmc_NumFree[TMMUCACHE_NUMCLASSES];
+	/* Allocations served from a magazine */
+	TUINT tmc_Hits;
+	/* Allocations passed on to the underlying allocator */
+	TUINT tmc_Misses;
+	/* Blocks returned by other tasks */
+	TUINT tmc_RemoteFrees;
+};
+
+/*
+**	Header of a block allocated through a cache
+*/
+
+union TMMUCacheNode
+{
+	struct
+	{
+		/* Next free block in a magazine or remote stack */
+		union TMMUCacheNode *tcn_Next;
+		/* Cache the block belongs to */
+		struct TMMUCache *tcn_Cache;
+	} tcn_Node;
+	/* Enforce per-platform alignment */
+	struct TMMUInfoAlign tcn_Align;
+};
+
+/*****************************************************************************/
+/*
+**	Worker pool
+**	Each worker owns a queue of jobs. Jobs submitted from a worker are
+**	added and taken at the tail of its own queue, jobs from other tasks
+**	are distributed over the workers in turn. Workers whose queues have
+**	run empty steal the oldest jobs from the heads of the other queues.
+*/
+
+struct TWorker
+{
+	/* Pool the worker belongs to */
+	struct TWorkerPool *twk_Pool;
+	/* Worker task */
+	struct TTask *twk_Task;
+	/* Queue of jobs */
+	struct TList twk_Jobs;
+	/* HAL locking object for the queue */
+	struct THALObject twk_Lock;
+	/* Worker is waiting for jobs */
+	volatile TBOOL twk_Idle;
+};
+
+struct TWorkerPool
+{
+	/* Exec object handle */
+	struct THandle twp_Handle;
+	/* Array of workers */
+	struct TWorker *twp_Workers;
+	/* Number of workers */
+	TUINT twp_NumWorkers;
+	/* Worker to receive the next job from outside the pool */
+	TUINT twp_NextWorker;
+	/* Pool is being destroyed */
+	volatile TBOOL twp_Abort;
 };
 
 /*****************************************************************************/
@@ -367,6 +505,9 @@ struct TTask
 
 	/* Task flags, see below */
 	TUINT tsk_Flags;
+
+	/* Caches of task-safe memory managers used by this task */
+	struct TMMUCache *tsk_MMUCaches;
 };
 
 /*
@@ -404,6 +545,9 @@ struct TTask
 **	Execbase structure
 */
 
+/* Number of buckets in the atom hash table, must be a power of two */
+#define TATOM_HASHSIZE			64
+
 typedef struct
 {
 	/* Module header */
@@ -424,8 +568,14 @@ typedef struct
 	struct TList texb_TaskInitList;
 	/* List of closing tasks */
 	struct TList texb_TaskExitList;
-	/* List of named atoms */
-	struct TList texb_AtomList;
+	/* Locking for atom lookup and atom state */
+	struct THALObject texb_AtomLock;
+	/* Named atoms, hashed by name */
+	struct TList texb_AtomHash[TATOM_HASHSIZE];
+	/* Locking for ownership of per-task MMU caches */
+	struct THALObject texb_CacheLock;
+	/* List of named memory managers */
+	struct TList texb_MMUList;
 	/* List of internal modules */
 	struct TList texb_IntModList;
 	/* Node of initial modules (passed from init): */
@@ -32,10 +32,31 @@ struct HALSpecific
 	TUINT hsp_RefCount;					/* Open reference counter */
 	TAPTR hsp_ExecBase;					/* Inserted at device open */
 	TAPTR hsp_DevTask;					/* Created at device open */
-	struct TList hsp_ReqList;					/* List of pending requests */
+	struct HALTimeRequest **hsp_Timers;	/* Pending requests, binary heap */
+	TUINT hsp_NumTimers;				/* Number of pending requests */
+	TUINT hsp_MaxTimers;				/* Capacity of the heap */
 	TINT hsp_TZSec;						/* Seconds west of GMT */
 };
 
+#if defined(HAL_POSIX_FUTEX_USE)
+
+struct HALLock
+{
+	volatile TUINT hlk_State;			/* 0: free, 1: locked, 2: contended */
+};
+
+struct HALThread
+{
+	pthread_t hth_PThread;				/* Thread handle */
+	void *hth_Data;						/* Task data ptr */
+	void (*hth_Function)(void *);		/* Task function */
+	TAPTR hth_HALBase;					/* HAL module base ptr */
+	volatile TUINT hth_SigState;		/* Signal state, futex word */
+	volatile TUINT hth_SigWaiting;		/* Thread is waiting on futex */
+};
+
+#else
+
 struct HALThread
 {
 	pthread_t hth_PThread;				/* Thread handle */
@@ -47,6 +68,14 @@ struct HALThread
 	TUINT hth_SigState;					/* Signal state */
 };
 
+#endif
+
+struct HALTimeRequest
+{
+	struct TTimeRequest htr_Req;		/* Timer request */
+	TUINT htr_Index;					/* Position in the timer heap */
+};
+
 struct HALModule
 {
 	void *hmd_Lib;						/* Host-specific module handle */
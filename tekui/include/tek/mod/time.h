@@ -120,6 +120,23 @@ struct TTimeRequest
 #define	TTREQ_ADDLOCALDATE	(TIOCMD_EXTENDED + 5)	/* Wait for local */
 #define TTREQ_GETDSFROMDATE (TIOCMD_EXTENDED + 6)	/* Daylight saving sec. */
 
+/*
+**	Request flags, in ttr_Req.io_Flags
+*/
+
+#define TTREQF_MONOTONIC	0x0100	/* Time queries use monotonic clock */
+
+/*
+**	Tags for TTimeAllocTimeRequest()
+*/
+
+#define TTIMETAGS_				(TTAG_USER + 0x700)
+
+/* Query time from a monotonic clock which is unaffected by changes to
+** the system time. Its values are meaningful only relative to each
+** other, and cannot be converted to dates */
+#define TTimeRequest_Monotonic	(TTIMETAGS_ + 0)
+
 /*****************************************************************************/
 /*
 **	Revision History
@@ -59,6 +59,11 @@ typedef TTAG TVPEN;
 #define TVisual_PenArray			(TVISTAGS_ + 0x10d)
 
 #define TVisual_ExposeHook			(TVISTAGS_ + 0x10e)
+#define TVisual_CollectExposures	(TVISTAGS_ + 0x10f)
+
+#define TVisual_ImageCacheHits		(TVISTAGS_ + 0x110)
+#define TVisual_ImageCacheMisses	(TVISTAGS_ + 0x111)
+#define TVisual_ImageCacheBytes		(TVISTAGS_ + 0x112)
 
 /* Tagged rendering: */
 
@@ -119,6 +124,17 @@ struct TVRequest
 		struct { TAPTR Instance; TINT Rect[4]; TTAGITEM *Tags; } ClipRect;
 		struct { TAPTR Instance; TINT RRect[4]; TAPTR Buf; TINT TotWidth;
 			TTAGITEM *Tags; } DrawBuffer;
+		struct { TAPTR Instance; TINT Width, Height; TAPTR Pixmap; } AllocPixmap;
+		struct { TAPTR Instance; TAPTR Pixmap; } FreePixmap;
+		struct { TAPTR Instance; TAPTR Pixmap; } SetTarget;
+		struct { TAPTR Instance; TAPTR Pixmap; TINT Rect[4]; TINT DestX;
+			TINT DestY; } DrawPixmap;
+		struct { TAPTR Instance; struct THook *Hook; } GetExposures;
+		struct { TAPTR Instance; TAPTR Pixmap; TINT Border[4];
+			TINT Rect[4]; } DrawNinePatch;
+		struct { TAPTR Instance; TAPTR Key; TINT KeyLen; TVPEN *Pens;
+			TINT NumPens; TINT Rect[4]; TINT Result; } BeginImage;
+		struct { TAPTR Instance; } EndImage;
 	} tvr_Op;
 };
 
@@ -152,6 +168,14 @@ struct TVRequest
 #define TVCMD_UNSETCLIPRECT	0x101b
 #define TVCMD_DRAWFARC		0x101c
 #define TVCMD_DRAWBUFFER	0x101d
+#define TVCMD_ALLOCPIXMAP	0x101e
+#define TVCMD_FREEPIXMAP	0x101f
+#define TVCMD_SETTARGET		0x1020
+#define TVCMD_DRAWPIXMAP	0x1021
+#define TVCMD_GETEXPOSURES	0x1022
+#define TVCMD_DRAWNINEPATCH	0x1023
+#define TVCMD_BEGINIMAGE	0x1024
+#define TVCMD_ENDIMAGE		0x1025
 
 /*****************************************************************************/
 /*
@@ -217,4 +217,22 @@
 #define TExecRemModules(exec,im,flags) \
 	(*(((TMODCALL TBOOL(**)(TAPTR,struct TModInitNode *,TUINT))(exec))[-74]))(exec,im,flags)
 
+#define TExecFindMMU(exec,name) \
+	(*(((TMODCALL TAPTR(**)(TAPTR,TSTRPTR))(exec))[-75]))(exec,name)
+
+#define TExecGetMMUStats(exec,mmu,stats) \
+	(*(((TMODCALL TBOOL(**)(TAPTR,TAPTR,struct TMMUStats *))(exec))[-76]))(exec,mmu,stats)
+
+#define TExecCreateWorkerPool(exec,tags) \
+	(*(((TMODCALL TAPTR(**)(TAPTR,TTAGITEM *))(exec))[-77]))(exec,tags)
+
+#define TExecSubmitJob(exec,pool,job) \
+	(*(((TMODCALL TBOOL(**)(TAPTR,TAPTR,struct TJob *))(exec))[-78]))(exec,pool,job)
+
+#define TExecCancelJob(exec,pool,job) \
+	(*(((TMODCALL TBOOL(**)(TAPTR,TAPTR,struct TJob *))(exec))[-79]))(exec,pool,job)
+
+#define TExecGetNamedMMUStats(exec,name,stats) \
+	(*(((TMODCALL TINT(**)(TAPTR,TSTRPTR,struct TMMUStats *))(exec))[-80]))(exec,name,stats)
+
 #endif /* _TEK_STDCALL_EXEC_H */
@@ -77,4 +77,7 @@
 #define THALJulianToDate(hal,jd,date) \
 	(*(((TMODCALL void(**)(TAPTR,TDOUBLE,TDATE *))(hal))[-31]))(hal,jd,date)
 
+#define THALGetMonoTime(hal,time) \
+	(*(((TMODCALL void(**)(TAPTR,TTIME *))(hal))[-32]))(hal,time)
+
 #endif /* _TEK_STDCALL_HAL_H */
@@ -113,4 +113,28 @@
 #define TVisualDrawBuffer(visual,x,y,buf,w,h,totw,tags) \
 	(*(((TMODCALL void(**)(TAPTR,TINT,TINT,TAPTR,TINT,TINT,TINT,TTAGITEM *))(visual))[-43]))(visual,x,y,buf,w,h,totw,tags)
 
+#define TVisualAllocPixmap(visual,w,h) \
+	(*(((TMODCALL TAPTR(**)(TAPTR,TINT,TINT))(visual))[-44]))(visual,w,h)
+
+#define TVisualFreePixmap(visual,pixmap) \
+	(*(((TMODCALL void(**)(TAPTR,TAPTR))(visual))[-45]))(visual,pixmap)
+
+#define TVisualSetTarget(visual,pixmap) \
+	(*(((TMODCALL void(**)(TAPTR,TAPTR))(visual))[-46]))(visual,pixmap)
+
+#define TVisualDrawPixmap(visual,pixmap,x,y,w,h,dx,dy) \
+	(*(((TMODCALL void(**)(TAPTR,TAPTR,TINT,TINT,TINT,TINT,TINT,TINT))(visual))[-47]))(visual,pixmap,x,y,w,h,dx,dy)
+
+#define TVisualGetExposures(visual,hook) \
+	(*(((TMODCALL void(**)(TAPTR,struct THook *))(visual))[-48]))(visual,hook)
+
+#define TVisualDrawNinePatch(visual,pixmap,border,rect) \
+	(*(((TMODCALL void(**)(TAPTR,TAPTR,TINT *,TINT *))(visual))[-49]))(visual,pixmap,border,rect)
+
+#define TVisualBeginImage(visual,key,keylen,pens,numpens,rect) \
+	(*(((TMODCALL TINT(**)(TAPTR,TAPTR,TINT,TVPEN *,TINT,TINT *))(visual))[-50]))(visual,key,keylen,pens,numpens,rect)
+
+#define TVisualEndImage(visual) \
+	(*(((TMODCALL void(**)(TAPTR))(visual))[-51]))(visual)
+
 #endif /* _TEK_STDCALL_VISUAL_H */
@@ -191,8 +191,12 @@ dfb_init(TMOD_DFB *mod, TTAGITEM *tags)
 			TExecOpenModule(mod->dfb_ExecBase, "time", 0, TNULL);
 		if (mod->dfb_TimeBase == TNULL) break;
 
+		/* timestamps and intervals are on the monotonic clock */
+		tags[0].tti_Tag = TTimeRequest_Monotonic;
+		tags[0].tti_Value = TTRUE;
+		tags[1].tti_Tag = TTAG_DONE;
 		mod->dfb_TimeReq =
-			TTimeAllocTimeRequest(mod->dfb_TimeBase, TNULL);
+			TTimeAllocTimeRequest(mod->dfb_TimeBase, tags);
 
 		tags[0].tti_Tag = TTask_UserData;
 		tags[0].tti_Value = (TTAG) mod;
@@ -516,6 +520,22 @@ dfb_docmd(TMOD_DFB *inst, struct TVRequest *req)
 		case TVCMD_DRAWBUFFER:
 			dfb_drawbuffer(inst, req);
 			break;
+		case TVCMD_ALLOCPIXMAP:
+		case TVCMD_FREEPIXMAP:
+		case TVCMD_SETTARGET:
+		case TVCMD_DRAWPIXMAP:
+		case TVCMD_DRAWNINEPATCH:
+			/* offscreen pixmaps not supported; AllocPixmap returns TNULL */
+			break;
+		case TVCMD_BEGINIMAGE:
+			/* no image cache; images are drawn directly */
+			req->tvr_Op.BeginImage.Result = -1;
+			break;
+		case TVCMD_ENDIMAGE:
+			break;
+		case TVCMD_GETEXPOSURES:
+			/* copies are served from the backbuffer, nothing to collect */
+			break;
 		default:
 			TDBPRINTF(TDB_ERROR,("Unknown command code: %d\n",
 			req->tvr_Req.io_Command));
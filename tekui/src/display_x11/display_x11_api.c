@@ -42,6 +42,8 @@ x11_openvisual(TMOD_X11 *mod, struct TVRequest *req)
 		mod->x11_fm.defref++;
 
 		TInitList(&v->penlist);
+		TInitList(&v->pixmaplist);
+		TInitList(&v->copylist);
 
 		TInitList(&v->imsgqueue);
 		v->imsgport = req->tvr_Op.OpenVisual.IMsgPort;
@@ -143,6 +145,7 @@ x11_openvisual(TMOD_X11 *mod, struct TVRequest *req)
 			swa_mask, &swa);
 		if (v->window == TNULL)
 			break;
+		v->drawable = v->window;
 
 		if (v->sizehints->flags)
 			XSetWMNormalHints(mod->x11_Display, v->window, v->sizehints);
@@ -197,6 +200,8 @@ LOCAL void
 x11_closevisual(TMOD_X11 *mod, struct TVRequest *req)
 {
 	struct X11Pen *pen;
+	struct X11Pixmap *pm;
+	struct TNode *copy;
 	TAPTR exec = TGetExecBase(mod);
 	VISUAL *v = req->tvr_Op.OpenVisual.Instance;
 	if (v == TNULL) return;
@@ -218,6 +223,19 @@ x11_closevisual(TMOD_X11 *mod, struct TVRequest *req)
 	while ((pen = (struct X11Pen *) TRemHead(&v->penlist)))
 		freepen(mod, v, pen);
 
+	while ((pm = (struct X11Pixmap *) TRemHead(&v->pixmaplist)))
+	{
+		XFreePixmap(mod->x11_Display, pm->pixmap);
+		TExecFree(exec, pm);
+	}
+
+	if (v->cacheimage)
+		v->cacheimage->busy = TFALSE;
+
+	while ((copy = TRemHead(&v->copylist)))
+		TExecFree(exec, copy);
+	TExecFree(exec, v->exposures);
+
 	if (v->colormap)
 		XFreeColormap(mod->x11_Display, v->colormap);
 	if (v->sizehints)
@@ -360,7 +378,7 @@ x11_frect(TMOD_X11 *mod, struct TVRequest *req)
 	TUINT x1 = req->tvr_Op.FRect.Rect[2];
 	TUINT y1 = req->tvr_Op.FRect.Rect[3];
 	setfgpen(mod, v, req->tvr_Op.FRect.Pen);
-	XFillRectangle(mod->x11_Display, v->window, v->gc,
+	XFillRectangle(mod->x11_Display, v->drawable, v->gc,
 		x0, y0, x1, y1);
 }
 
@@ -375,7 +393,7 @@ x11_line(TMOD_X11 *mod, struct TVRequest *req)
 	TUINT x1 = req->tvr_Op.Line.Rect[2];
 	TUINT y1 = req->tvr_Op.Line.Rect[3];
 	setfgpen(mod, v, req->tvr_Op.Line.Pen);
-	XDrawLine(mod->x11_Display, v->window, v->gc,
+	XDrawLine(mod->x11_Display, v->drawable, v->gc,
 		x0, y0, x1, y1);
 }
 
@@ -390,7 +408,7 @@ x11_rect(TMOD_X11 *mod, struct TVRequest *req)
 	TUINT x1 = req->tvr_Op.Rect.Rect[2];
 	TUINT y1 = req->tvr_Op.Rect.Rect[3];
 	setfgpen(mod, v, req->tvr_Op.Rect.Pen);
-	XDrawRectangle(mod->x11_Display, v->window, v->gc,
+	XDrawRectangle(mod->x11_Display, v->drawable, v->gc,
 		x0, y0, x1 - 1, y1 - 1);
 }
 
@@ -403,7 +421,35 @@ x11_plot(TMOD_X11 *mod, struct TVRequest *req)
 	TUINT x0 = req->tvr_Op.Plot.Rect[0];
 	TUINT y0 = req->tvr_Op.Plot.Rect[1];
 	setfgpen(mod, v, req->tvr_Op.Plot.Pen);
-	XDrawPoint(mod->x11_Display, v->window, v->gc, x0, y0);
+	XDrawPoint(mod->x11_Display, v->drawable, v->gc, x0, y0);
+}
+
+/*****************************************************************************/
+/*
+**	Fill a triangle, or render it into the image cache entry, if one is
+**	being rendered; see x11_beginimage().
+*/
+
+static void
+fillpoly(TMOD_X11 *mod, VISUAL *v, XPoint *tri, TVPEN pen)
+{
+	struct X11Image *im = v->cacheimage;
+	if (im)
+	{
+		if (pen != TVPEN_UNDEFINED)
+			XSetForeground(mod->x11_Display, mod->x11_ImageGC,
+				((struct X11Pen *) pen)->color.pixel);
+		XFillPolygon(mod->x11_Display, im->pixmap, mod->x11_ImageGC, tri, 3,
+			Nonconvex, CoordModeOrigin);
+		XFillPolygon(mod->x11_Display, im->mask, mod->x11_MaskGC, tri, 3,
+			Nonconvex, CoordModeOrigin);
+	}
+	else
+	{
+		setfgpen(mod, v, pen);
+		XFillPolygon(mod->x11_Display, v->drawable, v->gc, tri, 3,
+			Nonconvex, CoordModeOrigin);
+	}
 }
 
 /*****************************************************************************/
@@ -423,9 +469,7 @@ x11_drawstrip(TMOD_X11 *mod, struct TVRequest *req)
 	if (num < 3) return;
 
 	if (penarray)
-		setfgpen(mod, v, penarray[2]);
-	else
-		setfgpen(mod, v, pen);
+		pen = penarray[2];
 
 	tri[0].x = (TINT16) array[0];
 	tri[0].y = (TINT16) array[1];
@@ -434,8 +478,7 @@ x11_drawstrip(TMOD_X11 *mod, struct TVRequest *req)
 	tri[2].x = (TINT16) array[4];
 	tri[2].y = (TINT16) array[5];
 
-	XFillPolygon(mod->x11_Display, v->window, v->gc, tri, 3,
-		Nonconvex, CoordModeOrigin);
+	fillpoly(mod, v, tri, pen);
 
 	for (i = 3; i < num; i++)
 	{
@@ -447,10 +490,9 @@ x11_drawstrip(TMOD_X11 *mod, struct TVRequest *req)
 		tri[2].y = (TINT16) array[i*2+1];
 
 		if (penarray)
-			setfgpen(mod, v, penarray[i]);
+			pen = penarray[i];
 
-		XFillPolygon(mod->x11_Display, v->window, v->gc, tri, 3,
-			Nonconvex, CoordModeOrigin);
+		fillpoly(mod, v, tri, pen);
 	}
 }
 
@@ -471,9 +513,7 @@ x11_drawfan(TMOD_X11 *mod, struct TVRequest *req)
 	if (num < 3) return;
 
 	if (penarray)
-		setfgpen(mod, v, penarray[2]);
-	else
-		setfgpen(mod, v, pen);
+		pen = penarray[2];
 
 	tri[0].x = (TINT16) array[0];
 	tri[0].y = (TINT16) array[1];
@@ -482,8 +522,7 @@ x11_drawfan(TMOD_X11 *mod, struct TVRequest *req)
 	tri[2].x = (TINT16) array[4];
 	tri[2].y = (TINT16) array[5];
 
-	XFillPolygon(mod->x11_Display, v->window, v->gc, tri, 3,
-		Nonconvex, CoordModeOrigin);
+	fillpoly(mod, v, tri, pen);
 
 	for (i = 3; i < num; i++)
 	{
@@ -493,10 +532,9 @@ x11_drawfan(TMOD_X11 *mod, struct TVRequest *req)
 		tri[2].y = (TINT16) array[i*2+1];
 
 		if (penarray)
-			setfgpen(mod, v, penarray[i]);
+			pen = penarray[i];
 
-		XFillPolygon(mod->x11_Display, v->window, v->gc, tri, 3,
-			Nonconvex, CoordModeOrigin);
+		fillpoly(mod, v, tri, pen);
 	}
 }
 
@@ -514,7 +552,7 @@ x11_drawarc(TMOD_X11 *mod, struct TVRequest *req)
 	TINT a2 = req->tvr_Op.Arc.Angle2*64;
 
 	setfgpen(mod, v, req->tvr_Op.Arc.Pen);
-	XDrawArc(mod->x11_Display, v->window, v->gc, x, y, w, h, a1, a2);
+	XDrawArc(mod->x11_Display, v->drawable, v->gc, x, y, w, h, a1, a2);
 }
 
 /*****************************************************************************/
@@ -531,11 +569,31 @@ x11_drawfarc(TMOD_X11 *mod, struct TVRequest *req)
 	TINT a2 = req->tvr_Op.Arc.Angle2*64;
 
 	setfgpen(mod, v, req->tvr_Op.Arc.Pen);
-	XFillArc(mod->x11_Display, v->window, v->gc, x, y, w, h, a1, a2);
+	XFillArc(mod->x11_Display, v->drawable, v->gc, x, y, w, h, a1, a2);
 }
 
 /*****************************************************************************/
 
+static void
+x11_addrect(TMOD_X11 *mod, VISUAL *v, TINT x0, TINT y0, TINT x1, TINT y1);
+
+/*
+**	Exposure hook for copies which could not be recorded for asynchronous
+**	collection. Nothing is issued while the request is in progress, so
+**	the exposures need no transformation.
+*/
+
+static THOOKENTRY TTAG
+x11_collectexposure(struct THook *hook, TAPTR obj, TTAG msg)
+{
+	TMOD_X11 *mod = hook->thk_Data;
+	VISUAL *v = obj;
+	TINT *r = (TINT *) msg;
+	x11_addrect(mod, v, r[0], r[1], r[2], r[3]);
+	x11_wakeexposures(mod, v);
+	return 0;
+}
+
 LOCAL void
 x11_copyarea(TMOD_X11 *mod, struct TVRequest *req)
 {
@@ -546,21 +604,155 @@ x11_copyarea(TMOD_X11 *mod, struct TVRequest *req)
 	TINT h = req->tvr_Op.CopyArea.Rect[3];
 	TINT dx = req->tvr_Op.CopyArea.DestX;
 	TINT dy = req->tvr_Op.CopyArea.DestY;
+	TTAGITEM *tags = req->tvr_Op.CopyArea.Tags;
+	struct THook *hook = (struct THook *)
+		TGetTag(tags, TVisual_ExposeHook, TNULL);
+	struct X11Copy copy, *c;
+
+	if (v->drawable != v->window)
+	{
+		/* pixmaps are always complete, no exposures to expect: */
+		XSetGraphicsExposures(mod->x11_Display, v->gc, False);
+		XCopyArea(mod->x11_Display, v->drawable, v->drawable, v->gc,
+			x, y, w, h, dx, dy);
+		XSetGraphicsExposures(mod->x11_Display, v->gc, True);
+		return;
+	}
+
+	c = &copy;
+	if (TGetTag(tags, TVisual_CollectExposures, TFALSE) && hook == TNULL)
+	{
+		/* exposures are collected asynchronously, see x11_addexposure: */
+		c = TExecAlloc(TGetExecBase(mod), mod->x11_MemMgr,
+			sizeof(struct X11Copy));
+		if (c == TNULL)
+		{
+			/* out of memory; wait for the exposures, and collect them: */
+			TInitHook(&mod->x11_CollectHook, x11_collectexposure, mod);
+			hook = &mod->x11_CollectHook;
+			c = &copy;
+		}
+	}
+	c->serial = NextRequest(mod->x11_Display);
+	c->rect[0] = x;
+	c->rect[1] = y;
+	c->rect[2] = x + w - 1;
+	c->rect[3] = y + h - 1;
+	c->dx = dx - x;
+	c->dy = dy - y;
+
+	/* exposures collected so far move along with the contents: */
+	x11_transformexposures(mod, v, 0, c);
+
+	if (c == &copy && hook == TNULL)
+	{
+		/* exposures not wanted; avoid unaccounted expose events: */
+		XSetGraphicsExposures(mod->x11_Display, v->gc, False);
+		XCopyArea(mod->x11_Display, v->drawable, v->drawable, v->gc,
+			x, y, w, h, dx, dy);
+		XSetGraphicsExposures(mod->x11_Display, v->gc, True);
+		return;
+	}
 
-	XCopyArea(mod->x11_Display, v->window, v->window, v->gc,
+	XCopyArea(mod->x11_Display, v->drawable, v->drawable, v->gc,
 		x, y, w, h, dx, dy);
 
-	mod->x11_CopyExposeHook = (struct THook *)
-		TGetTag(req->tvr_Op.CopyArea.Tags, TVisual_ExposeHook, TNULL);
-	if (mod->x11_CopyExposeHook)
+	if (c != &copy)
+		TAddTail(&v->copylist, &c->node);
+	else
 	{
 		/* register request in progress: */
+		mod->x11_CopyExposeHook = hook;
 		mod->x11_RequestInProgress = req;
 	}
 }
 
 /*****************************************************************************/
 
+static void
+x11_addrect(TMOD_X11 *mod, VISUAL *v, TINT x0, TINT y0, TINT x1, TINT y1)
+{
+	TINT *r;
+	if (v->numexposures == v->maxexposures)
+	{
+		TAPTR exec = TGetExecBase(mod);
+		TINT max = v->maxexposures ? v->maxexposures * 2 : 16;
+		TINT *buf = TExecAlloc(exec, mod->x11_MemMgr, sizeof(TINT) * 4 * max);
+		if (buf == TNULL)
+			return;
+		if (v->exposures)
+		{
+			TExecCopyMem(exec, v->exposures, buf,
+				sizeof(TINT) * 4 * v->numexposures);
+			TExecFree(exec, v->exposures);
+		}
+		v->exposures = buf;
+		v->maxexposures = max;
+	}
+	r = v->exposures + v->numexposures++ * 4;
+	r[0] = x0;
+	r[1] = y0;
+	r[2] = x1;
+	r[3] = y1;
+}
+
+/*
+**	Apply a copy to the exposures collected from the given index: The part
+**	of a damage inside the copy's source is damaged at the destination,
+**	too. The original damage is retained, as it might not have been covered
+**	by the copy.
+*/
+
+LOCAL void
+x11_transformexposures(TMOD_X11 *mod, VISUAL *v, TINT first,
+	struct X11Copy *c)
+{
+	TINT i, n = v->numexposures;
+	for (i = first; i < n; ++i)
+	{
+		TINT *r = v->exposures + i * 4;
+		TINT x0 = TMAX(r[0], c->rect[0]);
+		TINT y0 = TMAX(r[1], c->rect[1]);
+		TINT x1 = TMIN(r[2], c->rect[2]);
+		TINT y1 = TMIN(r[3], c->rect[3]);
+		if (x0 <= x1 && y0 <= y1)
+			x11_addrect(mod, v, x0 + c->dx, y0 + c->dy, x1 + c->dx,
+				y1 + c->dy);
+	}
+}
+
+/*
+**	Add an exposure resulting from copy c. Copies issued after the one the
+**	exposure belongs to have already been performed by the server, so the
+**	damage is carried along with them.
+*/
+
+LOCAL void
+x11_addexposure(TMOD_X11 *mod, VISUAL *v, TINT *rect, struct X11Copy *c)
+{
+	TINT first = v->numexposures;
+	struct TNode *next, *node = c->node.tln_Succ;
+	x11_addrect(mod, v, rect[0], rect[1], rect[2], rect[3]);
+	for (; (next = node->tln_Succ); node = next)
+		x11_transformexposures(mod, v, first, (struct X11Copy *) node);
+}
+
+/*****************************************************************************/
+
+LOCAL void
+x11_getexposures(TMOD_X11 *mod, struct TVRequest *req)
+{
+	VISUAL *v = req->tvr_Op.GetExposures.Instance;
+	struct THook *hook = req->tvr_Op.GetExposures.Hook;
+	TINT i;
+	for (i = 0; i < v->numexposures; ++i)
+		TCallHookPkt(hook, v, (TTAG) (v->exposures + i * 4));
+	v->numexposures = 0;
+	v->exposurewake = TFALSE;
+}
+
+/*****************************************************************************/
+
 LOCAL void
 x11_setcliprect(TMOD_X11 *mod, struct TVRequest *req)
 {
@@ -579,6 +771,12 @@ x11_setcliprect(TMOD_X11 *mod, struct TVRequest *req)
 	rectangle.width = (unsigned short) w;
 	rectangle.height = (unsigned short) h;
 
+	v->cliprect[0] = x;
+	v->cliprect[1] = y;
+	v->cliprect[2] = w;
+	v->cliprect[3] = h;
+	v->clipped = TTRUE;
+
 	/* union rect into region */
 	XUnionRectWithRegion(&rectangle, region, region);
 	/* set clip region */
@@ -597,6 +795,7 @@ x11_unsetcliprect(TMOD_X11 *mod, struct TVRequest *req)
 {
 	VISUAL *v = req->tvr_Op.ClipRect.Instance;
 	/*XSetClipMask(mod->x11_Display, v->gc, None);*/
+	v->clipped = TFALSE;
 	XSetRegion(mod->x11_Display, v->gc, mod->x11_HugeRegion);
 	if (mod->x11_use_xft)
 		(*mod->x11_xftiface.XftDrawSetClip)(v->draw, mod->x11_HugeRegion);
@@ -609,7 +808,7 @@ x11_clear(TMOD_X11 *mod, struct TVRequest *req)
 {
 	VISUAL *v = req->tvr_Op.Clear.Instance;
 	setfgpen(mod, v, req->tvr_Op.Clear.Pen);
-	XFillRectangle(mod->x11_Display, v->window, v->gc,
+	XFillRectangle(mod->x11_Display, v->drawable, v->gc,
 		0, 0, v->winwidth, v->winheight);
 }
 
@@ -650,6 +849,15 @@ getattrfunc(struct THook *hook, TAPTR obj, TTAG msg)
 		case TVisual_MaxHeight:
 			*((TINT *) item->tti_Value) = v->sizehints->max_height;
 			break;
+		case TVisual_ImageCacheHits:
+			*((TUINT *) item->tti_Value) = data->mod->x11_ImageCacheHits;
+			break;
+		case TVisual_ImageCacheMisses:
+			*((TUINT *) item->tti_Value) = data->mod->x11_ImageCacheMisses;
+			break;
+		case TVisual_ImageCacheBytes:
+			*((TSIZE *) item->tti_Value) = data->mod->x11_ImageCacheBytes;
+			break;
 	}
 	data->num++;
 	return TTRUE;
@@ -822,7 +1030,7 @@ x11_drawtext(TMOD_X11 *mod, struct TVRequest *req)
 			if (latin)
 			{
 				XFontStruct *f = ((struct FontNode *) v->curfont)->font;
-				XDrawString(mod->x11_Display, v->window, v->gc,
+				XDrawString(mod->x11_Display, v->drawable, v->gc,
 					x, y + f->ascent, (char *) latin, strlen(latin));
 				TExecFree(exec, latin);
 			}
@@ -847,7 +1055,7 @@ x11_drawtext(TMOD_X11 *mod, struct TVRequest *req)
 			if (latin)
 			{
 				XFontStruct *f = ((struct FontNode *) v->curfont)->font;
-				XDrawImageString(mod->x11_Display, v->window, v->gc,
+				XDrawImageString(mod->x11_Display, v->drawable, v->gc,
 					x, y + f->ascent, (char *) latin, strlen(latin));
 				TExecFree(exec, latin);
 			}
@@ -933,7 +1141,7 @@ struct drawdata
 	VISUAL *v;
 	TMOD_X11 *mod;
 	Display *display;
-	Window window;
+	Drawable drawable;
 	GC gc;
 	TINT x0, x1, y0, y1;
 };
@@ -976,15 +1184,15 @@ drawtagfunc(struct THook *hook, TAPTR obj, TTAG msg)
 			switch (item->tti_Value)
 			{
 				case TVCMD_FRECT:
-					XFillRectangle(data->display, data->window, data->gc,
+					XFillRectangle(data->display, data->drawable, data->gc,
 						data->x0, data->y0, data->x1, data->y1);
 					break;
 				case TVCMD_RECT:
-					XDrawRectangle(data->display, data->window, data->gc,
+					XDrawRectangle(data->display, data->drawable, data->gc,
 						data->x0, data->y0, data->x1 - 1, data->y1 - 1);
 					break;
 				case TVCMD_LINE:
-					XDrawLine(data->display, data->window, data->gc,
+					XDrawLine(data->display, data->drawable, data->gc,
 						data->x0, data->y0, data->x1, data->y1);
 					break;
 			}
@@ -1001,7 +1209,7 @@ x11_drawtags(TMOD_X11 *mod, struct TVRequest *req)
 	data.v = req->tvr_Op.DrawTags.Instance;
 	data.mod = mod;
 	data.display = mod->x11_Display;
-	data.window = data.v->window;
+	data.drawable = data.v->drawable;
 	data.gc = data.v->gc;
 
 	TInitHook(&hook, drawtagfunc, &data);
@@ -1261,14 +1469,389 @@ x11_drawbuffer(TMOD_X11 *mod, struct TVRequest *req)
 
 		if (shm_available && mod->x11_Shm)
 		{
-			XShmPutImage(mod->x11_Display, v->window, v->gc, v->image, 0, 0,
+			XShmPutImage(mod->x11_Display, v->drawable, v->gc, v->image, 0, 0,
 				x0, y0, w, h, 1);
 			mod->x11_RequestInProgress = req;
 		}
 		else
 		{
-			XPutImage(mod->x11_Display, v->window, v->gc, v->image, 0, 0,
+			XPutImage(mod->x11_Display, v->drawable, v->gc, v->image, 0, 0,
 				x0, y0, w, h);
 		}
 	}
 }
+
+/*****************************************************************************/
+
+LOCAL void
+x11_allocpixmap(TMOD_X11 *mod, struct TVRequest *req)
+{
+	TAPTR exec = TGetExecBase(mod);
+	VISUAL *v = req->tvr_Op.AllocPixmap.Instance;
+	TINT w = req->tvr_Op.AllocPixmap.Width;
+	TINT h = req->tvr_Op.AllocPixmap.Height;
+	struct X11Pixmap *pm;
+
+	req->tvr_Op.AllocPixmap.Pixmap = TNULL;
+	if (w <= 0 || h <= 0)
+		return;
+
+	pm = TExecAlloc(exec, mod->x11_MemMgr, sizeof(struct X11Pixmap));
+	if (pm)
+	{
+		pm->pixmap = XCreatePixmap(mod->x11_Display, v->window, w, h,
+			DefaultDepth(mod->x11_Display, mod->x11_Screen));
+		if (pm->pixmap)
+		{
+			pm->width = w;
+			pm->height = h;
+			TAddTail(&v->pixmaplist, &pm->node);
+			req->tvr_Op.AllocPixmap.Pixmap = pm;
+			return;
+		}
+		TExecFree(exec, pm);
+	}
+}
+
+/*****************************************************************************/
+
+LOCAL void
+x11_freepixmap(TMOD_X11 *mod, struct TVRequest *req)
+{
+	VISUAL *v = req->tvr_Op.FreePixmap.Instance;
+	struct X11Pixmap *pm = req->tvr_Op.FreePixmap.Pixmap;
+	if (pm == TNULL)
+		return;
+	if (v->drawable == pm->pixmap)
+	{
+		v->drawable = v->window;
+		if (mod->x11_use_xft == TTRUE)
+			(*mod->x11_xftiface.XftDrawChange)(v->draw, v->drawable);
+	}
+	TRemove(&pm->node);
+	XFreePixmap(mod->x11_Display, pm->pixmap);
+	TExecFree(TGetExecBase(mod), pm);
+}
+
+/*****************************************************************************/
+
+LOCAL void
+x11_settarget(TMOD_X11 *mod, struct TVRequest *req)
+{
+	VISUAL *v = req->tvr_Op.SetTarget.Instance;
+	struct X11Pixmap *pm = req->tvr_Op.SetTarget.Pixmap;
+	Drawable d = pm ? pm->pixmap : v->window;
+	if (d != v->drawable)
+	{
+		v->drawable = d;
+		if (mod->x11_use_xft == TTRUE)
+			(*mod->x11_xftiface.XftDrawChange)(v->draw, d);
+	}
+}
+
+/*****************************************************************************/
+
+LOCAL void
+x11_drawpixmap(TMOD_X11 *mod, struct TVRequest *req)
+{
+	VISUAL *v = req->tvr_Op.DrawPixmap.Instance;
+	struct X11Pixmap *pm = req->tvr_Op.DrawPixmap.Pixmap;
+	TINT x = req->tvr_Op.DrawPixmap.Rect[0];
+	TINT y = req->tvr_Op.DrawPixmap.Rect[1];
+	TINT w = req->tvr_Op.DrawPixmap.Rect[2];
+	TINT h = req->tvr_Op.DrawPixmap.Rect[3];
+	TINT dx = req->tvr_Op.DrawPixmap.DestX;
+	TINT dy = req->tvr_Op.DrawPixmap.DestY;
+
+	/* pixmaps are always complete, suppress the NoExpose round trip: */
+	XSetGraphicsExposures(mod->x11_Display, v->gc, False);
+	XCopyArea(mod->x11_Display, pm->pixmap, v->drawable, v->gc,
+		x, y, w, h, dx, dy);
+	XSetGraphicsExposures(mod->x11_Display, v->gc, True);
+}
+
+/*****************************************************************************/
+
+static void
+copypatch(TMOD_X11 *mod, VISUAL *v, Pixmap pm, TINT x, TINT y, TINT w,
+	TINT h, TINT dx, TINT dy)
+{
+	if (w > 0 && h > 0)
+		XCopyArea(mod->x11_Display, pm, v->drawable, v->gc, x, y, w, h,
+			dx, dy);
+}
+
+/*
+**	Draw a border from a nine-patch: The pixmap contains a border of the
+**	given thicknesses around a center; corners are copied as they are,
+**	edges are assembled from pieces of the center's width or height.
+*/
+
+LOCAL void
+x11_drawninepatch(TMOD_X11 *mod, struct TVRequest *req)
+{
+	VISUAL *v = req->tvr_Op.DrawNinePatch.Instance;
+	struct X11Pixmap *pm = req->tvr_Op.DrawNinePatch.Pixmap;
+	TINT *b = req->tvr_Op.DrawNinePatch.Border;
+	TINT x0 = req->tvr_Op.DrawNinePatch.Rect[0];
+	TINT y0 = req->tvr_Op.DrawNinePatch.Rect[1];
+	TINT x1 = req->tvr_Op.DrawNinePatch.Rect[2];
+	TINT y1 = req->tvr_Op.DrawNinePatch.Rect[3];
+	TINT cw = pm->width - b[0] - b[2];
+	TINT ch = pm->height - b[1] - b[3];
+	TINT w = x1 - x0 + 1;
+	TINT h = y1 - y0 + 1;
+	TINT i;
+
+	if (cw <= 0 || ch <= 0)
+		return;
+
+	XSetGraphicsExposures(mod->x11_Display, v->gc, False);
+
+	/* corners: */
+	copypatch(mod, v, pm->pixmap, 0, 0, b[0], b[1], x0 - b[0], y0 - b[1]);
+	copypatch(mod, v, pm->pixmap, b[0] + cw, 0, b[2], b[1], x1 + 1,
+		y0 - b[1]);
+	copypatch(mod, v, pm->pixmap, 0, b[1] + ch, b[0], b[3], x0 - b[0],
+		y1 + 1);
+	copypatch(mod, v, pm->pixmap, b[0] + cw, b[1] + ch, b[2], b[3], x1 + 1,
+		y1 + 1);
+
+	/* top and bottom edges: */
+	for (i = 0; i < w; i += cw)
+	{
+		TINT n = TMIN(cw, w - i);
+		copypatch(mod, v, pm->pixmap, b[0], 0, n, b[1], x0 + i, y0 - b[1]);
+		copypatch(mod, v, pm->pixmap, b[0], b[1] + ch, n, b[3], x0 + i,
+			y1 + 1);
+	}
+
+	/* left and right edges: */
+	for (i = 0; i < h; i += ch)
+	{
+		TINT n = TMIN(ch, h - i);
+		copypatch(mod, v, pm->pixmap, 0, b[1], b[0], n, x0 - b[0], y0 + i);
+		copypatch(mod, v, pm->pixmap, b[0] + cw, b[1], b[2], n, x1 + 1,
+			y0 + i);
+	}
+
+	XSetGraphicsExposures(mod->x11_Display, v->gc, True);
+}
+
+/*****************************************************************************/
+/*
+**	Image cache: Images are rendered once per key, size and set of pens
+**	into a pixmap and a mask, from which they are subsequently drawn with
+**	a single XCopyArea. Entries are kept in LRU order and evicted when the
+**	cache exceeds X11_IMAGECACHE_BYTES.
+*/
+
+static TUINT
+hashimage(TUINT8 *key, TINT len)
+{
+	TUINT h = 2166136261u;
+	while (len--)
+		h = (h ^ *key++) * 16777619u;
+	return h;
+}
+
+static TBOOL
+initimagecache(TMOD_X11 *mod)
+{
+	if (mod->x11_ImageGC == TNULL)
+	{
+		Display *d = mod->x11_Display;
+		Window root = DefaultRootWindow(d);
+		Pixmap bitmap = XCreatePixmap(d, root, 1, 1, 1);
+		XGCValues gcv;
+		gcv.graphics_exposures = False;
+		gcv.foreground = 1;
+		mod->x11_MaskGC = XCreateGC(d, bitmap,
+			GCGraphicsExposures | GCForeground, &gcv);
+		XFreePixmap(d, bitmap);
+		mod->x11_ImageGC = XCreateGC(d, root, GCGraphicsExposures, &gcv);
+	}
+	return mod->x11_ImageGC && mod->x11_MaskGC;
+}
+
+static void
+freeimage(TMOD_X11 *mod, struct X11Image *im)
+{
+	struct X11Image **pp = &mod->x11_ImageHash[im->hash % X11_IMAGECACHE_HASH];
+	for (; *pp; pp = &(*pp)->next)
+	{
+		if (*pp == im)
+		{
+			*pp = im->next;
+			break;
+		}
+	}
+	TRemove(&im->node);
+	mod->x11_ImageCacheBytes -= im->bytes;
+	XFreePixmap(mod->x11_Display, im->pixmap);
+	XFreePixmap(mod->x11_Display, im->mask);
+	TExecFree(TGetExecBase(mod), im);
+}
+
+LOCAL void
+x11_freeimagecache(TMOD_X11 *mod)
+{
+	struct X11Image *im;
+	while ((im = (struct X11Image *) TFIRSTNODE(&mod->x11_ImageCache)))
+		freeimage(mod, im);
+	if (mod->x11_ImageGC)
+		XFreeGC(mod->x11_Display, mod->x11_ImageGC);
+	if (mod->x11_MaskGC)
+		XFreeGC(mod->x11_Display, mod->x11_MaskGC);
+	mod->x11_ImageGC = TNULL;
+	mod->x11_MaskGC = TNULL;
+}
+
+static void
+drawimage(TMOD_X11 *mod, VISUAL *v, struct X11Image *im, TINT x, TINT y)
+{
+	TINT x0 = x, y0 = y;
+	TINT x1 = x + im->width - 1, y1 = y + im->height - 1;
+	if (v->clipped)
+	{
+		x0 = TMAX(x0, v->cliprect[0]);
+		y0 = TMAX(y0, v->cliprect[1]);
+		x1 = TMIN(x1, v->cliprect[0] + v->cliprect[2] - 1);
+		y1 = TMIN(y1, v->cliprect[1] + v->cliprect[3] - 1);
+	}
+	if (x0 > x1 || y0 > y1)
+		return;
+	XSetClipMask(mod->x11_Display, mod->x11_ImageGC, im->mask);
+	XSetClipOrigin(mod->x11_Display, mod->x11_ImageGC, x, y);
+	XCopyArea(mod->x11_Display, im->pixmap, v->drawable, mod->x11_ImageGC,
+		x0 - x, y0 - y, x1 - x0 + 1, y1 - y0 + 1, x0, y0);
+	XSetClipMask(mod->x11_Display, mod->x11_ImageGC, None);
+}
+
+LOCAL void
+x11_beginimage(TMOD_X11 *mod, struct TVRequest *req)
+{
+	TAPTR exec = TGetExecBase(mod);
+	VISUAL *v = req->tvr_Op.BeginImage.Instance;
+	TINT keylen = req->tvr_Op.BeginImage.KeyLen;
+	TINT numpens = req->tvr_Op.BeginImage.NumPens;
+	TVPEN *pens = req->tvr_Op.BeginImage.Pens;
+	TINT x = req->tvr_Op.BeginImage.Rect[0];
+	TINT y = req->tvr_Op.BeginImage.Rect[1];
+	TINT w = req->tvr_Op.BeginImage.Rect[2];
+	TINT h = req->tvr_Op.BeginImage.Rect[3];
+	TINT len = sizeof(TINT) * 2 + keylen + sizeof(unsigned long) * numpens;
+	TSIZE bytes = (TSIZE) w * h * mod->x11_BPP + (w + 7) / 8 * h;
+	struct X11Image *im;
+	TUINT8 *key;
+	TUINT hash;
+	TINT i;
+
+	req->tvr_Op.BeginImage.Result = -1;
+	if (w <= 0 || h <= 0 || bytes > X11_IMAGECACHE_BYTES / 4 ||
+		v->cacheimage || !initimagecache(mod))
+		return;
+
+	/* the key consists of the size, the caller's key, and pixel values: */
+	key = TExecAlloc(exec, mod->x11_MemMgr, len);
+	if (key == TNULL)
+		return;
+	((TINT *) key)[0] = w;
+	((TINT *) key)[1] = h;
+	memcpy(key + sizeof(TINT) * 2, req->tvr_Op.BeginImage.Key, keylen);
+	for (i = 0; i < numpens; ++i)
+	{
+		unsigned long pixel = pens[i] == TVPEN_UNDEFINED ? 0 :
+			((struct X11Pen *) pens[i])->color.pixel;
+		memcpy(key + sizeof(TINT) * 2 + keylen + sizeof(pixel) * i,
+			&pixel, sizeof(pixel));
+	}
+	hash = hashimage(key, len);
+
+	for (im = mod->x11_ImageHash[hash % X11_IMAGECACHE_HASH]; im;
+		im = im->next)
+	{
+		if (im->hash == hash && im->keylen == len &&
+			memcmp(im + 1, key, len) == 0)
+		{
+			/* hit; move to the end of the LRU list and draw: */
+			TExecFree(exec, key);
+			TRemove(&im->node);
+			TAddTail(&mod->x11_ImageCache, &im->node);
+			mod->x11_ImageCacheHits++;
+			drawimage(mod, v, im, x, y);
+			req->tvr_Op.BeginImage.Result = 1;
+			return;
+		}
+	}
+
+	mod->x11_ImageCacheMisses++;
+
+	/* evict least recently used entries: */
+	while (mod->x11_ImageCacheBytes + bytes > X11_IMAGECACHE_BYTES)
+	{
+		struct TNode *next, *node = mod->x11_ImageCache.tlh_Head;
+		for (; (next = node->tln_Succ); node = next)
+			if (!((struct X11Image *) node)->busy)
+				break;
+		if (next == TNULL)
+			break;
+		freeimage(mod, (struct X11Image *) node);
+	}
+
+	im = TExecAlloc0(exec, mod->x11_MemMgr, sizeof(struct X11Image) + len);
+	if (im)
+	{
+		Window root = DefaultRootWindow(mod->x11_Display);
+		im->pixmap = XCreatePixmap(mod->x11_Display, root, w, h,
+			DefaultDepth(mod->x11_Display, mod->x11_Screen));
+		im->mask = XCreatePixmap(mod->x11_Display, root, w, h, 1);
+		if (im->pixmap && im->mask)
+		{
+			im->hash = hash;
+			im->width = w;
+			im->height = h;
+			im->bytes = bytes;
+			im->keylen = len;
+			im->busy = TTRUE;
+			memcpy(im + 1, key, len);
+			im->next = mod->x11_ImageHash[hash % X11_IMAGECACHE_HASH];
+			mod->x11_ImageHash[hash % X11_IMAGECACHE_HASH] = im;
+			TAddTail(&mod->x11_ImageCache, &im->node);
+			mod->x11_ImageCacheBytes += bytes;
+
+			/* clear the mask: */
+			XSetForeground(mod->x11_Display, mod->x11_MaskGC, 0);
+			XFillRectangle(mod->x11_Display, im->mask, mod->x11_MaskGC,
+				0, 0, w, h);
+			XSetForeground(mod->x11_Display, mod->x11_MaskGC, 1);
+
+			v->cacheimage = im;
+			v->cacheimagex = x;
+			v->cacheimagey = y;
+			req->tvr_Op.BeginImage.Result = 0;
+		}
+		else
+		{
+			if (im->pixmap)
+				XFreePixmap(mod->x11_Display, im->pixmap);
+			if (im->mask)
+				XFreePixmap(mod->x11_Display, im->mask);
+			TExecFree(exec, im);
+		}
+	}
+	TExecFree(exec, key);
+}
+
+LOCAL void
+x11_endimage(TMOD_X11 *mod, struct TVRequest *req)
+{
+	VISUAL *v = req->tvr_Op.EndImage.Instance;
+	struct X11Image *im = v->cacheimage;
+	if (im)
+	{
+		v->cacheimage = TNULL;
+		im->busy = TFALSE;
+		drawimage(mod, v, im, v->cacheimagex, v->cacheimagey);
+	}
+}
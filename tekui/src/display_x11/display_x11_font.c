@@ -47,6 +47,7 @@ TSTRPTR libxftsyms[LIBXFT_NUMSYMS] =
 	"XftDrawCreate",
 	"XftDrawDestroy",
 	"XftDrawSetClip",
+	"XftDrawChange",
 };
 
 static const
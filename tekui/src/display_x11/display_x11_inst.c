@@ -1,13 +1,29 @@
 
+#if defined(__linux__)
+/* for CLOCK_MONOTONIC under _XOPEN_SOURCE */
+#define _GNU_SOURCE
+#endif
+
 #include <unistd.h>
 #include <dlfcn.h>
-#include <sys/select.h>
 
 #include "display_x11_mod.h"
 
+#if defined(X11_USE_EPOLL)
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#else
+#include <sys/select.h>
+#endif
+
 TBOOL initlibxft(TMOD_X11 *mod);
 
 static TTASKENTRY void x11_taskfunc(TAPTR task);
+static TBOOL x11_initwait(TMOD_X11 *inst);
+static void x11_exitwait(TMOD_X11 *inst);
+static TBOOL x11_wait(TMOD_X11 *inst);
 static TTASKENTRY TBOOL x11_initinstance(TAPTR task);
 static void x11_exitinstance(TMOD_X11 *inst);
 static void x11_processevent(TMOD_X11 *mod);
@@ -31,8 +47,12 @@ x11_init(TMOD_X11 *mod, TTAGITEM *tags)
 			TExecOpenModule(mod->x11_ExecBase, "time", 0, TNULL);
 		if (mod->x11_TimeBase == TNULL) break;
 
+		/* timestamps and intervals are on the monotonic clock */
+		tags[0].tti_Tag = TTimeRequest_Monotonic;
+		tags[0].tti_Value = TTRUE;
+		tags[1].tti_Tag = TTAG_DONE;
 		mod->x11_TimeReq =
-			TTimeAllocTimeRequest(mod->x11_TimeBase, TNULL);
+			TTimeAllocTimeRequest(mod->x11_TimeBase, tags);
 
 		tags[0].tti_Tag = TTask_UserData;
 		tags[0].tti_Value = (TTAG) mod;
@@ -163,7 +183,6 @@ x11_initinstance(TAPTR task)
 	for (;;)
 	{
 		TTAGITEM ftags[3];
-		int pipefd[2];
 		XRectangle rectangle;
 
 		/* list of free input messages: */
@@ -175,8 +194,17 @@ x11_initinstance(TAPTR task)
 		/* init fontmanager and default font */
 		TInitList(&inst->x11_fm.openfonts);
 
+		/* cache of rendered images: */
+		TInitList(&inst->x11_ImageCache);
+
+		#if defined(X11_USE_EPOLL)
+		inst->x11_fd_epoll = -1;
+		inst->x11_fd_wake = -1;
+		inst->x11_fd_timer = -1;
+		#else
 		inst->x11_fd_sigpipe_read = -1;
 		inst->x11_fd_sigpipe_write = -1;
+		#endif
 
 		inst->x11_Display = XOpenDisplay(NULL);
 		if (inst->x11_Display == TNULL)
@@ -191,12 +219,8 @@ x11_initinstance(TAPTR task)
 		if (getprops(inst) == TFALSE)
 			break;
 
-		if (pipe(pipefd) != 0)
+		if (x11_initwait(inst) == TFALSE)
 			break;
-		inst->x11_fd_sigpipe_read = pipefd[0];
-		inst->x11_fd_sigpipe_write = pipefd[1];
-		inst->x11_fd_max =
-			TMAX(inst->x11_fd_sigpipe_read, inst->x11_fd_display) + 1;
 
 		initlibxft(inst);
 
@@ -259,11 +283,10 @@ x11_exitinstance(TMOD_X11 *inst)
 
 	/*XDestroyRegion(inst->x11_HugeRegion);*/
 
-	if (inst->x11_fd_sigpipe_read != -1)
-	{
-		close(inst->x11_fd_sigpipe_read);
-		close(inst->x11_fd_sigpipe_write);
-	}
+	if (inst->x11_Display)
+		x11_freeimagecache(inst);
+
+	x11_exitwait(inst);
 
 	if (inst->x11_Display)
 		XCloseDisplay(inst->x11_Display);
@@ -372,6 +395,30 @@ x11_docmd(TMOD_X11 *inst, struct TVRequest *req)
 		case TVCMD_DRAWBUFFER:
 			x11_drawbuffer(inst, req);
 			break;
+		case TVCMD_ALLOCPIXMAP:
+			x11_allocpixmap(inst, req);
+			break;
+		case TVCMD_FREEPIXMAP:
+			x11_freepixmap(inst, req);
+			break;
+		case TVCMD_SETTARGET:
+			x11_settarget(inst, req);
+			break;
+		case TVCMD_DRAWPIXMAP:
+			x11_drawpixmap(inst, req);
+			break;
+		case TVCMD_GETEXPOSURES:
+			x11_getexposures(inst, req);
+			break;
+		case TVCMD_DRAWNINEPATCH:
+			x11_drawninepatch(inst, req);
+			break;
+		case TVCMD_BEGINIMAGE:
+			x11_beginimage(inst, req);
+			break;
+		case TVCMD_ENDIMAGE:
+			x11_endimage(inst, req);
+			break;
 		default:
 			TDBPRINTF(TDB_ERROR,("Unknown command code: %d\n",
 			req->tvr_Req.io_Command));
@@ -383,25 +430,13 @@ x11_taskfunc(TAPTR task)
 {
 	TMOD_X11 *inst = TExecGetTaskData(TGetExecBase(task), task);
 	TUINT sig;
-	fd_set rset;
 	struct TVRequest *req;
-	char buf[1];
-	struct timeval tv;
-
-	/* interval time: 1/50s: */
-	TTIME intt = { 0, 20000 };
-	/* next absolute time to send interval message: */
-	TTIME nextt;
-	TTIME waitt, nowt;
-
-	TTimeQueryTime(inst->x11_TimeBase, inst->x11_TimeReq, &nextt);
-	TTimeAddTime(inst->x11_TimeBase, &nextt, &intt);
 
 	TDBPRINTF(TDB_INFO,("Device instance running\n"));
 
 	do
 	{
-		TBOOL do_interval = TFALSE;
+		TBOOL do_interval;
 
 		while (inst->x11_RequestInProgress == TNULL &&
 			(req = TExecGetMsg(inst->x11_ExecBase, inst->x11_CmdPort)))
@@ -414,37 +449,8 @@ x11_taskfunc(TAPTR task)
 
 		XFlush(inst->x11_Display);
 
-		FD_ZERO(&rset);
-		FD_SET(inst->x11_fd_display, &rset);
-		FD_SET(inst->x11_fd_sigpipe_read, &rset);
-
-		/* calculate new delta to wait: */
-		TTimeQueryTime(inst->x11_TimeBase, inst->x11_TimeReq, &nowt);
-		waitt = nextt;
-		TTimeSubTime(inst->x11_TimeBase, &waitt, &nowt);
-
-		tv.tv_sec = waitt.ttm_Sec;
-		tv.tv_usec = waitt.ttm_USec;
-		/* wait for display, signal fd and timeout: */
-		if (select(inst->x11_fd_max, &rset, NULL, NULL, &tv) > 0)
-			if (FD_ISSET(inst->x11_fd_sigpipe_read, &rset))
-				/* consume one signal: */
-				read(inst->x11_fd_sigpipe_read, buf, 1);
-
-		/* check if time interval has expired: */
-		TTimeQueryTime(inst->x11_TimeBase, inst->x11_TimeReq, &nowt);
-		if (TTimeCmpTime(inst->x11_TimeBase, &nowt, &nextt) > 0)
-		{
-			/* expired; send interval: */
-			do_interval = TTRUE;
-			TTimeAddTime(inst->x11_TimeBase, &nextt, &intt);
-			if (TTimeCmpTime(inst->x11_TimeBase, &nowt, &nextt) >= 0)
-			{
-				/* nexttime expired already; create new time from now: */
-				nextt = nowt;
-				TTimeAddTime(inst->x11_TimeBase, &nextt, &intt);
-			}
-		}
+		/* wait for display, wakeup and interval: */
+		do_interval = x11_wait(inst);
 
 		/* process input messages: */
 		x11_processevent(inst);
@@ -463,12 +469,188 @@ x11_taskfunc(TAPTR task)
 	x11_exitinstance(inst);
 }
 
+/*****************************************************************************/
+/*
+**	Event waiting. On Linux, the task waits in epoll for the display
+**	connection, an eventfd for command wakeups, and a timerfd ticking at
+**	the interval rate. Wakeups are coalesced: only the first x11_wake()
+**	after the task has consumed the eventfd writes to it.
+*/
+
+#if defined(X11_USE_EPOLL)
+
+static TBOOL
+x11_initwait(TMOD_X11 *inst)
+{
+	struct epoll_event ev;
+	struct itimerspec its;
+
+	inst->x11_WakePending = 0;
+	inst->x11_fd_epoll = epoll_create1(EPOLL_CLOEXEC);
+	inst->x11_fd_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	inst->x11_fd_timer = timerfd_create(CLOCK_MONOTONIC,
+		TFD_NONBLOCK | TFD_CLOEXEC);
+	if (inst->x11_fd_epoll == -1 || inst->x11_fd_wake == -1 ||
+		inst->x11_fd_timer == -1)
+		return TFALSE;
+
+	its.it_interval.tv_sec = 0;
+	its.it_interval.tv_nsec = X11_INTERVAL_USEC * 1000;
+	its.it_value = its.it_interval;
+	if (timerfd_settime(inst->x11_fd_timer, 0, &its, NULL) == -1)
+		return TFALSE;
+
+	ev.events = EPOLLIN;
+	ev.data.fd = inst->x11_fd_display;
+	if (epoll_ctl(inst->x11_fd_epoll, EPOLL_CTL_ADD, ev.data.fd, &ev) == -1)
+		return TFALSE;
+	ev.data.fd = inst->x11_fd_wake;
+	if (epoll_ctl(inst->x11_fd_epoll, EPOLL_CTL_ADD, ev.data.fd, &ev) == -1)
+		return TFALSE;
+	ev.data.fd = inst->x11_fd_timer;
+	if (epoll_ctl(inst->x11_fd_epoll, EPOLL_CTL_ADD, ev.data.fd, &ev) == -1)
+		return TFALSE;
+
+	return TTRUE;
+}
+
+static void
+x11_exitwait(TMOD_X11 *inst)
+{
+	if (inst->x11_fd_timer != -1)
+		close(inst->x11_fd_timer);
+	if (inst->x11_fd_wake != -1)
+		close(inst->x11_fd_wake);
+	if (inst->x11_fd_epoll != -1)
+		close(inst->x11_fd_epoll);
+}
+
+static TBOOL
+x11_wait(TMOD_X11 *inst)
+{
+	struct epoll_event ev[3];
+	TBOOL do_interval = TFALSE;
+	uint64_t count;
+	int i, n;
+
+	n = epoll_wait(inst->x11_fd_epoll, ev, 3, -1);
+	for (i = 0; i < n; ++i)
+	{
+		if (ev[i].data.fd == inst->x11_fd_wake)
+		{
+			/* consume all wakeups, then re-arm x11_wake() */
+			read(inst->x11_fd_wake, &count, sizeof count);
+			#if defined(TSYS_HAVE_ATOMICS)
+			TATOMIC_SWAP(&inst->x11_WakePending, 0);
+			TATOMIC_BARRIER();
+			#endif
+		}
+		else if (ev[i].data.fd == inst->x11_fd_timer)
+		{
+			/* expirations missed in the meantime are dropped */
+			if (read(inst->x11_fd_timer, &count, sizeof count) > 0)
+				do_interval = TTRUE;
+		}
+	}
+
+	return do_interval;
+}
+
+LOCAL void x11_wake(TMOD_X11 *inst)
+{
+	uint64_t one = 1;
+	#if defined(TSYS_HAVE_ATOMICS)
+	if (!TATOMIC_CAS(&inst->x11_WakePending, 0, 1))
+		return;
+	#endif
+	write(inst->x11_fd_wake, &one, sizeof one);
+}
+
+#else
+
+static TBOOL
+x11_initwait(TMOD_X11 *inst)
+{
+	int pipefd[2];
+	TTIME intt = { 0, X11_INTERVAL_USEC };
+
+	if (pipe(pipefd) != 0)
+		return TFALSE;
+	inst->x11_fd_sigpipe_read = pipefd[0];
+	inst->x11_fd_sigpipe_write = pipefd[1];
+	inst->x11_fd_max =
+		TMAX(inst->x11_fd_sigpipe_read, inst->x11_fd_display) + 1;
+
+	TTimeQueryTime(inst->x11_TimeBase, inst->x11_TimeReq,
+		&inst->x11_NextTime);
+	TTimeAddTime(inst->x11_TimeBase, &inst->x11_NextTime, &intt);
+
+	return TTRUE;
+}
+
+static void
+x11_exitwait(TMOD_X11 *inst)
+{
+	if (inst->x11_fd_sigpipe_read != -1)
+	{
+		close(inst->x11_fd_sigpipe_read);
+		close(inst->x11_fd_sigpipe_write);
+	}
+}
+
+static TBOOL
+x11_wait(TMOD_X11 *inst)
+{
+	TTIME intt = { 0, X11_INTERVAL_USEC };
+	TTIME *nextt = &inst->x11_NextTime;
+	TTIME waitt, nowt;
+	struct timeval tv;
+	fd_set rset;
+	char buf[1];
+
+	FD_ZERO(&rset);
+	FD_SET(inst->x11_fd_display, &rset);
+	FD_SET(inst->x11_fd_sigpipe_read, &rset);
+
+	/* calculate new delta to wait: */
+	TTimeQueryTime(inst->x11_TimeBase, inst->x11_TimeReq, &nowt);
+	waitt = *nextt;
+	TTimeSubTime(inst->x11_TimeBase, &waitt, &nowt);
+
+	tv.tv_sec = waitt.ttm_Sec;
+	tv.tv_usec = waitt.ttm_USec;
+	/* wait for display, signal fd and timeout: */
+	if (select(inst->x11_fd_max, &rset, NULL, NULL, &tv) > 0)
+		if (FD_ISSET(inst->x11_fd_sigpipe_read, &rset))
+			/* consume one signal: */
+			read(inst->x11_fd_sigpipe_read, buf, 1);
+
+	/* check if time interval has expired: */
+	TTimeQueryTime(inst->x11_TimeBase, inst->x11_TimeReq, &nowt);
+	if (TTimeCmpTime(inst->x11_TimeBase, &nowt, nextt) > 0)
+	{
+		/* expired; send interval: */
+		TTimeAddTime(inst->x11_TimeBase, nextt, &intt);
+		if (TTimeCmpTime(inst->x11_TimeBase, &nowt, nextt) >= 0)
+		{
+			/* nexttime expired already; create new time from now: */
+			*nextt = nowt;
+			TTimeAddTime(inst->x11_TimeBase, nextt, &intt);
+		}
+		return TTRUE;
+	}
+
+	return TFALSE;
+}
+
 LOCAL void x11_wake(TMOD_X11 *inst)
 {
 	char sig = 0;
 	write(inst->x11_fd_sigpipe_write, &sig, 1);
 }
 
+#endif
+
 /*****************************************************************************/
 /*
 **	ProcessEvents
@@ -733,9 +915,54 @@ static TBOOL processkey(TMOD_X11 *mod, VISUAL *v, XKeyEvent *ev, TBOOL keydown)
 	return newkey;
 }
 
+static struct X11Copy *
+findcopy(VISUAL *v, unsigned long serial)
+{
+	struct TNode *next, *node = v->copylist.tlh_Head;
+	for (; (next = node->tln_Succ); node = next)
+	{
+		struct X11Copy *c = (struct X11Copy *) node;
+		if (c->serial == serial)
+			return c;
+	}
+	return TNULL;
+}
+
+/*
+**	Announce collected exposures to the owner of a visual, once until they
+**	are retrieved.
+*/
+
+LOCAL void
+x11_wakeexposures(TMOD_X11 *mod, VISUAL *v)
+{
+	TIMSG *imsg;
+	if (v->numexposures > 0 && !v->exposurewake &&
+		(v->eventmask & TITYPE_REFRESH) &&
+		getimsg(mod, v, &imsg, TITYPE_REFRESH))
+	{
+		/* empty refresh; the owner retrieves the exposures on its own: */
+		imsg->timsg_X = 0;
+		imsg->timsg_Y = 0;
+		imsg->timsg_Width = 0;
+		imsg->timsg_Height = 0;
+		TAddTail(&v->imsgqueue, &imsg->timsg_Node);
+		v->exposurewake = TTRUE;
+	}
+}
+
+static void
+endcopy(TMOD_X11 *mod, VISUAL *v, struct X11Copy *c)
+{
+	TRemove(&c->node);
+	TExecFree(mod->x11_ExecBase, c);
+	x11_wakeexposures(mod, v);
+}
+
 static TBOOL
 x11_processvisualevent(TMOD_X11 *mod, VISUAL *v, TAPTR msgstate, XEvent *ev)
 {
+	struct X11Copy *c;
 	TIMSG *imsg;
 
 	switch (ev->type)
@@ -807,6 +1034,21 @@ x11_processvisualevent(TMOD_X11 *mod, VISUAL *v, TAPTR msgstate, XEvent *ev)
 			break;
 
 		case GraphicsExpose:
+			c = findcopy(v, ev->xany.serial);
+			if (c)
+			{
+				/* exposure from a pipelined copy: */
+				TINT rect[4];
+				rect[0] = ev->xgraphicsexpose.x;
+				rect[1] = ev->xgraphicsexpose.y;
+				rect[2] = rect[0] + ev->xgraphicsexpose.width - 1;
+				rect[3] = rect[1] + ev->xgraphicsexpose.height - 1;
+				x11_addexposure(mod, v, rect, c);
+				if (ev->xgraphicsexpose.count == 0)
+					endcopy(mod, v, c);
+				break;
+			}
+
 			if (mod->x11_CopyExposeHook)
 			{
 				TINT rect[4];
@@ -825,6 +1067,12 @@ x11_processvisualevent(TMOD_X11 *mod, VISUAL *v, TAPTR msgstate, XEvent *ev)
 			/* no more graphics expose events, fallthru: */
 
 		case NoExpose:
+			c = findcopy(v, ev->xany.serial);
+			if (c)
+			{
+				endcopy(mod, v, c);
+				break;
+			}
 			if (mod->x11_RequestInProgress)
 			{
 				TExecReplyMsg(mod->x11_ExecBase, mod->x11_RequestInProgress);
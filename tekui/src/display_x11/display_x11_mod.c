@@ -34,6 +34,7 @@ static void
 x11_destroy(TMOD_X11 *mod)
 {
 	TDBPRINTF(TDB_TRACE,("X11 module destroy...\n"));
+	TDestroy(mod->x11_MemMgr);
 	TDestroy(mod->x11_Lock);
 }
 
@@ -59,6 +60,7 @@ tek_init_display_x11(TAPTR task, struct TModule *vis, TUINT16 version,
 	TTAGITEM *tags)
 {
 	TMOD_X11 *mod = (TMOD_X11 *) vis;
+	TTAGITEM mmutags[2];
 	if (mod == TNULL)
 	{
 		if (version == 0xffff)
@@ -76,6 +78,14 @@ tek_init_display_x11(TAPTR task, struct TModule *vis, TUINT16 version,
 		mod->x11_Lock = TExecCreateLock(mod->x11_ExecBase, TNULL);
 		if (mod->x11_Lock == TNULL) break;
 
+		/* small allocations (pens, pixmaps, strings) are served from
+		** slabs; if unavailable, fall back to the default allocator: */
+		mmutags[0].tti_Tag = TMem_Name;
+		mmutags[0].tti_Value = (TTAG) "display.x11";
+		mmutags[1].tti_Tag = TTAG_DONE;
+		mod->x11_MemMgr = TExecCreateMMU(mod->x11_ExecBase, TNULL,
+			TMMUT_Slab | TMMUT_TaskSafe, mmutags);
+
 		mod->x11_Module.tmd_Version = X11DISPLAY_VERSION;
 		mod->x11_Module.tmd_Revision = X11DISPLAY_REVISION;
 		mod->x11_Module.tmd_Handle.thn_Hook.thk_Entry = x11_dispatch;
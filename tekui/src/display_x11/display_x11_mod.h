@@ -39,6 +39,14 @@
 #define EXPORT TMODAPI
 #endif
 
+/* wait for events with epoll, eventfd and timerfd instead of select */
+#if defined(__linux__)
+#define X11_USE_EPOLL
+#endif
+
+/* interval message rate: 1/50s */
+#define X11_INTERVAL_USEC		20000
+
 /*****************************************************************************/
 
 struct utf8reader
@@ -69,6 +77,10 @@ LOCAL unsigned char *encodeutf8(unsigned char *buf, int c);
 #define	FNT_WILDCARD		"*"
 
 #define FNTQUERY_NUMATTR	(5+1)
+
+/* Image cache limit in bytes, number of hash buckets: */
+#define X11_IMAGECACHE_BYTES	(2*1024*1024)
+#define X11_IMAGECACHE_HASH		64
 #define	FNTQUERY_UNDEFINED	-1
 
 #define FNT_ITALIC			0x1
@@ -151,6 +163,7 @@ struct XftInterface
 		Colormap colormap);
 	void (*XftDrawDestroy)(XftDraw *draw);
 	Bool (*XftDrawSetClip)(XftDraw *d, Region r);
+	void (*XftDrawChange)(XftDraw *draw, Drawable drawable);
 };
 
 #define LIBXFT_NUMSYMS	(sizeof(struct XftInterface) / sizeof(void (*)(void)))
@@ -218,9 +231,20 @@ typedef struct X11Display
 	TINT x11_Depth, x11_BPP;
 
 	int x11_fd_display;
+	#if defined(X11_USE_EPOLL)
+	/* epoll instance, command wakeup eventfd, interval timerfd: */
+	int x11_fd_epoll;
+	int x11_fd_wake;
+	int x11_fd_timer;
+	/* wakeup written but not yet consumed by the task: */
+	volatile TUINT x11_WakePending;
+	#else
 	int x11_fd_sigpipe_read;
 	int x11_fd_sigpipe_write;
 	int x11_fd_max;
+	/* next absolute time to send interval message: */
+	TTIME x11_NextTime;
+	#endif
 
 	TBOOL x11_use_xft;
 	TAPTR x11_libxfthandle;
@@ -237,6 +261,8 @@ typedef struct X11Display
 
 	struct TVRequest *x11_RequestInProgress;
 	struct THook *x11_CopyExposeHook;
+	/* collects exposures of a copy that could not be pipelined: */
+	struct THook x11_CollectHook;
 
 	Region x11_HugeRegion;
 	TINT x11_Shm, x11_ShmEvent;
@@ -244,6 +270,14 @@ typedef struct X11Display
 	TINT x11_KeyQual;
 	TINT x11_MouseX, x11_MouseY;
 
+	/* cache of rendered images, least recently used first: */
+	struct TList x11_ImageCache;
+	struct X11Image *x11_ImageHash[X11_IMAGECACHE_HASH];
+	TSIZE x11_ImageCacheBytes;
+	TUINT x11_ImageCacheHits, x11_ImageCacheMisses;
+	/* GCs for rendering into cached images and their masks: */
+	GC x11_ImageGC, x11_MaskGC;
+
 } TMOD_X11;
 
 struct X11Pen
@@ -253,6 +287,39 @@ struct X11Pen
 	XftColor xftcolor;
 };
 
+struct X11Pixmap
+{
+	struct TNode node;
+	Pixmap pixmap;
+	TINT width, height;
+};
+
+struct X11Image
+{
+	/* node in the cache's LRU list: */
+	struct TNode node;
+	/* next entry in the hash bucket: */
+	struct X11Image *next;
+	TUINT hash;
+	Pixmap pixmap, mask;
+	TINT width, height;
+	TSIZE bytes;
+	/* being rendered, must not be evicted: */
+	TBOOL busy;
+	TINT keylen;
+	/* followed by the key */
+};
+
+struct X11Copy
+{
+	struct TNode node;
+	/* sequence number of the XCopyArea request: */
+	unsigned long serial;
+	/* source rectangle (x0, y0, x1, y1) and displacement: */
+	TINT rect[4];
+	TINT dx, dy;
+};
+
 typedef struct
 {
 	struct TNode node;
@@ -262,6 +329,7 @@ typedef struct
 	TSTRPTR title;
 
 	Window window;
+	Drawable drawable;			/* current rendering target */
 
 	XTextProperty title_prop;
 	Colormap colormap;
@@ -289,6 +357,25 @@ typedef struct
 	/* list of allocated pens: */
 	struct TList penlist;
 
+	/* list of allocated pixmaps: */
+	struct TList pixmaplist;
+
+	/* copies with exposures pending, in order of issue: */
+	struct TList copylist;
+	/* collected exposures, not yet retrieved (x0, y0, x1, y1 each): */
+	TINT *exposures;
+	TINT numexposures, maxexposures;
+	/* a refresh message announcing the exposures has been sent: */
+	TBOOL exposurewake;
+
+	/* current clipping rectangle (x, y, w, h), if any: */
+	TINT cliprect[4];
+	TBOOL clipped;
+
+	/* image cache entry being rendered, and its destination: */
+	struct X11Image *cacheimage;
+	TINT cacheimagex, cacheimagey;
+
 	/* HACK to consume an Expose event after ConfigureNotify: */
 	TBOOL waitforexpose;
 
@@ -354,6 +441,20 @@ LOCAL void x11_setcliprect(TMOD_X11 *mod, struct TVRequest *req);
 LOCAL void x11_unsetcliprect(TMOD_X11 *mod, struct TVRequest *req);
 LOCAL void x11_drawfarc(TMOD_X11 *mod, struct TVRequest *req);
 LOCAL void x11_drawbuffer(TMOD_X11 *mod, struct TVRequest *req);
+LOCAL void x11_allocpixmap(TMOD_X11 *mod, struct TVRequest *req);
+LOCAL void x11_freepixmap(TMOD_X11 *mod, struct TVRequest *req);
+LOCAL void x11_settarget(TMOD_X11 *mod, struct TVRequest *req);
+LOCAL void x11_drawpixmap(TMOD_X11 *mod, struct TVRequest *req);
+LOCAL void x11_getexposures(TMOD_X11 *mod, struct TVRequest *req);
+LOCAL void x11_drawninepatch(TMOD_X11 *mod, struct TVRequest *req);
+LOCAL void x11_beginimage(TMOD_X11 *mod, struct TVRequest *req);
+LOCAL void x11_endimage(TMOD_X11 *mod, struct TVRequest *req);
+LOCAL void x11_freeimagecache(TMOD_X11 *mod);
+LOCAL void x11_transformexposures(TMOD_X11 *mod, VISUAL *v, TINT first,
+	struct X11Copy *c);
+LOCAL void x11_wakeexposures(TMOD_X11 *mod, VISUAL *v);
+LOCAL void x11_addexposure(TMOD_X11 *mod, VISUAL *v, TINT *rect,
+	struct X11Copy *c);
 
 LOCAL void x11_wake(TMOD_X11 *inst);
 
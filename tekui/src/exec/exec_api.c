@@ -27,6 +27,7 @@ exec_systaskdestroy(struct THook *hook, TAPTR obj, TTAG msg)
 		TAPTR hal = exec->texb_HALBase;
 
 		THALDestroyThread(hal, &task->tsk_Thread);
+		exec_releasecaches(exec, task);
 		THALLock(hal, &exec->texb_Lock);
 		TREMOVE((struct TNode *) task);
 		THALUnlock(hal, &exec->texb_Lock);
@@ -431,9 +432,29 @@ exec_WaitIO(TEXECBASE *exec, struct TIORequest *ioreq)
 			status = msg->tmsg_Flags;
 		}
 
-		THALLock(hal, &replyport->tmp_Lock);
-		TREMOVE((struct TNode *) msg);
-		THALUnlock(hal, &replyport->tmp_Lock);
+		if (replyport->tmp_Flags & TMSGPORTF_LOCKFREE)
+		{
+			/* the status is set before the message is pushed */
+			for (;;)
+			{
+				struct TNode *next, *node;
+				exec_drainport(exec, replyport);
+				node = replyport->tmp_MsgList.tlh_Head;
+				for (; (next = node->tln_Succ); node = next)
+					if (node == &msg->tmsg_Node)
+						break;
+				if (next)
+					break;
+				THALWait(hal, replyport->tmp_Signal);
+			}
+			TREMOVE((struct TNode *) msg);
+		}
+		else
+		{
+			THALLock(hal, &replyport->tmp_Lock);
+			TREMOVE((struct TNode *) msg);
+			THALUnlock(hal, &replyport->tmp_Lock);
+		}
 
 		msg->tmsg_Flags = 0;
 	}
@@ -573,6 +594,7 @@ exec_Lock(TEXECBASE *exec, struct TLock *lock)
 	{
 		TAddTail(&lock->tlk_Waiters, &request.tlr_Node);
 		lock->tlk_WaitCount++;
+		lock->tlk_Contended++;
 		THALUnlock(hal, &lock->tlk_HLock);
 
 		THALWait(hal, TTASK_SIG_SINGLE);
@@ -624,6 +646,8 @@ exec_destroyuserport(struct THook *hook, TAPTR obj, TTAG msg)
 	{
 		struct TMsgPort *port = obj;
 		TEXECBASE *exec = (TEXECBASE *) TGetExecBase(port);
+		if (!TISLISTEMPTY(&port->tmp_MsgList) || port->tmp_Incoming)
+			TDBPRINTF(TDB_WARN,("Message queue was not empty\n"));
 		exec_freesignal(exec, port->tmp_SigTask, port->tmp_Signal);
 		THALDestroyLock(exec->texb_HALBase, &port->tmp_Lock);
 		exec_Free(exec, port);
@@ -644,6 +668,10 @@ exec_CreatePort(TEXECBASE *exec, struct TTagItem *tags)
 		{
 			/* overwrite destructor */
 			port->tmp_Handle.thn_Hook.thk_Entry = exec_destroyuserport;
+			#if defined(TSYS_HAVE_ATOMICS)
+			if (TGetTag(tags, TPort_LockFree, TFALSE))
+				port->tmp_Flags |= TMSGPORTF_LOCKFREE;
+			#endif
 			return port;
 		}
 		exec_Free(exec, port);
@@ -668,11 +696,21 @@ exec_WaitPort(TEXECBASE *exec, struct TMsgPort *port)
 		TDBASSERT(99, THALFindSelf(hal) == port->tmp_SigTask);
 		for (;;)
 		{
-			THALLock(hal, &port->tmp_Lock);
-			node = port->tmp_MsgList.tlh_Head;
-			if (node->tln_Succ == TNULL)
-				node = TNULL;
-			THALUnlock(hal, &port->tmp_Lock);
+			if (port->tmp_Flags & TMSGPORTF_LOCKFREE)
+			{
+				exec_drainport(exec, port);
+				node = port->tmp_MsgList.tlh_Head;
+				if (node->tln_Succ == TNULL)
+					node = TNULL;
+			}
+			else
+			{
+				THALLock(hal, &port->tmp_Lock);
+				node = port->tmp_MsgList.tlh_Head;
+				if (node->tln_Succ == TNULL)
+					node = TNULL;
+				THALUnlock(hal, &port->tmp_Lock);
+			}
 			if (node)
 				break;
 			THALWait(hal, port->tmp_Signal);
@@ -710,20 +748,12 @@ exec_PutMsg(TEXECBASE *exec, struct TMsgPort *port, struct TMsgPort *replyport,
 {
 	if (port && mem)
 	{
-		TAPTR hal = exec->texb_HALBase;
 		struct TMessage *msg = TGETMSGPTR(mem);
 
 		msg->tmsg_RPort = replyport;
 		msg->tmsg_Sender = TNULL; /* sender is local address space */
 
-		THALLock(hal, &port->tmp_Lock);
-		TAddTail(&port->tmp_MsgList, (struct TNode *) msg);
-		msg->tmsg_Flags = TMSGF_SENT | TMSGF_QUEUED;
-		if (port->tmp_Hook)
-			TCALLHOOKPKT(port->tmp_Hook, port, (TTAG) msg);
-		THALUnlock(hal, &port->tmp_Lock);
-
-		THALSignal(hal, &port->tmp_SigTask->tsk_Thread, port->tmp_Signal);
+		exec_queuemsg(exec, port, msg, TMSGF_SENT | TMSGF_QUEUED);
 	}
 	else
 		TDBPRINTF(TDB_WARN,("port/msg=TNULL\n"));
@@ -1000,13 +1030,16 @@ exec_LockAtom(TEXECBASE *exec, TAPTR atom, TUINT mode)
 	{
 		struct TTask *task = THALFindSelf(exec->texb_HALBase);
 
-		task->tsk_ReqCode = TTREQ_LOCKATOM;
-		task->tsk_Request.trq_Atom.tra_Atom = atom;
-		task->tsk_Request.trq_Atom.tra_Task = task;
-		task->tsk_Request.trq_Atom.tra_Mode = mode;
+		if (!exec_lockatomfast(exec, (struct TAtom **) &atom, task, mode))
+		{
+			task->tsk_ReqCode = TTREQ_LOCKATOM;
+			task->tsk_Request.trq_Atom.tra_Atom = atom;
+			task->tsk_Request.trq_Atom.tra_Task = task;
+			task->tsk_Request.trq_Atom.tra_Mode = mode;
 
-		if (exec_sendmsg(exec, task, exec->texb_ExecPort, task))
-			atom = task->tsk_Request.trq_Atom.tra_Atom;
+			if (exec_sendmsg(exec, task, exec->texb_ExecPort, task))
+				atom = task->tsk_Request.trq_Atom.tra_Atom;
+		}
 
 		if (atom && (mode & TATOMF_DESTROY))
 			exec_UnlockAtom(exec, atom, TATOMF_DESTROY);
@@ -1023,7 +1056,7 @@ exec_LockAtom(TEXECBASE *exec, TAPTR atom, TUINT mode)
 EXPORT void
 exec_UnlockAtom(TEXECBASE *exec, struct TAtom *atom, TUINT mode)
 {
-	if (atom)
+	if (atom && !exec_unlockatomfast(exec, atom, mode))
 	{
 		struct TTask *task = THALFindSelf(exec->texb_HALBase);
 
@@ -1049,14 +1082,21 @@ exec_InsertMsg(TEXECBASE *exec, struct TMsgPort *port, TAPTR mem,
 {
 	struct TMessage *msg = TGETMSGPTR(mem);
 	struct TMessage *predmsg = predmem ? TGETMSGPTR(predmem) : TNULL;
+	TBOOL lockfree = port->tmp_Flags & TMSGPORTF_LOCKFREE;
+
+	/* lock-free ports: to be called by the port's owner only */
+	if (lockfree)
+		exec_drainport(exec, port);
+	else
+		THALLock(exec->texb_HALBase, &port->tmp_Lock);
 
-	THALLock(exec->texb_HALBase, &port->tmp_Lock);
 	if (predmsg)
 		TInsert(&port->tmp_MsgList, &msg->tmsg_Node, &predmsg->tmsg_Node);
 	else
 		TAddTail(&port->tmp_MsgList, &msg->tmsg_Node);
 
-	THALUnlock(exec->texb_HALBase, &port->tmp_Lock);
+	if (!lockfree)
+		THALUnlock(exec->texb_HALBase, &port->tmp_Lock);
 
 	msg->tmsg_Flags = status | TMSGF_QUEUED;
 }
@@ -1071,7 +1111,13 @@ EXPORT void
 exec_RemoveMsg(TEXECBASE *exec, struct TMsgPort *port, TAPTR mem)
 {
 	struct TMessage *msg = TGETMSGPTR(mem);
-	THALLock(exec->texb_HALBase, &port->tmp_Lock);
+	TBOOL lockfree = port->tmp_Flags & TMSGPORTF_LOCKFREE;
+
+	/* lock-free ports: to be called by the port's owner only */
+	if (lockfree)
+		exec_drainport(exec, port);
+	else
+		THALLock(exec->texb_HALBase, &port->tmp_Lock);
 	#ifdef TDEBUG
 	{
 		struct TNode *next, *node = port->tmp_MsgList.tlh_Head;
@@ -1090,7 +1136,8 @@ exec_RemoveMsg(TEXECBASE *exec, struct TMsgPort *port, TAPTR mem)
 	}
 	#endif
 	TREMOVE(&msg->tmsg_Node);
-	THALUnlock(exec->texb_HALBase, &port->tmp_Lock);
+	if (!lockfree)
+		THALUnlock(exec->texb_HALBase, &port->tmp_Lock);
 }
 
 /*****************************************************************************/
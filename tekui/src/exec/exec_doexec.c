@@ -772,6 +772,7 @@ exec_destroytask(TEXECBASE *exec, struct TTask *task)
 {
 	TAPTR hal = exec->texb_HALBase;
 	THALDestroyThread(hal, &task->tsk_Thread);
+	exec_releasecaches(exec, task);
 	TDESTROY(&task->tsk_SyncPort);
 	TDESTROY(&task->tsk_UserPort);
 	TDESTROY(&task->tsk_HeapMMU);
@@ -873,8 +874,23 @@ exec_childexit(TEXECBASE *exec)
 /*****************************************************************************/
 /*
 **	Atoms
+**	Atoms are hashed by name. Lookups and changes of an atom's lock state
+**	are protected by texb_AtomLock, so that locks which can be granted
+**	right away, and unlocks which need not hand the atom over to a waiter,
+**	can be performed in the calling task. Only creating, destroying and
+**	waiting for atoms require a round trip to the exec task.
 */
 
+static struct TList *
+exec_atomhash(TEXECBASE *exec, TSTRPTR name)
+{
+	TUINT h = 5381;
+	TUINT8 c;
+	while ((c = (TUINT8) *name++))
+		h = h * 33 + c;
+	return &exec->texb_AtomHash[h & (TATOM_HASHSIZE - 1)];
+}
+
 static void
 exec_replyatom(TEXECBASE *exec, struct TTask *msg, struct TAtom *atom)
 {
@@ -885,7 +901,7 @@ exec_replyatom(TEXECBASE *exec, struct TTask *msg, struct TAtom *atom)
 static TAPTR
 exec_lookupatom(TEXECBASE *exec, TSTRPTR name)
 {
-	return TFindHandle(&exec->texb_AtomList, name);
+	return TFindHandle(exec_atomhash(exec, name), name);
 }
 
 static struct TAtom *
@@ -908,13 +924,124 @@ exec_newatom(TEXECBASE *exec, TSTRPTR name)
 		TINITLIST(&atom->tatm_Waiters);
 		atom->tatm_State = TATOMF_LOCKED;
 		atom->tatm_Nest = 1;
-		TAddHead(&exec->texb_AtomList, (struct TNode *) atom);
+		TAddHead(exec_atomhash(exec, name), (struct TNode *) atom);
 		TDBPRINTF(TDB_TRACE,("atom %s created - nest: 1\n", name));
 	}
 
 	return atom;
 }
 
+/*
+**	granted = exec_grantatom(atom, task, mode)
+**	Obtain an atom if this is possible without waiting
+*/
+
+static TBOOL
+exec_grantatom(struct TAtom *atom, struct TTask *task, TUINT mode)
+{
+	if (atom->tatm_State & TATOMF_LOCKED)
+	{
+		if ((atom->tatm_State & TATOMF_SHARED) ?
+			(mode & TATOMF_SHARED) : (atom->tatm_Owner == task))
+		{
+			atom->tatm_Nest++;
+			TDBPRINTF(TDB_TRACE,("nest: %d\n", atom->tatm_Nest));
+			return TTRUE;
+		}
+		return TFALSE;
+	}
+
+	if (atom->tatm_Nest)
+		TDBPRINTF(TDB_FAIL,("atom->nestcount %d!\n", atom->tatm_Nest));
+
+	atom->tatm_State = TATOMF_LOCKED;
+	if (mode & TATOMF_SHARED)
+	{
+		atom->tatm_State |= TATOMF_SHARED;
+		atom->tatm_Owner = TNULL;
+	}
+	else
+		atom->tatm_Owner = task;
+	atom->tatm_Nest = 1;
+	TDBPRINTF(TDB_TRACE,("atom taken. nest: %d\n", atom->tatm_Nest));
+	return TTRUE;
+}
+
+/*****************************************************************************/
+/*
+**	done = exec_lockatomfast(exec, patom, task, mode)
+**	Lock an atom in the caller's context. Returns TFALSE if the request
+**	must be passed to the exec task, for creating the atom or for waiting.
+*/
+
+LOCAL TBOOL
+exec_lockatomfast(TEXECBASE *exec, struct TAtom **patom, struct TTask *task,
+	TUINT mode)
+{
+	TAPTR hal = exec->texb_HALBase;
+	struct TAtom *atom = *patom;
+	TBOOL done = TTRUE;
+
+	if ((mode & (TATOMF_CREATE|TATOMF_NAME)) == TATOMF_CREATE)
+		return TFALSE;
+
+	THALLock(hal, &exec->texb_AtomLock);
+
+	if (mode & TATOMF_NAME)
+		atom = exec_lookupatom(exec, (TSTRPTR) atom);
+
+	if (atom == TNULL)
+		done = !(mode & TATOMF_CREATE);
+	else if ((mode & (TATOMF_CREATE|TATOMF_TRY)) ==
+		(TATOMF_CREATE|TATOMF_TRY))
+		atom = TNULL; /* already exists - deny */
+	else if (!exec_grantatom(atom, task, mode))
+	{
+		if (mode & TATOMF_TRY)
+			atom = TNULL;
+		else
+			done = TFALSE;
+	}
+
+	THALUnlock(hal, &exec->texb_AtomLock);
+
+	if (done)
+		*patom = atom;
+	return done;
+}
+
+/*
+**	done = exec_unlockatomfast(exec, atom, mode)
+**	Unlock an atom in the caller's context. Returns TFALSE if the request
+**	must be passed to the exec task, for destroying the atom or for
+**	restarting its waiters.
+*/
+
+LOCAL TBOOL
+exec_unlockatomfast(TEXECBASE *exec, struct TAtom *atom, TUINT mode)
+{
+	TAPTR hal = exec->texb_HALBase;
+	TBOOL done = TFALSE;
+
+	if (mode & TATOMF_DESTROY)
+		return TFALSE;
+
+	THALLock(hal, &exec->texb_AtomLock);
+	if (atom->tatm_Nest > 1 || TISLISTEMPTY(&atom->tatm_Waiters))
+	{
+		if (--atom->tatm_Nest == 0)
+		{
+			atom->tatm_State = 0;
+			atom->tatm_Owner = TNULL;
+		}
+		TDBPRINTF(TDB_TRACE,("unlock. nest: %d\n", atom->tatm_Nest));
+		done = TTRUE;
+	}
+	THALUnlock(hal, &exec->texb_AtomLock);
+
+	return done;
+}
+
 /*****************************************************************************/
 
 static void
@@ -924,6 +1051,8 @@ exec_lockatom(TEXECBASE *exec, struct TTask *msg)
 	struct TAtom *atom = msg->tsk_Request.trq_Atom.tra_Atom;
 	struct TTask *task = msg->tsk_Request.trq_Atom.tra_Task;
 
+	THALLock(exec->texb_HALBase, &exec->texb_AtomLock);
+
 	switch (mode & (TATOMF_CREATE|TATOMF_SHARED|TATOMF_NAME|TATOMF_TRY))
 	{
 		case TATOMF_CREATE | TATOMF_SHARED | TATOMF_NAME:
@@ -949,7 +1078,7 @@ exec_lockatom(TEXECBASE *exec, struct TTask *msg)
 
 		reply:
 			exec_replyatom(exec, msg, atom);
-			return;
+			break;
 
 		case TATOMF_NAME | TATOMF_SHARED | TATOMF_TRY:
 		case TATOMF_NAME | TATOMF_SHARED:
@@ -974,49 +1103,19 @@ exec_lockatom(TEXECBASE *exec, struct TTask *msg)
 
 		obtain:
 
-			if (atom->tatm_State & TATOMF_LOCKED)
-			{
-				if (atom->tatm_State & TATOMF_SHARED)
-				{
-					if (mode & TATOMF_SHARED)
-					{
-		nest:			atom->tatm_Nest++;
-						TDBPRINTF(TDB_TRACE,("nest: %d\n", atom->tatm_Nest));
-						goto reply;
-					}
-				}
-				else
-					if (atom->tatm_Owner == task)
-						goto nest;
-
-				if (mode & TATOMF_TRY)
-					goto fail;
-			}
-			else
-			{
-				if (atom->tatm_Nest)
-					TDBPRINTF(TDB_FAIL,
-						("atom->nestcount %d!\n", atom->tatm_Nest));
-
-				atom->tatm_State = TATOMF_LOCKED;
-				if (mode & TATOMF_SHARED)
-				{
-					atom->tatm_State |= TATOMF_SHARED;
-					atom->tatm_Owner = TNULL;
-				}
-				else
-					atom->tatm_Owner = task;
-				atom->tatm_Nest = 1;
-				TDBPRINTF(TDB_TRACE,
-					("atom taken. nest: %d\n", atom->tatm_Nest));
+			if (exec_grantatom(atom, task, mode))
 				goto reply;
-			}
+
+			if (mode & TATOMF_TRY)
+				goto fail;
 
 			/* put this request into atom's list of waiters */
 			msg->tsk_Request.trq_Atom.tra_Mode = mode & TATOMF_SHARED;
 			TAddTail(&atom->tatm_Waiters, &msg->tsk_Request.trq_Atom.tra_Node);
 			TDBPRINTF(TDB_TRACE,("must wait\n"));
 	}
+
+	THALUnlock(exec->texb_HALBase, &exec->texb_AtomLock);
 }
 
 /*****************************************************************************/
@@ -1027,6 +1126,8 @@ exec_unlockatom(TEXECBASE *exec, struct TTask *msg)
 	TUINT mode = msg->tsk_Request.trq_Atom.tra_Mode;
 	struct TAtom *atom = msg->tsk_Request.trq_Atom.tra_Atom;
 
+	THALLock(exec->texb_HALBase, &exec->texb_AtomLock);
+
 	atom->tatm_Nest--;
 	TDBPRINTF(TDB_TRACE,("unlock. nest: %d\n", atom->tatm_Nest));
 
@@ -1096,5 +1197,7 @@ exec_unlockatom(TEXECBASE *exec, struct TTask *msg)
 		}
 	}
 
+	THALUnlock(exec->texb_HALBase, &exec->texb_AtomLock);
+
 	exec_returnmsg(exec, msg, TMSG_STATUS_ACKD | TMSGF_QUEUED);
 }
@@ -13,18 +13,34 @@
 
 static const union TMemMsg msg_destroy = { TMMSG_DESTROY };
 
+static struct TSlabAlloc *exec_createslab(TEXECBASE *exec,
+	struct TTagItem *tags);
+
 /*****************************************************************************/
 /*
 **	mmu = exec_CreateMMU(exec, allocator, mmutype, tags)
 **	Create a memory manager
 */
 
+static void
+exec_remmmu(TEXECBASE *exec, struct TMemManager *mmu)
+{
+	if (mmu->tmm_Handle.thn_Name)
+	{
+		TAPTR hal = exec->texb_HALBase;
+		THALLock(hal, &exec->texb_Lock);
+		TREMOVE(&mmu->tmm_Handle.thn_Node);
+		THALUnlock(hal, &exec->texb_Lock);
+	}
+}
+
 static THOOKENTRY TTAG
 exec_destroymmu(struct THook *hook, TAPTR obj, TTAG msg)
 {
 	if (msg == TMSG_DESTROY)
 	{
 		struct TMemManager *mmu = obj;
+		exec_remmmu((TEXECBASE *) mmu->tmm_Handle.thn_Owner, mmu);
 		TCALLHOOKPKT(&mmu->tmm_Hook, mmu, (TTAG) &msg_destroy);
 		exec_Free((TEXECBASE *) mmu->tmm_Handle.thn_Owner, mmu);
 	}
@@ -37,6 +53,7 @@ exec_destroymmu_and_allocator(struct THook *hook, TAPTR obj, TTAG msg)
 	if (msg == TMSG_DESTROY)
 	{
 		struct TMemManager *mmu = obj;
+		exec_remmmu((TEXECBASE *) mmu->tmm_Handle.thn_Owner, mmu);
 		TCALLHOOKPKT(&mmu->tmm_Hook, mmu, (TTAG) &msg_destroy);
 		TDESTROY(mmu->tmm_Allocator);
 		exec_Free((TEXECBASE *) mmu->tmm_Handle.thn_Owner, mmu);
@@ -51,6 +68,7 @@ exec_destroymmu_and_free(struct THook *hook, TAPTR obj, TTAG msg)
 	{
 		struct TMemManager *mmu = obj;
 		TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
+		exec_remmmu(exec, mmu);
 		TCALLHOOKPKT(&mmu->tmm_Hook, mmu, (TTAG) &msg_destroy);
 		exec_Free(exec, mmu->tmm_Allocator);
 		exec_Free(exec, mmu);
@@ -62,8 +80,26 @@ EXPORT struct TMemManager *
 exec_CreateMMU(TEXECBASE *exec, TAPTR allocator, TUINT mmutype,
 	struct TTagItem *tags)
 {
-	struct TMemManager *mmu = exec_AllocMMU(exec, TNULL,
-		sizeof(struct TMemManager));
+	struct TMemManager *mmu;
+	TSTRPTR name = (TSTRPTR) TGetTag(tags, TMem_Name, TNULL);
+	TUINT namelen = 0;
+
+	if (name && !(mmutype & TMMUT_TaskSafe))
+	{
+		/* other tasks could find it and access it without locking */
+		TDBPRINTF(TDB_WARN,("not registering non-task-safe MMU %s\n",
+			name));
+		name = TNULL;
+	}
+
+	if (name)
+	{
+		TSTRPTR t = name;
+		while (*t++);
+		namelen = t - name;
+	}
+
+	mmu = exec_AllocMMU(exec, TNULL, sizeof(struct TMemManager) + namelen);
 	if (mmu)
 	{
 		THOOKENTRY THOOKFUNC destructor = TNULL;
@@ -76,6 +112,12 @@ exec_CreateMMU(TEXECBASE *exec, TAPTR allocator, TUINT mmutype,
 			allocator = exec_CreatePool(exec, tags);
 			destructor = exec_destroymmu_and_allocator;
 		}
+		else if ((mmutype & TMMUT_Slab) && allocator == TNULL)
+		{
+			/* Create a MMU based on an internal slab allocator */
+			allocator = exec_createslab(exec, tags);
+			destructor = exec_destroymmu_and_allocator;
+		}
 		else if (mmutype & TMMUT_Static)
 		{
 			/* Create a MMU based on a static memory block */
@@ -123,6 +165,16 @@ exec_CreateMMU(TEXECBASE *exec, TAPTR allocator, TUINT mmutype,
 				/* Overwrite destructor. The one provided by exec_initmmu()
 				doesn't know how to free the memory manager. */
 				mmu->tmm_Handle.thn_Hook.thk_Entry = destructor;
+				if (name)
+				{
+					TAPTR hal = exec->texb_HALBase;
+					TSTRPTR t = (TSTRPTR) (mmu + 1);
+					mmu->tmm_Handle.thn_Name = t;
+					while ((*t++ = *name++));
+					THALLock(hal, &exec->texb_Lock);
+					TAddTail(&exec->texb_MMUList, &mmu->tmm_Handle.thn_Node);
+					THALUnlock(hal, &exec->texb_Lock);
+				}
 				return mmu;
 			}
 		}
@@ -927,6 +979,189 @@ exec_ReallocPool(TEXECBASE *exec, struct TMemPool *pool, TINT8 *oldmem,
 	return TNULL;
 }
 
+/*****************************************************************************/
+/*
+**	slab = exec_createslab(exec, tags)
+**	Create a size-class slab allocator. Allocations up to TSlab_MaxSize
+**	bytes are served from free lists, one per size class; a free list is
+**	refilled by dividing a slab of TSlab_SlabSize bytes into chunks of the
+**	class' size. Larger allocations are passed to the parent MMU. Slabs
+**	are returned to the parent MMU when the allocator is destroyed.
+*/
+
+#define TSLAB_HEADSIZE \
+	((sizeof(struct TNode) + TSLAB_GRAIN - 1) & ~(TSLAB_GRAIN - 1))
+
+static THOOKENTRY TTAG
+exec_destroyslab(struct THook *hook, TAPTR obj, TTAG msg)
+{
+	if (msg == TMSG_DESTROY)
+	{
+		struct TSlabAlloc *slab = obj;
+		TEXECBASE *exec = (TEXECBASE *) TGetExecBase(slab);
+		struct TNode *nnode, *node = slab->tsa_List.tlh_Head;
+		while ((nnode = node->tln_Succ))
+		{
+			exec_Free(exec, node);
+			node = nnode;
+		}
+		exec_Free(exec, slab);
+	}
+	return 0;
+}
+
+static struct TSlabAlloc *
+exec_createslab(TEXECBASE *exec, struct TTagItem *tags)
+{
+	TUINT slabsize = (TUINT) TGetTag(tags, TSlab_SlabSize, (TTAG) 4096);
+	TUINT maxsize = (TUINT) TGetTag(tags, TSlab_MaxSize, (TTAG) 256);
+	maxsize = TMIN(maxsize + sizeof(union TMMUInfo),
+		TSLAB_GRAIN * TSLAB_NUMCLASSES);
+	/* the largest chunk is that of the class maxsize falls into: */
+	maxsize = (maxsize + TSLAB_GRAIN - 1) & ~(TSLAB_GRAIN - 1);
+	if (slabsize >= TSLAB_HEADSIZE + maxsize)
+	{
+		struct TSlabAlloc *slab = exec_AllocMMU0(exec, TNULL,
+			sizeof(struct TSlabAlloc));
+		if (slab)
+		{
+			slab->tsa_Handle.thn_Owner = (struct TModule *) exec;
+			slab->tsa_Handle.thn_Hook.thk_Entry = exec_destroyslab;
+			slab->tsa_MMU = (TAPTR) TGetTag(tags, TPool_MMU, TNULL);
+			slab->tsa_SlabSize = slabsize;
+			slab->tsa_MaxSize = maxsize;
+			TINITLIST(&slab->tsa_List);
+		}
+		return slab;
+	}
+	return TNULL;
+}
+
+static TAPTR
+exec_allocslab(TEXECBASE *exec, struct TSlabAlloc *slab, TUINT size)
+{
+	TUINT c;
+	TAPTR *chunk;
+
+	if (size > slab->tsa_MaxSize)
+		return exec_AllocMMU(exec, slab->tsa_MMU, size);
+
+	c = (size - 1) / TSLAB_GRAIN;
+	chunk = slab->tsa_Free[c];
+	if (chunk == TNULL)
+	{
+		/* divide a new slab into chunks of this class' size: */
+		TUINT csize = (c + 1) * TSLAB_GRAIN;
+		TUINT n = (slab->tsa_SlabSize - TSLAB_HEADSIZE) / csize;
+		TINT8 *mem = exec_AllocMMU(exec, slab->tsa_MMU, slab->tsa_SlabSize);
+		if (mem == TNULL)
+			return TNULL;
+		TAddTail(&slab->tsa_List, (struct TNode *) mem);
+		mem += TSLAB_HEADSIZE;
+		chunk = (TAPTR *) mem;
+		while (--n)
+		{
+			*(TAPTR *) mem = mem + csize;
+			mem += csize;
+		}
+		*(TAPTR *) mem = TNULL;
+	}
+
+	slab->tsa_Free[c] = *chunk;
+	return chunk;
+}
+
+static void
+exec_freeslab(TEXECBASE *exec, struct TSlabAlloc *slab, TINT8 *mem,
+	TUINT size)
+{
+	if (size > slab->tsa_MaxSize)
+		exec_Free(exec, mem);
+	else
+	{
+		TUINT c = (size - 1) / TSLAB_GRAIN;
+		*(TAPTR *) mem = slab->tsa_Free[c];
+		slab->tsa_Free[c] = mem;
+	}
+}
+
+static TAPTR
+exec_reallocslab(TEXECBASE *exec, struct TSlabAlloc *slab, TINT8 *oldmem,
+	TUINT oldsize, TUINT newsize)
+{
+	TUINT maxsize = slab->tsa_MaxSize;
+	TINT8 *newmem;
+
+	if (oldsize > maxsize && newsize > maxsize)
+		return exec_Realloc(exec, oldmem, newsize);
+
+	if (oldsize <= maxsize && newsize <= maxsize &&
+		(oldsize - 1) / TSLAB_GRAIN == (newsize - 1) / TSLAB_GRAIN)
+		return oldmem;
+
+	newmem = exec_allocslab(exec, slab, newsize);
+	if (newmem)
+	{
+		exec_CopyMem(exec, oldmem, newmem, TMIN(oldsize, newsize));
+		exec_freeslab(exec, slab, oldmem, oldsize);
+	}
+	return newmem;
+}
+
+/*****************************************************************************/
+/*
+**	Allocation statistics. Sizes passed to the hooks include the MMU
+**	header, which is not counted.
+*/
+
+static TUINT
+exec_statsindex(TUINT size)
+{
+	TUINT i = 0;
+	size = (size - 1) >> 4;
+	while (size && i < TMMUSTATS_NUMSIZES - 1)
+	{
+		size >>= 1;
+		i++;
+	}
+	return i;
+}
+
+static void
+exec_statsalloc(struct TMemManager *mmu, TUINT size)
+{
+	struct TMMUStats *stats = &mmu->tmm_Stats;
+	size -= sizeof(union TMMUInfo);
+	stats->tms_Bytes += size;
+	if (stats->tms_Bytes > stats->tms_PeakBytes)
+		stats->tms_PeakBytes = stats->tms_Bytes;
+	stats->tms_NumAllocs++;
+	stats->tms_Sizes[exec_statsindex(size)]++;
+}
+
+static void
+exec_statsfree(struct TMemManager *mmu, TUINT size)
+{
+	struct TMMUStats *stats = &mmu->tmm_Stats;
+	size -= sizeof(union TMMUInfo);
+	stats->tms_Bytes -= size;
+	stats->tms_NumFrees++;
+	stats->tms_Sizes[exec_statsindex(size)]--;
+}
+
+static void
+exec_statsrealloc(struct TMemManager *mmu, TUINT oldsize, TUINT newsize)
+{
+	struct TMMUStats *stats = &mmu->tmm_Stats;
+	oldsize -= sizeof(union TMMUInfo);
+	newsize -= sizeof(union TMMUInfo);
+	stats->tms_Bytes += newsize - oldsize;
+	if (stats->tms_Bytes > stats->tms_PeakBytes)
+		stats->tms_PeakBytes = stats->tms_Bytes;
+	stats->tms_Sizes[exec_statsindex(oldsize)]--;
+	stats->tms_Sizes[exec_statsindex(newsize)]++;
+}
+
 /*****************************************************************************/
 /*
 **	TNULL message allocator -
@@ -1127,6 +1362,350 @@ exec_mmu_pool(struct THook *hook, TAPTR obj, TTAG m)
 	return 0;
 }
 
+/*****************************************************************************/
+/*
+**	Per-task caches for task-safe allocators. Blocks of up to
+**	TMMUCACHE_NUMCLASSES * TMMUCACHE_GRAIN bytes are allocated with a
+**	header naming the cache of the allocating task. When such a block is
+**	freed by its owner, it is kept in a magazine of its size class; when
+**	freed by another task, it is pushed to the owner's remote stack, which
+**	the owner drains when its magazine runs empty. Only allocations that
+**	cannot be served from the cache go through the locked underlying
+**	allocator ("depot"). A task finds its caches in its own list. When
+**	it exits, its blocks are returned to the depots, and its caches are
+**	left to be taken over by other tasks, as blocks allocated through
+**	them may still be in use. Ownership changes are protected by
+**	texb_CacheLock, which is never held while calling a depot.
+*/
+
+struct exec_depot
+{
+	TAPTR (*alloc)(struct TMemManager *mmu, TUINT size);
+	void (*free)(struct TMemManager *mmu, TINT8 *mem, TUINT size);
+	TAPTR (*realloc)(struct TMemManager *mmu, TINT8 *oldmem, TUINT oldsize,
+		TUINT newsize);
+};
+
+#define TMMUCACHE_MAXSIZE	(TMMUCACHE_GRAIN * TMMUCACHE_NUMCLASSES)
+#define TMMUCACHE_CLASS(s)	(((s) - 1) / TMMUCACHE_GRAIN)
+#define TMMUCACHE_BLOCKSIZE(c) \
+	(((c) + 1) * TMMUCACHE_GRAIN + sizeof(union TMMUCacheNode))
+
+/* the size class is taken from the MMU header following ours */
+#define TMMUCACHE_NODECLASS(node) \
+	TMMUCACHE_CLASS(((union TMMUInfo *) ((node) + 1))->tmu_Node.tmu_UserSize \
+		+ sizeof(union TMMUInfo))
+
+#if defined(TSYS_HAVE_ATOMICS)
+
+static struct TMMUCache *
+exec_getcache(TEXECBASE *exec, struct TMemManager *mmu,
+	const struct exec_depot *depot)
+{
+	TAPTR hal = exec->texb_HALBase;
+	struct TTask *self = THALFindSelf(hal);
+	struct TMMUCache *cache;
+
+	for (cache = self->tsk_MMUCaches; cache; cache = cache->tmc_TaskNext)
+		if (cache->tmc_MMU == mmu)
+			return cache;
+
+	/* take over the cache of an exited task, or create a new one */
+	THALLock(hal, &exec->texb_CacheLock);
+	for (cache = mmu->tmm_Caches; cache; cache = cache->tmc_Next)
+	{
+		if (cache->tmc_Task == TNULL)
+		{
+			cache->tmc_Task = self;
+			break;
+		}
+	}
+	THALUnlock(hal, &exec->texb_CacheLock);
+
+	if (cache == TNULL)
+	{
+		cache = exec_AllocMMU0(exec, TNULL, sizeof(struct TMMUCache));
+		if (cache == TNULL)
+			return TNULL;
+		cache->tmc_MMU = mmu;
+		cache->tmc_Depot = (TAPTR) depot;
+		cache->tmc_Task = self;
+		THALLock(hal, &exec->texb_CacheLock);
+		cache->tmc_Next = mmu->tmm_Caches;
+		mmu->tmm_Caches = cache;
+		THALUnlock(hal, &exec->texb_CacheLock);
+	}
+
+	cache->tmc_TaskNext = self->tsk_MMUCaches;
+	self->tsk_MMUCaches = cache;
+	return cache;
+}
+
+static void
+exec_cachefree(TEXECBASE *exec, struct TMemManager *mmu, TINT8 *mem,
+	TUINT size, const struct exec_depot *depot)
+{
+	union TMMUCacheNode *node;
+	struct TMMUCache *owner;
+	struct TTask *task;
+	TUINT c;
+
+	if (size > TMMUCACHE_MAXSIZE)
+	{
+		(*depot->free)(mmu, mem, size);
+		return;
+	}
+
+	c = TMMUCACHE_CLASS(size);
+	node = (union TMMUCacheNode *) mem - 1;
+	owner = node->tcn_Node.tcn_Cache;
+	task = owner ? owner->tmc_Task : TNULL;
+
+	if (task == THALFindSelf(exec->texb_HALBase))
+	{
+		if (owner->tmc_NumFree[c] < TMMUCACHE_DEPTH)
+		{
+			node->tcn_Node.tcn_Next = owner->tmc_Free[c];
+			owner->tmc_Free[c] = node;
+			owner->tmc_NumFree[c]++;
+			return;
+		}
+	}
+	else if (task && owner->tmc_NumRemote < TMMUCACHE_DEPTH)
+	{
+		do node->tcn_Node.tcn_Next = owner->tmc_Remote;
+		while (!TATOMIC_CAS(&owner->tmc_Remote, node->tcn_Node.tcn_Next,
+			node));
+		TATOMIC_ADD(&owner->tmc_NumRemote, 1);
+		TATOMIC_ADD(&owner->tmc_RemoteFrees, 1);
+		return;
+	}
+
+	(*depot->free)(mmu, (TINT8 *) node, TMMUCACHE_BLOCKSIZE(c));
+}
+
+static void
+exec_drainremote(TEXECBASE *exec, struct TMemManager *mmu,
+	struct TMMUCache *cache, const struct exec_depot *depot)
+{
+	union TMMUCacheNode *next, *node;
+	TINT n = 0;
+	node = TATOMIC_SWAP(&cache->tmc_Remote, TNULL);
+	for (; node; node = next, ++n)
+	{
+		TUINT c = TMMUCACHE_NODECLASS(node);
+		next = node->tcn_Node.tcn_Next;
+		if (cache->tmc_NumFree[c] < TMMUCACHE_DEPTH)
+		{
+			node->tcn_Node.tcn_Next = cache->tmc_Free[c];
+			cache->tmc_Free[c] = node;
+			cache->tmc_NumFree[c]++;
+		}
+		else
+			(*depot->free)(mmu, (TINT8 *) node, TMMUCACHE_BLOCKSIZE(c));
+	}
+	TATOMIC_ADD(&cache->tmc_NumRemote, -n);
+}
+
+static TAPTR
+exec_cachealloc(TEXECBASE *exec, struct TMemManager *mmu, TUINT size,
+	const struct exec_depot *depot)
+{
+	union TMMUCacheNode *node;
+	struct TMMUCache *cache;
+	TUINT c;
+
+	if (size > TMMUCACHE_MAXSIZE)
+		return (*depot->alloc)(mmu, size);
+
+	c = TMMUCACHE_CLASS(size);
+	cache = exec_getcache(exec, mmu, depot);
+	if (cache)
+	{
+		if (cache->tmc_Free[c] == TNULL && cache->tmc_Remote)
+			exec_drainremote(exec, mmu, cache, depot);
+		node = cache->tmc_Free[c];
+		if (node)
+		{
+			cache->tmc_Free[c] = node->tcn_Node.tcn_Next;
+			cache->tmc_NumFree[c]--;
+			cache->tmc_Hits++;
+			return node + 1;
+		}
+		cache->tmc_Misses++;
+	}
+
+	node = (*depot->alloc)(mmu, TMMUCACHE_BLOCKSIZE(c));
+	if (node == TNULL)
+		return TNULL;
+	node->tcn_Node.tcn_Cache = cache;
+	return node + 1;
+}
+
+static TAPTR
+exec_cacherealloc(TEXECBASE *exec, struct TMemManager *mmu, TINT8 *oldmem,
+	TUINT oldsize, TUINT newsize, const struct exec_depot *depot)
+{
+	TINT8 *newmem;
+	if (oldsize > TMMUCACHE_MAXSIZE && newsize > TMMUCACHE_MAXSIZE)
+		return (*depot->realloc)(mmu, oldmem, oldsize, newsize);
+	if (oldsize <= TMMUCACHE_MAXSIZE && newsize <= TMMUCACHE_MAXSIZE &&
+		TMMUCACHE_CLASS(oldsize) == TMMUCACHE_CLASS(newsize))
+		return oldmem;
+	newmem = exec_cachealloc(exec, mmu, newsize, depot);
+	if (newmem)
+	{
+		exec_CopyMem(exec, oldmem, newmem, TMIN(oldsize, newsize));
+		exec_cachefree(exec, mmu, oldmem, oldsize, depot);
+	}
+	return newmem;
+}
+
+/*
+**	blocks = exec_takecache(cache)
+**	Unlink all blocks from a cache's magazines and remote stack, and
+**	return them in a single chain. Called with texb_CacheLock held.
+*/
+
+static union TMMUCacheNode *
+exec_takecache(struct TMMUCache *cache)
+{
+	union TMMUCacheNode *next, *node, *blocks;
+	TINT n = 0;
+	TUINT c;
+
+	blocks = TATOMIC_SWAP(&cache->tmc_Remote, TNULL);
+	for (node = blocks; node; node = node->tcn_Node.tcn_Next)
+		n++;
+	TATOMIC_ADD(&cache->tmc_NumRemote, -n);
+
+	for (c = 0; c < TMMUCACHE_NUMCLASSES; ++c)
+	{
+		for (node = cache->tmc_Free[c]; node; node = next)
+		{
+			next = node->tcn_Node.tcn_Next;
+			node->tcn_Node.tcn_Next = blocks;
+			blocks = node;
+		}
+		cache->tmc_Free[c] = TNULL;
+		cache->tmc_NumFree[c] = 0;
+	}
+
+	return blocks;
+}
+
+static void
+exec_freeblocks(struct TMemManager *mmu, union TMMUCacheNode *node,
+	const struct exec_depot *depot)
+{
+	union TMMUCacheNode *next;
+	for (; node; node = next)
+	{
+		next = node->tcn_Node.tcn_Next;
+		(*depot->free)(mmu, (TINT8 *) node,
+			TMMUCACHE_BLOCKSIZE(TMMUCACHE_NODECLASS(node)));
+	}
+}
+
+/*
+**	exec_releasecaches(exec, task)
+**	Return the blocks in the caches of a task that has exited to their
+**	memory managers, and leave the caches to other tasks. Caches whose
+**	memory managers have been destroyed are freed. A memory manager must
+**	not be destroyed while this is in progress for a task using it.
+*/
+
+LOCAL void
+exec_releasecaches(TEXECBASE *exec, struct TTask *task)
+{
+	TAPTR hal = exec->texb_HALBase;
+	struct TMMUCache *cache;
+
+	while ((cache = task->tsk_MMUCaches))
+	{
+		union TMMUCacheNode *blocks = TNULL;
+		struct TMemManager *mmu;
+
+		task->tsk_MMUCaches = cache->tmc_TaskNext;
+		cache->tmc_TaskNext = TNULL;
+
+		THALLock(hal, &exec->texb_CacheLock);
+		mmu = cache->tmc_MMU;
+		if (mmu)
+		{
+			blocks = exec_takecache(cache);
+			cache->tmc_Task = TNULL;
+		}
+		THALUnlock(hal, &exec->texb_CacheLock);
+
+		if (mmu)
+			exec_freeblocks(mmu, blocks, cache->tmc_Depot);
+		else
+			exec_Free(exec, cache);
+	}
+}
+
+static void
+exec_destroycaches(TEXECBASE *exec, struct TMemManager *mmu,
+	const struct exec_depot *depot)
+{
+	TAPTR hal = exec->texb_HALBase;
+	struct TMMUCache *next, *cache, *unused = TNULL;
+	union TMMUCacheNode *blocks = TNULL;
+
+	THALLock(hal, &exec->texb_CacheLock);
+	for (cache = mmu->tmm_Caches; cache; cache = next)
+	{
+		union TMMUCacheNode *node = exec_takecache(cache);
+		next = cache->tmc_Next;
+		while (node)
+		{
+			union TMMUCacheNode *nnext = node->tcn_Node.tcn_Next;
+			node->tcn_Node.tcn_Next = blocks;
+			blocks = node;
+			node = nnext;
+		}
+		TDBPRINTF(TDB_INFO,("mmu cache: hits=%d misses=%d remote=%d\n",
+			cache->tmc_Hits, cache->tmc_Misses, cache->tmc_RemoteFrees));
+		/* caches of running tasks are freed when the tasks exit */
+		cache->tmc_MMU = TNULL;
+		if (cache->tmc_Task == TNULL)
+		{
+			cache->tmc_Next = unused;
+			unused = cache;
+		}
+	}
+	mmu->tmm_Caches = TNULL;
+	THALUnlock(hal, &exec->texb_CacheLock);
+
+	exec_freeblocks(mmu, blocks, depot);
+	for (; unused; unused = next)
+	{
+		next = unused->tmc_Next;
+		exec_Free(exec, unused);
+	}
+
+	TDBPRINTF(TDB_INFO,("mmu lock contended %d times\n",
+		mmu->tmm_Lock.tlk_Contended));
+}
+
+#else /* defined(TSYS_HAVE_ATOMICS) */
+
+#define exec_cachealloc(exec, mmu, size, depot) \
+	(*(depot)->alloc)(mmu, size)
+#define exec_cachefree(exec, mmu, mem, size, depot) \
+	(*(depot)->free)(mmu, mem, size)
+#define exec_cacherealloc(exec, mmu, oldmem, oldsize, newsize, depot) \
+	(*(depot)->realloc)(mmu, oldmem, oldsize, newsize)
+#define exec_destroycaches(exec, mmu, depot)
+
+LOCAL void
+exec_releasecaches(TEXECBASE *exec, struct TTask *task)
+{
+}
+
+#endif /* defined(TSYS_HAVE_ATOMICS) */
+
 /*****************************************************************************/
 /*
 **	pooled+tasksafe allocator
@@ -1165,9 +1744,16 @@ exec_mmu_pooltaskrealloc(struct TMemManager *mmu, TINT8 *oldmem, TUINT oldsize,
 	return newmem;
 }
 
+static const struct exec_depot exec_pooltaskdepot =
+{
+	exec_mmu_pooltaskalloc, exec_mmu_pooltaskfree, exec_mmu_pooltaskrealloc
+};
+
 static void
 exec_mmu_pooltaskdestroy(struct TMemManager *mmu)
 {
+	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
+	exec_destroycaches(exec, mmu, &exec_pooltaskdepot);
 	TDESTROY(&mmu->tmm_Lock);
 }
 
@@ -1175,6 +1761,7 @@ static THOOKENTRY TTAG
 exec_mmu_pooltask(struct THook *hook, TAPTR obj, TTAG m)
 {
 	struct TMemManager *mmu = obj;
+	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
 	union TMemMsg *msg = (union TMemMsg *) m;
 	switch (msg->tmmsg_Type)
 	{
@@ -1182,15 +1769,78 @@ exec_mmu_pooltask(struct THook *hook, TAPTR obj, TTAG m)
 			exec_mmu_pooltaskdestroy(mmu);
 			break;
 		case TMMSG_ALLOC:
-			return (TTAG) exec_mmu_pooltaskalloc(mmu,
+			return (TTAG) exec_cachealloc(exec, mmu,
+				msg->tmmsg_Alloc.tmmsg_Size, &exec_pooltaskdepot);
+		case TMMSG_FREE:
+			exec_cachefree(exec, mmu,
+				msg->tmmsg_Free.tmmsg_Ptr,
+				msg->tmmsg_Free.tmmsg_Size, &exec_pooltaskdepot);
+			break;
+		case TMMSG_REALLOC:
+			return (TTAG) exec_cacherealloc(exec, mmu,
+				msg->tmmsg_Realloc.tmmsg_Ptr,
+				msg->tmmsg_Realloc.tmmsg_OSize,
+				msg->tmmsg_Realloc.tmmsg_NSize, &exec_pooltaskdepot);
+		default:
+			TDBPRINTF(TDB_FAIL,("unknown hookmsg\n"));
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	slab allocator
+*/
+
+static TAPTR
+exec_mmu_slaballoc(struct TMemManager *mmu, TUINT size)
+{
+	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
+	TINT8 *mem = exec_allocslab(exec, mmu->tmm_Allocator, size);
+	if (mem)
+		exec_statsalloc(mmu, size);
+	return mem;
+}
+
+static void
+exec_mmu_slabfree(struct TMemManager *mmu, TINT8 *mem, TUINT size)
+{
+	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
+	exec_freeslab(exec, mmu->tmm_Allocator, mem, size);
+	exec_statsfree(mmu, size);
+}
+
+static TAPTR
+exec_mmu_slabrealloc(struct TMemManager *mmu, TINT8 *oldmem, TUINT oldsize,
+	TUINT newsize)
+{
+	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
+	TINT8 *newmem = exec_reallocslab(exec, mmu->tmm_Allocator, oldmem,
+		oldsize, newsize);
+	if (newmem)
+		exec_statsrealloc(mmu, oldsize, newsize);
+	return newmem;
+}
+
+static THOOKENTRY TTAG
+exec_mmu_slab(struct THook *hook, TAPTR obj, TTAG m)
+{
+	struct TMemManager *mmu = obj;
+	union TMemMsg *msg = (union TMemMsg *) m;
+	switch (msg->tmmsg_Type)
+	{
+		case TMMSG_DESTROY:
+			break;
+		case TMMSG_ALLOC:
+			return (TTAG) exec_mmu_slaballoc(mmu,
 				msg->tmmsg_Alloc.tmmsg_Size);
 		case TMMSG_FREE:
-			exec_mmu_pooltaskfree(mmu,
+			exec_mmu_slabfree(mmu,
 				msg->tmmsg_Free.tmmsg_Ptr,
 				msg->tmmsg_Free.tmmsg_Size);
 			break;
 		case TMMSG_REALLOC:
-			return (TTAG) exec_mmu_pooltaskrealloc(mmu,
+			return (TTAG) exec_mmu_slabrealloc(mmu,
 				msg->tmmsg_Realloc.tmmsg_Ptr,
 				msg->tmmsg_Realloc.tmmsg_OSize,
 				msg->tmmsg_Realloc.tmmsg_NSize);
@@ -1200,6 +1850,86 @@ exec_mmu_pooltask(struct THook *hook, TAPTR obj, TTAG m)
 	return 0;
 }
 
+/*****************************************************************************/
+/*
+**	slab allocator, task-safe
+*/
+
+static TAPTR
+exec_mmu_slabtaskalloc(struct TMemManager *mmu, TUINT size)
+{
+	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
+	TINT8 *mem;
+	exec_Lock(exec, &mmu->tmm_Lock);
+	mem = exec_mmu_slaballoc(mmu, size);
+	exec_Unlock(exec, &mmu->tmm_Lock);
+	return mem;
+}
+
+static void
+exec_mmu_slabtaskfree(struct TMemManager *mmu, TINT8 *mem, TUINT size)
+{
+	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
+	exec_Lock(exec, &mmu->tmm_Lock);
+	exec_mmu_slabfree(mmu, mem, size);
+	exec_Unlock(exec, &mmu->tmm_Lock);
+}
+
+static TAPTR
+exec_mmu_slabtaskrealloc(struct TMemManager *mmu, TINT8 *oldmem,
+	TUINT oldsize, TUINT newsize)
+{
+	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
+	TINT8 *newmem;
+	exec_Lock(exec, &mmu->tmm_Lock);
+	newmem = exec_mmu_slabrealloc(mmu, oldmem, oldsize, newsize);
+	exec_Unlock(exec, &mmu->tmm_Lock);
+	return newmem;
+}
+
+static const struct exec_depot exec_slabtaskdepot =
+{
+	exec_mmu_slabtaskalloc, exec_mmu_slabtaskfree, exec_mmu_slabtaskrealloc
+};
+
+static void
+exec_mmu_slabtaskdestroy(struct TMemManager *mmu)
+{
+	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
+	exec_destroycaches(exec, mmu, &exec_slabtaskdepot);
+	TDESTROY(&mmu->tmm_Lock);
+}
+
+static THOOKENTRY TTAG
+exec_mmu_slabtask(struct THook *hook, TAPTR obj, TTAG m)
+{
+	struct TMemManager *mmu = obj;
+	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
+	union TMemMsg *msg = (union TMemMsg *) m;
+	switch (msg->tmmsg_Type)
+	{
+		case TMMSG_DESTROY:
+			exec_mmu_slabtaskdestroy(mmu);
+			break;
+		case TMMSG_ALLOC:
+			return (TTAG) exec_cachealloc(exec, mmu,
+				msg->tmmsg_Alloc.tmmsg_Size, &exec_slabtaskdepot);
+		case TMMSG_FREE:
+			exec_cachefree(exec, mmu,
+				msg->tmmsg_Free.tmmsg_Ptr,
+				msg->tmmsg_Free.tmmsg_Size, &exec_slabtaskdepot);
+			break;
+		case TMMSG_REALLOC:
+			return (TTAG) exec_cacherealloc(exec, mmu,
+				msg->tmmsg_Realloc.tmmsg_Ptr,
+				msg->tmmsg_Realloc.tmmsg_OSize,
+				msg->tmmsg_Realloc.tmmsg_NSize, &exec_slabtaskdepot);
+		default:
+			TDBPRINTF(TDB_FAIL,("unknown hookmsg\n"));
+	}
+	return 0;
+}
+
 /*****************************************************************************/
 /*
 **	static memheader allocator, task-safe
@@ -1310,9 +2040,16 @@ exec_mmu_taskfree(struct TMemManager *mmu, TINT8 *mem, TUINT size)
 	exec_Unlock(exec, &mmu->tmm_Lock);
 }
 
+static const struct exec_depot exec_taskdepot =
+{
+	exec_mmu_taskalloc, exec_mmu_taskfree, exec_mmu_taskrealloc
+};
+
 static void
 exec_mmu_taskdestroy(struct TMemManager *mmu)
 {
+	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
+	exec_destroycaches(exec, mmu, &exec_taskdepot);
 	TDESTROY(&mmu->tmm_Lock);
 }
 
@@ -1320,6 +2057,7 @@ static THOOKENTRY TTAG
 exec_mmu_task(struct THook *hook, TAPTR obj, TTAG m)
 {
 	struct TMemManager *mmu = obj;
+	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
 	union TMemMsg *msg = (union TMemMsg *) m;
 	switch (msg->tmmsg_Type)
 	{
@@ -1327,18 +2065,18 @@ exec_mmu_task(struct THook *hook, TAPTR obj, TTAG m)
 			exec_mmu_taskdestroy(mmu);
 			break;
 		case TMMSG_ALLOC:
-			return (TTAG) exec_mmu_taskalloc(mmu,
-				msg->tmmsg_Alloc.tmmsg_Size);
+			return (TTAG) exec_cachealloc(exec, mmu,
+				msg->tmmsg_Alloc.tmmsg_Size, &exec_taskdepot);
 		case TMMSG_FREE:
-			exec_mmu_taskfree(mmu,
+			exec_cachefree(exec, mmu,
 				msg->tmmsg_Free.tmmsg_Ptr,
-				msg->tmmsg_Free.tmmsg_Size);
+				msg->tmmsg_Free.tmmsg_Size, &exec_taskdepot);
 			break;
 		case TMMSG_REALLOC:
-			return (TTAG) exec_mmu_taskrealloc(mmu,
+			return (TTAG) exec_cacherealloc(exec, mmu,
 				msg->tmmsg_Realloc.tmmsg_Ptr,
 				msg->tmmsg_Realloc.tmmsg_OSize,
-				msg->tmmsg_Realloc.tmmsg_NSize);
+				msg->tmmsg_Realloc.tmmsg_NSize, &exec_taskdepot);
 		default:
 			TDBPRINTF(TDB_FAIL,("unknown hookmsg\n"));
 	}
@@ -1359,6 +2097,7 @@ exec_mmu_trackalloc(struct TMemManager *mmu, TUINT size)
 	if (mem)
 	{
 		TAddHead(&mmu->tmm_TrackList, (struct TNode *) mem);
+		exec_statsalloc(mmu, size);
 		return (TAPTR) (mem + sizeof(struct TNode));
 	}
 	return TNULL;
@@ -1377,6 +2116,7 @@ exec_mmu_trackrealloc(struct TMemManager *mmu, TINT8 *oldmem, TUINT oldsize,
 	{
 		TAddHead(&mmu->tmm_TrackList, (struct TNode *) newmem);
 		newmem += sizeof(struct TNode);
+		exec_statsrealloc(mmu, oldsize, newsize);
 	}
 	return (TAPTR) newmem;
 }
@@ -1387,6 +2127,7 @@ exec_mmu_trackfree(struct TMemManager *mmu, TINT8 *mem, TUINT size)
 	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(mmu);
 	TREMOVE((struct TNode *) (mem - sizeof(struct TNode)));
 	exec_Free(exec, mem - sizeof(struct TNode));
+	exec_statsfree(mmu, size);
 }
 
 static void
@@ -1450,6 +2191,7 @@ exec_mmu_tasktrackalloc(struct TMemManager *mmu, TUINT size)
 	{
 		TAddHead(&mmu->tmm_TrackList, (struct TNode *) mem);
 		mem += sizeof(struct TNode);
+		exec_statsalloc(mmu, size);
 	}
 	exec_Unlock(exec, &mmu->tmm_Lock);
 	return (TAPTR) mem;
@@ -1469,6 +2211,7 @@ exec_mmu_tasktrackrealloc(struct TMemManager *mmu, TINT8 *oldmem,
 	{
 		TAddHead(&mmu->tmm_TrackList, (struct TNode *) newmem);
 		newmem += sizeof(struct TNode);
+		exec_statsrealloc(mmu, oldsize, newsize);
 	}
 	exec_Unlock(exec, &mmu->tmm_Lock);
 	return (TAPTR) newmem;
@@ -1481,6 +2224,7 @@ exec_mmu_tasktrackfree(struct TMemManager *mmu, TINT8 *mem, TUINT size)
 	exec_Lock(exec, &mmu->tmm_Lock);
 	TREMOVE((struct TNode *) (mem - sizeof(struct TNode)));
 	exec_Free(exec, mem - sizeof(struct TNode));
+	exec_statsfree(mmu, size);
 	exec_Unlock(exec, &mmu->tmm_Lock);
 }
 
@@ -1547,6 +2291,7 @@ exec_mmu_kntasktrackalloc(struct TMemManager *mmu, TUINT size)
 	{
 		TAddHead(&mmu->tmm_TrackList, mem);
 		mem++;
+		exec_statsalloc(mmu, size);
 	}
 	exec_Unlock(exec, &mmu->tmm_Lock);
 	return (TAPTR) mem;
@@ -1566,6 +2311,7 @@ exec_mmu_kntasktrackrealloc(struct TMemManager *mmu, TINT8 *oldmem,
 	{
 		TAddHead(&mmu->tmm_TrackList, newmem);
 		newmem++;
+		exec_statsrealloc(mmu, oldsize, newsize);
 	}
 	exec_Unlock(exec, &mmu->tmm_Lock);
 	return (TAPTR) newmem;
@@ -1579,6 +2325,7 @@ exec_mmu_kntasktrackfree(struct TMemManager *mmu, TINT8 *mem, TUINT size)
 	exec_Lock(exec, &mmu->tmm_Lock);
 	TREMOVE((struct TNode *) mem);
 	exec_Free(exec, mem);
+	exec_statsfree(mmu, size);
 	exec_Unlock(exec, &mmu->tmm_Lock);
 }
 
@@ -1918,6 +2665,27 @@ exec_initmmu(TEXECBASE *exec, struct TMemManager *mmu, TAPTR allocator,
 			}
 			break;
 
+		case TMMUT_Slab:
+			/*	MMU on top of a slab allocator */
+			if (allocator)
+			{
+				mmu->tmm_Hook.thk_Entry = exec_mmu_slab;
+				return TTRUE;
+			}
+			break;
+
+		case TMMUT_Slab | TMMUT_TaskSafe:
+			/*	MMU on top of a slab allocator, task-safe */
+			if (allocator)
+			{
+				if (exec_initlock(exec, &mmu->tmm_Lock))
+				{
+					mmu->tmm_Hook.thk_Entry = exec_mmu_slabtask;
+					return TTRUE;
+				}
+			}
+			break;
+
 		case TMMUT_Void:
 			mmu->tmm_Hook.thk_Entry = exec_mmu_void;
 			mmu->tmm_Allocator = TNULL;
@@ -1934,3 +2702,97 @@ exec_initmmu(TEXECBASE *exec, struct TMemManager *mmu, TAPTR allocator,
  	mmu->tmm_Type = TMMUT_Void;
 	return TFALSE;
 }
+
+/*****************************************************************************/
+/*
+**	mmu = exec_FindMMU(exec, name)
+**	Find a memory manager that was created with a name. The caller must
+**	ensure that it is not destroyed while the pointer is in use; see also
+**	exec_GetNamedMMUStats().
+*/
+
+EXPORT TAPTR
+exec_FindMMU(TEXECBASE *exec, TSTRPTR name)
+{
+	TAPTR hal = exec->texb_HALBase;
+	TAPTR mmu;
+	if (name == TNULL)
+		return TNULL;
+	THALLock(hal, &exec->texb_Lock);
+	mmu = TFindHandle(&exec->texb_MMUList, name);
+	THALUnlock(hal, &exec->texb_Lock);
+	return mmu;
+}
+
+/*****************************************************************************/
+/*
+**	success = exec_GetMMUStats(exec, mmu, stats)
+**	Get a memory manager's statistics. Returns TFALSE if the memory
+**	manager does not count allocations; the lock and cache counters are
+**	filled in regardless.
+*/
+
+EXPORT TBOOL
+exec_GetMMUStats(TEXECBASE *exec, struct TMemManager *mmu,
+	struct TMMUStats *stats)
+{
+	THOOKENTRY THOOKFUNC entry;
+	TBOOL locked;
+
+	if (mmu == TNULL)
+		mmu = &exec->texb_BaseMMU;
+
+	entry = mmu->tmm_Hook.thk_Entry;
+	locked = entry == exec_mmu_tasktrack || entry == exec_mmu_kntasktrack ||
+		entry == exec_mmu_slabtask;
+
+	if (locked)
+		exec_Lock(exec, &mmu->tmm_Lock);
+	exec_CopyMem(exec, &mmu->tmm_Stats, stats, sizeof(struct TMMUStats));
+	if (locked)
+		exec_Unlock(exec, &mmu->tmm_Lock);
+
+	stats->tms_LockWaits = mmu->tmm_Lock.tlk_Contended;
+	stats->tms_CacheHits = 0;
+	stats->tms_CacheMisses = 0;
+	#if defined(TSYS_HAVE_ATOMICS)
+	{
+		struct TMMUCache *cache;
+		THALLock(exec->texb_HALBase, &exec->texb_CacheLock);
+		for (cache = mmu->tmm_Caches; cache; cache = cache->tmc_Next)
+		{
+			stats->tms_CacheHits += cache->tmc_Hits;
+			stats->tms_CacheMisses += cache->tmc_Misses;
+		}
+		THALUnlock(exec->texb_HALBase, &exec->texb_CacheLock);
+	}
+	#endif
+
+	return (mmu->tmm_Type & (TMMUT_Tracking | TMMUT_Slab)) != 0;
+}
+
+/*****************************************************************************/
+/*
+**	result = exec_GetNamedMMUStats(exec, name, stats)
+**	Get the statistics of the memory manager registered under the given
+**	name. It is looked up and read in one go, so that it cannot be
+**	destroyed in the meantime. Returns -1 if no such memory manager
+**	exists, otherwise the result of exec_GetMMUStats().
+*/
+
+EXPORT TINT
+exec_GetNamedMMUStats(TEXECBASE *exec, TSTRPTR name,
+	struct TMMUStats *stats)
+{
+	TAPTR hal = exec->texb_HALBase;
+	struct TMemManager *mmu;
+	TINT result = -1;
+	if (name == TNULL)
+		return -1;
+	THALLock(hal, &exec->texb_Lock);
+	mmu = (struct TMemManager *) TFindHandle(&exec->texb_MMUList, name);
+	if (mmu)
+		result = exec_GetMMUStats(exec, mmu, stats);
+	THALUnlock(hal, &exec->texb_Lock);
+	return result;
+}
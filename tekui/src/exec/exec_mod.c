@@ -152,6 +152,13 @@ exec_vectors[EXEC_NUMVECTORS] =
 
 	(TMFPTR) exec_AddModules,
 	(TMFPTR) exec_RemModules,
+
+	(TMFPTR) exec_FindMMU,
+	(TMFPTR) exec_GetMMUStats,
+	(TMFPTR) exec_CreateWorkerPool,
+	(TMFPTR) exec_SubmitJob,
+	(TMFPTR) exec_CancelJob,
+	(TMFPTR) exec_GetNamedMMUStats,
 };
 
 /*****************************************************************************/
@@ -165,6 +172,8 @@ exec_dispatch(struct THook *hook, TAPTR obj, TTAG msg)
 	if (msg == TMSG_DESTROY)
 	{
 		TEXECBASE *exec = obj;
+		THALDestroyLock(exec->texb_HALBase, &exec->texb_CacheLock);
+		THALDestroyLock(exec->texb_HALBase, &exec->texb_AtomLock);
 		THALDestroyLock(exec->texb_HALBase, &exec->texb_Lock);
 		TDESTROY(&exec->texb_BaseMMU);
 		TDESTROY(&exec->texb_MsgMMU);
@@ -181,6 +190,7 @@ static TBOOL
 exec_init(TEXECBASE *exec, TTAGITEM *tags)
 {
 	TAPTR *halp, hal;
+	TINT i;
 
 	halp = (TAPTR *) TGetTag(tags, TExecBase_HAL, TNULL);
 	if (!halp)
@@ -192,45 +202,58 @@ exec_init(TEXECBASE *exec, TTAGITEM *tags)
 
 	if (THALInitLock(hal, &exec->texb_Lock))
 	{
-		if (exec_initmmu(exec, &exec->texb_MsgMMU, TNULL, TMMUT_Message,
-			TNULL))
+		if (THALInitLock(hal, &exec->texb_AtomLock))
 		{
-			if (exec_initmmu(exec, &exec->texb_BaseMMU, TNULL, TMMUT_TaskSafe,
-				TNULL))
+			if (THALInitLock(hal, &exec->texb_CacheLock))
 			{
-				exec->texb_Module.tmd_Handle.thn_Name = TMODNAME_EXEC;
-				exec->texb_Module.tmd_Handle.thn_Owner =
-					(struct TModule *) exec;
-				exec->texb_Module.tmd_ModSuper = (struct TModule *) exec;
-				exec->texb_Module.tmd_InitTask = TNULL; /* inserted later */
-				exec->texb_Module.tmd_HALMod = TNULL; /* inserted later */
-				exec->texb_Module.tmd_NegSize =
-					EXEC_NUMVECTORS * sizeof(TAPTR);
-				exec->texb_Module.tmd_PosSize = sizeof(TEXECBASE);
-				exec->texb_Module.tmd_RefCount = 1;
-				exec->texb_Module.tmd_Flags =
-					TMODF_INITIALIZED | TMODF_VECTORTABLE;
-
-				TInitList(&exec->texb_IntModList);
-				exec->texb_InitModNode.tmin_Modules = (struct TInitModule *)
-					TGetTag(tags, TExecBase_ModInit, TNULL);
-				if (exec->texb_InitModNode.tmin_Modules)
+				if (exec_initmmu(exec, &exec->texb_MsgMMU, TNULL,
+					TMMUT_Message, TNULL))
 				{
-					TAddTail(&exec->texb_IntModList,
-						&exec->texb_InitModNode.tmin_Node);
+					if (exec_initmmu(exec, &exec->texb_BaseMMU, TNULL,
+						TMMUT_TaskSafe, TNULL))
+					{
+						exec->texb_Module.tmd_Handle.thn_Name = TMODNAME_EXEC;
+						exec->texb_Module.tmd_Handle.thn_Owner =
+							(struct TModule *) exec;
+						exec->texb_Module.tmd_ModSuper =
+							(struct TModule *) exec;
+						/* inserted later: */
+						exec->texb_Module.tmd_InitTask = TNULL;
+						exec->texb_Module.tmd_HALMod = TNULL;
+						exec->texb_Module.tmd_NegSize =
+							EXEC_NUMVECTORS * sizeof(TAPTR);
+						exec->texb_Module.tmd_PosSize = sizeof(TEXECBASE);
+						exec->texb_Module.tmd_RefCount = 1;
+						exec->texb_Module.tmd_Flags =
+							TMODF_INITIALIZED | TMODF_VECTORTABLE;
+
+						TInitList(&exec->texb_IntModList);
+						exec->texb_InitModNode.tmin_Modules =
+							(struct TInitModule *)
+							TGetTag(tags, TExecBase_ModInit, TNULL);
+						if (exec->texb_InitModNode.tmin_Modules)
+						{
+							TAddTail(&exec->texb_IntModList,
+								&exec->texb_InitModNode.tmin_Node);
+						}
+
+						for (i = 0; i < TATOM_HASHSIZE; ++i)
+							TInitList(&exec->texb_AtomHash[i]);
+						TInitList(&exec->texb_MMUList);
+						TInitList(&exec->texb_TaskList);
+						TInitList(&exec->texb_TaskInitList);
+						TInitList(&exec->texb_TaskExitList);
+						TInitList(&exec->texb_ModList);
+						TAddHead(&exec->texb_ModList, (struct TNode *) exec);
+						TAddHead(&exec->texb_ModList, (struct TNode *) hal);
+
+						return TTRUE;
+					}
+					TDESTROY(&exec->texb_MsgMMU);
 				}
-
-				TInitList(&exec->texb_AtomList);
-				TInitList(&exec->texb_TaskList);
-				TInitList(&exec->texb_TaskInitList);
-				TInitList(&exec->texb_TaskExitList);
-				TInitList(&exec->texb_ModList);
-				TAddHead(&exec->texb_ModList, (struct TNode *) exec);
-				TAddHead(&exec->texb_ModList, (struct TNode *) hal);
-
-				return TTRUE;
+				THALDestroyLock(hal, &exec->texb_CacheLock);
 			}
-			TDESTROY(&exec->texb_MsgMMU);
+			THALDestroyLock(hal, &exec->texb_AtomLock);
 		}
 		THALDestroyLock(hal, &exec->texb_Lock);
 	}
@@ -321,7 +344,7 @@ exec_destroyport_internal(struct THook *h, TAPTR obj, TTAG msg)
 		struct TMsgPort *port = obj;
 		TEXECBASE *exec = (TEXECBASE *) TGetExecBase(port);
 
-		if (!TISLISTEMPTY(&port->tmp_MsgList))
+		if (!TISLISTEMPTY(&port->tmp_MsgList) || port->tmp_Incoming)
 			TDBPRINTF(TDB_FAIL,("Message queue was not empty\n"));
 
 		exec_freesignal(exec, port->tmp_SigTask, port->tmp_Signal);
@@ -348,6 +371,8 @@ exec_initport(TEXECBASE *exec, struct TMsgPort *port, struct TTask *task,
 		port->tmp_Handle.thn_Owner = (struct TModule *) exec;
 		port->tmp_Handle.thn_Name = TNULL;
 		TInitList(&port->tmp_MsgList);
+		port->tmp_Incoming = TNULL;
+		port->tmp_Flags = 0;
 		port->tmp_Hook = TNULL;
 		port->tmp_Signal = signal;
 		port->tmp_SigTask = task;
@@ -387,11 +412,91 @@ exec_initlock(TEXECBASE *exec, struct TLock *lock)
 		lock->tlk_Owner = TNULL;
 		lock->tlk_NestCount = 0;
 		lock->tlk_WaitCount = 0;
+		lock->tlk_Contended = 0;
 		return TTRUE;
 	}
 	return TFALSE;
 }
 
+/*****************************************************************************/
+/*
+**	exec_queuemsg(exec, port, msg, status)
+**	Queue a message in a port, set its status, and signal the port's
+**	owner. Lock-free ports are signalled only when the first message
+**	arrives after the owner has taken over the previous ones. Port hooks
+**	are still serialized with the port lock.
+*/
+
+LOCAL void
+exec_queuemsg(TEXECBASE *exec, struct TMsgPort *port, struct TMessage *msg,
+	TUINT status)
+{
+	TAPTR hal = exec->texb_HALBase;
+
+	#if defined(TSYS_HAVE_ATOMICS)
+	if (port->tmp_Flags & TMSGPORTF_LOCKFREE)
+	{
+		struct TNode *head;
+		msg->tmsg_Flags = status;
+		if (port->tmp_Hook)
+		{
+			THALLock(hal, &port->tmp_Lock);
+			if (port->tmp_Hook)
+				TCALLHOOKPKT(port->tmp_Hook, port, (TTAG) msg);
+			THALUnlock(hal, &port->tmp_Lock);
+		}
+		do
+		{
+			head = port->tmp_Incoming;
+			msg->tmsg_Node.tln_Succ = head;
+		} while (!TATOMIC_CAS(&port->tmp_Incoming, head, &msg->tmsg_Node));
+		if (head == TNULL)
+			THALSignal(hal, &port->tmp_SigTask->tsk_Thread, port->tmp_Signal);
+		return;
+	}
+	#endif
+
+	THALLock(hal, &port->tmp_Lock);
+	TAddTail(&port->tmp_MsgList, (struct TNode *) msg);
+	msg->tmsg_Flags = status;
+	if (port->tmp_Hook)
+		TCALLHOOKPKT(port->tmp_Hook, port, (TTAG) msg);
+	THALUnlock(hal, &port->tmp_Lock);
+
+	THALSignal(hal, &port->tmp_SigTask->tsk_Thread, port->tmp_Signal);
+}
+
+/*****************************************************************************/
+/*
+**	exec_drainport(exec, port)
+**	Take over the messages that have arrived at a lock-free port, and
+**	append them to its message list in order of arrival. To be called by
+**	the port's owner only.
+*/
+
+LOCAL void
+exec_drainport(TEXECBASE *exec, struct TMsgPort *port)
+{
+	#if defined(TSYS_HAVE_ATOMICS)
+	if (port->tmp_Incoming)
+	{
+		struct TNode *next, *node = TATOMIC_SWAP(&port->tmp_Incoming, TNULL);
+		struct TNode *pred = port->tmp_MsgList.tlh_TailPred;
+		struct TNode *succ = (struct TNode *) &port->tmp_MsgList.tlh_Tail;
+		/* link newest to oldest, inserting each before its successor */
+		for (; node; node = next)
+		{
+			next = node->tln_Succ;
+			node->tln_Succ = succ;
+			succ->tln_Pred = node;
+			succ = node;
+		}
+		succ->tln_Pred = pred;
+		pred->tln_Succ = succ;
+	}
+	#endif
+}
+
 /*****************************************************************************/
 /*
 **	msg = exec_getmsg(exec, port)
@@ -404,9 +509,18 @@ exec_getmsg(TEXECBASE *exec, struct TMsgPort *port)
 	struct TMessage *msg;
 	TAPTR hal = exec->texb_HALBase;
 
-	THALLock(hal, &port->tmp_Lock);
-	msg = (struct TMessage *) TRemHead(&port->tmp_MsgList);
-	THALUnlock(hal, &port->tmp_Lock);
+	if (port->tmp_Flags & TMSGPORTF_LOCKFREE)
+	{
+		if (TISLISTEMPTY(&port->tmp_MsgList))
+			exec_drainport(exec, port);
+		msg = (struct TMessage *) TRemHead(&port->tmp_MsgList);
+	}
+	else
+	{
+		THALLock(hal, &port->tmp_Lock);
+		msg = (struct TMessage *) TRemHead(&port->tmp_MsgList);
+		THALUnlock(hal, &port->tmp_Lock);
+	}
 
 	if (msg)
 	{
@@ -428,7 +542,6 @@ LOCAL TUINT
 exec_sendmsg(TEXECBASE *exec, struct TTask *task, struct TMsgPort *port,
 	TAPTR mem)
 {
-	TAPTR hal = exec->texb_HALBase;
 	struct TMessage *msg = TGETMSGPTR(mem);
 	TAPTR reply;
 
@@ -438,14 +551,7 @@ exec_sendmsg(TEXECBASE *exec, struct TTask *task, struct TMsgPort *port,
 	/* sender is local address space */
 	msg->tmsg_Sender = TNULL;
 
-	THALLock(hal, &port->tmp_Lock);
-	TAddTail(&port->tmp_MsgList, (struct TNode *) msg);
-	msg->tmsg_Flags = TMSG_STATUS_SENT | TMSGF_QUEUED;
-	if (port->tmp_Hook)
-		TCALLHOOKPKT(port->tmp_Hook, port, (TTAG) msg);
-	THALUnlock(hal, &port->tmp_Lock);
-
-	THALSignal(hal, &port->tmp_SigTask->tsk_Thread, port->tmp_Signal);
+	exec_queuemsg(exec, port, msg, TMSG_STATUS_SENT | TMSGF_QUEUED);
 
 	for (;;)
 	{
@@ -474,19 +580,7 @@ exec_returnmsg(TEXECBASE *exec, TAPTR mem, TUINT status)
 	struct TMessage *msg = TGETMSGPTR(mem);
 	struct TMsgPort *replyport = msg->tmsg_RPort;
 	if (replyport)
-	{
-		TAPTR hal = exec->texb_HALBase;
-
-		THALLock(hal, &replyport->tmp_Lock);
-		TAddTail(&replyport->tmp_MsgList, (struct TNode *) msg);
-		msg->tmsg_Flags = status;
-		if (replyport->tmp_Hook)
-			TCALLHOOKPKT(replyport->tmp_Hook, replyport, (TTAG) msg);
-		THALUnlock(hal, &replyport->tmp_Lock);
-
-		THALSignal(hal, &replyport->tmp_SigTask->tsk_Thread,
-			replyport->tmp_Signal);
-	}
+		exec_queuemsg(exec, replyport, msg, status);
 	else
 	{
 		exec_Free(exec, mem);	/* free one-way msg transparently */
@@ -18,7 +18,7 @@
 
 #define EXEC_VERSION	5
 #define EXEC_REVISION	0
-#define EXEC_NUMVECTORS	74
+#define EXEC_NUMVECTORS	80
 
 /*****************************************************************************/
 
@@ -57,6 +57,14 @@ LOCAL void exec_freesignal(TEXECBASE *exec, struct TTask *task,
 	TUINT signals);
 LOCAL TBOOL exec_initlock(TEXECBASE *exec, struct TLock *lock);
 LOCAL TAPTR exec_getmsg(TEXECBASE *exec, struct TMsgPort *port);
+LOCAL void exec_queuemsg(TEXECBASE *exec, struct TMsgPort *port,
+	struct TMessage *msg, TUINT status);
+LOCAL void exec_drainport(TEXECBASE *exec, struct TMsgPort *port);
+LOCAL TBOOL exec_lockatomfast(TEXECBASE *exec, struct TAtom **patom,
+	struct TTask *task, TUINT mode);
+LOCAL TBOOL exec_unlockatomfast(TEXECBASE *exec, struct TAtom *atom,
+	TUINT mode);
+LOCAL void exec_releasecaches(TEXECBASE *exec, struct TTask *task);
 LOCAL void exec_returnmsg(TEXECBASE *exec, TAPTR mem, TUINT status);
 LOCAL TUINT exec_sendmsg(TEXECBASE *exec, struct TTask *task,
 	struct TMsgPort *port, TAPTR mem);
@@ -143,6 +151,16 @@ EXPORT TBOOL exec_AddModules(TEXECBASE *exec, struct TModInitNode *tmin,
 	TUINT flags);
 EXPORT TBOOL exec_RemModules(TEXECBASE *exec, struct TModInitNode *tmin,
 	TUINT flags);
+EXPORT TAPTR exec_FindMMU(TEXECBASE *exec, TSTRPTR name);
+EXPORT TBOOL exec_GetMMUStats(TEXECBASE *exec, struct TMemManager *mmu,
+	struct TMMUStats *stats);
+EXPORT TAPTR exec_CreateWorkerPool(TEXECBASE *exec, struct TTagItem *tags);
+EXPORT TBOOL exec_SubmitJob(TEXECBASE *exec, struct TWorkerPool *pool,
+	struct TJob *job);
+EXPORT TBOOL exec_CancelJob(TEXECBASE *exec, struct TWorkerPool *pool,
+	struct TJob *job);
+EXPORT TINT exec_GetNamedMMUStats(TEXECBASE *exec, TSTRPTR name,
+	struct TMMUStats *stats);
 
 /*****************************************************************************/
 /*
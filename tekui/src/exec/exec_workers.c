@@ -0,0 +1,319 @@
+/*
+**	teklib/src/exec/exec_workers.c - Worker pools with work stealing
+**	See copyright notice in teklib/COPYRIGHT
+*/
+
+#include "exec_mod.h"
+#include <tek/debug.h>
+#include <tek/teklib.h>
+
+/* Number of workers if not specified: */
+#define EXEC_DEFWORKERS	4
+
+/*****************************************************************************/
+/*
+**	exec_completejob(exec, job, status)
+**	Set the final status of a job, and return it to its reply port
+**	and/or signal its task. The job must not be accessed afterwards.
+*/
+
+static void
+exec_completejob(TEXECBASE *exec, struct TJob *job, TUINT status)
+{
+	struct TMsgPort *rport = job->tjb_ReplyPort;
+	struct TTask *sigtask = job->tjb_SigTask;
+	TUINT signals = job->tjb_Signals;
+
+	job->tjb_Status = status;
+	if (rport)
+	{
+		TGETMSGREPLYPORT(job) = rport;
+		exec_returnmsg(exec, job, (status == TJOB_DONE ?
+			TMSG_STATUS_REPLIED : TMSG_STATUS_FAILED) | TMSGF_QUEUED);
+	}
+	if (sigtask)
+		THALSignal(exec->texb_HALBase, &sigtask->tsk_Thread, signals);
+}
+
+/*****************************************************************************/
+/*
+**	job = exec_getjob(exec, worker)
+**	Take the most recent job from the worker's own queue, or steal the
+**	oldest job from one of the other workers.
+*/
+
+static struct TJob *
+exec_getjob(TEXECBASE *exec, struct TWorker *worker)
+{
+	TAPTR hal = exec->texb_HALBase;
+	struct TWorkerPool *pool = worker->twk_Pool;
+	TUINT n = pool->twp_NumWorkers;
+	TUINT i = worker - pool->twp_Workers;
+	struct TJob *job;
+	TUINT j;
+
+	THALLock(hal, &worker->twk_Lock);
+	job = (struct TJob *) TRemTail(&worker->twk_Jobs);
+	if (job)
+		job->tjb_Status = TJOB_RUNNING;
+	THALUnlock(hal, &worker->twk_Lock);
+
+	for (j = 1; job == TNULL && j < n; ++j)
+	{
+		struct TWorker *victim = &pool->twp_Workers[(i + j) % n];
+		if (TISLISTEMPTY(&victim->twk_Jobs))
+			continue;
+		THALLock(hal, &victim->twk_Lock);
+		job = (struct TJob *) TRemHead(&victim->twk_Jobs);
+		if (job)
+			job->tjb_Status = TJOB_RUNNING;
+		THALUnlock(hal, &victim->twk_Lock);
+	}
+
+	return job;
+}
+
+/*****************************************************************************/
+/*
+**	Worker task
+*/
+
+static TTASKENTRY void
+exec_workertask(struct TTask *task)
+{
+	TEXECBASE *exec = (TEXECBASE *) TGetExecBase(task);
+	struct TWorker *worker = task->tsk_UserData;
+
+	for (;;)
+	{
+		struct TJob *job = exec_getjob(exec, worker);
+		if (job)
+		{
+			(*job->tjb_Func)(task, job);
+			exec_completejob(exec, job, TJOB_DONE);
+			continue;
+		}
+
+		/* signals are sticky, a job queued meanwhile is not missed */
+		worker->twk_Idle = TTRUE;
+		if (THALWait(exec->texb_HALBase, TTASK_SIG_USER | TTASK_SIG_ABORT) &
+			TTASK_SIG_ABORT)
+			break;
+		worker->twk_Idle = TFALSE;
+	}
+}
+
+/*****************************************************************************/
+/*
+**	pool = exec_CreateWorkerPool(exec, tags)
+**	Create a pool of worker tasks. Destroying the pool cancels the jobs
+**	that are still queued, and waits for running jobs to finish.
+*/
+
+static THOOKENTRY TTAG
+exec_destroyworkerpool(struct THook *hook, TAPTR obj, TTAG msg)
+{
+	if (msg == TMSG_DESTROY)
+	{
+		struct TWorkerPool *pool = obj;
+		TEXECBASE *exec = (TEXECBASE *) TGetExecBase(pool);
+		TAPTR hal = exec->texb_HALBase;
+		TUINT i;
+
+		pool->twp_Abort = TTRUE;
+
+		for (i = 0; i < pool->twp_NumWorkers; ++i)
+		{
+			struct TWorker *worker = &pool->twp_Workers[i];
+			struct TList cancelled;
+			struct TNode *node;
+
+			TInitList(&cancelled);
+			THALLock(hal, &worker->twk_Lock);
+			while ((node = TRemHead(&worker->twk_Jobs)))
+				TAddTail(&cancelled, node);
+			THALUnlock(hal, &worker->twk_Lock);
+
+			while ((node = TRemHead(&cancelled)))
+				exec_completejob(exec, (struct TJob *) node, TJOB_CANCELLED);
+
+			if (worker->twk_Task)
+				THALSignal(hal, &worker->twk_Task->tsk_Thread,
+					TTASK_SIG_ABORT);
+		}
+
+		for (i = 0; i < pool->twp_NumWorkers; ++i)
+		{
+			struct TWorker *worker = &pool->twp_Workers[i];
+			TDESTROY(worker->twk_Task);
+			THALDestroyLock(hal, &worker->twk_Lock);
+		}
+
+		exec_Free(exec, pool);
+	}
+	return 0;
+}
+
+EXPORT TAPTR
+exec_CreateWorkerPool(TEXECBASE *exec, struct TTagItem *tags)
+{
+	TAPTR hal = exec->texb_HALBase;
+	TUINT n = (TUINT) TGetTag(tags, TWorkerPool_NumWorkers, EXEC_DEFWORKERS);
+	struct TWorkerPool *pool;
+	TTAGITEM tasktags[2];
+	TUINT i;
+
+	if (n == 0)
+		return TNULL;
+
+	pool = exec_AllocMMU0(exec, TNULL,
+		sizeof(struct TWorkerPool) + sizeof(struct TWorker) * n);
+	if (pool == TNULL)
+		return TNULL;
+
+	pool->twp_Handle.thn_Hook.thk_Entry = exec_destroyworkerpool;
+	pool->twp_Handle.thn_Owner = (struct TModule *) exec;
+	pool->twp_Workers = (struct TWorker *) (pool + 1);
+
+	for (i = 0; i < n; ++i)
+	{
+		struct TWorker *worker = &pool->twp_Workers[i];
+		if (!THALInitLock(hal, &worker->twk_Lock))
+			break;
+		worker->twk_Pool = pool;
+		TInitList(&worker->twk_Jobs);
+		pool->twp_NumWorkers++;
+	}
+
+	if (pool->twp_NumWorkers == n)
+	{
+		tasktags[0].tti_Tag = TTask_UserData;
+		tasktags[1].tti_Tag = TTAG_DONE;
+		for (i = 0; i < n; ++i)
+		{
+			struct TWorker *worker = &pool->twp_Workers[i];
+			tasktags[0].tti_Value = (TTAG) worker;
+			worker->twk_Task = exec_CreateTask(exec,
+				(TTASKFUNC) exec_workertask, TNULL, tasktags);
+			if (worker->twk_Task == TNULL)
+				break;
+		}
+		if (i == n)
+			return pool;
+	}
+
+	TDBPRINTF(TDB_ERROR,("failed to create worker pool\n"));
+	exec_destroyworkerpool(&pool->twp_Handle.thn_Hook, pool, TMSG_DESTROY);
+	return TNULL;
+}
+
+/*****************************************************************************/
+/*
+**	success = exec_SubmitJob(exec, pool, job)
+**	Queue a job in a worker pool. A job submitted from one of the pool's
+**	workers is queued with that worker, other jobs are distributed over
+**	the workers in turn. Fails if the pool is being destroyed.
+*/
+
+EXPORT TBOOL
+exec_SubmitJob(TEXECBASE *exec, struct TWorkerPool *pool, struct TJob *job)
+{
+	TAPTR hal = exec->texb_HALBase;
+	struct TTask *self = THALFindSelf(hal);
+	struct TWorker *worker = TNULL;
+	TUINT n, i;
+
+	if (pool == TNULL || job == TNULL || job->tjb_Func == TNULL)
+	{
+		TDBPRINTF(TDB_WARN,("pool/job=TNULL\n"));
+		return TFALSE;
+	}
+
+	n = pool->twp_NumWorkers;
+	for (i = 0; i < n; ++i)
+	{
+		if (pool->twp_Workers[i].twk_Task == self)
+		{
+			worker = &pool->twp_Workers[i];
+			break;
+		}
+	}
+
+	if (worker == TNULL)
+	{
+		/* races on the counter only affect the distribution */
+		worker = &pool->twp_Workers[pool->twp_NextWorker++ % n];
+	}
+
+	job->tjb_Worker = worker;
+	job->tjb_Cancel = TFALSE;
+
+	THALLock(hal, &worker->twk_Lock);
+	if (pool->twp_Abort)
+	{
+		THALUnlock(hal, &worker->twk_Lock);
+		return TFALSE;
+	}
+	job->tjb_Status = TJOB_QUEUED;
+	TAddTail(&worker->twk_Jobs, &job->tjb_Node);
+	THALUnlock(hal, &worker->twk_Lock);
+
+	if (worker->twk_Task != self)
+		THALSignal(hal, &worker->twk_Task->tsk_Thread, TTASK_SIG_USER);
+
+	if (!worker->twk_Idle || worker->twk_Task == self)
+	{
+		/* wake up an idle worker to steal the job */
+		for (i = 0; i < n; ++i)
+		{
+			struct TWorker *thief = &pool->twp_Workers[i];
+			if (thief != worker && thief->twk_Idle)
+			{
+				THALSignal(hal, &thief->twk_Task->tsk_Thread,
+					TTASK_SIG_USER);
+				break;
+			}
+		}
+	}
+
+	return TTRUE;
+}
+
+/*****************************************************************************/
+/*
+**	success = exec_CancelJob(exec, pool, job)
+**	Cancel a job that is still queued, which is then completed with the
+**	status TJOB_CANCELLED. If the job is already running, its tjb_Cancel
+**	field is set, and TFALSE is returned. The job must not have been
+**	completed yet.
+*/
+
+EXPORT TBOOL
+exec_CancelJob(TEXECBASE *exec, struct TWorkerPool *pool, struct TJob *job)
+{
+	TAPTR hal = exec->texb_HALBase;
+	struct TWorker *worker;
+	TBOOL cancelled = TFALSE;
+
+	if (pool == TNULL || job == TNULL)
+	{
+		TDBPRINTF(TDB_WARN,("pool/job=TNULL\n"));
+		return TFALSE;
+	}
+
+	worker = job->tjb_Worker;
+	THALLock(hal, &worker->twk_Lock);
+	if (job->tjb_Status == TJOB_QUEUED)
+	{
+		TREMOVE(&job->tjb_Node);
+		cancelled = TTRUE;
+	}
+	else
+		job->tjb_Cancel = TTRUE;
+	THALUnlock(hal, &worker->twk_Lock);
+
+	if (cancelled)
+		exec_completejob(exec, job, TJOB_CANCELLED);
+
+	return cancelled;
+}
@@ -14,7 +14,7 @@
 
 #define HAL_VERSION		2
 #define HAL_REVISION	0
-#define HAL_NUMVECTORS	31
+#define HAL_NUMVECTORS	32
 
 static THOOKENTRY TTAG hal_dispatch(struct THook *hook, TAPTR obj, TTAG msg);
 static const TMFPTR hal_vectors[HAL_NUMVECTORS];
@@ -129,6 +129,8 @@ hal_vectors[HAL_NUMVECTORS] =
 
 	(TMFPTR) hal_datetojulian,
 	(TMFPTR) hal_juliantodate,
+
+	(TMFPTR) hal_getmonotime,
 };
 
 /*****************************************************************************/
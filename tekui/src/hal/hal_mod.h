@@ -91,6 +91,7 @@ EXPORT TUINT hal_wait(TMOD_HAL *hal, TUINT signals);
 EXPORT void hal_signal(TMOD_HAL *hal, THALO *thread, TUINT signals);
 EXPORT TUINT hal_setsignal(TMOD_HAL *hal, TUINT newsig, TUINT sigmask);
 EXPORT void hal_getsystime(TMOD_HAL *hal, TTIME *time);
+EXPORT void hal_getmonotime(TMOD_HAL *hal, TTIME *time);
 
 EXPORT TDOUBLE hal_datetojulian(TMOD_HAL *hal, TDATE *date);
 EXPORT void hal_juliantodate(TMOD_HAL *hal, TDOUBLE jd, TDATE *date);
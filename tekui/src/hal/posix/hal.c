@@ -23,6 +23,11 @@
 #include <time.h>
 #include <dlfcn.h>
 
+#if defined(HAL_POSIX_FUTEX_USE)
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
 /* undefine to use waiting locks */
 #define HAL_POSIX_SPINLOCK_USE
 /* if defined, number of spins before falling back to waits */
@@ -208,6 +213,82 @@ hal_fillmem(TMOD_HAL *hal, TAPTR dest, TUINT numbytes, TUINT8 fillval)
 	memset(dest, (int) fillval, numbytes);
 }
 
+/*****************************************************************************/
+/*
+**	Futexes: Signals are ORed into the thread's signal word, and a waiting
+**	thread sleeps on that word. Locks are spin-then-sleep mutexes with the
+**	states 0 (free), 1 (locked) and 2 (locked, possibly with waiters).
+*/
+
+#if defined(HAL_POSIX_FUTEX_USE)
+
+static int
+hal_futex(volatile TUINT *addr, int op, TUINT val, const struct timespec *ts)
+{
+	return syscall(SYS_futex, addr, op | FUTEX_PRIVATE_FLAG, val, ts,
+		NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+EXPORT TBOOL
+hal_initlock(TMOD_HAL *hal, THALO *lock)
+{
+	struct HALLock *l = THALNewObject(hal, lock, struct HALLock);
+	if (l)
+	{
+		l->hlk_State = 0;
+		THALSetObject(lock, struct HALLock, l);
+		return TTRUE;
+	}
+	TDBPRINTF(20,("could not create lock\n"));
+	return TFALSE;
+}
+
+EXPORT void
+hal_destroylock(TMOD_HAL *hal, THALO *lock)
+{
+	struct HALLock *l = THALGetObject(lock, struct HALLock);
+	if (l->hlk_State) TDBPRINTF(20,("lock still held\n"));
+	THALDestroyObject(hal, l, struct HALLock);
+}
+
+EXPORT void
+hal_lock(TMOD_HAL *hal, THALO *lock)
+{
+	struct HALLock *l = THALGetObject(lock, struct HALLock);
+	TUINT c = __sync_val_compare_and_swap(&l->hlk_State, 0, 1);
+	#if defined(HAL_POSIX_SPINLOCK_MAXCOUNT)
+	int maxc = HAL_POSIX_SPINLOCK_MAXCOUNT;
+	while (c == 1 && --maxc)
+	{
+		if (l->hlk_State == 0)
+			c = __sync_val_compare_and_swap(&l->hlk_State, 0, 1);
+	}
+	#endif
+	if (c == 0)
+		return;
+	/* mark contended, and sleep until we are the one to unlock it */
+	if (c != 2)
+		c = __sync_lock_test_and_set(&l->hlk_State, 2);
+	while (c != 0)
+	{
+		hal_futex(&l->hlk_State, FUTEX_WAIT, 2, NULL);
+		c = __sync_lock_test_and_set(&l->hlk_State, 2);
+	}
+}
+
+EXPORT void
+hal_unlock(TMOD_HAL *hal, THALO *lock)
+{
+	struct HALLock *l = THALGetObject(lock, struct HALLock);
+	if (__sync_fetch_and_sub(&l->hlk_State, 1) != 1)
+	{
+		l->hlk_State = 0;
+		hal_futex(&l->hlk_State, FUTEX_WAKE, 1, NULL);
+	}
+}
+
+#else
+
 /*****************************************************************************/
 /*
 **	Locks
@@ -266,6 +347,8 @@ hal_unlock(TMOD_HAL *hal, THALO *lock)
 	pthread_mutex_unlock(mut);
 }
 
+#endif
+
 /*****************************************************************************/
 /*
 **	Threads
@@ -299,9 +382,22 @@ hal_initthread(TMOD_HAL *hal, THALO *thread,
 	struct HALThread *t = THALNewObject(hal, thread, struct HALThread);
 	if (t)
 	{
-		if (pthread_cond_init(&t->hth_SigCond, NULL) == 0)
+		#if defined(HAL_POSIX_FUTEX_USE)
+		t->hth_SigWaiting = 0;
+		#else
+		pthread_condattr_t attr;
+		int err;
+		pthread_condattr_init(&attr);
+		/* timed waits are on the monotonic clock */
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		err = pthread_cond_init(&t->hth_SigCond, &attr);
+		pthread_condattr_destroy(&attr);
+		if (err == 0)
+		#endif
 		{
+			#if !defined(HAL_POSIX_FUTEX_USE)
 			pthread_mutex_init(&t->hth_SigMutex, NULL);
+			#endif
 			t->hth_SigState = 0;
 			t->hth_Function = function;
 			t->hth_Data = data;
@@ -319,7 +415,9 @@ hal_initthread(TMOD_HAL *hal, THALO *thread,
 				if (pthread_setspecific(hps->hsp_TSDKey, (void *) t) == 0)
 					return TTRUE;
 			}
+			#if !defined(HAL_POSIX_FUTEX_USE)
 			pthread_cond_destroy(&t->hth_SigCond);
+			#endif
 		}
 		THALDestroyObject(hal, t, struct HALThread);
 	}
@@ -335,10 +433,12 @@ hal_destroythread(TMOD_HAL *hal, THALO *thread)
 	{
 		if (pthread_join(t->hth_PThread, NULL)) TDBPRINTF(20,("pthread_join\n"));
 	}
+	#if !defined(HAL_POSIX_FUTEX_USE)
 	if (pthread_mutex_destroy(&t->hth_SigMutex))
 		TDBPRINTF(20,("mutex_destroy\n"));
 	if (pthread_cond_destroy(&t->hth_SigCond))
 		TDBPRINTF(20,("cond_destroy\n"));
+	#endif
 	THALDestroyObject(hal, t, struct HALThread);
 }
 
@@ -355,6 +455,79 @@ hal_findself(TMOD_HAL *hal)
 **	Signals
 */
 
+#if defined(HAL_POSIX_FUTEX_USE)
+
+EXPORT void
+hal_signal(TMOD_HAL *hal, THALO *thread, TUINT signals)
+{
+	struct HALThread *t = THALGetObject(thread, struct HALThread);
+	if (signals & ~t->hth_SigState)
+	{
+		TUINT oldsig = __sync_fetch_and_or(&t->hth_SigState, signals);
+		if ((signals & ~oldsig) && t->hth_SigWaiting)
+			hal_futex(&t->hth_SigState, FUTEX_WAKE, 1, NULL);
+	}
+}
+
+EXPORT TUINT
+hal_setsignal(TMOD_HAL *hal, TUINT newsig, TUINT sigmask)
+{
+	TUINT oldsig;
+	struct HALSpecific *hps = hal->hmb_Specific;
+	struct HALThread *t = pthread_getspecific(hps->hsp_TSDKey);
+	/* only the calling thread can be waiting for its signals */
+	do oldsig = t->hth_SigState;
+	while (!__sync_bool_compare_and_swap(&t->hth_SigState, oldsig,
+		(oldsig & ~sigmask) | newsig));
+	return oldsig;
+}
+
+static TUINT
+hal_futexwait(struct HALThread *t, const struct timespec *abstime,
+	TUINT sigmask)
+{
+	TUINT sig, state;
+	for (;;)
+	{
+		sig = __sync_fetch_and_and(&t->hth_SigState, ~sigmask) & sigmask;
+		if (sig)
+			break;
+		t->hth_SigWaiting = 1;
+		__sync_synchronize();
+		state = t->hth_SigState;
+		if ((state & sigmask) == 0 && hal_futex(&t->hth_SigState,
+			abstime ? FUTEX_WAIT_BITSET : FUTEX_WAIT,
+			state, abstime) == -1 && errno == ETIMEDOUT)
+		{
+			t->hth_SigWaiting = 0;
+			sig = __sync_fetch_and_and(&t->hth_SigState, ~sigmask) & sigmask;
+			break;
+		}
+		t->hth_SigWaiting = 0;
+	}
+	return sig;
+}
+
+EXPORT TUINT
+hal_wait(TMOD_HAL *hal, TUINT sigmask)
+{
+	struct HALSpecific *hps = hal->hmb_Specific;
+	struct HALThread *t = pthread_getspecific(hps->hsp_TSDKey);
+	return hal_futexwait(t, NULL, sigmask);
+}
+
+static TUINT
+hal_timedwaitevent(TAPTR hal, struct HALThread *t, TTIME *wt,
+	TUINT sigmask)
+{
+	struct timespec tv;
+	tv.tv_sec = wt->ttm_Sec;
+	tv.tv_nsec = wt->ttm_USec * 1000;
+	return hal_futexwait(t, &tv, sigmask);
+}
+
+#else
+
 EXPORT void
 hal_signal(TMOD_HAL *hal, THALO *thread, TUINT signals)
 {
@@ -434,6 +607,8 @@ hal_timedwaitevent(TAPTR hal, struct HALThread *t, TTIME *wt,
 	return sig;
 }
 
+#endif
+
 /*****************************************************************************/
 /*
 **	Time and date
@@ -448,6 +623,21 @@ hal_getsystime(TMOD_HAL *hal, TTIME *time)
 	time->ttm_USec = tv.tv_usec;
 }
 
+/*
+**	hal_getmonotime(hal, time)
+**	Get time from a clock which is not subject to adjustments of the
+**	system time. Deadlines in the timer device are on this clock.
+*/
+
+EXPORT void
+hal_getmonotime(TMOD_HAL *hal, TTIME *time)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	time->ttm_Sec = ts.tv_sec;
+	time->ttm_USec = ts.tv_nsec / 1000;
+}
+
 /*****************************************************************************/
 /*
 **	err = hal_getsysdate(hal, datep, tzsecp)
@@ -765,7 +955,7 @@ hal_open(TMOD_HAL *hal, TAPTR task, TTAGITEM *tags)
 	struct TTimeRequest *req;
 	hps->hsp_ExecBase = exec;
 
-	req = TExecAllocMsg0(exec, sizeof(struct TTimeRequest));
+	req = TExecAllocMsg0(exec, sizeof(struct HALTimeRequest));
 	if (req)
 	{
 		pthread_mutex_lock(&hps->hsp_DevLock);
@@ -776,14 +966,37 @@ hal_open(TMOD_HAL *hal, TAPTR task, TTAGITEM *tags)
 			tasktags[0].tti_Tag = TTask_Name;			/* set task name */
 			tasktags[0].tti_Value = (TTAG) TTASKNAME_HALDEV;
 			tasktags[1].tti_Tag = TTAG_DONE;
-			TINITLIST(&hps->hsp_ReqList);
+			hps->hsp_NumTimers = 0;
 			hps->hsp_DevTask = TExecCreateSysTask(exec, hal_devfunc, tasktags);
 		}
 
-		if (hps->hsp_DevTask)
+		/* reserve a heap slot for every request, so that queueing
+		** in the device task cannot fail */
+		if (hps->hsp_DevTask && hps->hsp_RefCount >= hps->hsp_MaxTimers)
+		{
+			TUINT max = hps->hsp_MaxTimers ? hps->hsp_MaxTimers * 2 : 16;
+			struct HALTimeRequest **timers = hal_realloc(hal,
+				hps->hsp_Timers, sizeof(TAPTR) * hps->hsp_MaxTimers,
+				sizeof(TAPTR) * max);
+			if (timers)
+			{
+				hps->hsp_Timers = timers;
+				hps->hsp_MaxTimers = max;
+			}
+			else if (hps->hsp_RefCount == 0)
+			{
+				TExecSignal(exec, hps->hsp_DevTask, TTASK_SIG_ABORT);
+				TDESTROY(hps->hsp_DevTask);
+				hps->hsp_DevTask = TNULL;
+			}
+		}
+
+		if (hps->hsp_DevTask && hps->hsp_RefCount < hps->hsp_MaxTimers)
 		{
 			hps->hsp_RefCount++;
 			req->ttr_Req.io_Device = (struct TModule *) hal;
+			if (TGetTag(tags, TTimeRequest_Monotonic, TFALSE))
+				req->ttr_Req.io_Flags |= TTREQF_MONOTONIC;
 		}
 		else
 		{
@@ -813,11 +1026,91 @@ hal_close(TMOD_HAL *hal, TAPTR task)
 			TDBPRINTF(2,("destroy hal.device task...\n"));
 			TDESTROY(hps->hsp_DevTask);
 			hps->hsp_DevTask = TNULL;
+			hal_free(hal, hps->hsp_Timers,
+				sizeof(TAPTR) * hps->hsp_MaxTimers);
+			hps->hsp_Timers = TNULL;
+			hps->hsp_MaxTimers = 0;
 		}
 	}
 	pthread_mutex_unlock(&hps->hsp_DevLock);
 }
 
+/*****************************************************************************/
+/*
+**	Timer heap: pending requests are kept in a binary min-heap ordered by
+**	their absolute expiration time. Each request knows its position in
+**	the heap, so that aborting it is O(log n) as well.
+*/
+
+static void
+hal_settimer(struct HALSpecific *hps, TUINT i, struct HALTimeRequest *tr)
+{
+	hps->hsp_Timers[i] = tr;
+	tr->htr_Index = i;
+}
+
+static void
+hal_timerup(struct HALSpecific *hps, TUINT i)
+{
+	struct HALTimeRequest *tr = hps->hsp_Timers[i];
+	TTIME *tm = &tr->htr_Req.ttr_Data.ttr_Time;
+	while (i > 0)
+	{
+		TUINT parent = (i - 1) / 2;
+		struct HALTimeRequest *p = hps->hsp_Timers[parent];
+		if (hal_cmptime(&p->htr_Req.ttr_Data.ttr_Time, tm) <= 0)
+			break;
+		hal_settimer(hps, i, p);
+		i = parent;
+	}
+	hal_settimer(hps, i, tr);
+}
+
+static void
+hal_timerdown(struct HALSpecific *hps, TUINT i)
+{
+	struct HALTimeRequest *tr = hps->hsp_Timers[i];
+	TTIME *tm = &tr->htr_Req.ttr_Data.ttr_Time;
+	TUINT n = hps->hsp_NumTimers;
+	for (;;)
+	{
+		TUINT child = i * 2 + 1;
+		struct HALTimeRequest *c;
+		if (child >= n)
+			break;
+		c = hps->hsp_Timers[child];
+		if (child + 1 < n && hal_cmptime(&c->htr_Req.ttr_Data.ttr_Time,
+			&hps->hsp_Timers[child + 1]->htr_Req.ttr_Data.ttr_Time) > 0)
+			c = hps->hsp_Timers[++child];
+		if (hal_cmptime(tm, &c->htr_Req.ttr_Data.ttr_Time) <= 0)
+			break;
+		hal_settimer(hps, i, c);
+		i = child;
+	}
+	hal_settimer(hps, i, tr);
+}
+
+static void
+hal_addtimer(struct HALSpecific *hps, struct HALTimeRequest *tr)
+{
+	hal_settimer(hps, hps->hsp_NumTimers++, tr);
+	hal_timerup(hps, tr->htr_Index);
+}
+
+static void
+hal_remtimer(struct HALSpecific *hps, struct HALTimeRequest *tr)
+{
+	TUINT i = tr->htr_Index;
+	TUINT last = --hps->hsp_NumTimers;
+	if (i != last)
+	{
+		struct HALTimeRequest *moved = hps->hsp_Timers[last];
+		hal_settimer(hps, i, moved);
+		hal_timerup(hps, i);
+		hal_timerdown(hps, moved->htr_Index);
+	}
+}
+
 /*****************************************************************************/
 
 static void TTASKENTRY
@@ -828,10 +1121,9 @@ hal_devfunc(TAPTR task)
 	struct HALSpecific *hps = hal->hmb_Specific;
 	struct HALThread *thread = pthread_getspecific(hps->hsp_TSDKey);
 	TAPTR port = TExecGetUserPort(exec, task);
-	struct TTimeRequest *msg;
+	struct HALTimeRequest *msg;
 	TUINT sig = 0;
 	TTIME waittime, curtime;
-	struct TNode *nnode, *node;
 
  	waittime.ttm_Sec = 2000000000;
  	waittime.ttm_USec = 0;
@@ -845,29 +1137,27 @@ hal_devfunc(TAPTR task)
 			break;
 
 		pthread_mutex_lock(&hps->hsp_DevLock);
-		hal_getsystime(hal, &curtime);
+		hal_getmonotime(hal, &curtime);
 
 		while ((msg = TExecGetMsg(exec, port)))
 		{
-			hal_addtime(&msg->ttr_Data.ttr_Time, &curtime);
-			TAddTail(&hps->hsp_ReqList, (struct TNode *) msg);
+			hal_addtime(&msg->htr_Req.ttr_Data.ttr_Time, &curtime);
+			hal_addtimer(hps, msg);
 		}
 
+		/* reply expired requests; the next one determines the wait */
 		waittime.ttm_Sec = 2000000000;
 		waittime.ttm_USec = 0;
-		node = hps->hsp_ReqList.tlh_Head;
-		for (; (nnode = node->tln_Succ); node = nnode)
+		while (hps->hsp_NumTimers > 0)
 		{
-			struct TTimeRequest *tr = (struct TTimeRequest *) node;
-			TTIME *tm = &tr->ttr_Data.ttr_Time;
-			if (hal_cmptime(&curtime, tm) >= 0)
+			msg = hps->hsp_Timers[0];
+			if (hal_cmptime(&curtime, &msg->htr_Req.ttr_Data.ttr_Time) < 0)
 			{
-				TREMOVE(node);
-				TExecReplyMsg(exec, node);
-				continue;
+				waittime = msg->htr_Req.ttr_Data.ttr_Time;
+				break;
 			}
-			if (hal_cmptime(tm, &waittime) < 0)
-				waittime = *tm;
+			hal_remtimer(hps, msg);
+			TExecReplyMsg(exec, msg);
 		}
 
 		pthread_mutex_unlock(&hps->hsp_DevLock);
@@ -918,7 +1208,10 @@ hal_beginio(TMOD_HAL *hal, struct TTimeRequest *req)
 			break;
 
 		case TTREQ_GETTIME:
-			hal_getsystime(hal, &req->ttr_Data.ttr_Time);
+			if (req->ttr_Req.io_Flags & TTREQF_MONOTONIC)
+				hal_getmonotime(hal, &req->ttr_Data.ttr_Time);
+			else
+				hal_getsystime(hal, &req->ttr_Data.ttr_Time);
 			break;
 
 		case TTREQ_GETDSFROMDATE:
@@ -953,9 +1246,9 @@ hal_abortio(TMOD_HAL *hal, struct TTimeRequest *req)
 		}
 		else
 		{
-			/* remove from reqlist */
-			TREMOVE((struct TNode *) req);
-			TExecSignal(exec, hps->hsp_DevTask, TTASK_SIG_USER);
+			/* remove from timer heap; the device task may wake up
+			** early, but will find no expired request then */
+			hal_remtimer(hps, (struct HALTimeRequest *) req);
 		}
 	}
 	else
@@ -205,7 +205,7 @@ EXPORT struct TTimeRequest *
 time_allocreq(TMOD_TIME *tmod, TTAGITEM *tags)
 {
 	TAPTR exec = TGetExecBase(tmod);
-	return TExecOpenModule(exec, TMODNAME_TIMER, 0, TNULL);
+	return TExecOpenModule(exec, TMODNAME_TIMER, 0, tags);
 }
 
 /*****************************************************************************/
@@ -224,14 +224,18 @@ time_freereq(TMOD_TIME *tmod, struct TTimeRequest *req)
 /*****************************************************************************/
 /*
 **	time_query(time, treq, time)
-**	Insert system time into *time
+**	Insert system time into *time, or the time of the monotonic clock
+**	if the request was allocated with TTimeRequest_Monotonic
 */
 
 EXPORT void
 time_query(TMOD_TIME *tmod, struct TTimeRequest *tr, TTIME *timep)
 {
 #if 1
-	THALGetSysTime(tmod->hal, timep);
+	if (tr && (tr->ttr_Req.io_Flags & TTREQF_MONOTONIC))
+		THALGetMonoTime(tmod->hal, timep);
+	else
+		THALGetSysTime(tmod->hal, timep);
 #else
 	if (tr)
 	{
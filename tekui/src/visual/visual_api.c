@@ -651,3 +651,127 @@ EXPORT void vis_drawbuffer(TMOD_VIS *inst,
 	req->tvr_Op.DrawBuffer.Tags = tags;
 	visi_dosync(inst, req);
 }
+
+/*****************************************************************************/
+
+EXPORT TAPTR vis_allocpixmap(TMOD_VIS *inst, TINT w, TINT h)
+{
+	struct TVRequest *req = visi_getreq(inst, TVCMD_ALLOCPIXMAP,
+		inst->vis_Display, TNULL);
+	req->tvr_Op.AllocPixmap.Instance = inst->vis_Visual;
+	req->tvr_Op.AllocPixmap.Width = w;
+	req->tvr_Op.AllocPixmap.Height = h;
+	req->tvr_Op.AllocPixmap.Pixmap = TNULL;
+	visi_dosync(inst, req);
+	return req->tvr_Op.AllocPixmap.Pixmap;
+}
+
+/*****************************************************************************/
+
+EXPORT void vis_freepixmap(TMOD_VIS *inst, TAPTR pixmap)
+{
+	struct TVRequest *req = visi_getreq(inst, TVCMD_FREEPIXMAP,
+		inst->vis_Display, TNULL);
+	req->tvr_Op.FreePixmap.Instance = inst->vis_Visual;
+	req->tvr_Op.FreePixmap.Pixmap = pixmap;
+	visi_doasync(inst, req);
+}
+
+/*****************************************************************************/
+
+EXPORT void vis_settarget(TMOD_VIS *inst, TAPTR pixmap)
+{
+	struct TVRequest *req = visi_getreq(inst, TVCMD_SETTARGET,
+		inst->vis_Display, TNULL);
+	req->tvr_Op.SetTarget.Instance = inst->vis_Visual;
+	req->tvr_Op.SetTarget.Pixmap = pixmap;
+	visi_doasync(inst, req);
+}
+
+/*****************************************************************************/
+
+EXPORT void vis_drawpixmap(TMOD_VIS *inst, TAPTR pixmap, TINT x, TINT y,
+	TINT w, TINT h, TINT dx, TINT dy)
+{
+	struct TVRequest *req = visi_getreq(inst, TVCMD_DRAWPIXMAP,
+		inst->vis_Display, TNULL);
+	req->tvr_Op.DrawPixmap.Instance = inst->vis_Visual;
+	req->tvr_Op.DrawPixmap.Pixmap = pixmap;
+	req->tvr_Op.DrawPixmap.Rect[0] = x;
+	req->tvr_Op.DrawPixmap.Rect[1] = y;
+	req->tvr_Op.DrawPixmap.Rect[2] = w;
+	req->tvr_Op.DrawPixmap.Rect[3] = h;
+	req->tvr_Op.DrawPixmap.DestX = dx;
+	req->tvr_Op.DrawPixmap.DestY = dy;
+	visi_doasync(inst, req);
+}
+
+/*****************************************************************************/
+
+EXPORT void vis_getexposures(TMOD_VIS *inst, struct THook *hook)
+{
+	struct TVRequest *req = visi_getreq(inst, TVCMD_GETEXPOSURES,
+		inst->vis_Display, TNULL);
+	req->tvr_Op.GetExposures.Instance = inst->vis_Visual;
+	req->tvr_Op.GetExposures.Hook = hook;
+	visi_dosync(inst, req);
+}
+
+/*****************************************************************************/
+
+EXPORT void vis_drawninepatch(TMOD_VIS *inst, TAPTR pixmap, TINT *border,
+	TINT *rect)
+{
+	struct TVRequest *req = visi_getreq(inst, TVCMD_DRAWNINEPATCH,
+		inst->vis_Display, TNULL);
+	req->tvr_Op.DrawNinePatch.Instance = inst->vis_Visual;
+	req->tvr_Op.DrawNinePatch.Pixmap = pixmap;
+	req->tvr_Op.DrawNinePatch.Border[0] = border[0];
+	req->tvr_Op.DrawNinePatch.Border[1] = border[1];
+	req->tvr_Op.DrawNinePatch.Border[2] = border[2];
+	req->tvr_Op.DrawNinePatch.Border[3] = border[3];
+	req->tvr_Op.DrawNinePatch.Rect[0] = rect[0];
+	req->tvr_Op.DrawNinePatch.Rect[1] = rect[1];
+	req->tvr_Op.DrawNinePatch.Rect[2] = rect[2];
+	req->tvr_Op.DrawNinePatch.Rect[3] = rect[3];
+	visi_doasync(inst, req);
+}
+
+/*****************************************************************************/
+/*
+**	Look up an image rendered with the given pens in the display's cache,
+**	and draw it into the rectangle (x, y, w, h) if found. Returns 1 if the
+**	image was drawn, 0 if rendering is redirected into a new cache entry,
+**	in which case the image must be drawn relative to the rectangle's
+**	origin and completed with vis_endimage(), or -1 if the image cannot be
+**	cached and must be drawn directly.
+*/
+
+EXPORT TINT vis_beginimage(TMOD_VIS *inst, TAPTR key, TINT keylen,
+	TVPEN *pens, TINT numpens, TINT *rect)
+{
+	struct TVRequest *req = visi_getreq(inst, TVCMD_BEGINIMAGE,
+		inst->vis_Display, TNULL);
+	req->tvr_Op.BeginImage.Instance = inst->vis_Visual;
+	req->tvr_Op.BeginImage.Key = key;
+	req->tvr_Op.BeginImage.KeyLen = keylen;
+	req->tvr_Op.BeginImage.Pens = pens;
+	req->tvr_Op.BeginImage.NumPens = numpens;
+	req->tvr_Op.BeginImage.Rect[0] = rect[0];
+	req->tvr_Op.BeginImage.Rect[1] = rect[1];
+	req->tvr_Op.BeginImage.Rect[2] = rect[2];
+	req->tvr_Op.BeginImage.Rect[3] = rect[3];
+	req->tvr_Op.BeginImage.Result = -1;
+	visi_dosync(inst, req);
+	return req->tvr_Op.BeginImage.Result;
+}
+
+/*****************************************************************************/
+
+EXPORT void vis_endimage(TMOD_VIS *inst)
+{
+	struct TVRequest *req = visi_getreq(inst, TVCMD_ENDIMAGE,
+		inst->vis_Display, TNULL);
+	req->tvr_Op.EndImage.Instance = inst->vis_Visual;
+	visi_doasync(inst, req);
+}
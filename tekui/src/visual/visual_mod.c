@@ -65,11 +65,23 @@ vis_vectors[VISUAL_NUMVECTORS] =
 
 	(TMFPTR) vis_drawbuffer,
 
+	(TMFPTR) vis_allocpixmap,
+	(TMFPTR) vis_freepixmap,
+	(TMFPTR) vis_settarget,
+	(TMFPTR) vis_drawpixmap,
+
+	(TMFPTR) vis_getexposures,
+	(TMFPTR) vis_drawninepatch,
+
+	(TMFPTR) vis_beginimage,
+	(TMFPTR) vis_endimage,
+
 };
 
 static void
 vis_destroy(TMOD_VIS *mod)
 {
+	TDestroy(mod->vis_MemMgr);
 	TDestroy(mod->vis_Lock);
 }
 
@@ -95,6 +107,7 @@ tek_init_visual(TAPTR task, struct TModule *vis, TUINT16 version,
 	TTAGITEM *tags)
 {
 	TMOD_VIS *mod = (TMOD_VIS *) vis;
+	TTAGITEM mmutags[2];
 	if (mod == TNULL)
 	{
 		if (version == 0xffff)
@@ -112,6 +125,14 @@ tek_init_visual(TAPTR task, struct TModule *vis, TUINT16 version,
 		mod->vis_Lock = TExecCreateLock(mod->vis_ExecBase, TNULL);
 		if (mod->vis_Lock == TNULL) break;
 
+		/* hash nodes and keys are served from slabs; if unavailable,
+		** fall back to the default allocator: */
+		mmutags[0].tti_Tag = TMem_Name;
+		mmutags[0].tti_Value = (TTAG) "visual";
+		mmutags[1].tti_Tag = TTAG_DONE;
+		mod->vis_MemMgr = TExecCreateMMU(mod->vis_ExecBase, TNULL,
+			TMMUT_Slab | TMMUT_TaskSafe, mmutags);
+
 		mod->vis_Module.tmd_Version = VISUAL_VERSION;
 		mod->vis_Module.tmd_Revision = VISUAL_REVISION;
 		mod->vis_Module.tmd_Handle.thn_Hook.thk_Entry = vis_dispatch;
@@ -156,12 +177,17 @@ vis_modopen(TMOD_VIS *mod, TTAGITEM *tags)
 				base->vis_Module.tmd_NegSize);
 			if (inst)
 			{
+				TTAGITEM porttags[2];
+				/* both ports are only ever read by the instance's owner */
+				porttags[0].tti_Tag = TPort_LockFree;
+				porttags[0].tti_Value = TTRUE;
+				porttags[1].tti_Tag = TTAG_DONE;
 				TInitList(&inst->vis_ReqPool);
 				TInitList(&inst->vis_WaitList);
 				inst->vis_IMsgPort =
-					TExecCreatePort(inst->vis_ExecBase, TNULL);
+					TExecCreatePort(inst->vis_ExecBase, porttags);
 				inst->vis_CmdRPort =
-					TExecCreatePort(inst->vis_ExecBase, TNULL);
+					TExecCreatePort(inst->vis_ExecBase, porttags);
 				if (inst->vis_IMsgPort == TNULL || inst->vis_CmdRPort == TNULL)
 				{
 					TDestroy(inst->vis_CmdRPort);
@@ -22,7 +22,7 @@
 
 #define VISUAL_VERSION		4
 #define VISUAL_REVISION		0
-#define VISUAL_NUMVECTORS	43
+#define VISUAL_NUMVECTORS	51
 
 #ifndef LOCAL
 #define LOCAL
@@ -146,4 +146,17 @@ EXPORT void vis_drawfarc(TMOD_VIS *mod, TINT x, TINT y, TINT w, TINT h,
 EXPORT void vis_drawbuffer(TMOD_VIS *inst,
 	TINT x, TINT y, TAPTR buf, TINT w, TINT h, TINT totw, TTAGITEM *tags);
 
+EXPORT TAPTR vis_allocpixmap(TMOD_VIS *mod, TINT w, TINT h);
+EXPORT void vis_freepixmap(TMOD_VIS *mod, TAPTR pixmap);
+EXPORT void vis_settarget(TMOD_VIS *mod, TAPTR pixmap);
+EXPORT void vis_drawpixmap(TMOD_VIS *mod, TAPTR pixmap, TINT x, TINT y,
+	TINT w, TINT h, TINT dx, TINT dy);
+
+EXPORT void vis_getexposures(TMOD_VIS *mod, struct THook *hook);
+EXPORT void vis_drawninepatch(TMOD_VIS *mod, TAPTR pixmap, TINT *border,
+	TINT *rect);
+EXPORT TINT vis_beginimage(TMOD_VIS *mod, TAPTR key, TINT keylen,
+	TVPEN *pens, TINT numpens, TINT *rect);
+EXPORT void vis_endimage(TMOD_VIS *mod);
+
 #endif
@@ -12,13 +12,31 @@
 --	OVERVIEW::
 --		This class implements a list container.
 --
+--		The line accessors (List:getCell(), List:isSelected(),
+--		List:getLineRange(), etc.) operate on items in the format used by
+--		the [[#tek.ui.class.listgadget : ListGadget]]. The same interface
+--		is implemented by the native list models in {{tek.lib.listmodel}},
+--		which store large lists compactly outside of Lua tables.
+--
 --	IMPLEMENTS::
 --		- List:addItem() - Adds an item to the list
+--		- List:addItems() - Adds multiple items to the list
 --		- List:changeItem() - Replaces an item in the list
 --		- List:checkPosition() - Verify position in the list
---		- List:getN() - Returns the number of items in the list
+--		- List:clearCellWidths() - Forgets cached column widths
+--		- List:getCell() - Returns the text in a column of an item
+--		- List:getCellWidth() - Returns the cached width of a column
 --		- List:getItem() - Returns the item at the specified position
+--		- List:getLineRange() - Returns the vertical extent of a line
+--		- List:getN() - Returns the number of items in the list
+--		- List:getNumColumns() - Returns the number of columns of an item
+--		- List:isSelected() - Returns the selection state of an item
 --		- List:remItem() - Removes an item from the list
+--		- List:remItems() - Removes multiple items from the list
+--		- List:searchLine() - Finds a line by its vertical position
+--		- List:setCellWidth() - Caches the width of a column
+--		- List:setLineRange() - Sets the vertical extent of a line
+--		- List:setSelected() - Sets the selection state of an item
 --
 --	OVERRIDES::
 --		- Class.new()
@@ -26,13 +44,14 @@
 -------------------------------------------------------------------------------
 
 local Class = require "tek.class"
+local floor = math.floor
 local insert = table.insert
 local max = math.max
 local min = math.min
 local remove = table.remove
 
 module("tek.class.list", tek.class)
-_VERSION = "List 1.3"
+_VERSION = "List 1.5"
 local List = _M
 
 -------------------------------------------------------------------------------
@@ -90,6 +109,48 @@ function List:remItem(lnr)
 	end
 end
 
+-------------------------------------------------------------------------------
+--	pos = List:addItems(entries[, pos]): Adds an array of items to the list,
+--	optionally inserting them at the specified position, in a single
+--	operation. Returns the position of the first item added.
+-------------------------------------------------------------------------------
+
+function List:addItems(entries, lnr)
+	local items = self.Items
+	local numl = #items
+	local n = #entries
+	lnr = lnr and min(max(1, lnr), numl + 1) or numl + 1
+	for i = numl, lnr, -1 do
+		items[i + n] = items[i]
+	end
+	for i = 1, n do
+		items[lnr + i - 1] = entries[i]
+	end
+	return lnr
+end
+
+-------------------------------------------------------------------------------
+--	num = List:remItems(pos, count): Removes up to {{count}} items from the
+--	list, starting at the specified position, in a single operation.
+--	Returns the number of items removed.
+-------------------------------------------------------------------------------
+
+function List:remItems(lnr, num)
+	local items = self.Items
+	local numl = #items
+	if lnr < 1 or lnr > numl or num <= 0 then
+		return 0
+	end
+	num = min(num, numl - lnr + 1)
+	for i = lnr, numl - num do
+		items[i] = items[i + num]
+	end
+	for i = numl, numl - num + 1, -1 do
+		items[i] = nil
+	end
+	return num
+end
+
 -------------------------------------------------------------------------------
 --	success = List:changeItem(entry, pos): Changes the item at the specified
 --	position in the list. Returns a boolean indicating whether there was an
@@ -126,3 +187,105 @@ function List:checkPosition(lnr, null_valid)
 	end
 	return true, lnr
 end
+
+-------------------------------------------------------------------------------
+--	text = List:getCell(pos, column): Returns the text in the specified
+--	column of the item at the given position.
+-------------------------------------------------------------------------------
+
+function List:getCell(lnr, col)
+	return self.Items[lnr][1][col]
+end
+
+-------------------------------------------------------------------------------
+--	n = List:getNumColumns(pos): Returns the number of columns of the item
+--	at the specified position.
+-------------------------------------------------------------------------------
+
+function List:getNumColumns(lnr)
+	return #self.Items[lnr][1]
+end
+
+-------------------------------------------------------------------------------
+--	selected = List:isSelected(pos): Returns a boolean indicating whether
+--	the item at the specified position is selected.
+-------------------------------------------------------------------------------
+
+function List:isSelected(lnr)
+	return self.Items[lnr][3] or false
+end
+
+-------------------------------------------------------------------------------
+--	List:setSelected(pos, selected): Sets the selection state of the item
+--	at the specified position.
+-------------------------------------------------------------------------------
+
+function List:setSelected(lnr, selected)
+	self.Items[lnr][3] = selected
+end
+
+-------------------------------------------------------------------------------
+--	y0, y1 = List:getLineRange(pos): Returns the vertical extent of the
+--	line at the specified position.
+-------------------------------------------------------------------------------
+
+function List:getLineRange(lnr)
+	local l = self.Items[lnr]
+	return l[4], l[5]
+end
+
+-------------------------------------------------------------------------------
+--	List:setLineRange(pos, y0, y1): Sets the vertical extent of the line at
+--	the specified position.
+-------------------------------------------------------------------------------
+
+function List:setLineRange(lnr, y0, y1)
+	local l = self.Items[lnr]
+	l[4], l[5] = y0, y1
+end
+
+-------------------------------------------------------------------------------
+--	width = List:getCellWidth(pos, column): Returns the cached width of
+--	the specified column of an item, or '''nil''' if it is unknown. This
+--	class does not cache widths, so the result is always '''nil'''.
+-------------------------------------------------------------------------------
+
+function List:getCellWidth(lnr, col)
+end
+
+-------------------------------------------------------------------------------
+--	List:setCellWidth(pos, column, width): Caches the width of the
+--	specified column of an item. In this class, this function does nothing.
+-------------------------------------------------------------------------------
+
+function List:setCellWidth(lnr, col, width)
+end
+
+-------------------------------------------------------------------------------
+--	List:clearCellWidths(): Forgets all cached column widths. In this
+--	class, this function does nothing.
+-------------------------------------------------------------------------------
+
+function List:clearCellWidths()
+end
+
+-------------------------------------------------------------------------------
+--	pos = List:searchLine(y): Returns the position of the first line whose
+--	lower edge is at or below the given y coordinate; as lines are laid out
+--	in ascending order, this is done by binary search. If no such line
+--	exists, the number of lines plus one is returned.
+-------------------------------------------------------------------------------
+
+function List:searchLine(y)
+	local items = self.Items
+	local l0, l1 = 1, #items + 1
+	while l0 < l1 do
+		local lnr = floor((l0 + l1) / 2)
+		if items[lnr][5] < y then
+			l0 = lnr + 1
+		else
+			l1 = lnr
+		end
+	end
+	return l0
+end
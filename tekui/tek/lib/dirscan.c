@@ -0,0 +1,498 @@
+/*
+**	tek.lib.dirscan - Reading directories in a worker task
+**	Written by Timm S. Mueller <tmueller at schulze-mueller.de>
+**	See copyright notice in COPYRIGHT
+**
+**	A scanner reads the entries of a directory and determines their
+**	types and sizes in a task of its own, so that large or slow
+**	directories (e.g. on network filesystems) do not block the caller.
+**	The entries are passed back in batches, through a message port which
+**	is owned by the caller and can be polled without waiting. The first
+**	batches are kept small, so that a lister can start displaying
+**	entries as early as possible.
+*/
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <tek/debug.h>
+#include <tek/teklib.h>
+#include <tek/proto/exec.h>
+
+#define TEK_LIB_DIRSCAN_NAME "tek.lib.dirscan*"
+
+/* Size of a batch message, in bytes: */
+#define DS_MSGSIZE		16384
+
+/* Number of entries in the first batch, and default maximum: */
+#define DS_MINBATCH		32
+#define DS_MAXBATCH		512
+
+/* Entry flags: */
+#define DSF_DIRECTORY	0x0001
+
+/* Message types: */
+#define DSMSG_BATCH		0
+#define DSMSG_DONE		1
+
+/*****************************************************************************/
+
+struct DirScanMsg;
+
+struct DirScan
+{
+	TAPTR ds_ExecBase;
+	/* Worker task, TNULL when finished and joined: */
+	TAPTR ds_Task;
+	/* Port for receiving batches, owned by the caller: */
+	TAPTR ds_Port;
+	/* Final message, allocated in advance so that it cannot fail: */
+	struct DirScanMsg *ds_DoneMsg;
+	DIR *ds_Dir;
+	TINT ds_BatchSize;
+	/* Errno of the worker, valid when done: */
+	TINT ds_Error;
+	/* All messages received: */
+	TBOOL ds_Done;
+};
+
+struct DirScanMsg
+{
+	TINT dsm_Type;
+	TINT dsm_Error;
+	TINT dsm_NumEntries;
+	TUINT dsm_Used;
+	/* followed by dsm_NumEntries entries */
+};
+
+struct DirScanEntry
+{
+	double dse_Size;
+	TUINT dse_Flags;
+	TUINT dse_Length;
+	/* followed by the name, zero-terminated, padded to 8 bytes */
+};
+
+#define DS_ENTRYSIZE(len) \
+	((sizeof(struct DirScanEntry) + (len) + 1 + 7) & ~7)
+
+/*****************************************************************************/
+/*
+**	Worker task
+*/
+
+static struct DirScanMsg *allocbatch(TAPTR exec, TINT type, TUINT size)
+{
+	struct DirScanMsg *msg = TExecAllocMsg(exec, size);
+	if (msg)
+	{
+		msg->dsm_Type = type;
+		msg->dsm_Error = 0;
+		msg->dsm_NumEntries = 0;
+		msg->dsm_Used = sizeof(struct DirScanMsg);
+	}
+	return msg;
+}
+
+/*
+**	The abort is checked before each call into the filesystem, so that
+**	closing a scanner waits for no more than the call in progress.
+*/
+
+static TBOOL aborted(TAPTR exec)
+{
+	return (TExecSetSignal(exec, 0, TTASK_SIG_ABORT) & TTASK_SIG_ABORT) != 0;
+}
+
+static TTASKENTRY void dirscan_task(TAPTR task)
+{
+	TAPTR exec = TGetExecBase(task);
+	struct DirScan *ds = TExecGetTaskData(exec, task);
+	struct DirScanMsg *msg = TNULL;
+	TINT batchsize = TMIN(DS_MINBATCH, ds->ds_BatchSize);
+	TINT error = 0;
+	int fd = dirfd(ds->ds_Dir);
+	struct dirent *de;
+
+	for (;;)
+	{
+		struct DirScanEntry *e;
+		struct stat st;
+		size_t len;
+
+		if (aborted(exec))
+		{
+			error = ECANCELED;
+			break;
+		}
+
+		errno = 0;
+		de = readdir(ds->ds_Dir);
+		if (de == TNULL)
+		{
+			error = errno;
+			break;
+		}
+
+		if (de->d_name[0] == '.' && (de->d_name[1] == 0 ||
+			(de->d_name[1] == '.' && de->d_name[2] == 0)))
+			continue;
+
+		if (aborted(exec))
+		{
+			error = ECANCELED;
+			break;
+		}
+
+		len = strlen(de->d_name);
+		if (msg && msg->dsm_Used + DS_ENTRYSIZE(len) > DS_MSGSIZE)
+		{
+			TExecPutMsg(exec, ds->ds_Port, TNULL, msg);
+			msg = TNULL;
+			batchsize = TMIN(batchsize * 2, ds->ds_BatchSize);
+		}
+		if (msg == TNULL)
+		{
+			msg = allocbatch(exec, DSMSG_BATCH, DS_MSGSIZE);
+			if (msg == TNULL)
+			{
+				error = ENOMEM;
+				break;
+			}
+		}
+
+		e = (struct DirScanEntry *) ((TUINT8 *) msg + msg->dsm_Used);
+		e->dse_Flags = 0;
+		e->dse_Size = 0;
+		e->dse_Length = len;
+		memcpy(e + 1, de->d_name, len + 1);
+		/* like lfs.attributes(), follow symbolic links: */
+		if (fstatat(fd, de->d_name, &st, 0) == 0)
+		{
+			if (S_ISDIR(st.st_mode))
+				e->dse_Flags |= DSF_DIRECTORY;
+			e->dse_Size = st.st_size;
+		}
+		msg->dsm_Used += DS_ENTRYSIZE(len);
+
+		if (++msg->dsm_NumEntries == batchsize)
+		{
+			TExecPutMsg(exec, ds->ds_Port, TNULL, msg);
+			msg = TNULL;
+			batchsize = TMIN(batchsize * 2, ds->ds_BatchSize);
+		}
+	}
+
+	if (msg)
+		TExecPutMsg(exec, ds->ds_Port, TNULL, msg);
+
+	closedir(ds->ds_Dir);
+	ds->ds_Dir = TNULL;
+
+	msg = ds->ds_DoneMsg;
+	ds->ds_DoneMsg = TNULL;
+	msg->dsm_Error = error;
+	TExecPutMsg(exec, ds->ds_Port, TNULL, msg);
+}
+
+/*****************************************************************************/
+
+static struct DirScan *checkscan(lua_State *L, int narg)
+{
+	return luaL_checkudata(L, narg, TEK_LIB_DIRSCAN_NAME);
+}
+
+/*
+**	Stop and join the worker, and release all pending batches.
+*/
+
+static void endscan(struct DirScan *ds)
+{
+	TAPTR exec = ds->ds_ExecBase;
+	if (ds->ds_Task)
+	{
+		TExecSignal(exec, ds->ds_Task, TTASK_SIG_ABORT);
+		TDestroy(ds->ds_Task);
+		ds->ds_Task = TNULL;
+	}
+	if (ds->ds_Port)
+	{
+		TAPTR msg;
+		while ((msg = TExecGetMsg(exec, ds->ds_Port)))
+			TExecAckMsg(exec, msg);
+		TDestroy(ds->ds_Port);
+		ds->ds_Port = TNULL;
+	}
+	if (ds->ds_DoneMsg)
+	{
+		/* worker was never started: */
+		TExecFree(exec, ds->ds_DoneMsg);
+		ds->ds_DoneMsg = TNULL;
+	}
+	if (ds->ds_Dir)
+	{
+		/* worker was never started: */
+		closedir(ds->ds_Dir);
+		ds->ds_Dir = TNULL;
+	}
+}
+
+/*****************************************************************************/
+/*
+**	scanner = dirscan.open(path[, dirtext[, batchsize]]): Starts reading
+**	the specified directory in a worker task. dirtext is placed in the
+**	size column of directory entries, and defaults to "[Directory]".
+**	batchsize is the maximum number of entries per batch. Returns nil and
+**	an error message if the directory cannot be opened.
+*/
+
+static int lib_open(lua_State *L)
+{
+	const char *path = luaL_checkstring(L, 1);
+	TINT batchsize = luaL_optinteger(L, 3, DS_MAXBATCH);
+	struct DirScan *ds;
+	TTAGITEM tags[2];
+	TAPTR exec;
+
+	luaL_optstring(L, 2, TNULL);
+	luaL_argcheck(L, batchsize > 0, 3, "invalid batch size");
+
+	ds = lua_newuserdata(L, sizeof(struct DirScan));
+	/* s: udata */
+	memset(ds, 0, sizeof(struct DirScan));
+	ds->ds_BatchSize = batchsize;
+
+	lua_getfield(L, LUA_REGISTRYINDEX, TEK_LIB_DIRSCAN_NAME);
+	/* s: udata, metatable */
+	lua_rawgeti(L, -1, 1);
+	/* s: udata, metatable, execbase */
+	exec = ds->ds_ExecBase = *(TAPTR *) lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	/* s: udata, metatable */
+	lua_setmetatable(L, -2);
+	/* s: udata */
+
+	/* the directory text is kept in the environment of the scanner: */
+	lua_newtable(L);
+	/* s: udata, envtab */
+	if (lua_isstring(L, 2))
+		lua_pushvalue(L, 2);
+	else
+		lua_pushliteral(L, "[Directory]");
+	/* s: udata, envtab, dirtext */
+	lua_rawseti(L, -2, 1);
+	/* s: udata, envtab */
+	lua_setfenv(L, -2);
+	/* s: udata */
+
+	ds->ds_Dir = opendir(path);
+	if (ds->ds_Dir == TNULL)
+	{
+		lua_pushnil(L);
+		lua_pushfstring(L, "%s: %s", path, strerror(errno));
+		return 2;
+	}
+
+	ds->ds_Port = TExecCreatePort(exec, TNULL);
+	ds->ds_DoneMsg = allocbatch(exec, DSMSG_DONE,
+		sizeof(struct DirScanMsg));
+	if (ds->ds_Port == TNULL || ds->ds_DoneMsg == TNULL)
+	{
+		endscan(ds);
+		luaL_error(L, "out of memory");
+	}
+
+	tags[0].tti_Tag = TTask_UserData;
+	tags[0].tti_Value = (TTAG) ds;
+	tags[1].tti_Tag = TTAG_DONE;
+	ds->ds_Task = TExecCreateTask(exec, (TTASKFUNC) dirscan_task, TNULL,
+		tags);
+	if (ds->ds_Task == TNULL)
+	{
+		endscan(ds);
+		luaL_error(L, "failed to create task");
+	}
+
+	return 1;
+}
+
+/*****************************************************************************/
+/*
+**	items[, errmsg] = scanner:read([max]): Returns an array of the
+**	entries that have been received since the last call, without
+**	waiting. The array may be empty if no entries are pending. Reading
+**	stops after the batch in which at least max entries are collected.
+**	The entries are in the format of ListGadget items,
+**		{ { name, size or dirtext }, isdirectory }
+**	When the scan is finished and all entries have been read, returns
+**	nil, and an error message if reading the directory failed.
+*/
+
+static int pushdone(lua_State *L, struct DirScan *ds)
+{
+	lua_pushnil(L);
+	if (ds->ds_Error && ds->ds_Error != ECANCELED)
+	{
+		lua_pushstring(L, strerror(ds->ds_Error));
+		return 2;
+	}
+	return 1;
+}
+
+static int ds_read(lua_State *L)
+{
+	struct DirScan *ds = checkscan(L, 1);
+	TINT max = luaL_optinteger(L, 2, 0x7fffffff);
+	TAPTR exec = ds->ds_ExecBase;
+	TINT n = 0;
+
+	if (ds->ds_Port == TNULL || ds->ds_Done)
+		return pushdone(L, ds);
+
+	lua_getfenv(L, 1);
+	lua_rawgeti(L, -1, 1);
+	lua_remove(L, -2);
+	/* s: dirtext */
+	lua_newtable(L);
+	/* s: dirtext, items */
+
+	while (n < max)
+	{
+		struct DirScanMsg *msg = TExecGetMsg(exec, ds->ds_Port);
+		struct DirScanEntry *e;
+		TINT i;
+
+		if (msg == TNULL)
+			break;
+
+		if (msg->dsm_Type == DSMSG_DONE)
+		{
+			ds->ds_Error = msg->dsm_Error;
+			ds->ds_Done = TTRUE;
+			TExecAckMsg(exec, msg);
+			/* collect the worker: */
+			TDestroy(ds->ds_Task);
+			ds->ds_Task = TNULL;
+			break;
+		}
+
+		e = (struct DirScanEntry *) (msg + 1);
+		for (i = 0; i < msg->dsm_NumEntries; ++i)
+		{
+			lua_createtable(L, 2, 0);
+			/* s: dirtext, items, item */
+			lua_createtable(L, 2, 0);
+			/* s: dirtext, items, item, cols */
+			lua_pushlstring(L, (const char *) (e + 1), e->dse_Length);
+			lua_rawseti(L, -2, 1);
+			if (e->dse_Flags & DSF_DIRECTORY)
+				lua_pushvalue(L, -4);
+			else
+				lua_pushnumber(L, e->dse_Size);
+			lua_rawseti(L, -2, 2);
+			lua_rawseti(L, -2, 1);
+			/* s: dirtext, items, item */
+			lua_pushboolean(L, e->dse_Flags & DSF_DIRECTORY);
+			lua_rawseti(L, -2, 2);
+			lua_rawseti(L, -2, ++n);
+			/* s: dirtext, items */
+			e = (struct DirScanEntry *)
+				((TUINT8 *) e + DS_ENTRYSIZE(e->dse_Length));
+		}
+		TExecAckMsg(exec, msg);
+	}
+
+	if (n == 0 && ds->ds_Done)
+		return pushdone(L, ds);
+
+	return 1;
+}
+
+/*
+**	done = scanner:isDone(): Returns true if the scan is finished and all
+**	entries have been read.
+*/
+
+static int ds_isdone(lua_State *L)
+{
+	struct DirScan *ds = checkscan(L, 1);
+	lua_pushboolean(L, ds->ds_Port == TNULL || ds->ds_Done);
+	return 1;
+}
+
+/*
+**	scanner:close(): Aborts the scan, waits for the worker task to
+**	finish, and discards all entries not yet read. The worker stops
+**	after the filesystem call it is currently blocked in, if any.
+*/
+
+static int ds_close(lua_State *L)
+{
+	struct DirScan *ds = checkscan(L, 1);
+	if (ds->ds_ExecBase)
+	{
+		endscan(ds);
+		ds->ds_Done = TTRUE;
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+
+static const luaL_Reg libfuncs[] =
+{
+	{ "open", lib_open },
+	{ NULL, NULL }
+};
+
+static const luaL_Reg scanmethods[] =
+{
+	{ "__gc", ds_close },
+	{ "read", ds_read },
+	{ "isDone", ds_isdone },
+	{ "close", ds_close },
+	{ NULL, NULL }
+};
+
+int luaopen_tek_lib_dirscan(lua_State *L)
+{
+	luaL_register(L, "tek.lib.dirscan", libfuncs);
+	/* s: libtab */
+
+	/* require "tek.lib.exec": */
+	lua_getglobal(L, "require");
+	/* s: libtab, "require" */
+	lua_pushliteral(L, "tek.lib.exec");
+	/* s: libtab, "require", "tek.lib.exec" */
+	lua_call(L, 1, 1);
+	/* s: libtab, exectab */
+	lua_getfield(L, -1, "base");
+	/* s: libtab, exectab, execbase */
+	lua_remove(L, -2);
+	/* s: libtab, execbase */
+
+	luaL_newmetatable(L, TEK_LIB_DIRSCAN_NAME);
+	/* s: libtab, execbase, metatable */
+	luaL_register(L, NULL, scanmethods);
+	/* s: libtab, execbase, metatable */
+	lua_pushvalue(L, -1);
+	/* s: libtab, execbase, metatable, metatable */
+	lua_pushvalue(L, -3);
+	/* s: libtab, execbase, metatable, metatable, execbase */
+	luaL_ref(L, -2); /* index returned is always 1 */
+	/* s: libtab, execbase, metatable, metatable */
+	lua_setfield(L, -2, "__index");
+	/* s: libtab, execbase, metatable */
+	lua_pop(L, 2);
+	/* s: libtab */
+
+	return 1;
+}
@@ -9,6 +9,9 @@
 #include <lauxlib.h>
 #include <lualib.h>
 
+#include <string.h>
+#include <unistd.h>
+
 #include <tek/debug.h>
 #include <tek/teklib.h>
 #include <tek/proto/hal.h>
@@ -28,6 +31,558 @@ static const luaL_Reg libfuncs[] =
 	{NULL, NULL}
 };
 
+/*****************************************************************************/
+/*
+**	stats = exec.getmmustats([name]): Returns a table of statistics for the
+**	memory manager registered under the given name, or for the heap of the
+**	calling task if no name is specified. The fields {{bytes}}, {{peak}},
+**	{{allocs}}, {{frees}} and {{sizes}} are present only if the memory
+**	manager counts its allocations. Returns '''nil''' if no memory manager
+**	of that name exists.
+*/
+
+static int
+tek_lib_exec_getmmustats(lua_State *L)
+{
+	TAPTR exec = *(TAPTR *) lua_touserdata(L, lua_upvalueindex(1));
+	const char *name = luaL_optstring(L, 1, NULL);
+	struct TMMUStats stats;
+	TINT counted;
+
+	/* a named MMU may be destroyed at any time, look up and read at once: */
+	if (name)
+		counted = TExecGetNamedMMUStats(exec, (TSTRPTR) name, &stats);
+	else
+		counted = TExecGetMMUStats(exec, TExecGetTaskMMU(exec, TNULL),
+			&stats);
+	if (counted < 0)
+		return 0;
+
+	lua_newtable(L);
+	if (counted)
+	{
+		int i;
+		lua_pushinteger(L, stats.tms_Bytes);
+		lua_setfield(L, -2, "bytes");
+		lua_pushinteger(L, stats.tms_PeakBytes);
+		lua_setfield(L, -2, "peak");
+		lua_pushinteger(L, stats.tms_NumAllocs);
+		lua_setfield(L, -2, "allocs");
+		lua_pushinteger(L, stats.tms_NumFrees);
+		lua_setfield(L, -2, "frees");
+		lua_createtable(L, TMMUSTATS_NUMSIZES, 0);
+		for (i = 0; i < TMMUSTATS_NUMSIZES; ++i)
+		{
+			lua_pushinteger(L, stats.tms_Sizes[i]);
+			lua_rawseti(L, -2, i + 1);
+		}
+		lua_setfield(L, -2, "sizes");
+	}
+	lua_pushinteger(L, stats.tms_LockWaits);
+	lua_setfield(L, -2, "lockwaits");
+	lua_pushinteger(L, stats.tms_CacheHits);
+	lua_setfield(L, -2, "cachehits");
+	lua_pushinteger(L, stats.tms_CacheMisses);
+	lua_setfield(L, -2, "cachemisses");
+	return 1;
+}
+
+/*****************************************************************************/
+/*
+**	Worker pools. A job runs a Lua function in a Lua state of its own,
+**	which is created in the worker task and provided with the standard
+**	libraries. Arguments and results are copied between the states, and
+**	can be nil, booleans, numbers, and strings.
+*/
+
+#define TEK_LIB_EXEC_POOL_CLASSNAME "tek.lib.exec.pool*"
+#define TEK_LIB_EXEC_JOB_CLASSNAME "tek.lib.exec.job*"
+
+/* Number of instructions between checks for cancellation: */
+#define JOB_HOOKCOUNT	1000
+
+struct JobValue
+{
+	int jv_Type;
+	lua_Number jv_Number;
+	const char *jv_String;
+	size_t jv_Length;
+};
+
+struct JobValues
+{
+	int jvs_Count;
+	struct JobValue *jvs_Values;
+};
+
+struct LuaPool
+{
+	TAPTR lp_ExecBase;
+	/* Worker pool, TNULL when closed: */
+	TAPTR lp_Pool;
+	/* Task and signal to be notified of completed jobs: */
+	TAPTR lp_Task;
+	TUINT lp_Signal;
+};
+
+struct LuaJob
+{
+	struct TJob lj_Job;
+	/* Function (bytecode or source), followed by the arguments: */
+	struct JobValues *lj_Args;
+	/* Results, error message if lj_Failed, or TNULL if out of memory: */
+	struct JobValues *lj_Results;
+	TBOOL lj_Failed;
+};
+
+struct LuaJobRef
+{
+	struct LuaPool *ljr_Pool;
+	struct LuaJob *ljr_Job;
+};
+
+static int checkvalues(lua_State *L, int first, int n)
+{
+	int i;
+	for (i = first; i < first + n; ++i)
+	{
+		switch (lua_type(L, i))
+		{
+			case LUA_TNIL:
+			case LUA_TBOOLEAN:
+			case LUA_TNUMBER:
+			case LUA_TSTRING:
+				break;
+			default:
+				return i;
+		}
+	}
+	return 0;
+}
+
+static struct JobValues *packvalues(lua_State *L, TAPTR exec, int first,
+	int n)
+{
+	size_t size = sizeof(struct JobValues) + sizeof(struct JobValue) * n;
+	struct JobValues *jvs;
+	char *p;
+	int i;
+
+	for (i = first; i < first + n; ++i)
+		if (lua_type(L, i) == LUA_TSTRING)
+			size += lua_objlen(L, i) + 1;
+
+	jvs = TExecAlloc(exec, TNULL, size);
+	if (jvs)
+	{
+		jvs->jvs_Count = n;
+		jvs->jvs_Values = (struct JobValue *) (jvs + 1);
+		p = (char *) (jvs->jvs_Values + n);
+		for (i = 0; i < n; ++i)
+		{
+			struct JobValue *jv = &jvs->jvs_Values[i];
+			jv->jv_Type = lua_type(L, first + i);
+			switch (jv->jv_Type)
+			{
+				case LUA_TBOOLEAN:
+					jv->jv_Number = lua_toboolean(L, first + i);
+					break;
+				case LUA_TNUMBER:
+					jv->jv_Number = lua_tonumber(L, first + i);
+					break;
+				case LUA_TSTRING:
+				{
+					const char *s = lua_tolstring(L, first + i, &jv->jv_Length);
+					memcpy(p, s, jv->jv_Length + 1);
+					jv->jv_String = p;
+					p += jv->jv_Length + 1;
+					break;
+				}
+			}
+		}
+	}
+	return jvs;
+}
+
+static void pushvalues(lua_State *L, struct JobValues *jvs, int first)
+{
+	int i;
+	for (i = first; i < jvs->jvs_Count; ++i)
+	{
+		struct JobValue *jv = &jvs->jvs_Values[i];
+		switch (jv->jv_Type)
+		{
+			case LUA_TBOOLEAN:
+				lua_pushboolean(L, jv->jv_Number != 0);
+				break;
+			case LUA_TNUMBER:
+				lua_pushnumber(L, jv->jv_Number);
+				break;
+			case LUA_TSTRING:
+				lua_pushlstring(L, jv->jv_String, jv->jv_Length);
+				break;
+			default:
+				lua_pushnil(L);
+				break;
+		}
+	}
+}
+
+static void job_hook(lua_State *L, lua_Debug *ar)
+{
+	struct LuaJob *lj;
+	lua_pushlightuserdata(L, (void *) job_hook);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	lj = lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	if (lj->lj_Job.tjb_Cancel)
+	{
+		lua_pushliteral(L, "cancelled");
+		lua_error(L);
+	}
+}
+
+static TTASKENTRY void job_run(TAPTR task, struct TJob *job)
+{
+	struct LuaJob *lj = (struct LuaJob *) job;
+	struct JobValues *args = lj->lj_Args;
+	lua_State *L = luaL_newstate();
+	if (L == TNULL)
+		return;
+
+	luaL_openlibs(L);
+	lua_pushlightuserdata(L, (void *) job_hook);
+	lua_pushlightuserdata(L, lj);
+	lua_rawset(L, LUA_REGISTRYINDEX);
+	lua_sethook(L, job_hook, LUA_MASKCOUNT, JOB_HOOKCOUNT);
+
+	if (luaL_loadbuffer(L, args->jvs_Values[0].jv_String,
+		args->jvs_Values[0].jv_Length, "=job") == 0 &&
+		lua_checkstack(L, args->jvs_Count))
+	{
+		pushvalues(L, args, 1);
+		if (lua_pcall(L, args->jvs_Count - 1, LUA_MULTRET, 0) == 0)
+		{
+			if (checkvalues(L, 1, lua_gettop(L)))
+			{
+				lua_pushliteral(L, "unsupported result type");
+				lj->lj_Failed = TTRUE;
+			}
+		}
+		else
+			lj->lj_Failed = TTRUE;
+	}
+	else
+		lj->lj_Failed = TTRUE;
+
+	if (lj->lj_Failed)
+	{
+		if (!lua_isstring(L, -1))
+			lua_pushliteral(L, "error object is not a string");
+		lj->lj_Results = packvalues(L, TGetExecBase(task), lua_gettop(L), 1);
+	}
+	else
+		lj->lj_Results = packvalues(L, TGetExecBase(task), 1, lua_gettop(L));
+
+	lua_close(L);
+}
+
+static int dumpwriter(lua_State *L, const void *p, size_t size, void *ud)
+{
+	luaL_addlstring((luaL_Buffer *) ud, (const char *) p, size);
+	return 0;
+}
+
+static struct LuaPool *checkpool(lua_State *L, int n)
+{
+	struct LuaPool *lp = luaL_checkudata(L, n, TEK_LIB_EXEC_POOL_CLASSNAME);
+	if (lp->lp_Pool == TNULL)
+		luaL_error(L, "pool closed");
+	return lp;
+}
+
+/*
+**	pool = exec.createpool([numworkers]): Creates a pool of worker tasks,
+**	by default one per processor.
+*/
+
+static int
+tek_lib_exec_createpool(lua_State *L)
+{
+	TAPTR exec = *(TAPTR *) lua_touserdata(L, lua_upvalueindex(1));
+	TINT n = luaL_optinteger(L, 1, 0);
+	struct LuaPool *lp;
+	TTAGITEM tags[2];
+
+	luaL_argcheck(L, n >= 0, 1, "invalid number of workers");
+	#if defined(_SC_NPROCESSORS_ONLN)
+	if (n == 0)
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+	#endif
+	tags[0].tti_Tag = n > 0 ? TWorkerPool_NumWorkers : TTAG_IGNORE;
+	tags[0].tti_Value = (TTAG) n;
+	tags[1].tti_Tag = TTAG_DONE;
+
+	lp = lua_newuserdata(L, sizeof(struct LuaPool));
+	/* s: udata */
+	memset(lp, 0, sizeof(struct LuaPool));
+	luaL_getmetatable(L, TEK_LIB_EXEC_POOL_CLASSNAME);
+	/* s: udata, metatable */
+	lua_setmetatable(L, -2);
+	/* s: udata */
+
+	lp->lp_ExecBase = exec;
+	lp->lp_Task = TExecFindTask(exec, TNULL);
+	lp->lp_Signal = TExecAllocSignal(exec, 0);
+	if (lp->lp_Signal == 0)
+		luaL_error(L, "out of signals");
+	lp->lp_Pool = TExecCreateWorkerPool(exec, tags);
+	if (lp->lp_Pool == TNULL)
+		luaL_error(L, "failed to create worker pool");
+
+	return 1;
+}
+
+/*
+**	job = pool:run(func, ...): Runs a function in one of the pool's
+**	workers. func can be a Lua function without upvalues, or a string
+**	containing a chunk of Lua source code. Returns a job object.
+*/
+
+static int
+tek_lib_exec_pool_run(lua_State *L)
+{
+	struct LuaPool *lp = checkpool(L, 1);
+	TAPTR exec = lp->lp_ExecBase;
+	int nargs = lua_gettop(L) - 2;
+	struct LuaJobRef *ref;
+	struct LuaJob *lj;
+	int bad;
+
+	if (lua_isfunction(L, 2))
+	{
+		luaL_Buffer b;
+		lua_pushvalue(L, 2);
+		luaL_buffinit(L, &b);
+		if (lua_dump(L, dumpwriter, &b) != 0)
+			luaL_argerror(L, 2, "unable to dump function");
+		luaL_pushresult(&b);
+		lua_replace(L, 2);
+		lua_pop(L, 1);
+	}
+	else
+		luaL_checkstring(L, 2);
+
+	bad = checkvalues(L, 3, nargs);
+	if (bad)
+		luaL_argerror(L, bad, "unsupported type");
+
+	ref = lua_newuserdata(L, sizeof(struct LuaJobRef));
+	/* s: udata */
+	ref->ljr_Pool = lp;
+	ref->ljr_Job = TNULL;
+	luaL_getmetatable(L, TEK_LIB_EXEC_JOB_CLASSNAME);
+	/* s: udata, metatable */
+	lua_setmetatable(L, -2);
+	/* s: udata */
+	lua_createtable(L, 1, 0);
+	/* s: udata, envtab */
+	lua_pushvalue(L, 1);
+	/* s: udata, envtab, pool */
+	lua_rawseti(L, -2, 1);
+	/* s: udata, envtab */
+	lua_setfenv(L, -2);
+	/* s: udata */
+
+	lj = TExecAlloc0(exec, TNULL, sizeof(struct LuaJob));
+	if (lj)
+	{
+		lj->lj_Args = packvalues(L, exec, 2, nargs + 1);
+		if (lj->lj_Args == TNULL)
+		{
+			TExecFree(exec, lj);
+			lj = TNULL;
+		}
+	}
+	if (lj == TNULL)
+		luaL_error(L, "out of memory");
+
+	lj->lj_Job.tjb_Func = job_run;
+	lj->lj_Job.tjb_SigTask = lp->lp_Task;
+	lj->lj_Job.tjb_Signals = lp->lp_Signal;
+	if (!TExecSubmitJob(exec, lp->lp_Pool, &lj->lj_Job))
+	{
+		TExecFree(exec, lj->lj_Args);
+		TExecFree(exec, lj);
+		luaL_error(L, "failed to submit job");
+	}
+	ref->ljr_Job = lj;
+
+	return 1;
+}
+
+/*
+**	pool:close(): Cancels the jobs that have not been started yet, waits
+**	for running jobs to finish, and closes the pool's worker tasks.
+*/
+
+static int
+tek_lib_exec_pool_close(lua_State *L)
+{
+	struct LuaPool *lp = luaL_checkudata(L, 1, TEK_LIB_EXEC_POOL_CLASSNAME);
+	if (lp->lp_Pool)
+	{
+		TDestroy(lp->lp_Pool);
+		lp->lp_Pool = TNULL;
+	}
+	if (lp->lp_Signal)
+	{
+		TExecFreeSignal(lp->lp_ExecBase, lp->lp_Signal);
+		lp->lp_Signal = 0;
+	}
+	return 0;
+}
+
+static struct LuaJob *checkjob(lua_State *L, int n)
+{
+	struct LuaJobRef *ref = luaL_checkudata(L, n, TEK_LIB_EXEC_JOB_CLASSNAME);
+	if (ref->ljr_Job == TNULL)
+		luaL_argerror(L, n, "invalid job");
+	return ref->ljr_Job;
+}
+
+static TBOOL isdone(struct LuaJob *lj)
+{
+	TUINT status = lj->lj_Job.tjb_Status;
+	return status == TJOB_DONE || status == TJOB_CANCELLED;
+}
+
+static void waitjob(struct LuaPool *lp, struct LuaJob *lj)
+{
+	/* other jobs' completions are noted in their status */
+	while (!isdone(lj))
+		TExecWait(lp->lp_ExecBase, lp->lp_Signal);
+}
+
+/*
+**	success, ... = job:wait(): Waits for the job to finish. Returns true
+**	followed by the function's results, or false and an error message if
+**	the function failed or the job was cancelled.
+*/
+
+static int
+tek_lib_exec_job_wait(lua_State *L)
+{
+	struct LuaJobRef *ref = luaL_checkudata(L, 1, TEK_LIB_EXEC_JOB_CLASSNAME);
+	struct LuaJob *lj = checkjob(L, 1);
+	struct JobValues *results;
+
+	waitjob(ref->ljr_Pool, lj);
+	results = lj->lj_Results;
+
+	if (lj->lj_Job.tjb_Status == TJOB_CANCELLED)
+	{
+		lua_pushboolean(L, 0);
+		lua_pushliteral(L, "cancelled");
+		return 2;
+	}
+	if (results == TNULL)
+	{
+		lua_pushboolean(L, 0);
+		lua_pushliteral(L, "out of memory");
+		return 2;
+	}
+	luaL_checkstack(L, results->jvs_Count + 1, "too many results");
+	lua_pushboolean(L, !lj->lj_Failed);
+	pushvalues(L, results, 0);
+	return results->jvs_Count + 1;
+}
+
+/*
+**	done = job:isDone(): Returns true if the job has finished or was
+**	cancelled, without waiting.
+*/
+
+static int
+tek_lib_exec_job_isdone(lua_State *L)
+{
+	lua_pushboolean(L, isdone(checkjob(L, 1)));
+	return 1;
+}
+
+/*
+**	cancelled = job:cancel(): Cancels the job. Returns true if the job
+**	had not been started yet. A running job is interrupted with the
+**	error "cancelled" at the next opportunity.
+*/
+
+static int
+tek_lib_exec_job_cancel(lua_State *L)
+{
+	struct LuaJobRef *ref = luaL_checkudata(L, 1, TEK_LIB_EXEC_JOB_CLASSNAME);
+	struct LuaJob *lj = checkjob(L, 1);
+	TBOOL cancelled = TFALSE;
+	if (!isdone(lj))
+		cancelled = TExecCancelJob(ref->ljr_Pool->lp_ExecBase,
+			ref->ljr_Pool->lp_Pool, &lj->lj_Job);
+	lua_pushboolean(L, cancelled);
+	return 1;
+}
+
+static int
+tek_lib_exec_job_gc(lua_State *L)
+{
+	struct LuaJobRef *ref = luaL_checkudata(L, 1, TEK_LIB_EXEC_JOB_CLASSNAME);
+	struct LuaJob *lj = ref->ljr_Job;
+	if (lj)
+	{
+		struct LuaPool *lp = ref->ljr_Pool;
+		TAPTR exec = lp->lp_ExecBase;
+		if (!isdone(lj))
+		{
+			TExecCancelJob(exec, lp->lp_Pool, &lj->lj_Job);
+			waitjob(lp, lj);
+		}
+		TExecFree(exec, lj->lj_Results);
+		TExecFree(exec, lj->lj_Args);
+		TExecFree(exec, lj);
+		ref->ljr_Job = TNULL;
+	}
+	return 0;
+}
+
+static const luaL_Reg poolmethods[] =
+{
+	{ "__gc", tek_lib_exec_pool_close },
+	{ "run", tek_lib_exec_pool_run },
+	{ "close", tek_lib_exec_pool_close },
+	{ NULL, NULL }
+};
+
+static const luaL_Reg jobmethods[] =
+{
+	{ "__gc", tek_lib_exec_job_gc },
+	{ "wait", tek_lib_exec_job_wait },
+	{ "isDone", tek_lib_exec_job_isdone },
+	{ "cancel", tek_lib_exec_job_cancel },
+	{ NULL, NULL }
+};
+
+static void registerclass(lua_State *L, const char *name,
+	const luaL_Reg *methods)
+{
+	luaL_newmetatable(L, name);
+	/* s: metatable */
+	luaL_register(L, NULL, methods);
+	lua_pushvalue(L, -1);
+	/* s: metatable, metatable */
+	lua_setfield(L, -2, "__index");
+	/* s: metatable */
+	lua_pop(L, 1);
+}
+
+/*****************************************************************************/
+
 static int
 tek_lib_exec_base_gc(lua_State *L)
 {
@@ -65,10 +620,25 @@ int luaopen_tek_lib_exec(lua_State *L)
 	/* s: libtab, udata, metatable */
 	lua_setmetatable(L, -2);
 	/* s: libtab, udata */
+	lua_pushvalue(L, -1);
+	/* s: libtab, udata, udata */
+	lua_pushcclosure(L, tek_lib_exec_getmmustats, 1);
+	/* s: libtab, udata, getmmustats */
+	lua_setfield(L, -3, "getmmustats");
+	/* s: libtab, udata */
+	lua_pushvalue(L, -1);
+	/* s: libtab, udata, udata */
+	lua_pushcclosure(L, tek_lib_exec_createpool, 1);
+	/* s: libtab, udata, createpool */
+	lua_setfield(L, -3, "createpool");
+	/* s: libtab, udata */
 	lua_setfield(L, -2, "base");
 	/* s: libtab */
 	lua_pop(L, 1);
 
+	registerclass(L, TEK_LIB_EXEC_POOL_CLASSNAME, poolmethods);
+	registerclass(L, TEK_LIB_EXEC_JOB_CLASSNAME, jobmethods);
+
 	tags[0].tti_Tag = TExecBase_ModInit;
 	tags[0].tti_Value = (TTAG) initmodules;
 	tags[1].tti_Tag = TTAG_DONE;
@@ -0,0 +1,1310 @@
+
+/*
+**	tek.lib.listmodel - Compact storage for list and table contents
+**	Written by Timm S. Mueller <tmueller at schulze-mueller.de>
+**	See copyright notice in COPYRIGHT
+**
+**	A list model holds the lines of a ListGadget outside of Lua tables:
+**	Each line is a fixed-size record (vertical extent, flags, offset of
+**	its text, cached column widths), and the texts of all columns are
+**	packed into a single string arena. This keeps the overhead per line
+**	at a few bytes and the model invisible to the garbage collector.
+**
+**	The model implements the interface of tek.class.list; items
+**	returned by getItem() and remItem() are copies in the format
+**
+**		{ { "column1", "column2", ... }, nil, selected, y0, y1 }
+**
+**	Column strings are stored zero-terminated, getCell() reports empty
+**	columns as nil, and the userdata field of an item is retained only
+**	as a boolean flag.
+**
+**	Lines can be sorted by multiple keys, and a filter can be applied,
+**	which restricts all line numbers and accessors to a view index over
+**	the matching lines. Lines added or removed while a filter is active
+**	are added to or removed from both the view and the underlying lines.
+**	As cached widths stay attached to their lines, a ListGadget needs to
+**	measure only lines which have not been visible before.
+*/
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tek/debug.h>
+#include <tek/teklib.h>
+#include <tek/proto/exec.h>
+
+#define TEK_LIB_LISTMODEL_NAME "tek.lib.listmodel*"
+
+/* Initial number of lines and arena size: */
+#define LM_MINROWS	64
+#define LM_MINARENA	1024
+
+/* Maximum number of columns: */
+#define LM_MAXCOLUMNS	256
+
+/* Maximum number of sort keys: */
+#define LM_MAXKEYS	8
+
+/* Line flags: */
+#define LMF_SELECTED	0x0001
+#define LMF_USER		0x0002
+
+/*****************************************************************************/
+
+struct ListModel
+{
+	TAPTR lm_ExecBase;
+	/* Line records, lm_RowSize bytes each: */
+	TUINT8 *lm_Rows;
+	TINT lm_NumRows;
+	TINT lm_MaxRows;
+	TUINT lm_RowSize;
+	TINT lm_NumColumns;
+	/* String arena: */
+	TSTRPTR lm_Arena;
+	TUINT lm_ArenaUsed;
+	TUINT lm_ArenaSize;
+	/* Number of unreferenced bytes in the arena: */
+	TUINT lm_ArenaWaste;
+	/* View index of a filter (indices of lines, ascending), or TNULL: */
+	TINT *lm_View;
+	TINT lm_NumView;
+	TINT lm_MaxView;
+};
+
+struct ListRow
+{
+	TINT lr_Y0, lr_Y1;
+	TUINT lr_Flags;
+	TUINT lr_TextOffs;
+	/* followed by lm_NumColumns cached widths */
+}; /* 16 bytes */
+
+#define LM_ROW(lm, i) \
+	((struct ListRow *) ((lm)->lm_Rows + (TUINT) (i) * (lm)->lm_RowSize))
+#define LM_WIDTHS(row) ((TINT *) ((row) + 1))
+
+/* Number of lines and line records, as seen through the view: */
+#define LM_NUMLINES(lm) ((lm)->lm_View ? (lm)->lm_NumView : (lm)->lm_NumRows)
+#define LM_LINE(lm, i) \
+	LM_ROW(lm, (lm)->lm_View ? (lm)->lm_View[i] : (i))
+
+/*****************************************************************************/
+
+static struct ListModel *checkmodel(lua_State *L, int narg)
+{
+	struct ListModel *lm = luaL_checkudata(L, narg, TEK_LIB_LISTMODEL_NAME);
+	if (lm->lm_ExecBase == TNULL)
+		luaL_argerror(L, narg, "closed list model");
+	return lm;
+}
+
+static struct ListRow *checkrow(lua_State *L, struct ListModel *lm, int narg)
+{
+	TINT lnr = luaL_checkinteger(L, narg);
+	if (lnr < 1 || lnr > LM_NUMLINES(lm))
+		luaL_argerror(L, narg, "line out of range");
+	return LM_LINE(lm, lnr - 1);
+}
+
+static TINT checkcolumn(lua_State *L, struct ListModel *lm, int narg)
+{
+	TINT col = luaL_checkinteger(L, narg);
+	if (col < 1 || col > lm->lm_NumColumns)
+		luaL_argerror(L, narg, "column out of range");
+	return col - 1;
+}
+
+static TAPTR growbuf(TAPTR exec, TAPTR buf, TUINT size)
+{
+	return buf ? TExecRealloc(exec, buf, size) : TExecAlloc(exec, TNULL, size);
+}
+
+/*****************************************************************************/
+/*
+**	Line and arena storage
+*/
+
+static void reserverows(lua_State *L, struct ListModel *lm, TINT num)
+{
+	TINT need = lm->lm_NumRows + num;
+	if (need > lm->lm_MaxRows)
+	{
+		TINT max = TMAX(lm->lm_MaxRows, LM_MINROWS);
+		TUINT8 *rows;
+		while (max < need)
+			max <<= 1;
+		rows = growbuf(lm->lm_ExecBase, lm->lm_Rows, max * lm->lm_RowSize);
+		if (rows == TNULL)
+			luaL_error(L, "out of memory");
+		lm->lm_Rows = rows;
+		lm->lm_MaxRows = max;
+	}
+}
+
+static void reservearena(lua_State *L, struct ListModel *lm, TUINT num)
+{
+	TUINT need = lm->lm_ArenaUsed + num;
+	if (need > lm->lm_ArenaSize)
+	{
+		TUINT max = TMAX(lm->lm_ArenaSize, LM_MINARENA);
+		TSTRPTR arena;
+		while (max < need)
+			max <<= 1;
+		arena = growbuf(lm->lm_ExecBase, lm->lm_Arena, max);
+		if (arena == TNULL)
+			luaL_error(L, "out of memory");
+		lm->lm_Arena = arena;
+		lm->lm_ArenaSize = max;
+	}
+}
+
+static void reserveview(lua_State *L, struct ListModel *lm, TINT num)
+{
+	TINT need = lm->lm_NumView + num;
+	if (need > lm->lm_MaxView)
+	{
+		TINT max = TMAX(lm->lm_MaxView, LM_MINROWS);
+		TINT *view;
+		while (max < need)
+			max <<= 1;
+		view = growbuf(lm->lm_ExecBase, lm->lm_View, max * sizeof(TINT));
+		if (view == TNULL)
+			luaL_error(L, "out of memory");
+		lm->lm_View = view;
+		lm->lm_MaxView = max;
+	}
+}
+
+static void freeview(struct ListModel *lm)
+{
+	TExecFree(lm->lm_ExecBase, lm->lm_View);
+	lm->lm_View = TNULL;
+	lm->lm_NumView = 0;
+	lm->lm_MaxView = 0;
+}
+
+static TUINT textsize(struct ListModel *lm, struct ListRow *row)
+{
+	TSTRPTR s = lm->lm_Arena + row->lr_TextOffs;
+	TSTRPTR p = s;
+	TINT i;
+	for (i = 0; i < lm->lm_NumColumns; ++i)
+		p += strlen(p) + 1;
+	return p - s;
+}
+
+static TSTRPTR getcell(struct ListModel *lm, struct ListRow *row, TINT col)
+{
+	TSTRPTR p = lm->lm_Arena + row->lr_TextOffs;
+	while (col--)
+		p += strlen(p) + 1;
+	return p;
+}
+
+/*
+**	Compact the arena by copying the texts of all lines, in line order,
+**	to a fresh buffer. Done when more than half of the arena is unused.
+*/
+
+static void compactarena(struct ListModel *lm)
+{
+	TUINT size = lm->lm_ArenaUsed - lm->lm_ArenaWaste;
+	TSTRPTR arena = TExecAlloc(lm->lm_ExecBase, TNULL,
+		TMAX(size, LM_MINARENA));
+	if (arena)
+	{
+		TUINT offs = 0;
+		TINT i;
+		for (i = 0; i < lm->lm_NumRows; ++i)
+		{
+			struct ListRow *row = LM_ROW(lm, i);
+			TUINT len = textsize(lm, row);
+			memcpy(arena + offs, lm->lm_Arena + row->lr_TextOffs, len);
+			row->lr_TextOffs = offs;
+			offs += len;
+		}
+		TExecFree(lm->lm_ExecBase, lm->lm_Arena);
+		lm->lm_Arena = arena;
+		lm->lm_ArenaSize = TMAX(size, LM_MINARENA);
+		lm->lm_ArenaUsed = offs;
+		lm->lm_ArenaWaste = 0;
+	}
+}
+
+static void checkwaste(struct ListModel *lm)
+{
+	if (lm->lm_ArenaWaste > LM_MINARENA &&
+		lm->lm_ArenaWaste > lm->lm_ArenaUsed / 2)
+		compactarena(lm);
+}
+
+/*****************************************************************************/
+/*
+**	Conversion of items from and to Lua
+*/
+
+static TUINT entrysize(lua_State *L, struct ListModel *lm, int idx)
+{
+	TUINT size = lm->lm_NumColumns;
+	TINT i, n;
+	luaL_checktype(L, idx, LUA_TTABLE);
+	lua_rawgeti(L, idx, 1);
+	if (lua_type(L, -1) != LUA_TTABLE)
+		luaL_error(L, "list item must contain a table of columns");
+	n = lua_objlen(L, -1);
+	if (n > lm->lm_NumColumns)
+		luaL_error(L, "too many columns in list item");
+	for (i = 1; i <= n; ++i)
+	{
+		size_t len = 0;
+		lua_rawgeti(L, -1, i);
+		if (lua_type(L, -1) == LUA_TSTRING || lua_type(L, -1) == LUA_TNUMBER)
+			lua_tolstring(L, -1, &len);
+		size += len;
+		lua_pop(L, 1);
+	}
+	lua_pop(L, 1);
+	return size;
+}
+
+/*
+**	Write an item's columns to the arena; the space must have been
+**	reserved in advance. Returns the offset of the text.
+*/
+
+static TUINT storeentry(lua_State *L, struct ListModel *lm, int idx)
+{
+	TUINT offs = lm->lm_ArenaUsed;
+	TSTRPTR p = lm->lm_Arena + offs;
+	TINT i, n;
+	lua_rawgeti(L, idx, 1);
+	n = lua_objlen(L, -1);
+	for (i = 1; i <= lm->lm_NumColumns; ++i)
+	{
+		size_t len = 0;
+		if (i <= n)
+		{
+			lua_rawgeti(L, -1, i);
+			if (lua_type(L, -1) == LUA_TSTRING ||
+				lua_type(L, -1) == LUA_TNUMBER)
+			{
+				const char *s = lua_tolstring(L, -1, &len);
+				/* embedded zeros terminate the column: */
+				len = strlen(s);
+				memcpy(p, s, len);
+			}
+			lua_pop(L, 1);
+		}
+		p[len] = 0;
+		p += len + 1;
+	}
+	lua_pop(L, 1);
+	lm->lm_ArenaUsed = p - lm->lm_Arena;
+	return offs;
+}
+
+static void initrow(lua_State *L, struct ListModel *lm, struct ListRow *row,
+	int idx)
+{
+	TINT *widths = LM_WIDTHS(row);
+	TINT i;
+	row->lr_TextOffs = storeentry(L, lm, idx);
+	row->lr_Y0 = row->lr_Y1 = 0;
+	lua_rawgeti(L, idx, 2);
+	row->lr_Flags = lua_toboolean(L, -1) ? LMF_USER : 0;
+	lua_rawgeti(L, idx, 3);
+	row->lr_Flags |= lua_toboolean(L, -1) ? LMF_SELECTED : 0;
+	lua_pop(L, 2);
+	for (i = 0; i < lm->lm_NumColumns; ++i)
+		widths[i] = -1;
+}
+
+static void pushitem(lua_State *L, struct ListModel *lm, struct ListRow *row)
+{
+	TSTRPTR p = lm->lm_Arena + row->lr_TextOffs;
+	TINT i, n = 0;
+	lua_createtable(L, 5, 0);
+	/* s: item */
+	lua_createtable(L, lm->lm_NumColumns, 0);
+	/* s: item, columns */
+	for (i = 0; i < lm->lm_NumColumns; ++i)
+	{
+		size_t len = strlen(p);
+		if (len)
+		{
+			/* fill gaps with empty strings, keeping the array contiguous: */
+			while (n < i)
+			{
+				lua_pushliteral(L, "");
+				lua_rawseti(L, -2, ++n);
+			}
+			lua_pushlstring(L, p, len);
+			lua_rawseti(L, -2, ++n);
+		}
+		p += len + 1;
+	}
+	lua_rawseti(L, -2, 1);
+	/* s: item */
+	lua_pushboolean(L, row->lr_Flags & LMF_USER);
+	lua_rawseti(L, -2, 2);
+	lua_pushboolean(L, row->lr_Flags & LMF_SELECTED);
+	lua_rawseti(L, -2, 3);
+	lua_pushinteger(L, row->lr_Y0);
+	lua_rawseti(L, -2, 4);
+	lua_pushinteger(L, row->lr_Y1);
+	lua_rawseti(L, -2, 5);
+}
+
+/*
+**	Insert the items in the array at index idx (or the single item at
+**	idx, if single is true) before the line with the 0-based index vpos.
+*/
+
+static void insertitems(lua_State *L, struct ListModel *lm, int idx,
+	TINT vpos, TINT num, TBOOL single)
+{
+	TINT *view = lm->lm_View;
+	TUINT size = 0;
+	TINT i, pos = vpos;
+
+	if (num <= 0)
+		return;
+
+	/* reserve all memory in advance, so that insertion cannot fail: */
+	if (single)
+		size = entrysize(L, lm, idx);
+	else
+	{
+		for (i = 1; i <= num; ++i)
+		{
+			lua_rawgeti(L, idx, i);
+			size += entrysize(L, lm, lua_gettop(L));
+			lua_pop(L, 1);
+		}
+	}
+	reserverows(L, lm, num);
+	reservearena(L, lm, size);
+
+	if (view)
+	{
+		/* insert before the line at vpos, or after the last line in view: */
+		reserveview(L, lm, num);
+		view = lm->lm_View;
+		if (vpos < lm->lm_NumView)
+			pos = view[vpos];
+		else if (lm->lm_NumView > 0)
+			pos = view[lm->lm_NumView - 1] + 1;
+		else
+			pos = lm->lm_NumRows;
+	}
+
+	if (pos < lm->lm_NumRows)
+		memmove(LM_ROW(lm, pos + num), LM_ROW(lm, pos),
+			(lm->lm_NumRows - pos) * lm->lm_RowSize);
+	lm->lm_NumRows += num;
+
+	if (single)
+		initrow(L, lm, LM_ROW(lm, pos), idx);
+	else
+	{
+		for (i = 0; i < num; ++i)
+		{
+			lua_rawgeti(L, idx, i + 1);
+			initrow(L, lm, LM_ROW(lm, pos + i), lua_gettop(L));
+			lua_pop(L, 1);
+		}
+	}
+
+	if (view)
+	{
+		for (i = vpos; i < lm->lm_NumView; ++i)
+			view[i] += num;
+		memmove(view + vpos + num, view + vpos,
+			(lm->lm_NumView - vpos) * sizeof(TINT));
+		for (i = 0; i < num; ++i)
+			view[vpos + i] = pos + i;
+		lm->lm_NumView += num;
+	}
+}
+
+/*
+**	Remove num lines starting at the 0-based index vpos.
+*/
+
+static void removeitems(struct ListModel *lm, TINT vpos, TINT num)
+{
+	TINT *view = lm->lm_View;
+	TINT i;
+	if (view)
+	{
+		/* the lines to remove are in ascending order, and all lines
+		** following them in the view are located behind them: */
+		TINT r, w = view[vpos], d = vpos, e = vpos + num;
+		for (r = w; r < lm->lm_NumRows; ++r)
+		{
+			if (d < e && view[d] == r)
+			{
+				lm->lm_ArenaWaste += textsize(lm, LM_ROW(lm, r));
+				d++;
+				continue;
+			}
+			if (w != r)
+				memcpy(LM_ROW(lm, w), LM_ROW(lm, r), lm->lm_RowSize);
+			w++;
+		}
+		lm->lm_NumRows = w;
+		memmove(view + vpos, view + e, (lm->lm_NumView - e) * sizeof(TINT));
+		lm->lm_NumView -= num;
+		for (i = vpos; i < lm->lm_NumView; ++i)
+			view[i] -= num;
+	}
+	else
+	{
+		for (i = 0; i < num; ++i)
+			lm->lm_ArenaWaste += textsize(lm, LM_ROW(lm, vpos + i));
+		memmove(LM_ROW(lm, vpos), LM_ROW(lm, vpos + num),
+			(lm->lm_NumRows - vpos - num) * lm->lm_RowSize);
+		lm->lm_NumRows -= num;
+	}
+	if (lm->lm_NumRows == 0)
+	{
+		lm->lm_ArenaUsed = 0;
+		lm->lm_ArenaWaste = 0;
+	}
+	else
+		checkwaste(lm);
+}
+
+/*****************************************************************************/
+/*
+**	model = listmodel.new([numcolumns]): Creates a new, empty list model
+**	with the specified number of columns (default: 1).
+*/
+
+static int lib_new(lua_State *L)
+{
+	TINT nc = luaL_optinteger(L, 1, 1);
+	struct ListModel *lm;
+
+	luaL_argcheck(L, nc >= 1 && nc <= LM_MAXCOLUMNS, 1,
+		"invalid number of columns");
+
+	lm = lua_newuserdata(L, sizeof(struct ListModel));
+	/* s: udata */
+	memset(lm, 0, sizeof(struct ListModel));
+	lm->lm_NumColumns = nc;
+	lm->lm_RowSize = sizeof(struct ListRow) + nc * sizeof(TINT);
+
+	lua_getfield(L, LUA_REGISTRYINDEX, TEK_LIB_LISTMODEL_NAME);
+	/* s: udata, metatable */
+	lua_rawgeti(L, -1, 1);
+	/* s: udata, metatable, execbase */
+	lm->lm_ExecBase = *(TAPTR *) lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	/* s: udata, metatable */
+	lua_setmetatable(L, -2);
+	/* s: udata */
+
+	return 1;
+}
+
+static int lm_collect(lua_State *L)
+{
+	struct ListModel *lm = luaL_checkudata(L, 1, TEK_LIB_LISTMODEL_NAME);
+	if (lm->lm_ExecBase)
+	{
+		TExecFree(lm->lm_ExecBase, lm->lm_Rows);
+		TExecFree(lm->lm_ExecBase, lm->lm_Arena);
+		freeview(lm);
+		lm->lm_Rows = TNULL;
+		lm->lm_Arena = TNULL;
+		lm->lm_NumRows = 0;
+		lm->lm_ExecBase = TNULL;
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	n = model:getN(): Returns the number of lines in the model.
+*/
+
+static int lm_getn(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	lua_pushinteger(L, LM_NUMLINES(lm));
+	return 1;
+}
+
+/*
+**	n = model:getNumColumns([line]): Returns the number of columns.
+*/
+
+static int lm_getnumcolumns(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	lua_pushinteger(L, lm->lm_NumColumns);
+	return 1;
+}
+
+/*
+**	item = model:getItem(line): Returns a copy of the item at the
+**	specified line, or nil if the line does not exist.
+*/
+
+static int lm_getitem(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	TINT lnr = luaL_checkinteger(L, 2);
+	if (lnr < 1 || lnr > LM_NUMLINES(lm))
+		return 0;
+	pushitem(L, lm, LM_LINE(lm, lnr - 1));
+	return 1;
+}
+
+/*
+**	line = model:addItem(item[, line]): Inserts an item before the
+**	specified line, or appends it to the end of the list. Returns the
+**	line at which the item was added.
+*/
+
+static int lm_additem(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	TINT lnr = luaL_optinteger(L, 3, LM_NUMLINES(lm) + 1);
+	lnr = TCLAMP(1, lnr, LM_NUMLINES(lm) + 1);
+	insertitems(L, lm, 2, lnr - 1, 1, TTRUE);
+	lua_pushinteger(L, lnr);
+	return 1;
+}
+
+/*
+**	line = model:addItems(array[, line]): Inserts all items from an
+**	array before the specified line, or appends them to the end of the
+**	list, in a single operation. Returns the line of the first item
+**	added.
+*/
+
+static int lm_additems(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	TINT lnr = luaL_optinteger(L, 3, LM_NUMLINES(lm) + 1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	lnr = TCLAMP(1, lnr, LM_NUMLINES(lm) + 1);
+	insertitems(L, lm, 2, lnr - 1, lua_objlen(L, 2), TFALSE);
+	lua_pushinteger(L, lnr);
+	return 1;
+}
+
+/*
+**	item = model:remItem(line): Removes the item at the specified line,
+**	and returns a copy of it.
+*/
+
+static int lm_remitem(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	TINT lnr = luaL_checkinteger(L, 2);
+	if (lnr < 1 || lnr > LM_NUMLINES(lm))
+		return 0;
+	pushitem(L, lm, LM_LINE(lm, lnr - 1));
+	removeitems(lm, lnr - 1, 1);
+	return 1;
+}
+
+/*
+**	num = model:remItems(line, count): Removes up to count items starting
+**	at the specified line. Returns the number of items removed.
+*/
+
+static int lm_remitems(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	TINT lnr = luaL_checkinteger(L, 2);
+	TINT num = luaL_checkinteger(L, 3);
+	if (lnr < 1 || lnr > LM_NUMLINES(lm) || num <= 0)
+		num = 0;
+	else
+	{
+		num = TMIN(num, LM_NUMLINES(lm) - lnr + 1);
+		removeitems(lm, lnr - 1, num);
+	}
+	lua_pushinteger(L, num);
+	return 1;
+}
+
+/*
+**	success = model:changeItem(item, line): Replaces the item at the
+**	specified line.
+*/
+
+static int lm_changeitem(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	TINT lnr = luaL_checkinteger(L, 3);
+	if (lnr >= 1 && lnr <= LM_NUMLINES(lm))
+	{
+		struct ListRow *row;
+		TINT y0, y1;
+		TUINT oldsize;
+		reservearena(L, lm, entrysize(L, lm, 2));
+		row = LM_LINE(lm, lnr - 1);
+		y0 = row->lr_Y0;
+		y1 = row->lr_Y1;
+		oldsize = textsize(lm, row);
+		initrow(L, lm, row, 2);
+		row->lr_Y0 = y0;
+		row->lr_Y1 = y1;
+		lm->lm_ArenaWaste += oldsize;
+		checkwaste(lm);
+		lua_pushboolean(L, 1);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+**	success[, line] = model:checkPosition(line[, null_valid]): See
+**	List:checkPosition().
+*/
+
+static int lm_checkposition(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	TINT lnr;
+	if (lua_isnoneornil(L, 2))
+	{
+		lua_pushboolean(L, 0);
+		return 1;
+	}
+	lnr = luaL_checkinteger(L, 2);
+	if (lnr == 0)
+	{
+		lua_pushboolean(L, lua_toboolean(L, 3));
+		lua_pushinteger(L, 0);
+		return 2;
+	}
+	if (lnr < 1)
+	{
+		lua_pushboolean(L, 0);
+		lua_pushinteger(L, 1);
+		return 2;
+	}
+	if (lnr > LM_NUMLINES(lm))
+	{
+		lua_pushboolean(L, 0);
+		lua_pushinteger(L, LM_NUMLINES(lm));
+		return 2;
+	}
+	lua_pushboolean(L, 1);
+	lua_pushinteger(L, lnr);
+	return 2;
+}
+
+/*****************************************************************************/
+/*
+**	Line accessors
+*/
+
+static int lm_getcell(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	struct ListRow *row = checkrow(L, lm, 2);
+	TINT col = luaL_checkinteger(L, 3);
+	TSTRPTR s;
+	/* nonexistent columns are empty: */
+	if (col < 1 || col > lm->lm_NumColumns)
+		return 0;
+	s = getcell(lm, row, col - 1);
+	if (*s == 0)
+		return 0;
+	lua_pushstring(L, s);
+	return 1;
+}
+
+static int lm_clearcellwidths(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	TINT i, j;
+	for (i = 0; i < lm->lm_NumRows; ++i)
+	{
+		TINT *widths = LM_WIDTHS(LM_ROW(lm, i));
+		for (j = 0; j < lm->lm_NumColumns; ++j)
+			widths[j] = -1;
+	}
+	return 0;
+}
+
+static int lm_isselected(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	struct ListRow *row = checkrow(L, lm, 2);
+	lua_pushboolean(L, row->lr_Flags & LMF_SELECTED);
+	return 1;
+}
+
+static int lm_setselected(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	struct ListRow *row = checkrow(L, lm, 2);
+	if (lua_toboolean(L, 3))
+		row->lr_Flags |= LMF_SELECTED;
+	else
+		row->lr_Flags &= ~LMF_SELECTED;
+	return 0;
+}
+
+static int lm_getlinerange(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	struct ListRow *row = checkrow(L, lm, 2);
+	lua_pushinteger(L, row->lr_Y0);
+	lua_pushinteger(L, row->lr_Y1);
+	return 2;
+}
+
+static int lm_setlinerange(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	struct ListRow *row = checkrow(L, lm, 2);
+	row->lr_Y0 = luaL_checkinteger(L, 3);
+	row->lr_Y1 = luaL_checkinteger(L, 4);
+	return 0;
+}
+
+static int lm_getcellwidth(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	struct ListRow *row = checkrow(L, lm, 2);
+	TINT w = LM_WIDTHS(row)[checkcolumn(L, lm, 3)];
+	if (w < 0)
+		return 0;
+	lua_pushinteger(L, w);
+	return 1;
+}
+
+static int lm_setcellwidth(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	struct ListRow *row = checkrow(L, lm, 2);
+	TINT col = checkcolumn(L, lm, 3);
+	LM_WIDTHS(row)[col] = luaL_optinteger(L, 4, -1);
+	return 0;
+}
+
+/*
+**	line = model:searchLine(y): Returns the first line whose lower edge
+**	is at or below the specified y coordinate, or the number of lines
+**	plus one if there is no such line.
+*/
+
+static int lm_searchline(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	TINT y = luaL_checkinteger(L, 2);
+	TINT l0 = 0, l1 = LM_NUMLINES(lm);
+	while (l0 < l1)
+	{
+		TINT lnr = (l0 + l1) / 2;
+		if (LM_LINE(lm, lnr)->lr_Y1 < y)
+			l0 = lnr + 1;
+		else
+			l1 = lnr;
+	}
+	lua_pushinteger(L, l0 + 1);
+	return 1;
+}
+
+/*
+**	for line, column1, column2, ... in model:iterate([first]) do ... end
+**	Iterates over the lines of the model, starting at the specified line.
+*/
+
+static int lm_iterator(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	TINT lnr = luaL_checkinteger(L, 2) + 1;
+	struct ListRow *row;
+	TSTRPTR p;
+	TINT i;
+	if (lnr < 1 || lnr > LM_NUMLINES(lm))
+		return 0;
+	row = LM_LINE(lm, lnr - 1);
+	luaL_checkstack(L, lm->lm_NumColumns + 1, "too many columns");
+	lua_pushinteger(L, lnr);
+	p = lm->lm_Arena + row->lr_TextOffs;
+	for (i = 0; i < lm->lm_NumColumns; ++i)
+	{
+		size_t len = strlen(p);
+		if (len)
+			lua_pushlstring(L, p, len);
+		else
+			lua_pushnil(L);
+		p += len + 1;
+	}
+	return lm->lm_NumColumns + 1;
+}
+
+static int lm_iterate(lua_State *L)
+{
+	checkmodel(L, 1);
+	lua_pushcfunction(L, lm_iterator);
+	lua_pushvalue(L, 1);
+	lua_pushinteger(L, luaL_optinteger(L, 2, 1) - 1);
+	return 3;
+}
+
+/*****************************************************************************/
+/*
+**	Sorting and filtering
+*/
+
+#define LMKEY_STRING	0
+#define LMKEY_NOCASE	1
+#define LMKEY_NUMERIC	2
+#define LMKEY_FLAG		3
+
+static const char *const keymodes[] =
+	{ "string", "nocase", "numeric", "flag", NULL };
+
+#define LMFILTER_SUBSTRING	0
+#define LMFILTER_NOCASE		1
+#define LMFILTER_PREFIX		2
+
+static const char *const filtermodes[] =
+	{ "substring", "nocase", "prefix", NULL };
+
+struct SortKey
+{
+	TINT sk_Mode;
+	TINT sk_Column;
+	TBOOL sk_Descending;
+	/* per line, depending on the mode: */
+	TSTRPTR *sk_Text;
+	double *sk_Number;
+};
+
+struct SortContext
+{
+	struct ListModel *sc_Model;
+	TINT sc_NumKeys;
+	struct SortKey sc_Keys[LM_MAXKEYS];
+};
+
+static int nocasecmp(const char *a, const char *b)
+{
+	for (;; ++a, ++b)
+	{
+		int c = tolower((unsigned char) *a) - tolower((unsigned char) *b);
+		if (c || *a == 0)
+			return c;
+	}
+}
+
+static const char *nocasestr(const char *s, const char *text, size_t len)
+{
+	for (; *s; ++s)
+	{
+		size_t i;
+		for (i = 0; i < len; ++i)
+			if (tolower((unsigned char) s[i]) !=
+				tolower((unsigned char) text[i]))
+				break;
+		if (i == len)
+			return s;
+	}
+	return len ? TNULL : s;
+}
+
+static int compare(struct SortContext *ctx, TINT a, TINT b)
+{
+	TINT i;
+	for (i = 0; i < ctx->sc_NumKeys; ++i)
+	{
+		struct SortKey *key = &ctx->sc_Keys[i];
+		int c = 0;
+		switch (key->sk_Mode)
+		{
+			case LMKEY_STRING:
+				c = strcoll(key->sk_Text[a], key->sk_Text[b]);
+				break;
+			case LMKEY_NOCASE:
+				c = nocasecmp(key->sk_Text[a], key->sk_Text[b]);
+				break;
+			case LMKEY_NUMERIC:
+				c = (key->sk_Number[a] > key->sk_Number[b]) -
+					(key->sk_Number[a] < key->sk_Number[b]);
+				break;
+			case LMKEY_FLAG:
+				c = !!(LM_ROW(ctx->sc_Model, a)->lr_Flags & LMF_USER) -
+					!!(LM_ROW(ctx->sc_Model, b)->lr_Flags & LMF_USER);
+				break;
+		}
+		if (c)
+			return key->sk_Descending ? -c : c;
+	}
+	return 0;
+}
+
+/*
+**	Stable bottom-up merge sort of n line indices in a, using t as
+**	temporary storage. Returns the array holding the result.
+*/
+
+static TINT *sortlines(struct SortContext *ctx, TINT *a, TINT *t, TINT n)
+{
+	TINT width, i;
+	for (width = 1; width < n; width <<= 1)
+	{
+		TINT *temp;
+		for (i = 0; i < n; i += 2 * width)
+		{
+			TINT m = TMIN(i + width, n);
+			TINT e = TMIN(i + 2 * width, n);
+			TINT p = i, q = m, k = i;
+			while (p < m && q < e)
+				t[k++] = compare(ctx, a[q], a[p]) < 0 ? a[q++] : a[p++];
+			while (p < m)
+				t[k++] = a[p++];
+			while (q < e)
+				t[k++] = a[q++];
+		}
+		temp = a;
+		a = t;
+		t = temp;
+	}
+	return a;
+}
+
+static int compareindex(const void *a, const void *b)
+{
+	return *(const TINT *) a - *(const TINT *) b;
+}
+
+static void checkkeys(lua_State *L, struct ListModel *lm,
+	struct SortContext *ctx)
+{
+	TINT i, n;
+	luaL_checktype(L, 2, LUA_TTABLE);
+	n = lua_objlen(L, 2);
+	luaL_argcheck(L, n <= LM_MAXKEYS, 2, "too many sort keys");
+	ctx->sc_Model = lm;
+	ctx->sc_NumKeys = n;
+	for (i = 0; i < n; ++i)
+	{
+		struct SortKey *key = &ctx->sc_Keys[i];
+		const char *mode;
+		TINT j;
+		lua_rawgeti(L, 2, i + 1);
+		if (lua_type(L, -1) != LUA_TTABLE)
+			luaL_error(L, "sort key must be a table");
+		lua_getfield(L, -1, "Mode");
+		mode = lua_isnil(L, -1) ? "string" : lua_tostring(L, -1);
+		for (j = 0; keymodes[j]; ++j)
+			if (mode && strcmp(mode, keymodes[j]) == 0)
+				break;
+		if (keymodes[j] == TNULL)
+			luaL_error(L, "invalid sort mode '%s'", mode ? mode : "?");
+		key->sk_Mode = j;
+		lua_getfield(L, -2, "Column");
+		key->sk_Column = lua_isnil(L, -1) ? 0 : lua_tointeger(L, -1) - 1;
+		if (key->sk_Mode != LMKEY_FLAG &&
+			(key->sk_Column < 0 || key->sk_Column >= lm->lm_NumColumns))
+			luaL_error(L, "sort key column out of range");
+		lua_getfield(L, -3, "Descending");
+		key->sk_Descending = lua_toboolean(L, -1);
+		lua_pop(L, 4);
+		key->sk_Text = TNULL;
+		key->sk_Number = TNULL;
+	}
+}
+
+/*
+**	model:sort(keys[, first]): Sorts all lines of the model, including
+**	those not visible through a filter. Sorting is stable. keys is an
+**	array of up to eight tables with the fields
+**		- Column - the column to compare
+**		- Mode - "string" (using the collation of the current locale),
+**		"nocase" (case-insensitive), "numeric", or "flag" (comparing
+**		the items' userdata flags instead of a column)
+**		- Descending - boolean, to reverse the order for this key
+**	If first is given, the lines before it (counted regardless of a
+**	filter) are assumed to be sorted already by the same keys; only the
+**	lines from first are sorted, and then merged with the others in a
+**	single pass. This allows for keeping a model sorted while lines are
+**	being appended to it in batches.
+*/
+
+static int lm_sort(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	struct SortContext ctx;
+	TINT n = lm->lm_NumRows;
+	TUINT size = 2 * n * sizeof(TINT);
+	TUINT8 *buf, *p;
+	TINT *order, *temp;
+	TUINT8 *rows;
+	TINT i, j, f;
+
+	checkkeys(L, lm, &ctx);
+	f = TMAX(luaL_optinteger(L, 3, 1) - 1, 0);
+	if (n < 2 || f >= n)
+		return 0;
+
+	/* one temporary buffer for line indices and keys: */
+	for (i = 0; i < ctx.sc_NumKeys; ++i)
+	{
+		if (ctx.sc_Keys[i].sk_Mode == LMKEY_NUMERIC)
+			size += n * sizeof(double);
+		else if (ctx.sc_Keys[i].sk_Mode != LMKEY_FLAG)
+			size += n * sizeof(TSTRPTR);
+	}
+	buf = TExecAlloc(lm->lm_ExecBase, TNULL, size);
+	rows = TExecAlloc(lm->lm_ExecBase, TNULL, lm->lm_MaxRows * lm->lm_RowSize);
+	if (buf == TNULL || rows == TNULL)
+	{
+		TExecFree(lm->lm_ExecBase, buf);
+		TExecFree(lm->lm_ExecBase, rows);
+		luaL_error(L, "out of memory");
+	}
+
+	/* numbers first, for alignment: */
+	p = buf;
+	for (i = 0; i < ctx.sc_NumKeys; ++i)
+	{
+		struct SortKey *key = &ctx.sc_Keys[i];
+		if (key->sk_Mode == LMKEY_NUMERIC)
+		{
+			key->sk_Number = (double *) p;
+			p += n * sizeof(double);
+			for (j = 0; j < n; ++j)
+				key->sk_Number[j] =
+					strtod(getcell(lm, LM_ROW(lm, j), key->sk_Column), TNULL);
+		}
+	}
+	for (i = 0; i < ctx.sc_NumKeys; ++i)
+	{
+		struct SortKey *key = &ctx.sc_Keys[i];
+		if (key->sk_Mode == LMKEY_STRING || key->sk_Mode == LMKEY_NOCASE)
+		{
+			key->sk_Text = (TSTRPTR *) p;
+			p += n * sizeof(TSTRPTR);
+			for (j = 0; j < n; ++j)
+				key->sk_Text[j] = getcell(lm, LM_ROW(lm, j), key->sk_Column);
+		}
+	}
+	order = (TINT *) p;
+	temp = order + n;
+	for (i = 0; i < n; ++i)
+		order[i] = i;
+
+	if (f == 0)
+	{
+		order = sortlines(&ctx, order, temp, n);
+		temp = order == (TINT *) p ? order + n : (TINT *) p;
+	}
+	else
+	{
+		/* sort the lines from first, and merge them with those before: */
+		TINT *a = sortlines(&ctx, order + f, temp + f, n - f);
+		TINT u = 0, v = f, k = 0;
+		if (a != order + f)
+			memcpy(order + f, a, (n - f) * sizeof(TINT));
+		while (u < f && v < n)
+			temp[k++] = compare(&ctx, order[v], order[u]) < 0 ?
+				order[v++] : order[u++];
+		while (u < f)
+			temp[k++] = order[u++];
+		while (v < n)
+			temp[k++] = order[v++];
+		a = order;
+		order = temp;
+		temp = a;
+	}
+
+	/* rearrange line records: */
+	for (i = 0; i < n; ++i)
+		memcpy(rows + i * lm->lm_RowSize, LM_ROW(lm, order[i]),
+			lm->lm_RowSize);
+	TExecFree(lm->lm_ExecBase, lm->lm_Rows);
+	lm->lm_Rows = rows;
+
+	if (lm->lm_View)
+	{
+		/* map the view to the new positions, and restore its order: */
+		for (i = 0; i < n; ++i)
+			temp[order[i]] = i;
+		for (i = 0; i < lm->lm_NumView; ++i)
+			lm->lm_View[i] = temp[lm->lm_View[i]];
+		qsort(lm->lm_View, lm->lm_NumView, sizeof(TINT), compareindex);
+	}
+
+	TExecFree(lm->lm_ExecBase, buf);
+	return 0;
+}
+
+static TBOOL matchcell(TSTRPTR cell, const char *text, size_t len, TINT mode)
+{
+	switch (mode)
+	{
+		default:
+		case LMFILTER_SUBSTRING:
+			return strstr(cell, text) != TNULL;
+		case LMFILTER_NOCASE:
+			return nocasestr(cell, text, len) != TNULL;
+		case LMFILTER_PREFIX:
+			return strncmp(cell, text, len) == 0;
+	}
+}
+
+/*
+**	n = model:filter([column, text[, mode]]) or n = model:filter(func):
+**	Restricts the visible lines of the model to those whose text in the
+**	given column matches, or for which the predicate function, called
+**	with the texts of all columns, returns true. Modes are "substring"
+**	(the default), "nocase" (case-insensitive substring), and "prefix".
+**	Without arguments, the filter is removed. Returns the number of
+**	visible lines.
+*/
+
+static int lm_filter(lua_State *L)
+{
+	struct ListModel *lm = checkmodel(L, 1);
+	TINT i, n = 0, num = lm->lm_NumRows;
+	TINT *view;
+
+	if (lua_isnoneornil(L, 2))
+	{
+		freeview(lm);
+		lua_pushinteger(L, lm->lm_NumRows);
+		return 1;
+	}
+
+	/* collect in a buffer owned by Lua, as the predicate may fail: */
+	view = lua_newuserdata(L, TMAX(num, 1) * sizeof(TINT));
+
+	if (lua_isfunction(L, 2))
+	{
+		luaL_checkstack(L, lm->lm_NumColumns + 2, "too many columns");
+		/* the predicate may modify the model; stay within bounds: */
+		for (i = 0; i < num && i < lm->lm_NumRows; ++i)
+		{
+			TSTRPTR p = lm->lm_Arena + LM_ROW(lm, i)->lr_TextOffs;
+			TINT c;
+			lua_pushvalue(L, 2);
+			for (c = 0; c < lm->lm_NumColumns; ++c)
+			{
+				size_t len = strlen(p);
+				if (len)
+					lua_pushlstring(L, p, len);
+				else
+					lua_pushnil(L);
+				p += len + 1;
+			}
+			lua_call(L, lm->lm_NumColumns, 1);
+			if (lua_toboolean(L, -1))
+				view[n++] = i;
+			lua_pop(L, 1);
+		}
+	}
+	else
+	{
+		TINT col = checkcolumn(L, lm, 2);
+		size_t len;
+		const char *text = luaL_checklstring(L, 3, &len);
+		TINT mode = luaL_checkoption(L, 4, "substring", filtermodes);
+		for (i = 0; i < num; ++i)
+			if (matchcell(getcell(lm, LM_ROW(lm, i), col), text, len, mode))
+				view[n++] = i;
+	}
+
+	freeview(lm);
+	lm->lm_View = TExecAlloc(lm->lm_ExecBase, TNULL,
+		TMAX(n, LM_MINROWS) * sizeof(TINT));
+	if (lm->lm_View == TNULL)
+		luaL_error(L, "out of memory");
+	memcpy(lm->lm_View, view, n * sizeof(TINT));
+	lm->lm_NumView = n;
+	lm->lm_MaxView = TMAX(n, LM_MINROWS);
+
+	lua_pushinteger(L, n);
+	return 1;
+}
+
+/*****************************************************************************/
+
+static const luaL_Reg libfuncs[] =
+{
+	{ "new", lib_new },
+	{ NULL, NULL }
+};
+
+static const luaL_Reg modelmethods[] =
+{
+	{ "__gc", lm_collect },
+	{ "__len", lm_getn },
+	{ "getN", lm_getn },
+	{ "getNumColumns", lm_getnumcolumns },
+	{ "getItem", lm_getitem },
+	{ "addItem", lm_additem },
+	{ "addItems", lm_additems },
+	{ "remItem", lm_remitem },
+	{ "remItems", lm_remitems },
+	{ "changeItem", lm_changeitem },
+	{ "checkPosition", lm_checkposition },
+	{ "getCell", lm_getcell },
+	{ "isSelected", lm_isselected },
+	{ "setSelected", lm_setselected },
+	{ "getLineRange", lm_getlinerange },
+	{ "setLineRange", lm_setlinerange },
+	{ "getCellWidth", lm_getcellwidth },
+	{ "setCellWidth", lm_setcellwidth },
+	{ "clearCellWidths", lm_clearcellwidths },
+	{ "searchLine", lm_searchline },
+	{ "iterate", lm_iterate },
+	{ "sort", lm_sort },
+	{ "filter", lm_filter },
+	{ NULL, NULL }
+};
+
+int luaopen_tek_lib_listmodel(lua_State *L)
+{
+	luaL_register(L, "tek.lib.listmodel", libfuncs);
+	/* s: libtab */
+
+	/* require "tek.lib.exec": */
+	lua_getglobal(L, "require");
+	/* s: libtab, "require" */
+	lua_pushliteral(L, "tek.lib.exec");
+	/* s: libtab, "require", "tek.lib.exec" */
+	lua_call(L, 1, 1);
+	/* s: libtab, exectab */
+	lua_getfield(L, -1, "base");
+	/* s: libtab, exectab, execbase */
+	lua_remove(L, -2);
+	/* s: libtab, execbase */
+
+	luaL_newmetatable(L, TEK_LIB_LISTMODEL_NAME);
+	/* s: libtab, execbase, metatable */
+	luaL_register(L, NULL, modelmethods);
+	/* s: libtab, execbase, metatable */
+	lua_pushvalue(L, -1);
+	/* s: libtab, execbase, metatable, metatable */
+	lua_pushvalue(L, -3);
+	/* s: libtab, execbase, metatable, metatable, execbase */
+	luaL_ref(L, -2); /* index returned is always 1 */
+	/* s: libtab, execbase, metatable, metatable */
+	lua_setfield(L, -2, "__index");
+	/* s: libtab, execbase, metatable */
+	lua_pop(L, 2);
+	/* s: libtab */
+
+	return 1;
+}
@@ -16,14 +16,22 @@
 #include <tek/proto/exec.h>
 
 #define TEK_CLASS_UI_REGION_NAME "tek.lib.region*"
+#define TEK_CLASS_UI_REGIONPOOL_NAME "tek.lib.region.pool*"
 
 #define MERGE_RECTS	5
 
 /*****************************************************************************/
 
+struct RegionPool
+{
+	TAPTR rp_ExecBase;
+	/* Slab allocator for rectangle nodes, shared by all regions: */
+	TAPTR rp_MMU;
+};
+
 struct Region
 {
-	TAPTR rg_ExecBase;
+	struct RegionPool *rg_Pool;
 	struct TList rg_List;
 }; /* 16 bytes on 32bit arch */
 
@@ -80,10 +88,11 @@ static void relinklist(struct TList *dlist, struct TList *slist)
 	}
 }
 
-static struct RectNode *allocrectnode(TAPTR exec,
+static struct RectNode *allocrectnode(struct RegionPool *pool,
 	TINT x0, TINT y0, TINT x1, TINT y1)
 {
-	struct RectNode *rn = TExecAlloc(exec, TNULL, sizeof(struct RectNode));
+	struct RectNode *rn = TExecAlloc(pool->rp_ExecBase, pool->rp_MMU,
+		sizeof(struct RectNode));
 	if (rn)
 	{
 		TDBPRINTF(TDB_TRACE,("allocrect: %08x\n", rn));
@@ -96,19 +105,19 @@ static struct RectNode *allocrectnode(TAPTR exec,
 	return rn;
 }
 
-static void freelist(TAPTR exec, struct TList *list)
+static void freelist(struct RegionPool *pool, struct TList *list)
 {
 	struct TNode *next, *node = list->tlh_Head;
 	for (; (next = node->tln_Succ); node = next)
 	{
 		TREMOVE(node);
-		TExecFree(exec, node);
+		TExecFree(pool->rp_ExecBase, node);
 	}
 }
 
 /*****************************************************************************/
 
-static TBOOL insertrect(TAPTR exec, struct TList *list,
+static TBOOL insertrect(struct RegionPool *pool, struct TList *list,
 	TINT s0, TINT s1, TINT s2, TINT s3)
 {
 	struct TNode *temp, *next, *node = list->tlh_Head;
@@ -148,7 +157,7 @@ static TBOOL insertrect(TAPTR exec, struct TList *list,
 	}
 	#endif
 
-	rn = allocrectnode(exec, s0, s1, s2, s3);
+	rn = allocrectnode(pool, s0, s1, s2, s3);
 	if (rn)
 	{
 		TADDHEAD(list, &rn->rn_Node, temp);
@@ -158,8 +167,8 @@ static TBOOL insertrect(TAPTR exec, struct TList *list,
 	return TFALSE;
 }
 
-static TBOOL cutrect(TAPTR exec, struct TList *list, const TINT d[4],
-	const TINT s[4])
+static TBOOL cutrect(struct RegionPool *pool, struct TList *list,
+	const TINT d[4], const TINT s[4])
 {
 	TINT d0 = d[0];
 	TINT d1 = d[1];
@@ -167,34 +176,34 @@ static TBOOL cutrect(TAPTR exec, struct TList *list, const TINT d[4],
 	TINT d3 = d[3];
 
 	if (!OVERLAPRECT(d, s))
-		return insertrect(exec, list, d[0], d[1], d[2], d[3]);
+		return insertrect(pool, list, d[0], d[1], d[2], d[3]);
 
 	for (;;)
 	{
 		if (d0 < s[0])
 		{
-			if (!insertrect(exec, list, d0, d1, s[0] - 1, d3))
+			if (!insertrect(pool, list, d0, d1, s[0] - 1, d3))
 				break;
 			d0 = s[0];
 		}
 
 		if (d1 < s[1])
 		{
-			if (!insertrect(exec, list, d0, d1, d2, s[1] - 1))
+			if (!insertrect(pool, list, d0, d1, d2, s[1] - 1))
 				break;
 			d1 = s[1];
 		}
 
 		if (d2 > s[2])
 		{
-			if (!insertrect(exec, list, s[2] + 1, d1, d2, d3))
+			if (!insertrect(pool, list, s[2] + 1, d1, d2, d3))
 				break;
 			d2 = s[2];
 		}
 
 		if (d3 > s[3])
 		{
-			if (!insertrect(exec, list, d0, s[3] + 1, d2, d3))
+			if (!insertrect(pool, list, d0, s[3] + 1, d2, d3))
 				break;
 		}
 
@@ -204,7 +213,7 @@ static TBOOL cutrect(TAPTR exec, struct TList *list, const TINT d[4],
 	return TFALSE;
 }
 
-static TBOOL cutrectlist(TAPTR exec, struct TList *inlist,
+static TBOOL cutrectlist(struct RegionPool *pool, struct TList *inlist,
 	struct TList *outlist, const TINT s[4])
 {
 	TBOOL success = TTRUE;
@@ -216,38 +225,38 @@ static TBOOL cutrectlist(TAPTR exec, struct TList *inlist,
 
 		TINITLIST(&temp);
 
-		success = cutrect(exec, &temp, rn->rn_Rect, s);
+		success = cutrect(pool, &temp, rn->rn_Rect, s);
 		if (success)
 		{
 			struct TNode *next2, *node2 = temp.tlh_Head;
 			for (; success && (next2 = node2->tln_Succ); node2 = next2)
 			{
 				struct RectNode *rn2 = (struct RectNode *) node2;
-				success = insertrect(exec, outlist, rn2->rn_Rect[0],
+				success = insertrect(pool, outlist, rn2->rn_Rect[0],
 					rn2->rn_Rect[1], rn2->rn_Rect[2], rn2->rn_Rect[3]);
 				/* note that if unsuccessful, outlist is unusable as well */
 			}
 		}
 
-		freelist(exec, &temp);
+		freelist(pool, &temp);
 	}
 	return success;
 }
 
-static TBOOL orrect(TAPTR exec, struct TList *list, TINT s[4])
+static TBOOL orrect(struct RegionPool *pool, struct TList *list, TINT s[4])
 {
 	struct TList temp;
 	TINITLIST(&temp);
-	if (cutrectlist(exec, list, &temp, s))
+	if (cutrectlist(pool, list, &temp, s))
 	{
-		if (insertrect(exec, &temp, s[0], s[1], s[2], s[3]))
+		if (insertrect(pool, &temp, s[0], s[1], s[2], s[3]))
 		{
-			freelist(exec, list);
+			freelist(pool, list);
 			relinklist(list, &temp);
 			return TTRUE;
 		}
 	}
-	freelist(exec, &temp);
+	freelist(pool, &temp);
 	return TFALSE;
 }
 
@@ -264,21 +273,21 @@ static int lib_new(lua_State *L)
 	/* s: udata */
 
 	TINITLIST(&region->rg_List);
-	region->rg_ExecBase = TNULL;
+	region->rg_Pool = TNULL;
 
 	lua_getfield(L, LUA_REGISTRYINDEX, TEK_CLASS_UI_REGION_NAME);
 	/* s: udata, metatable */
-	lua_rawgeti(L, -1, 1);
-	/* s: udata, metatable, execbase */
+	lua_rawgeti(L, -1, 2);
+	/* s: udata, metatable, pool */
 
-	region->rg_ExecBase = *(TAPTR *) lua_touserdata(L, -1);
+	region->rg_Pool = lua_touserdata(L, -1);
 
 	lua_pop(L, 1);
 	/* s: udata, metatable */
 	lua_setmetatable(L, -2);
 	/* s: udata */
 
-	if (insertrect(region->rg_ExecBase, &region->rg_List,
+	if (insertrect(region->rg_Pool, &region->rg_List,
 		x0, y0, x1, y1) == TFALSE)
 		luaL_error(L, "out of memory");
 
@@ -293,8 +302,8 @@ static int region_set(lua_State *L)
 	TINT x1 = luaL_checkinteger(L, 4);
 	TINT y1 = luaL_checkinteger(L, 5);
 
-	freelist(region->rg_ExecBase, &region->rg_List);
-	if (insertrect(region->rg_ExecBase, &region->rg_List,
+	freelist(region->rg_Pool, &region->rg_List);
+	if (insertrect(region->rg_Pool, &region->rg_List,
 		x0, y0, x1, y1) == TFALSE)
 		luaL_error(L, "out of memory");
 
@@ -305,12 +314,12 @@ static int region_collect(lua_State *L)
 {
 	struct Region *region = luaL_checkudata(L, 1, TEK_CLASS_UI_REGION_NAME);
 
-	if (region->rg_ExecBase)
+	if (region->rg_Pool)
 	{
 		TDBPRINTF(TDB_TRACE,("region collecting...\n"));
 
-		freelist(region->rg_ExecBase, &region->rg_List);
-		region->rg_ExecBase = TNULL;
+		freelist(region->rg_Pool, &region->rg_List);
+		region->rg_Pool = TNULL;
 
 	#if 0
 		/* release reference to ExecBase in metatable: */
@@ -325,6 +334,15 @@ static int region_collect(lua_State *L)
 	return 0;
 }
 
+static int pool_collect(lua_State *L)
+{
+	struct RegionPool *pool =
+		luaL_checkudata(L, 1, TEK_CLASS_UI_REGIONPOOL_NAME);
+	TDestroy(pool->rp_MMU);
+	pool->rp_MMU = TNULL;
+	return 0;
+}
+
 static int region_iterate(lua_State *L)
 {
 	struct TNode *node = lua_touserdata(L, 2);
@@ -398,7 +416,7 @@ static int region_orrect(lua_State *L)
 	s[2] = luaL_checkinteger(L, 4);
 	s[3] = luaL_checkinteger(L, 5);
 
-	if (orrect(region->rg_ExecBase, &region->rg_List, s) == TFALSE)
+	if (orrect(region->rg_Pool, &region->rg_List, s) == TFALSE)
 		luaL_error(L, "out of memory");
 
 	return 0;
@@ -411,7 +429,7 @@ static TBOOL orregion(struct Region *region, struct TList *list)
 	for (; success && (next = node->tln_Succ); node = next)
 	{
 		struct RectNode *rn = (struct RectNode *) node;
-		success = orrect(region->rg_ExecBase, &region->rg_List, rn->rn_Rect);
+		success = orrect(region->rg_Pool, &region->rg_List, rn->rn_Rect);
 	}
 	return success;
 }
@@ -419,7 +437,7 @@ static TBOOL orregion(struct Region *region, struct TList *list)
 static int region_xorrect(lua_State *L)
 {
 	struct Region *region = luaL_checkudata(L, 1, TEK_CLASS_UI_REGION_NAME);
-	TAPTR exec = region->rg_ExecBase;
+	struct RegionPool *pool = region->rg_Pool;
 	struct TNode *next, *node;
 	TBOOL success;
 	struct TList r1, r2;
@@ -433,7 +451,7 @@ static int region_xorrect(lua_State *L)
 	TINITLIST(&r1);
 	TINITLIST(&r2);
 
-	success = insertrect(exec, &r2, s[0], s[1], s[2], s[3]);
+	success = insertrect(pool, &r2, s[0], s[1], s[2], s[3]);
 
 	node = region->rg_List.tlh_Head;
 	for (; success && (next = node->tln_Succ); node = next)
@@ -443,38 +461,38 @@ static int region_xorrect(lua_State *L)
 		struct TList temp;
 
 		TINITLIST(&temp);
-		success = cutrect(exec, &temp, rn->rn_Rect, s);
+		success = cutrect(pool, &temp, rn->rn_Rect, s);
 
 		node2 = temp.tlh_Head;
 		for (; success && (next2 = node2->tln_Succ); node2 = next2)
 		{
 			struct RectNode *rn2 = (struct RectNode *) node2;
-			success = insertrect(exec, &r1, rn2->rn_Rect[0],
+			success = insertrect(pool, &r1, rn2->rn_Rect[0],
 				rn2->rn_Rect[1], rn2->rn_Rect[2], rn2->rn_Rect[3]);
 		}
 
-		freelist(exec, &temp);
+		freelist(pool, &temp);
 		TINITLIST(&temp);
 
 		if (success)
 		{
-			success = cutrectlist(exec, &r2, &temp, rn->rn_Rect);
-			freelist(exec, &r2);
+			success = cutrectlist(pool, &r2, &temp, rn->rn_Rect);
+			freelist(pool, &r2);
 			relinklist(&r2, &temp);
 		}
 	}
 
 	if (success)
 	{
-		freelist(exec, &region->rg_List);
+		freelist(pool, &region->rg_List);
 		relinklist(&region->rg_List, &r1);
 		orregion(region, &r2);
-		freelist(exec, &r2);
+		freelist(pool, &r2);
 	}
 	else
 	{
-		freelist(exec, &r1);
-		freelist(exec, &r2);
+		freelist(pool, &r1);
+		freelist(pool, &r2);
 		luaL_error(L, "out of memory");
 	}
 
@@ -484,7 +502,7 @@ static int region_xorrect(lua_State *L)
 static int region_subrect(lua_State *L)
 {
 	struct Region *region = luaL_checkudata(L, 1, TEK_CLASS_UI_REGION_NAME);
-	TAPTR exec = region->rg_ExecBase;
+	struct RegionPool *pool = region->rg_Pool;
 	struct TNode *next, *node;
 	TBOOL success;
 	struct TList r1;
@@ -506,27 +524,27 @@ static int region_subrect(lua_State *L)
 		struct TList temp;
 
 		TINITLIST(&temp);
-		success = cutrect(exec, &temp, rn->rn_Rect, s);
+		success = cutrect(pool, &temp, rn->rn_Rect, s);
 
 		node2 = temp.tlh_Head;
 		for (; success && (next2 = node2->tln_Succ); node2 = next2)
 		{
 			struct RectNode *rn2 = (struct RectNode *) node2;
-			success = insertrect(exec, &r1, rn2->rn_Rect[0],
+			success = insertrect(pool, &r1, rn2->rn_Rect[0],
 				rn2->rn_Rect[1], rn2->rn_Rect[2], rn2->rn_Rect[3]);
 		}
 
-		freelist(exec, &temp);
+		freelist(pool, &temp);
 	}
 
 	if (success)
 	{
-		freelist(exec, &region->rg_List);
+		freelist(pool, &region->rg_List);
 		relinklist(&region->rg_List, &r1);
 	}
 	else
 	{
-		freelist(exec, &r1);
+		freelist(pool, &r1);
 		luaL_error(L, "out of memory");
 	}
 
@@ -610,6 +628,8 @@ static const luaL_Reg regionmethods[] =
 
 int luaopen_tek_lib_region(lua_State *L)
 {
+	struct RegionPool *pool;
+
 	luaL_register(L, "tek.lib.region", libfuncs);
 	/* s: libtab */
 	lua_pop(L, 1);
@@ -627,19 +647,36 @@ int luaopen_tek_lib_region(lua_State *L)
 	lua_remove(L, -2);
 	/* s: execbase */
 
+	/* slab allocator for rectangle nodes, freed after all regions: */
+	pool = lua_newuserdata(L, sizeof(struct RegionPool));
+	/* s: execbase, pool */
+	pool->rp_ExecBase = *(TAPTR *) lua_touserdata(L, -2);
+	/* private to this state, hence neither task-safe nor registered */
+	pool->rp_MMU = TExecCreateMMU(pool->rp_ExecBase, TNULL, TMMUT_Slab,
+		TNULL);
+	/* falls back to the default allocator if TNULL */
+	luaL_newmetatable(L, TEK_CLASS_UI_REGIONPOOL_NAME);
+	lua_pushcfunction(L, pool_collect);
+	lua_setfield(L, -2, "__gc");
+	lua_setmetatable(L, -2);
+	/* s: execbase, pool */
+
 	luaL_newmetatable(L, TEK_CLASS_UI_REGION_NAME);
-	/* s: execbase, metatable */
+	/* s: execbase, pool, metatable */
 	luaL_register(L, NULL, regionmethods);
-	/* s: execbase, metatable */
-	lua_pushvalue(L, -1);
-	/* s: execbase, metatable, metatable */
+	/* s: execbase, pool, metatable */
 	lua_pushvalue(L, -3);
-	/* s: execbase, metatable, metatable, execbase */
-	luaL_ref(L, -2);
-	/* s: execbase, metatable, metatable */
+	/* s: execbase, pool, metatable, execbase */
+	lua_rawseti(L, -2, 1);
+	lua_pushvalue(L, -2);
+	/* s: execbase, pool, metatable, pool */
+	lua_rawseti(L, -2, 2);
+	/* s: execbase, pool, metatable */
+	lua_pushvalue(L, -1);
+	/* s: execbase, pool, metatable, metatable */
 	lua_setfield(L, -2, "__index");
-	/* s: execbase, metatable */
-	lua_pop(L, 2);
+	/* s: execbase, pool, metatable */
+	lua_pop(L, 3);
 	/* s: */
 
 	return 0;
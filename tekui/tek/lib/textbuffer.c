@@ -0,0 +1,421 @@
+
+/*
+**	tek.lib.textbuffer - Editable UTF-8 text buffer
+**	Written by Timm S. Mueller <tmueller at schulze-mueller.de>
+**	See copyright notice in COPYRIGHT
+**
+**	A text buffer holds UTF-8 encoded text in a gap buffer: The text is
+**	stored in a single allocation, with a gap at the position of the last
+**	modification. Inserting and erasing text near that position costs
+**	only the size of the modification, and positions are located by
+**	scanning from the nearest of the text's start, the gap, or its end.
+**
+**	Positions are in characters, not bytes. The interface is that of
+**	tek.class.utf8string, so that a text buffer can be used in its place.
+**	Continuation bytes which do not belong to a sequence are replaced
+**	by '?' on insertion, so that every character in the buffer starts
+**	with a byte that is not a continuation byte.
+*/
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+
+#include <string.h>
+
+#include <tek/debug.h>
+#include <tek/teklib.h>
+#include <tek/proto/exec.h>
+
+#define TEK_LIB_TEXTBUFFER_NAME "tek.lib.textbuffer*"
+
+/* Minimum size of the buffer, in bytes: */
+#define TB_MINSIZE	64
+
+#define ISCONT(c)	(((c) & 0xc0) == 0x80)
+
+/*****************************************************************************/
+
+struct TextBuffer
+{
+	TAPTR tb_ExecBase;
+	TUINT8 *tb_Buf;
+	/* Size of the buffer, in bytes: */
+	TUINT tb_Size;
+	/* Byte offsets of the gap, and of the text following it: */
+	TUINT tb_GapStart;
+	TUINT tb_GapEnd;
+	/* Number of characters in front of the gap, and in total: */
+	TINT tb_GapChar;
+	TINT tb_NumChars;
+};
+
+/*****************************************************************************/
+
+static struct TextBuffer *checkbuffer(lua_State *L, int narg)
+{
+	struct TextBuffer *tb = luaL_checkudata(L, narg, TEK_LIB_TEXTBUFFER_NAME);
+	if (tb->tb_ExecBase == TNULL)
+		luaL_argerror(L, narg, "closed text buffer");
+	return tb;
+}
+
+static TAPTR growbuf(TAPTR exec, TAPTR buf, TUINT size)
+{
+	return buf ? TExecRealloc(exec, buf, size) : TExecAlloc(exec, TNULL, size);
+}
+
+/*
+**	Advance n characters from byte offset p, not exceeding e
+*/
+
+static TUINT skipfwd(const TUINT8 *s, TUINT p, TUINT e, TINT n)
+{
+	while (n-- > 0 && p < e)
+		while (++p < e && ISCONT(s[p]));
+	return p;
+}
+
+/*
+**	Go back n characters from byte offset p, not below b
+*/
+
+static TUINT skipback(const TUINT8 *s, TUINT p, TUINT b, TINT n)
+{
+	while (n-- > 0 && p > b)
+		while (--p > b && ISCONT(s[p]));
+	return p;
+}
+
+/*
+**	Physical byte offset of the character at index c, 0 <= c <= NumChars.
+**	For c == GapChar, this is the offset of the first character after the
+**	gap.
+*/
+
+static TUINT charoffs(struct TextBuffer *tb, TINT c)
+{
+	TINT g = tb->tb_GapChar;
+	if (c < g)
+	{
+		if (c < g - c)
+			return skipfwd(tb->tb_Buf, 0, tb->tb_GapStart, c);
+		return skipback(tb->tb_Buf, tb->tb_GapStart, 0, g - c);
+	}
+	if (c - g < tb->tb_NumChars - c)
+		return skipfwd(tb->tb_Buf, tb->tb_GapEnd, tb->tb_Size, c - g);
+	return skipback(tb->tb_Buf, tb->tb_Size, tb->tb_GapEnd,
+		tb->tb_NumChars - c);
+}
+
+/*
+**	Move the gap in front of the character at index c
+*/
+
+static void movegap(struct TextBuffer *tb, TINT c)
+{
+	TUINT p = charoffs(tb, c);
+	if (c < tb->tb_GapChar)
+	{
+		TUINT n = tb->tb_GapStart - p;
+		memmove(tb->tb_Buf + tb->tb_GapEnd - n, tb->tb_Buf + p, n);
+		tb->tb_GapStart -= n;
+		tb->tb_GapEnd -= n;
+	}
+	else if (c > tb->tb_GapChar)
+	{
+		TUINT n = p - tb->tb_GapEnd;
+		memmove(tb->tb_Buf + tb->tb_GapStart, tb->tb_Buf + tb->tb_GapEnd, n);
+		tb->tb_GapStart += n;
+		tb->tb_GapEnd += n;
+	}
+	tb->tb_GapChar = c;
+}
+
+/*
+**	Make room for at least n bytes in the gap
+*/
+
+static void reserve(lua_State *L, struct TextBuffer *tb, TUINT n)
+{
+	if (tb->tb_GapEnd - tb->tb_GapStart < n)
+	{
+		TUINT used = tb->tb_Size - (tb->tb_GapEnd - tb->tb_GapStart);
+		TUINT tail = tb->tb_Size - tb->tb_GapEnd;
+		TUINT size = TMAX(tb->tb_Size, TB_MINSIZE);
+		TUINT8 *buf;
+		while (size < used + n)
+			size *= 2;
+		buf = growbuf(tb->tb_ExecBase, tb->tb_Buf, size);
+		if (buf == TNULL)
+			luaL_error(L, "out of memory");
+		memmove(buf + size - tail, buf + tb->tb_GapEnd, tail);
+		tb->tb_Buf = buf;
+		tb->tb_GapEnd = size - tail;
+		tb->tb_Size = size;
+	}
+}
+
+/*
+**	Insert a string in front of the character at index c
+*/
+
+static void insert(lua_State *L, struct TextBuffer *tb, TINT c,
+	const char *s, size_t len)
+{
+	TUINT8 *d;
+	TINT numc = 0, numa = 0;
+	size_t i;
+
+	reserve(L, tb, len);
+	movegap(tb, c);
+
+	d = tb->tb_Buf + tb->tb_GapStart;
+	for (i = 0; i < len; ++i)
+	{
+		TUINT8 b = s[i];
+		if (ISCONT(b))
+		{
+			if (numa == 0)
+			{
+				/* continuation byte outside of a sequence: */
+				b = '?';
+				numc++;
+			}
+			else
+				numa--;
+		}
+		else
+		{
+			numa = b >= 0xfc ? 5 : b >= 0xf8 ? 4 : b >= 0xf0 ? 3 :
+				b >= 0xe0 ? 2 : b >= 0xc0 ? 1 : 0;
+			numc++;
+		}
+		d[i] = b;
+	}
+
+	tb->tb_GapStart += len;
+	tb->tb_GapChar += numc;
+	tb->tb_NumChars += numc;
+}
+
+/*
+**	Resolve a range of characters with the semantics of string.sub();
+**	returns the number of characters, and the first index in *p0
+*/
+
+static TINT getrange(lua_State *L, struct TextBuffer *tb, int narg,
+	TINT *p0)
+{
+	TINT len = tb->tb_NumChars;
+	TINT i = luaL_checkinteger(L, narg);
+	TINT j = luaL_optinteger(L, narg + 1, -1);
+	if (i < 0)
+		i = len + 1 + i;
+	if (j < 0)
+		j = len + 1 + j;
+	i = TMAX(i, 1);
+	j = TMIN(j, len);
+	*p0 = i - 1;
+	return i <= j ? j - i + 1 : 0;
+}
+
+/*****************************************************************************/
+/*
+**	buffer = textbuffer.new([string]): Creates a text buffer, optionally
+**	initialized with an UTF-8 encoded string.
+*/
+
+static int lib_new(lua_State *L)
+{
+	size_t len = 0;
+	const char *s = luaL_optlstring(L, 1, "", &len);
+	struct TextBuffer *tb = lua_newuserdata(L, sizeof(struct TextBuffer));
+	/* s: udata */
+	memset(tb, 0, sizeof(struct TextBuffer));
+
+	lua_getfield(L, LUA_REGISTRYINDEX, TEK_LIB_TEXTBUFFER_NAME);
+	/* s: udata, metatable */
+	lua_rawgeti(L, -1, 1);
+	/* s: udata, metatable, execbase */
+	tb->tb_ExecBase = *(TAPTR *) lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	/* s: udata, metatable */
+	lua_setmetatable(L, -2);
+	/* s: udata */
+
+	insert(L, tb, 0, s, len);
+	return 1;
+}
+
+static int tb_collect(lua_State *L)
+{
+	struct TextBuffer *tb = luaL_checkudata(L, 1, TEK_LIB_TEXTBUFFER_NAME);
+	if (tb->tb_ExecBase)
+	{
+		TExecFree(tb->tb_ExecBase, tb->tb_Buf);
+		tb->tb_Buf = TNULL;
+		tb->tb_ExecBase = TNULL;
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	len = buffer:len(): Returns the length of the text, in characters.
+*/
+
+static int tb_len(lua_State *L)
+{
+	struct TextBuffer *tb = checkbuffer(L, 1);
+	lua_pushinteger(L, tb->tb_NumChars);
+	return 1;
+}
+
+/*****************************************************************************/
+/*
+**	string = buffer:get(): Returns the text in UTF-8 encoded form.
+*/
+
+static int tb_get(lua_State *L)
+{
+	struct TextBuffer *tb = checkbuffer(L, 1);
+	luaL_Buffer b;
+	luaL_buffinit(L, &b);
+	luaL_addlstring(&b, (const char *) tb->tb_Buf, tb->tb_GapStart);
+	luaL_addlstring(&b, (const char *) tb->tb_Buf + tb->tb_GapEnd,
+		tb->tb_Size - tb->tb_GapEnd);
+	luaL_pushresult(&b);
+	return 1;
+}
+
+/*****************************************************************************/
+/*
+**	substring = buffer:sub(i[, j]): Returns an UTF-8 encoded substring.
+**	The semantics are the same as for string.sub().
+*/
+
+static int tb_sub(lua_State *L)
+{
+	struct TextBuffer *tb = checkbuffer(L, 1);
+	TINT c0, n = getrange(L, tb, 2, &c0);
+	if (n > 0)
+	{
+		const char *s = (const char *) tb->tb_Buf;
+		TUINT p0 = charoffs(tb, c0);
+		TINT c1 = c0 + n;
+		if (c0 < tb->tb_GapChar && c1 > tb->tb_GapChar)
+		{
+			/* substring spans the gap: */
+			luaL_Buffer b;
+			TUINT p1 = skipfwd(tb->tb_Buf, tb->tb_GapEnd, tb->tb_Size,
+				c1 - tb->tb_GapChar);
+			luaL_buffinit(L, &b);
+			luaL_addlstring(&b, s + p0, tb->tb_GapStart - p0);
+			luaL_addlstring(&b, s + tb->tb_GapEnd, p1 - tb->tb_GapEnd);
+			luaL_pushresult(&b);
+		}
+		else
+		{
+			TUINT e = c0 < tb->tb_GapChar ? tb->tb_GapStart : tb->tb_Size;
+			TUINT p1 = skipfwd(tb->tb_Buf, p0, e, n);
+			lua_pushlstring(L, s + p0, p1 - p0);
+		}
+	}
+	else
+		lua_pushliteral(L, "");
+	return 1;
+}
+
+/*****************************************************************************/
+/*
+**	buffer:insert(string[, position]): Inserts an UTF-8 encoded string
+**	in front of the character at the specified position. If the position
+**	is absent, the string is added to the end.
+*/
+
+static int tb_insert(lua_State *L)
+{
+	struct TextBuffer *tb = checkbuffer(L, 1);
+	size_t len;
+	const char *s = luaL_checklstring(L, 2, &len);
+	TINT pos = luaL_optinteger(L, 3, 0);
+	pos = pos > 0 ? TMIN(pos - 1, tb->tb_NumChars) : tb->tb_NumChars;
+	insert(L, tb, pos, s, len);
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	buffer:erase(i[, j]): Erases the characters at the positions from i
+**	to j. The semantics for the range are the same as for buffer:sub().
+*/
+
+static int tb_erase(lua_State *L)
+{
+	struct TextBuffer *tb = checkbuffer(L, 1);
+	TINT c0, n = getrange(L, tb, 2, &c0);
+	if (n > 0)
+	{
+		movegap(tb, c0);
+		tb->tb_GapEnd = skipfwd(tb->tb_Buf, tb->tb_GapEnd, tb->tb_Size, n);
+		tb->tb_NumChars -= n;
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+
+static const luaL_Reg libfuncs[] =
+{
+	{ "new", lib_new },
+	{ NULL, NULL }
+};
+
+static const luaL_Reg buffermethods[] =
+{
+	{ "__gc", tb_collect },
+	{ "__len", tb_len },
+	{ "__tostring", tb_get },
+	{ "len", tb_len },
+	{ "get", tb_get },
+	{ "sub", tb_sub },
+	{ "insert", tb_insert },
+	{ "erase", tb_erase },
+	{ NULL, NULL }
+};
+
+int luaopen_tek_lib_textbuffer(lua_State *L)
+{
+	luaL_register(L, "tek.lib.textbuffer", libfuncs);
+	/* s: libtab */
+
+	/* require "tek.lib.exec": */
+	lua_getglobal(L, "require");
+	/* s: libtab, "require" */
+	lua_pushliteral(L, "tek.lib.exec");
+	/* s: libtab, "require", "tek.lib.exec" */
+	lua_call(L, 1, 1);
+	/* s: libtab, exectab */
+	lua_getfield(L, -1, "base");
+	/* s: libtab, exectab, execbase */
+	lua_remove(L, -2);
+	/* s: libtab, execbase */
+
+	luaL_newmetatable(L, TEK_LIB_TEXTBUFFER_NAME);
+	/* s: libtab, execbase, metatable */
+	luaL_register(L, NULL, buffermethods);
+	/* s: libtab, execbase, metatable */
+	lua_pushvalue(L, -1);
+	/* s: libtab, execbase, metatable, metatable */
+	lua_pushvalue(L, -3);
+	/* s: libtab, execbase, metatable, metatable, execbase */
+	luaL_ref(L, -2); /* index returned is always 1 */
+	/* s: libtab, execbase, metatable, metatable */
+	lua_setfield(L, -2, "__index");
+	/* s: libtab, execbase, metatable */
+	lua_pop(L, 2);
+	/* s: libtab */
+
+	return 1;
+}
@@ -1,4 +1,5 @@
 
+#include <string.h>
 #include "visual_lua.h"
 
 static TAPTR checkinstptr(lua_State *L, int n, const char *classname)
@@ -10,6 +11,8 @@ static TAPTR checkinstptr(lua_State *L, int n, const char *classname)
 
 #define getvisptr(L, n) luaL_checkudata(L, n, TEK_LIB_VISUAL_CLASSNAME)
 #define getpenptr(L, n) luaL_checkudata(L, n, TEK_LIB_VISUALPEN_CLASSNAME)
+#define getpixmapptr(L, n) \
+	luaL_checkudata(L, n, TEK_LIB_VISUALPIXMAP_CLASSNAME)
 #define checkvisptr(L, n) checkinstptr(L, n, TEK_LIB_VISUAL_CLASSNAME)
 #define checkpenptr(L, n) checkinstptr(L, n, TEK_LIB_VISUALPEN_CLASSNAME)
 #define checkfontptr(L, n) checkinstptr(L, n, TEK_LIB_VISUALFONT_CLASSNAME)
@@ -425,6 +428,192 @@ tek_lib_visual_freepen(lua_State *L)
 }
 
 /*****************************************************************************/
+/*
+**	pixmap = visual:allocpixmap(w, h): Allocates an offscreen pixmap of the
+**	given size on the display. Returns nil if the display driver does not
+**	support offscreen pixmaps.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_allocpixmap(lua_State *L)
+{
+	TEKVisual *vis = checkvisptr(L, 1);
+	TINT w = luaL_checkinteger(L, 2);
+	TINT h = luaL_checkinteger(L, 3);
+	TAPTR pm = TVisualAllocPixmap(vis->vis_Visual, w, h);
+	TEKPixmap *pixmap;
+	if (pm == TNULL)
+		return 0;
+	pixmap = lua_newuserdata(L, sizeof(TEKPixmap));
+	/* s: pixmapdata */
+	pixmap->pxm_Pixmap = pm;
+	pixmap->pxm_Visual = vis;
+	pixmap->pxm_Width = w;
+	pixmap->pxm_Height = h;
+	luaL_newmetatable(L, TEK_LIB_VISUALPIXMAP_CLASSNAME);
+	/* s: pixmapdata, meta */
+	lua_setmetatable(L, -2);
+	/* s: pixmapdata */
+	/* keep the visual alive as long as the pixmap, see collectpixmap: */
+	lua_createtable(L, 1, 0);
+	/* s: pixmapdata, envtab */
+	lua_pushvalue(L, 1);
+	/* s: pixmapdata, envtab, visual */
+	lua_rawseti(L, -2, 1);
+	/* s: pixmapdata, envtab */
+	lua_setfenv(L, -2);
+	/* s: pixmapdata */
+	return 1;
+}
+
+/*
+**	Garbage collection of a pixmap that was not freed explicitly. Its
+**	visual is still referenced, but may have been closed, in which case
+**	the display has already freed the pixmap.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_collectpixmap(lua_State *L)
+{
+	TEKPixmap *pixmap = getpixmapptr(L, 1);
+	if (pixmap->pxm_Pixmap && pixmap->pxm_Visual->vis_Visual)
+		TVisualFreePixmap(pixmap->pxm_Visual->vis_Visual,
+			pixmap->pxm_Pixmap);
+	pixmap->pxm_Pixmap = TNULL;
+	return 0;
+}
+
+/*
+**	visual:freepixmap(pixmap): Frees a pixmap. If it is the current
+**	rendering target, the target reverts to the window.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_freepixmap(lua_State *L)
+{
+	TEKVisual *vis = checkvisptr(L, 1);
+	TEKPixmap *pixmap = getpixmapptr(L, 2);
+	if (pixmap->pxm_Pixmap)
+	{
+		if (vis != pixmap->pxm_Visual)
+			luaL_argerror(L, 2, "Pixmap not from visual");
+		TVisualFreePixmap(vis->vis_Visual, pixmap->pxm_Pixmap);
+		pixmap->pxm_Pixmap = TNULL;
+	}
+	return 0;
+}
+
+/*
+**	visual:settarget([pixmap]): Directs subsequent drawing operations to
+**	the specified pixmap, or back to the window if no pixmap is given.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_settarget(lua_State *L)
+{
+	TEKVisual *vis = checkvisptr(L, 1);
+	TAPTR pm = TNULL;
+	if (!lua_isnoneornil(L, 2))
+	{
+		TEKPixmap *pixmap = getpixmapptr(L, 2);
+		if (pixmap->pxm_Pixmap == TNULL || vis != pixmap->pxm_Visual)
+			luaL_argerror(L, 2, "Invalid pixmap");
+		pm = pixmap->pxm_Pixmap;
+	}
+	TVisualSetTarget(vis->vis_Visual, pm);
+	tek_lib_visual_recordfail(vis);
+	return 0;
+}
+
+/*
+**	visual:drawpixmap(pixmap, x, y, w, h, dx, dy): Copies the rectangle
+**	x, y, w, h from the pixmap to the position dx, dy (subject to the
+**	current shift) in the current rendering target.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_drawpixmap(lua_State *L)
+{
+	TEKVisual *vis = checkvisptr(L, 1);
+	TEKPixmap *pixmap = getpixmapptr(L, 2);
+	TINT x = luaL_checkinteger(L, 3);
+	TINT y = luaL_checkinteger(L, 4);
+	TINT w = luaL_checkinteger(L, 5);
+	TINT h = luaL_checkinteger(L, 6);
+	TINT dx = luaL_checkinteger(L, 7) + vis->vis_ShiftX;
+	TINT dy = luaL_checkinteger(L, 8) + vis->vis_ShiftY;
+	if (pixmap->pxm_Pixmap == TNULL || vis != pixmap->pxm_Visual)
+		luaL_argerror(L, 2, "Invalid pixmap");
+	if (w > 0 && h > 0)
+	{
+		TEKDisplayOp *op;
+		TVisualDrawPixmap(vis->vis_Visual, pixmap->pxm_Pixmap, x, y, w, h,
+			dx, dy);
+		op = tek_lib_visual_record(L, vis, DLOP_PIXMAP, 2);
+		if (op)
+		{
+			op->op_Args[0] = x;
+			op->op_Args[1] = y;
+			op->op_Args[2] = w;
+			op->op_Args[3] = h;
+			op->op_Args[4] = dx;
+			op->op_Args[5] = dy;
+		}
+	}
+	return 0;
+}
+
+/*
+**	visual:drawninepatch(pixmap, b1, b2, b3, b4, x0, y0, x1, y1): Draws a
+**	border around the rectangle x0, y0, x1, y1 from a pixmap containing
+**	a border of the thicknesses b1, b2, b3, b4 (left, top, right, bottom)
+**	around a center of arbitrary size.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_drawninepatch(lua_State *L)
+{
+	TEKVisual *vis = checkvisptr(L, 1);
+	TEKPixmap *pixmap = getpixmapptr(L, 2);
+	TINT sx = vis->vis_ShiftX, sy = vis->vis_ShiftY;
+	TINT border[4], rect[4];
+	TEKDisplayOp *op;
+	border[0] = luaL_checkinteger(L, 3);
+	border[1] = luaL_checkinteger(L, 4);
+	border[2] = luaL_checkinteger(L, 5);
+	border[3] = luaL_checkinteger(L, 6);
+	rect[0] = luaL_checkinteger(L, 7) + sx;
+	rect[1] = luaL_checkinteger(L, 8) + sy;
+	rect[2] = luaL_checkinteger(L, 9) + sx;
+	rect[3] = luaL_checkinteger(L, 10) + sy;
+	if (pixmap->pxm_Pixmap == TNULL || vis != pixmap->pxm_Visual)
+		luaL_argerror(L, 2, "Invalid pixmap");
+	TVisualDrawNinePatch(vis->vis_Visual, pixmap->pxm_Pixmap, border, rect);
+	op = tek_lib_visual_record(L, vis, DLOP_NINEPATCH, 2);
+	if (op)
+	{
+		memcpy(op->op_Args, border, sizeof border);
+		memcpy(op->op_Args + 4, rect, sizeof rect);
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+
+static void
+recordrect(lua_State *L, TEKVisual *vis, TINT code, TINT x0, TINT y0,
+	TINT x1, TINT y1, TVPEN pen)
+{
+	TEKDisplayOp *op = tek_lib_visual_record(L, vis, code, 0);
+	if (op)
+	{
+		op->op_Args[0] = x0;
+		op->op_Args[1] = y0;
+		op->op_Args[2] = x1;
+		op->op_Args[3] = y1;
+		op->op_Pens[0] = pen;
+	}
+}
 
 LOCAL LUACFUNC TINT
 tek_lib_visual_rect(lua_State *L)
@@ -438,6 +627,7 @@ tek_lib_visual_rect(lua_State *L)
 	TEKPen *pen = checkpenptr(L, 6);
 	TVisualRect(vis->vis_Visual, x0, y0, x1 - x0 + 1, y1 - y0 + 1,
 		pen->pen_Pen);
+	recordrect(L, vis, DLOP_RECT, x0, y0, x1 - x0 + 1, y1 - y0 + 1, pen->pen_Pen);
 	return 0;
 }
 
@@ -453,6 +643,7 @@ tek_lib_visual_frect(lua_State *L)
 	TEKPen *pen = checkpenptr(L, 6);
 	TVisualFRect(vis->vis_Visual, x0, y0, x1 - x0 + 1, y1 - y0 + 1,
 		pen->pen_Pen);
+	recordrect(L, vis, DLOP_FRECT, x0, y0, x1 - x0 + 1, y1 - y0 + 1, pen->pen_Pen);
 	return 0;
 }
 
@@ -467,6 +658,7 @@ tek_lib_visual_line(lua_State *L)
 	TINT y1 = luaL_checkinteger(L, 5) + sy;
 	TEKPen *pen = checkpenptr(L, 6);
 	TVisualLine(vis->vis_Visual, x0, y0, x1, y1, pen->pen_Pen);
+	recordrect(L, vis, DLOP_LINE, x0, y0, x1, y1, pen->pen_Pen);
 	return 0;
 }
 
@@ -479,6 +671,7 @@ tek_lib_visual_plot(lua_State *L)
 	TINT y0 = luaL_checkinteger(L, 3) + sy;
 	TEKPen *pen = checkpenptr(L, 4);
 	TVisualPlot(vis->vis_Visual, x0, y0, pen->pen_Pen);
+	recordrect(L, vis, DLOP_PLOT, x0, y0, 0, 0, pen->pen_Pen);
 	return 0;
 }
 
@@ -496,6 +689,19 @@ tek_lib_visual_text(lua_State *L)
 	if (lua_isuserdata(L, 6))
 		bpen = ((TEKPen *) checkpenptr(L, 6))->pen_Pen;
 	TVisualText(vis->vis_Visual, x0, y0, text, tlen, fpen->pen_Pen, bpen);
+	if (vis->vis_Record)
+	{
+		TEKDisplayOp *op = tek_lib_visual_record(L, vis, DLOP_TEXT, 0);
+		if (op)
+		{
+			op->op_Args[0] = x0;
+			op->op_Args[1] = y0;
+			op->op_Pens[0] = fpen->pen_Pen;
+			op->op_Pens[1] = bpen;
+			op->op_Data = tek_lib_visual_recorddata(vis, text, tlen);
+			op->op_Length = tlen;
+		}
+	}
 	return 0;
 }
 
@@ -592,6 +798,11 @@ tek_lib_visual_drawimage(lua_State *L)
 	TINT sx = vis->vis_ShiftX, sy = vis->vis_ShiftY;
 	TTAGITEM tags[2];
 
+	if (lua_isuserdata(L, 2))
+		return tek_lib_visual_drawcompiled(L);
+
+	tek_lib_visual_recordfail(vis);
+
 	luaL_checktype(L, 2, LUA_TTABLE);
 
 	/* get rect */
@@ -924,6 +1135,8 @@ tek_lib_visual_setfont(lua_State *L)
 		/* s: vismeta */
 		lua_pop(L, 1);
 	}
+	if (font->font_Font)
+		tek_lib_visual_record(L, vis, DLOP_FONT, 2);
 	return 0;
 }
 
@@ -967,6 +1180,8 @@ tek_lib_visual_copyarea(lua_State *L)
 	TINT dx = luaL_checkinteger(L, 6) + sx;
 	TINT dy = luaL_checkinteger(L, 7) + sy;
 
+	tek_lib_visual_recordfail(vis);
+
 	if (lua_istable(L, 8))
 	{
 		vis->vis_RectBuffer = TNULL;
@@ -977,6 +1192,15 @@ tek_lib_visual_copyarea(lua_State *L)
 		tags[1].tti_Tag = TTAG_DONE;
 		tp = tags;
 	}
+	else if (lua_toboolean(L, 8))
+	{
+		/* collect asynchronously, see visual:getexposures(): */
+		tags[0].tti_Tag = TVisual_CollectExposures;
+		tags[0].tti_Value = TTRUE;
+		tags[1].tti_Tag = TTAG_DONE;
+		TVisualCopyArea(vis->vis_Visual, x, y, w, h, dx, dy, tags);
+		return 0;
+	}
 
 	TVisualCopyArea(vis->vis_Visual, x, y, w, h, dx, dy, tp);
 
@@ -995,8 +1219,75 @@ tek_lib_visual_copyarea(lua_State *L)
 	return 0;
 }
 
+/*
+**	table = visual:getexposures(): Returns a table of the raw coordinates
+**	of the rectangles exposed by copies which were issued with exposure
+**	collection enabled (x0, y0, x1, y1, x0, y0, ...), or nil if there are
+**	none. Exposures are retrieved only once.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_getexposures(lua_State *L)
+{
+	struct THook hook;
+	TEKVisual *vis = checkvisptr(L, 1);
+	TINT i;
+
+	vis->vis_RectBuffer = TNULL;
+	vis->vis_RectBufferNum = 0;
+	TInitHook(&hook, hookfunc, vis);
+	TVisualGetExposures(vis->vis_Visual, &hook);
+	if (vis->vis_RectBufferNum == 0)
+		return 0;
+
+	lua_createtable(L, vis->vis_RectBufferNum, 0);
+	for (i = 0; i < vis->vis_RectBufferNum; ++i)
+	{
+		lua_pushinteger(L, vis->vis_RectBuffer[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+	TExecFree(vis->vis_ExecBase, vis->vis_RectBuffer);
+	vis->vis_RectBuffer = TNULL;
+	return 1;
+}
+
 /*****************************************************************************/
 
+/*
+**	Make x, y, w, h the effective clipping rectangle of the visual, or
+**	remove clipping if clipped is false. The display driver is addressed
+**	only if this changes the effective clipping rectangle.
+*/
+
+static void
+setclip(lua_State *L, TEKVisual *vis, TBOOL clipped, TINT x, TINT y,
+	TINT w, TINT h)
+{
+	TINT *cr = vis->vis_ClipRect;
+	if (clipped)
+	{
+		TEKDisplayOp *op;
+		if (vis->vis_Clipped && cr[0] == x && cr[1] == y && cr[2] == w &&
+			cr[3] == h)
+			return;
+		TVisualSetClipRect(vis->vis_Visual, x, y, w, h, TNULL);
+		cr[0] = x;
+		cr[1] = y;
+		cr[2] = w;
+		cr[3] = h;
+		vis->vis_Clipped = TTRUE;
+		op = tek_lib_visual_record(L, vis, DLOP_CLIP, 0);
+		if (op)
+			memcpy(op->op_Args, cr, sizeof(TINT) * 4);
+	}
+	else if (vis->vis_Clipped)
+	{
+		TVisualUnsetClipRect(vis->vis_Visual);
+		vis->vis_Clipped = TFALSE;
+		tek_lib_visual_record(L, vis, DLOP_UNCLIP, 0);
+	}
+}
+
 LOCAL LUACFUNC TINT
 tek_lib_visual_setcliprect(lua_State *L)
 {
@@ -1005,7 +1296,7 @@ tek_lib_visual_setcliprect(lua_State *L)
 	TINT y = luaL_checkinteger(L, 3);
 	TINT w = luaL_checkinteger(L, 4);
 	TINT h = luaL_checkinteger(L, 5);
-	TVisualSetClipRect(vis->vis_Visual, x, y, w, h, TNULL);
+	setclip(L, vis, TTRUE, x, y, w, h);
 	return 0;
 }
 
@@ -1015,7 +1306,95 @@ LOCAL LUACFUNC TINT
 tek_lib_visual_unsetcliprect(lua_State *L)
 {
 	TEKVisual *vis = checkvisptr(L, 1);
-	TVisualUnsetClipRect(vis->vis_Visual);
+	setclip(L, vis, TFALSE, 0, 0, 0, 0);
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	visual:pushcliprect([x0, y0, x1, y1]): Pushes a rectangle, subject to
+**	the current shift, on the visual's stack of cliprects. The effective
+**	cliprect is its intersection with the cliprect below it, which is
+**	stored with the level, so that popping it takes constant time. If no
+**	rectangle is given, an unclipped level is pushed.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_pushcliprect(lua_State *L)
+{
+	TEKVisual *vis = checkvisptr(L, 1);
+	TEKClip *clip;
+
+	if (vis->vis_ClipDepth == vis->vis_ClipMax)
+	{
+		TINT n = TMAX(vis->vis_ClipMax * 2, VIS_MINCLIPS);
+		TEKClip *stack = vis->vis_ClipStack ?
+			TExecRealloc(vis->vis_ExecBase, vis->vis_ClipStack,
+				sizeof(TEKClip) * n) :
+			TExecAlloc(vis->vis_ExecBase, TNULL, sizeof(TEKClip) * n);
+		if (stack == TNULL)
+			luaL_error(L, "out of memory");
+		vis->vis_ClipStack = stack;
+		vis->vis_ClipMax = n;
+	}
+
+	clip = &vis->vis_ClipStack[vis->vis_ClipDepth++];
+	clip->clp_Clipped = !lua_isnoneornil(L, 2);
+	if (clip->clp_Clipped)
+	{
+		TINT sx = vis->vis_ShiftX, sy = vis->vis_ShiftY;
+		TINT x0 = luaL_checkinteger(L, 2) + sx;
+		TINT y0 = luaL_checkinteger(L, 3) + sy;
+		TINT x1 = luaL_checkinteger(L, 4) + sx;
+		TINT y1 = luaL_checkinteger(L, 5) + sy;
+		if (vis->vis_ClipDepth > 1 && clip[-1].clp_Clipped)
+		{
+			TINT *r = clip[-1].clp_Rect;
+			x0 = TMAX(x0, r[0]);
+			y0 = TMAX(y0, r[1]);
+			x1 = TMIN(x1, r[2]);
+			y1 = TMIN(y1, r[3]);
+			if (x0 > x1 || y0 > y1)
+				x0 = y0 = x1 = y1 = -1;
+		}
+		clip->clp_Rect[0] = x0;
+		clip->clp_Rect[1] = y0;
+		clip->clp_Rect[2] = x1;
+		clip->clp_Rect[3] = y1;
+		setclip(L, vis, TTRUE, x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+	}
+	else
+		setclip(L, vis, TFALSE, 0, 0, 0, 0);
+
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	visual:popcliprect(): Pops the topmost level from the visual's stack
+**	of cliprects, restoring the cliprect that was in effect before.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_popcliprect(lua_State *L)
+{
+	TEKVisual *vis = checkvisptr(L, 1);
+	TEKClip *clip;
+	if (vis->vis_ClipDepth == 0)
+		luaL_error(L, "cliprect stack underflow");
+	if (--vis->vis_ClipDepth == 0)
+	{
+		setclip(L, vis, TFALSE, 0, 0, 0, 0);
+		return 0;
+	}
+	clip = &vis->vis_ClipStack[vis->vis_ClipDepth - 1];
+	if (clip->clp_Clipped)
+	{
+		TINT *r = clip->clp_Rect;
+		setclip(L, vis, TTRUE, r[0], r[1], r[2] - r[0] + 1, r[3] - r[1] + 1);
+	}
+	else
+		setclip(L, vis, TFALSE, 0, 0, 0, 0);
 	return 0;
 }
 
@@ -1053,6 +1432,7 @@ tek_lib_visual_drawrgb(lua_State *L)
 	TINT bh = h * ph;
 
 	luaL_checktype(L, 4, LUA_TTABLE);
+	tek_lib_visual_recordfail(vis);
 
 	buf = TExecAlloc(vis->vis_ExecBase, TNULL, bw * bh * sizeof(TUINT));
 	if (buf)
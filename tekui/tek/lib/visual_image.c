@@ -0,0 +1,500 @@
+/*
+**	tek.lib.visual - compiled vector images
+**
+**	A vector image is described by a table of coordinates and a list of
+**	primitives referencing them by index; see visual_api.c. Compiling
+**	an image resolves the indices once and stores the coordinates of
+**	each primitive in sequence, normalized to the image's bounding box,
+**	along with the pen indices. The result is immutable; for drawing, it
+**	is scaled to the size of the target rectangle, and the scaled point
+**	arrays for the most recently used sizes are retained, so that
+**	drawing an image of a known size only requires translating it to its
+**	position. Furthermore, the display may keep the rendered image in a
+**	cache, keyed on the image, its size, and the pens used.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "visual_lua.h"
+
+/* Number of scaled point arrays retained per image: */
+#define IMG_NUMSCALED	4
+
+/*****************************************************************************/
+
+struct IMGPrim
+{
+	/* Format code: */
+	TINT p_Format;
+	/* Number of points: */
+	TINT p_NumPoints;
+	/* Index of the first point: */
+	TINT p_First;
+	/* Index of the first pen, or -1: */
+	TINT p_Pens;
+};
+
+struct IMGScaled
+{
+	TINT s_Width, s_Height;
+	TUINT s_Tick;
+	/* Points relative to the rectangle's lower left corner: */
+	TINT *s_Points;
+};
+
+typedef struct
+{
+	TEKVisual *img_VisBase;
+	/* Unique number, distinguishes images at recycled addresses: */
+	TUINT img_Serial;
+	TINT img_NumPrims;
+	struct IMGPrim *img_Prims;
+	/* Total number of points, max. number of points per primitive: */
+	TINT img_NumPoints;
+	TINT img_MaxPoints;
+	/* Normalized coordinates, two per point: */
+	lua_Number *img_Coords;
+	/* Pen indices, one per single-pen primitive or per point: */
+	TINT img_NumPens;
+	TINT *img_Pens;
+	/* Buffers for drawing a primitive, and for the resolved pens: */
+	TINT *img_DrawPoints;
+	TVPEN *img_DrawPens;
+	struct IMGScaled img_Scaled[IMG_NUMSCALED];
+	TUINT img_Tick;
+
+} TEKImage;
+
+#define checkimageptr(L, n) luaL_checkudata(L, n, TEK_LIB_VISUALIMAGE_CLASSNAME)
+
+/*****************************************************************************/
+
+static lua_Number
+igetnumber(lua_State *L, TINT index, TINT n)
+{
+	lua_Number result;
+	lua_rawgeti(L, index, n);
+	result = luaL_checknumber(L, -1);
+	lua_pop(L, 1);
+	return result;
+}
+
+static lua_Integer
+igetinteger(lua_State *L, TINT index, TINT n)
+{
+	lua_Integer result;
+	lua_rawgeti(L, index, n);
+	result = luaL_checkinteger(L, -1);
+	lua_pop(L, 1);
+	return result;
+}
+
+/*****************************************************************************/
+
+static TBOOL
+allocimage(TEKImage *img)
+{
+	TEKVisual *vis = img->img_VisBase;
+	TINT np = img->img_NumPoints;
+	TINT mp = img->img_MaxPoints;
+	TINT npens = TMAX(img->img_NumPens, 1);
+	img->img_Prims = TAlloc(TNULL,
+		sizeof(struct IMGPrim) * img->img_NumPrims);
+	img->img_Coords = TAlloc(TNULL, sizeof(lua_Number) * np * 2);
+	img->img_Pens = TAlloc(TNULL, sizeof(TINT) * npens);
+	img->img_DrawPoints = TAlloc(TNULL, sizeof(TINT) * mp * 2);
+	img->img_DrawPens = TAlloc(TNULL, sizeof(TVPEN) * npens);
+	return img->img_Prims && img->img_Coords && img->img_Pens &&
+		img->img_DrawPoints && img->img_DrawPens;
+}
+
+/*****************************************************************************/
+/*
+**	image = visual.compileimage(data)
+**	Compiles an image from a table in the format accepted by
+**	visual:drawimage(); see visual_api.c. Pens must be referenced by
+**	numeric indices into the pen table.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_compileimage(lua_State *L)
+{
+	TEKImage *img;
+	lua_Number minmax[4], xoffs, yoffs, xrange, yrange;
+	TINT i, j, n;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+
+	img = lua_newuserdata(L, sizeof(TEKImage));
+	/* s: image */
+	memset(img, 0, sizeof(TEKImage));
+	lua_getfield(L, LUA_REGISTRYINDEX, TEK_LIB_VISUAL_BASECLASSNAME);
+	img->img_VisBase = lua_touserdata(L, -1);
+	img->img_Serial = ++img->img_VisBase->vis_ImageSerial;
+	lua_pop(L, 1);
+	luaL_newmetatable(L, TEK_LIB_VISUALIMAGE_CLASSNAME);
+	lua_setmetatable(L, -2);
+
+	lua_getfield(L, 1, "MinMax");
+	luaL_checktype(L, -1, LUA_TTABLE);
+	/* s: image, minmax */
+	for (i = 0; i < 4; i++)
+		minmax[i] = igetnumber(L, -1, i + 1);
+	lua_pop(L, 1);
+
+	xoffs = minmax[0];
+	yoffs = minmax[1];
+	xrange = minmax[2] - xoffs;
+	yrange = minmax[3] - yoffs;
+	if (xrange == 0 || yrange == 0)
+		luaL_argerror(L, 1, "empty bounding box");
+
+	lua_getfield(L, 1, "Coords");
+	luaL_checktype(L, -1, LUA_TTABLE);
+	lua_getfield(L, 1, "Primitives");
+	luaL_checktype(L, -1, LUA_TTABLE);
+	/* s: image, coords, primitives */
+
+	/* count primitives and points: */
+	img->img_NumPrims = lua_objlen(L, -1);
+	for (i = 0; i < img->img_NumPrims; ++i)
+	{
+		lua_rawgeti(L, -1, i + 1);
+		luaL_checktype(L, -1, LUA_TTABLE);
+		n = igetinteger(L, -1, 2);
+		if (n < 0)
+			luaL_argerror(L, 1, "invalid number of points");
+		switch (igetinteger(L, -1, 1) & 0xf)
+		{
+			case 0x0:
+				img->img_NumPens++;
+				break;
+			case 0x1:
+				img->img_NumPens += n;
+				break;
+		}
+		img->img_NumPoints += n;
+		img->img_MaxPoints = TMAX(img->img_MaxPoints, n);
+		lua_pop(L, 1);
+	}
+
+	if (img->img_NumPoints == 0)
+	{
+		/* nothing to draw; no pen arrays are allocated either: */
+		img->img_NumPrims = 0;
+		img->img_NumPens = 0;
+		lua_pop(L, 2);
+		return 1;
+	}
+
+	if (!allocimage(img))
+		luaL_error(L, "out of memory");
+
+	img->img_NumPens = 0;
+	for (i = 0, n = 0; i < img->img_NumPrims; ++i)
+	{
+		struct IMGPrim *p = &img->img_Prims[i];
+
+		lua_rawgeti(L, -1, i + 1);
+		/* s: image, coords, primitives, primitives[i+1] */
+		p->p_Format = igetinteger(L, -1, 1);
+		p->p_NumPoints = igetinteger(L, -1, 2);
+		p->p_First = n;
+		p->p_Pens = -1;
+
+		lua_getfield(L, -1, "Points");
+		luaL_checktype(L, -1, LUA_TTABLE);
+		/* s: image, coords, primitives, primitives[i+1], points */
+		for (j = 0; j < p->p_NumPoints; ++j)
+		{
+			TINT pidx = igetinteger(L, -1, j + 1);
+			img->img_Coords[(n + j) * 2] =
+				(igetnumber(L, -4, pidx * 2 - 1) - xoffs) / xrange;
+			img->img_Coords[(n + j) * 2 + 1] =
+				(igetnumber(L, -4, pidx * 2) - yoffs) / yrange;
+		}
+		lua_pop(L, 1);
+
+		switch (p->p_Format & 0xf)
+		{
+			case 0x0:
+				lua_getfield(L, -1, "Pen");
+				p->p_Pens = img->img_NumPens;
+				img->img_Pens[img->img_NumPens++] = luaL_checkinteger(L, -1);
+				lua_pop(L, 1);
+				break;
+			case 0x1:
+				lua_getfield(L, -1, "Pens");
+				luaL_checktype(L, -1, LUA_TTABLE);
+				p->p_Pens = img->img_NumPens;
+				for (j = 0; j < p->p_NumPoints; ++j)
+					img->img_Pens[img->img_NumPens++] =
+						igetinteger(L, -1, j + 1);
+				lua_pop(L, 1);
+				break;
+		}
+
+		lua_pop(L, 1);
+		/* s: image, coords, primitives */
+		n += p->p_NumPoints;
+	}
+
+	lua_pop(L, 2);
+	/* s: image */
+	return 1;
+}
+
+/*****************************************************************************/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_freeimage(lua_State *L)
+{
+	TEKImage *img = checkimageptr(L, 1);
+	TEKVisual *vis = img->img_VisBase;
+	if (vis)
+	{
+		TINT i;
+		for (i = 0; i < IMG_NUMSCALED; ++i)
+			TFree(img->img_Scaled[i].s_Points);
+		TFree(img->img_Prims);
+		TFree(img->img_Coords);
+		TFree(img->img_Pens);
+		TFree(img->img_DrawPoints);
+		TFree(img->img_DrawPens);
+		img->img_VisBase = TNULL;
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	Get the image's points scaled to a rectangle of the given size,
+**	relative to its lower left corner. Retains the arrays for the most
+**	recently used sizes.
+*/
+
+static TINT *
+getscaled(TEKImage *img, TINT w, TINT h)
+{
+	TEKVisual *vis = img->img_VisBase;
+	struct IMGScaled *s = &img->img_Scaled[0];
+	TINT i;
+
+	for (i = 0; i < IMG_NUMSCALED; ++i)
+	{
+		struct IMGScaled *c = &img->img_Scaled[i];
+		if (c->s_Points && c->s_Width == w && c->s_Height == h)
+		{
+			c->s_Tick = ++img->img_Tick;
+			return c->s_Points;
+		}
+		if (c->s_Points == TNULL || c->s_Tick < s->s_Tick)
+			s = c;
+	}
+
+	/* not found, replace the least recently used: */
+	if (s->s_Points == TNULL)
+	{
+		s->s_Points = TAlloc(TNULL, sizeof(TINT) * img->img_NumPoints * 2);
+		if (s->s_Points == TNULL)
+			return TNULL;
+	}
+
+	for (i = 0; i < img->img_NumPoints; ++i)
+	{
+		s->s_Points[i * 2] = floor(img->img_Coords[i * 2] * w);
+		s->s_Points[i * 2 + 1] = floor(-img->img_Coords[i * 2 + 1] * h);
+	}
+	s->s_Width = w;
+	s->s_Height = h;
+	s->s_Tick = ++img->img_Tick;
+	return s->s_Points;
+}
+
+/*****************************************************************************/
+
+static TVPEN
+getpen(lua_State *L, TINT pentab, TINT idx)
+{
+	TEKPen *pen;
+	lua_rawgeti(L, pentab, idx);
+	pen = luaL_checkudata(L, -1, TEK_LIB_VISUALPEN_CLASSNAME);
+	lua_pop(L, 1);
+	return pen->pen_Pen;
+}
+
+/*****************************************************************************/
+
+static void
+drawprims(TEKVisual *vis, TEKImage *img, TINT *scaled, TINT ox, TINT oy)
+{
+	TTAGITEM tags[2];
+	TINT i, j;
+
+	for (i = 0; i < img->img_NumPrims; ++i)
+	{
+		struct IMGPrim *p = &img->img_Prims[i];
+		TINT *src = scaled + p->p_First * 2;
+		TINT *dst = img->img_DrawPoints;
+		TINT nump = p->p_NumPoints;
+
+		for (j = 0; j < nump; ++j)
+		{
+			dst[j * 2] = ox + src[j * 2];
+			dst[j * 2 + 1] = oy + src[j * 2 + 1];
+		}
+
+		tags[0].tti_Tag = TTAG_DONE;
+		switch (p->p_Format & 0xf)
+		{
+			case 0x0:
+				tags[0].tti_Tag = TVisual_Pen;
+				tags[0].tti_Value = (TTAG) img->img_DrawPens[p->p_Pens];
+				tags[1].tti_Tag = TTAG_DONE;
+				break;
+			case 0x1:
+				tags[0].tti_Tag = TVisual_PenArray;
+				tags[0].tti_Value = (TTAG) (img->img_DrawPens + p->p_Pens);
+				tags[1].tti_Tag = TTAG_DONE;
+				break;
+		}
+
+		switch (p->p_Format & 0xf000)
+		{
+			case 0x1000: /* Strip */
+			case 0x4000: /* Triangle */
+				TVisualDrawStrip(vis->vis_Visual, dst, nump, tags);
+				break;
+			case 0x2000: /* Fan */
+				TVisualDrawFan(vis->vis_Visual, dst, nump, tags);
+				break;
+		}
+	}
+}
+
+/*****************************************************************************/
+/*
+**	Draw a compiled image into the rectangle x0, y0, x1, y1 (with the
+**	shift already applied), using the given pens.
+*/
+
+LOCAL void
+tek_lib_visual_drawimagepens(TEKVisual *vis, TAPTR image, TINT x0, TINT y0,
+	TINT x1, TINT y1, TVPEN *pens)
+{
+	TEKImage *img = image;
+	struct { TEKImage *image; TUINT serial; } key;
+	TINT rect[4];
+	TINT *scaled;
+
+	if (img->img_NumPrims == 0)
+		return;
+
+	scaled = getscaled(img, x1 - x0, y1 - y0);
+	if (scaled == TNULL)
+		return;
+
+	if (pens != img->img_DrawPens)
+		memcpy(img->img_DrawPens, pens, sizeof(TVPEN) * img->img_NumPens);
+
+	memset(&key, 0, sizeof(key));
+	key.image = img;
+	key.serial = img->img_Serial;
+	rect[0] = x0;
+	rect[1] = y0;
+	rect[2] = x1 - x0 + 1;
+	rect[3] = y1 - y0 + 1;
+
+	switch (TVisualBeginImage(vis->vis_Visual, &key, sizeof(key),
+		img->img_DrawPens, img->img_NumPens, rect))
+	{
+		case 1:
+			/* drawn from cache */
+			break;
+		case 0:
+			/* render into the cache, relative to the rectangle: */
+			drawprims(vis, img, scaled, 0, y1 - y0);
+			TVisualEndImage(vis->vis_Visual);
+			break;
+		default:
+			drawprims(vis, img, scaled, x0, y1);
+			break;
+	}
+}
+
+/*****************************************************************************/
+/*
+**	visual:drawimage(image, x0, y0, x1, y1, pentable)
+**	Draws a compiled image into the specified rectangle, using pens
+**	from the given table.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_drawcompiled(lua_State *L)
+{
+	TEKVisual *vis = luaL_checkudata(L, 1, TEK_LIB_VISUAL_CLASSNAME);
+	TEKImage *img = checkimageptr(L, 2);
+	TINT sx = vis->vis_ShiftX, sy = vis->vis_ShiftY;
+	TINT x0 = luaL_checkinteger(L, 3) + sx;
+	TINT y0 = luaL_checkinteger(L, 4) + sy;
+	TINT x1 = luaL_checkinteger(L, 5) + sx;
+	TINT y1 = luaL_checkinteger(L, 6) + sy;
+	TINT i;
+
+	luaL_checktype(L, 7, LUA_TTABLE);
+
+	if (img->img_VisBase == TNULL)
+		luaL_argerror(L, 2, "Closed handle");
+
+	for (i = 0; i < img->img_NumPens; ++i)
+		img->img_DrawPens[i] = getpen(L, 7, img->img_Pens[i]);
+
+	tek_lib_visual_drawimagepens(vis, img, x0, y0, x1, y1,
+		img->img_DrawPens);
+
+	if (vis->vis_Record)
+	{
+		TEKDisplayOp *op = tek_lib_visual_record(L, vis, DLOP_IMAGE, 2);
+		if (op)
+		{
+			op->op_Args[0] = x0;
+			op->op_Args[1] = y0;
+			op->op_Args[2] = x1;
+			op->op_Args[3] = y1;
+			op->op_Data = tek_lib_visual_recorddata(vis, img->img_DrawPens,
+				sizeof(TVPEN) * img->img_NumPens);
+		}
+	}
+
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	hits, misses, bytes = visual:getimagecache()
+**	Returns the number of hits and misses in the display's cache of
+**	rendered images, and the number of bytes occupied by it.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_getimagecache(lua_State *L)
+{
+	TEKVisual *vis = luaL_checkudata(L, 1, TEK_LIB_VISUAL_CLASSNAME);
+	TUINT hits = 0, misses = 0;
+	TSIZE bytes = 0;
+	TTAGITEM tags[4];
+
+	tags[0].tti_Tag = TVisual_ImageCacheHits;
+	tags[0].tti_Value = (TTAG) &hits;
+	tags[1].tti_Tag = TVisual_ImageCacheMisses;
+	tags[1].tti_Value = (TTAG) &misses;
+	tags[2].tti_Tag = TVisual_ImageCacheBytes;
+	tags[2].tti_Value = (TTAG) &bytes;
+	tags[3].tti_Tag = TTAG_DONE;
+	TVisualGetAttrs(vis->vis_Visual, tags);
+
+	lua_pushinteger(L, hits);
+	lua_pushinteger(L, misses);
+	lua_pushinteger(L, bytes);
+	return 3;
+}
@@ -0,0 +1,651 @@
+/*
+**	tek.lib.visual - text layout
+**
+**	A text layout breaks a text into lines of a given width. The text is
+**	split into words and line breaks once, when it is set, and word
+**	widths are looked up in a cache per layout, so that each distinct
+**	word is measured only once. Lines are described by offsets into the
+**	text rather than by copies of it, and a layout for a different width
+**	is computed in a single pass over the words. When the text changes,
+**	words and lines up to the paragraph containing the first change are
+**	retained.
+**
+**	Alternatively, the text can be taken from a file, which is mapped into
+**	memory. Such a layout can be computed in steps of a limited number of
+**	bytes, so that large files can be displayed while they are processed.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "visual_lua.h"
+
+/* Initial number of words, lines, and cache slots: */
+#define TL_MINWORDS		256
+#define TL_MINLINES		64
+#define TL_MINHASH		256
+
+/*****************************************************************************/
+
+struct TLWord
+{
+	/* Offset into the text: */
+	TUINT w_Offs;
+	/* Length, 0 for a line break: */
+	TUINT w_Len;
+	TINT w_Width;
+};
+
+struct TLLine
+{
+	/* Index of the first word: */
+	TINT l_First;
+	/* Number of words in the line: */
+	TINT l_NumWords;
+	/* Index of the word following the line, including a line break: */
+	TINT l_Next;
+	TINT l_Width;
+};
+
+struct TLCacheEntry
+{
+	struct TLCacheEntry *ce_Next;
+	TUINT ce_Hash;
+	TUINT ce_Len;
+	TINT ce_Width;
+	/* followed by the word */
+};
+
+typedef struct
+{
+	TEKVisual *tl_VisBase;
+	TEKFont *tl_Font;
+	/* Text, referenced in the environment of the layout, or mapped: */
+	const char *tl_Text;
+	size_t tl_TextLen;
+	/* Memory-mapped file, or TNULL: */
+	TAPTR tl_Map;
+	/* Number of bytes of text split into words: */
+	size_t tl_Scanned;
+	struct TLWord *tl_Words;
+	TINT tl_NumWords, tl_MaxWords;
+	struct TLLine *tl_Lines;
+	TINT tl_NumLines, tl_MaxLines;
+	/* Width of the last layout, or -1: */
+	TINT tl_Width;
+	/* Index of the first word not covered by valid lines: */
+	TINT tl_Dirty;
+	/* Text changed since the last layout: */
+	TBOOL tl_Changed;
+	TINT tl_SpaceWidth;
+	TINT tl_MinWidth;
+	/* Widths of characters, for words consisting of 7-bit characters: */
+	TINT tl_CharWidth[128];
+	/* Word width cache: */
+	struct TLCacheEntry **tl_Hash;
+	TUINT tl_HashSize, tl_NumCached;
+	/* Buffer for zero-terminating words: */
+	char *tl_Buf;
+	TUINT tl_BufSize;
+
+} TEKTextLayout;
+
+#define checklayoutptr(L, n) \
+	((TEKTextLayout *) luaL_checkudata(L, n, TEK_LIB_VISUALLAYOUT_CLASSNAME))
+
+/*****************************************************************************/
+
+static TAPTR growbuf(TEKVisual *vis, TAPTR buf, TUINT size)
+{
+	return buf ? TRealloc(buf, size) : TAlloc(TNULL, size);
+}
+
+static TINT measure(lua_State *L, TEKTextLayout *tl, const char *s, TUINT len)
+{
+	TEKVisual *vis = tl->tl_VisBase;
+	TEKFont *font = tl->tl_Font;
+	if (font->font_Font == TNULL)
+		luaL_error(L, "font closed");
+	if (len + 1 > tl->tl_BufSize)
+	{
+		char *buf = growbuf(vis, tl->tl_Buf, len + 1);
+		if (buf == TNULL)
+			luaL_error(L, "out of memory");
+		tl->tl_Buf = buf;
+		tl->tl_BufSize = len + 1;
+	}
+	memcpy(tl->tl_Buf, s, len);
+	tl->tl_Buf[len] = 0;
+	return TVisualTextSize(font->font_VisBase, font->font_Font,
+		(TSTRPTR) tl->tl_Buf);
+}
+
+static void rehash(lua_State *L, TEKTextLayout *tl)
+{
+	TEKVisual *vis = tl->tl_VisBase;
+	TUINT size = tl->tl_HashSize ? tl->tl_HashSize * 2 : TL_MINHASH;
+	struct TLCacheEntry **hash =
+		TAlloc0(TNULL, size * sizeof(struct TLCacheEntry *));
+	TUINT i;
+	if (hash == TNULL)
+		luaL_error(L, "out of memory");
+	for (i = 0; i < tl->tl_HashSize; ++i)
+	{
+		struct TLCacheEntry *e, *next;
+		for (e = tl->tl_Hash[i]; e; e = next)
+		{
+			next = e->ce_Next;
+			e->ce_Next = hash[e->ce_Hash & (size - 1)];
+			hash[e->ce_Hash & (size - 1)] = e;
+		}
+	}
+	TFree(tl->tl_Hash);
+	tl->tl_Hash = hash;
+	tl->tl_HashSize = size;
+}
+
+static TINT wordwidth(lua_State *L, TEKTextLayout *tl, const char *s,
+	TUINT len)
+{
+	TEKVisual *vis = tl->tl_VisBase;
+	struct TLCacheEntry *e;
+	TUINT h = 2166136261U;
+	TUINT i;
+
+	/* font widths are additive, so a 7-bit word is the sum of its
+	** characters, which are each measured only once: */
+	for (i = 0; i < len && (TUINT8) s[i] < 128; ++i);
+	if (i == len)
+	{
+		TINT w = 0;
+		for (i = 0; i < len; ++i)
+		{
+			TINT *cw = &tl->tl_CharWidth[(TUINT8) s[i]];
+			if (*cw < 0)
+				*cw = measure(L, tl, s + i, 1);
+			w += *cw;
+		}
+		return w;
+	}
+
+	for (i = 0; i < len; ++i)
+		h = (h ^ (TUINT8) s[i]) * 16777619U;
+
+	if (tl->tl_HashSize)
+	{
+		for (e = tl->tl_Hash[h & (tl->tl_HashSize - 1)]; e; e = e->ce_Next)
+			if (e->ce_Hash == h && e->ce_Len == len &&
+				memcmp(e + 1, s, len) == 0)
+				return e->ce_Width;
+	}
+
+	if (tl->tl_NumCached >= tl->tl_HashSize)
+		rehash(L, tl);
+
+	e = TAlloc(TNULL, sizeof(struct TLCacheEntry) + len);
+	if (e == TNULL)
+		luaL_error(L, "out of memory");
+	e->ce_Hash = h;
+	e->ce_Len = len;
+	e->ce_Width = measure(L, tl, s, len);
+	memcpy(e + 1, s, len);
+	e->ce_Next = tl->tl_Hash[h & (tl->tl_HashSize - 1)];
+	tl->tl_Hash[h & (tl->tl_HashSize - 1)] = e;
+	tl->tl_NumCached++;
+	return e->ce_Width;
+}
+
+static void addword(lua_State *L, TEKTextLayout *tl, TUINT offs, TUINT len,
+	TINT width)
+{
+	struct TLWord *w;
+	if (tl->tl_NumWords == tl->tl_MaxWords)
+	{
+		TEKVisual *vis = tl->tl_VisBase;
+		TINT max = TMAX(tl->tl_MaxWords * 2, TL_MINWORDS);
+		struct TLWord *words = growbuf(vis, tl->tl_Words,
+			max * sizeof(struct TLWord));
+		if (words == TNULL)
+			luaL_error(L, "out of memory");
+		tl->tl_Words = words;
+		tl->tl_MaxWords = max;
+	}
+	w = &tl->tl_Words[tl->tl_NumWords++];
+	w->w_Offs = offs;
+	w->w_Len = len;
+	w->w_Width = width;
+	tl->tl_MinWidth = TMAX(tl->tl_MinWidth, width);
+}
+
+static void addline(lua_State *L, TEKTextLayout *tl, TINT first, TINT nw,
+	TINT next, TINT width)
+{
+	struct TLLine *l;
+	if (tl->tl_NumLines == tl->tl_MaxLines)
+	{
+		TEKVisual *vis = tl->tl_VisBase;
+		TINT max = TMAX(tl->tl_MaxLines * 2, TL_MINLINES);
+		struct TLLine *lines = growbuf(vis, tl->tl_Lines,
+			max * sizeof(struct TLLine));
+		if (lines == TNULL)
+			luaL_error(L, "out of memory");
+		tl->tl_Lines = lines;
+		tl->tl_MaxLines = max;
+	}
+	l = &tl->tl_Lines[tl->tl_NumLines++];
+	l->l_First = first;
+	l->l_NumWords = nw;
+	l->l_Next = next;
+	l->l_Width = width;
+}
+
+static TBOOL isspc(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/*
+**	Split the text into words, from where the last call stopped, until
+**	the given position is reached. Words are not split.
+*/
+
+static void scan(lua_State *L, TEKTextLayout *tl, size_t limit)
+{
+	const char *s = tl->tl_Text;
+	size_t len = tl->tl_TextLen;
+	size_t p = tl->tl_Scanned;
+	limit = TMIN(limit, len);
+	while (p < limit)
+	{
+		if (s[p] == '\n')
+			addword(L, tl, p++, 0, 0);
+		else if (isspc(s[p]))
+			p++;
+		else
+		{
+			size_t e = p;
+			while (e < len && !isspc(s[e]))
+				e++;
+			addword(L, tl, p, e - p, wordwidth(L, tl, s + p, e - p));
+			p = e;
+		}
+	}
+	tl->tl_Scanned = p;
+}
+
+static void unmap(TEKTextLayout *tl)
+{
+	if (tl->tl_Map)
+	{
+		munmap(tl->tl_Map, tl->tl_TextLen);
+		tl->tl_Map = TNULL;
+	}
+}
+
+static struct TLLine *checkline(lua_State *L, TEKTextLayout *tl, int narg)
+{
+	TINT lnr = luaL_checkinteger(L, narg);
+	if (lnr < 1 || lnr > tl->tl_NumLines)
+		luaL_argerror(L, narg, "line out of range");
+	return &tl->tl_Lines[lnr - 1];
+}
+
+/*****************************************************************************/
+/*
+**	layout = textlayout(font): Creates a text layout for the given font.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_textlayout(lua_State *L)
+{
+	TEKFont *font = luaL_checkudata(L, 1, TEK_LIB_VISUALFONT_CLASSNAME);
+	TEKTextLayout *tl = lua_newuserdata(L, sizeof(TEKTextLayout));
+	TINT i;
+	/* s: layout */
+	memset(tl, 0, sizeof(TEKTextLayout));
+	tl->tl_Width = -1;
+	for (i = 0; i < 128; ++i)
+		tl->tl_CharWidth[i] = -1;
+
+	lua_getfield(L, LUA_REGISTRYINDEX, TEK_LIB_VISUAL_BASECLASSNAME);
+	tl->tl_VisBase = lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	tl->tl_Font = font;
+
+	luaL_newmetatable(L, TEK_LIB_VISUALLAYOUT_CLASSNAME);
+	/* s: layout, meta */
+	lua_setmetatable(L, -2);
+	/* s: layout */
+
+	/* reference font and text in the environment: */
+	lua_createtable(L, 2, 0);
+	/* s: layout, env */
+	lua_pushvalue(L, 1);
+	lua_rawseti(L, -2, 1);
+	lua_setfenv(L, -2);
+	/* s: layout */
+
+	tl->tl_SpaceWidth = measure(L, tl, " ", 1);
+	return 1;
+}
+
+/*****************************************************************************/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_freelayout(lua_State *L)
+{
+	TEKTextLayout *tl = checklayoutptr(L, 1);
+	TEKVisual *vis = tl->tl_VisBase;
+	if (vis)
+	{
+		TUINT i;
+		for (i = 0; i < tl->tl_HashSize; ++i)
+		{
+			struct TLCacheEntry *e, *next;
+			for (e = tl->tl_Hash[i]; e; e = next)
+			{
+				next = e->ce_Next;
+				TFree(e);
+			}
+		}
+		TFree(tl->tl_Hash);
+		TFree(tl->tl_Words);
+		TFree(tl->tl_Lines);
+		TFree(tl->tl_Buf);
+		unmap(tl);
+		tl->tl_VisBase = TNULL;
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	minwidth = layout:settext(text): Sets the text of the layout, and
+**	returns the width of its longest word. Words and lines preceding the
+**	paragraph with the first change are retained.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_settext(lua_State *L)
+{
+	TEKTextLayout *tl = checklayoutptr(L, 1);
+	size_t len, p = 0, d = 0;
+	const char *s = luaL_checklstring(L, 2, &len);
+	TINT k = 0, i;
+
+	if (tl->tl_VisBase == TNULL)
+		luaL_argerror(L, 1, "Closed handle");
+
+	if (tl->tl_Text)
+	{
+		/* retain words in front of the first change, up to and
+		** including the last line break before it: */
+		size_t n = TMIN(len, tl->tl_TextLen);
+		while (d < n && s[d] == tl->tl_Text[d])
+			d++;
+		if (d == len && len == tl->tl_TextLen && tl->tl_Map == TNULL)
+		{
+			lua_pushinteger(L, tl->tl_MinWidth);
+			return 1;
+		}
+		for (i = 0; i < tl->tl_NumWords; ++i)
+		{
+			struct TLWord *w = &tl->tl_Words[i];
+			if (w->w_Offs + w->w_Len >= d)
+				break;
+			if (w->w_Len == 0)
+			{
+				k = i + 1;
+				p = w->w_Offs + 1;
+			}
+		}
+	}
+
+	unmap(tl);
+	lua_getfenv(L, 1);
+	lua_pushvalue(L, 2);
+	lua_rawseti(L, -2, 2);
+	lua_pop(L, 1);
+	tl->tl_Text = s;
+	tl->tl_TextLen = len;
+
+	tl->tl_NumWords = k;
+	tl->tl_Dirty = TMIN(tl->tl_Dirty, k);
+	tl->tl_Changed = TTRUE;
+
+	tl->tl_MinWidth = 0;
+	for (i = 0; i < k; ++i)
+		tl->tl_MinWidth = TMAX(tl->tl_MinWidth, tl->tl_Words[i].w_Width);
+
+	tl->tl_Scanned = p;
+	scan(L, tl, len);
+
+	lua_pushinteger(L, tl->tl_MinWidth);
+	return 1;
+}
+
+/*****************************************************************************/
+/*
+**	success[, errmsg] = layout:setfile(path): Sets the text of the layout
+**	to the contents of a file, which is mapped into memory. The file is
+**	processed by subsequent calls to layout:layout().
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_setfile(lua_State *L)
+{
+	TEKTextLayout *tl = checklayoutptr(L, 1);
+	const char *path = luaL_checkstring(L, 2);
+	TAPTR map = TNULL;
+	struct stat st;
+	int fd;
+
+	if (tl->tl_VisBase == TNULL)
+		luaL_argerror(L, 1, "Closed handle");
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0)
+	{
+		int err = errno;
+		if (fd >= 0)
+			close(fd);
+		lua_pushnil(L);
+		lua_pushfstring(L, "%s: %s", path, strerror(err));
+		return 2;
+	}
+	if (st.st_size > 0)
+	{
+		map = mmap(TNULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED)
+		{
+			int err = errno;
+			close(fd);
+			lua_pushnil(L);
+			lua_pushfstring(L, "%s: %s", path, strerror(err));
+			return 2;
+		}
+		madvise(map, st.st_size, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	unmap(tl);
+	lua_getfenv(L, 1);
+	lua_pushnil(L);
+	lua_rawseti(L, -2, 2);
+	lua_pop(L, 1);
+
+	tl->tl_Map = map;
+	tl->tl_Text = map ? map : "";
+	tl->tl_TextLen = map ? st.st_size : 0;
+	tl->tl_Scanned = 0;
+	tl->tl_NumWords = 0;
+	tl->tl_NumLines = 0;
+	tl->tl_Dirty = 0;
+	tl->tl_Changed = TTRUE;
+	tl->tl_MinWidth = 0;
+
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+/*****************************************************************************/
+/*
+**	numlines, first, done = layout:layout(width[, step]): Breaks the text
+**	into lines of the given width. Returns the number of lines, the number
+**	of the first line that has changed, or false if no lines have changed,
+**	and a boolean indicating that the whole text is processed. If step is
+**	given, at most about this number of bytes of text which have not been
+**	processed before are taken into account, and the last paragraph may be
+**	incomplete; otherwise, the whole text is processed.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_layout(lua_State *L)
+{
+	TEKTextLayout *tl = checklayoutptr(L, 1);
+	TINT width = luaL_checkinteger(L, 2);
+	TINT ws = tl->tl_SpaceWidth;
+	TINT i, first, nw = 0, tw = 0, so = 0;
+	TBOOL done;
+
+	if (lua_isnoneornil(L, 3))
+		scan(L, tl, tl->tl_TextLen);
+	else
+		scan(L, tl, tl->tl_Scanned + luaL_checkinteger(L, 3));
+	done = tl->tl_Scanned == tl->tl_TextLen;
+
+	if (width != tl->tl_Width)
+	{
+		tl->tl_NumLines = 0;
+		tl->tl_Dirty = 0;
+		tl->tl_Width = width;
+	}
+	else if (!tl->tl_Changed)
+	{
+		lua_pushinteger(L, tl->tl_NumLines);
+		lua_pushboolean(L, 0);
+		lua_pushboolean(L, done);
+		return 3;
+	}
+
+	/* drop lines from the first invalid word: */
+	while (tl->tl_NumLines > 0 &&
+		tl->tl_Lines[tl->tl_NumLines - 1].l_Next > tl->tl_Dirty)
+		tl->tl_NumLines--;
+	lua_pushinteger(L, tl->tl_NumLines + 1);
+	/* s: firstline */
+
+	first = i = tl->tl_NumLines > 0 ?
+		tl->tl_Lines[tl->tl_NumLines - 1].l_Next : 0;
+	for (; i < tl->tl_NumWords; ++i)
+	{
+		struct TLWord *w = &tl->tl_Words[i];
+		if (w->w_Len == 0)
+		{
+			addline(L, tl, first, nw, i + 1, tw + so);
+			first = i + 1;
+			nw = tw = so = 0;
+			continue;
+		}
+		tw += w->w_Width;
+		if (tw + so > width)
+		{
+			if (nw > 0)
+			{
+				addline(L, tl, first, nw, i, tw - w->w_Width + so);
+				first = i;
+			}
+			nw = so = 0;
+			tw = w->w_Width;
+		}
+		nw++;
+		so += ws;
+	}
+	if (done)
+	{
+		if (nw > 0)
+			addline(L, tl, first, nw, i, tw + so);
+		tl->tl_Dirty = tl->tl_NumWords;
+		tl->tl_Changed = TFALSE;
+	}
+	else
+	{
+		/* the last paragraph may continue; lay it out again next time: */
+		tl->tl_Dirty = first;
+	}
+
+	lua_pushinteger(L, tl->tl_NumLines);
+	lua_insert(L, -2);
+	lua_pushboolean(L, done);
+	return 3;
+}
+
+/*****************************************************************************/
+/*
+**	offs, len, width = layout:getline(lnr): Returns the position of a line
+**	in the text, its length in bytes, and its width in pixels.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_getline(lua_State *L)
+{
+	TEKTextLayout *tl = checklayoutptr(L, 1);
+	struct TLLine *l = checkline(L, tl, 2);
+	struct TLWord *w = &tl->tl_Words[l->l_First];
+	if (l->l_NumWords > 0)
+	{
+		struct TLWord *e = w + l->l_NumWords - 1;
+		lua_pushinteger(L, w->w_Offs + 1);
+		lua_pushinteger(L, e->w_Offs + e->w_Len - w->w_Offs);
+	}
+	else
+	{
+		lua_pushinteger(L, l->l_First < tl->tl_NumWords ?
+			w->w_Offs + 1 : (TINT) tl->tl_TextLen + 1);
+		lua_pushinteger(L, 0);
+	}
+	lua_pushinteger(L, l->l_Width);
+	return 3;
+}
+
+/*****************************************************************************/
+/*
+**	text = layout:gettext(lnr): Returns the text of a line, with its words
+**	separated by single spaces, or nil if the line is empty.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_gettext(lua_State *L)
+{
+	TEKTextLayout *tl = checklayoutptr(L, 1);
+	struct TLLine *l = checkline(L, tl, 2);
+	struct TLWord *w = &tl->tl_Words[l->l_First];
+	luaL_Buffer b;
+	TINT i;
+
+	if (l->l_NumWords == 0)
+		return 0;
+
+	luaL_buffinit(L, &b);
+	for (i = 0; i < l->l_NumWords; ++i, ++w)
+	{
+		if (i > 0)
+			luaL_addchar(&b, ' ');
+		luaL_addlstring(&b, tl->tl_Text + w->w_Offs, w->w_Len);
+	}
+	luaL_pushresult(&b);
+	return 1;
+}
+
+/*****************************************************************************/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_getnumlines(lua_State *L)
+{
+	TEKTextLayout *tl = checklayoutptr(L, 1);
+	lua_pushinteger(L, tl->tl_NumLines);
+	return 1;
+}
@@ -37,6 +37,8 @@ static const luaL_Reg libfuncs[] =
 	{ "closefont", tek_lib_visual_closefont },
 	{ "textsize", tek_lib_visual_textsize_font },
 	{ "gettime", tek_lib_visual_gettime },
+	{ "textlayout", tek_lib_visual_textlayout },
+	{ "compileimage", tek_lib_visual_compileimage },
 	{ TNULL, TNULL }
 };
 
@@ -61,10 +63,22 @@ static const luaL_Reg classmethods[] =
 	{ "textsize", tek_lib_visual_textsize_visual },
 	{ "setfont", tek_lib_visual_setfont },
 	{ "copyarea", tek_lib_visual_copyarea },
+	{ "getexposures", tek_lib_visual_getexposures },
 	{ "setcliprect", tek_lib_visual_setcliprect },
 	{ "unsetcliprect", tek_lib_visual_unsetcliprect },
+	{ "pushcliprect", tek_lib_visual_pushcliprect },
+	{ "popcliprect", tek_lib_visual_popcliprect },
 	{ "setshift", tek_lib_visual_setshift },
 	{ "drawrgb", tek_lib_visual_drawrgb },
+	{ "allocpixmap", tek_lib_visual_allocpixmap },
+	{ "freepixmap", tek_lib_visual_freepixmap },
+	{ "settarget", tek_lib_visual_settarget },
+	{ "drawpixmap", tek_lib_visual_drawpixmap },
+	{ "drawninepatch", tek_lib_visual_drawninepatch },
+	{ "getimagecache", tek_lib_visual_getimagecache },
+	{ "beginrecord", tek_lib_visual_beginrecord },
+	{ "endrecord", tek_lib_visual_endrecord },
+	{ "replay", tek_lib_visual_replay },
 	{ TNULL, TNULL }
 };
 
@@ -76,6 +90,36 @@ static const luaL_Reg fontmethods[] =
 	{ TNULL, TNULL }
 };
 
+static const luaL_Reg layoutmethods[] =
+{
+	{ "__gc", tek_lib_visual_freelayout },
+	{ "settext", tek_lib_visual_settext },
+	{ "setfile", tek_lib_visual_setfile },
+	{ "layout", tek_lib_visual_layout },
+	{ "getline", tek_lib_visual_getline },
+	{ "gettext", tek_lib_visual_gettext },
+	{ "getnumlines", tek_lib_visual_getnumlines },
+	{ TNULL, TNULL }
+};
+
+static const luaL_Reg pixmapmethods[] =
+{
+	{ "__gc", tek_lib_visual_collectpixmap },
+	{ TNULL, TNULL }
+};
+
+static const luaL_Reg imagemethods[] =
+{
+	{ "__gc", tek_lib_visual_freeimage },
+	{ TNULL, TNULL }
+};
+
+static const luaL_Reg displaylistmethods[] =
+{
+	{ "__gc", tek_lib_visual_freedisplaylist },
+	{ TNULL, TNULL }
+};
+
 /*****************************************************************************/
 /*
 **	visual_open { args }
@@ -136,6 +180,12 @@ tek_lib_visual_open(lua_State *L)
 	vis->vis_ShiftX = 0;
 	vis->vis_ShiftY = 0;
 	vis->vis_Display = visbase->vis_Display;
+	vis->vis_Clipped = TFALSE;
+	vis->vis_ClipStack = TNULL;
+	vis->vis_ClipDepth = 0;
+	vis->vis_ClipMax = 0;
+	vis->vis_Record = TNULL;
+	vis->vis_refRecord = -1;
 
 	/* place ref to base in metatable: */
 	vis->vis_refBase = luaL_ref(L, -2);
@@ -251,6 +301,20 @@ tek_lib_visual_close(lua_State *L)
 	TFree(vis->vis_RectBuffer);
 	vis->vis_RectBuffer = TNULL;
 
+	TFree(vis->vis_ClipStack);
+	vis->vis_ClipStack = TNULL;
+	vis->vis_ClipDepth = 0;
+	vis->vis_ClipMax = 0;
+
+	vis->vis_Record = TNULL;
+	if (vis->vis_refRecord >= 0)
+	{
+		lua_getmetatable(L, 1);
+		luaL_unref(L, -1, vis->vis_refRecord);
+		vis->vis_refRecord = -1;
+		lua_pop(L, 1);
+	}
+
 	if (vis->vis_refBase >= 0)
 	{
 		lua_getmetatable(L, 1);
@@ -326,6 +390,7 @@ int luaopen_tek_lib_visual(lua_State *L)
 	vis->vis_ExecBase = exec;
 	vis->vis_Visual = TNULL;
 	vis->vis_refBase = -1;
+	vis->vis_refRecord = -1;
 	vis->vis_isBase = TTRUE;
 
 	/* register base: */
@@ -365,6 +430,34 @@ int luaopen_tek_lib_visual(lua_State *L)
 	luaL_register(L, NULL, fontmethods);
 	lua_pop(L, 1);
 
+	/* prepare text layout metatable: */
+	luaL_newmetatable(L, TEK_LIB_VISUALLAYOUT_CLASSNAME);
+	/* s: layoutmeta */
+	lua_pushvalue(L, -1);
+	/* s: layoutmeta, layoutmeta */
+	lua_setfield(L, -2, "__index");
+	/* s: layoutmeta */
+	luaL_register(L, NULL, layoutmethods);
+	lua_pop(L, 1);
+
+	/* prepare pixmap metatable: */
+	luaL_newmetatable(L, TEK_LIB_VISUALPIXMAP_CLASSNAME);
+	/* s: pixmapmeta */
+	luaL_register(L, NULL, pixmapmethods);
+	lua_pop(L, 1);
+
+	/* prepare compiled image metatable: */
+	luaL_newmetatable(L, TEK_LIB_VISUALIMAGE_CLASSNAME);
+	/* s: imagemeta */
+	luaL_register(L, NULL, imagemethods);
+	lua_pop(L, 1);
+
+	/* prepare display list metatable: */
+	luaL_newmetatable(L, TEK_LIB_VISUALDISPLAYLIST_CLASSNAME);
+	/* s: displaylistmeta */
+	luaL_register(L, NULL, displaylistmethods);
+	lua_pop(L, 1);
+
 	/* Add visual module to TEKlib's internal module list: */
 	TAddModules((struct TModInitNode *) &im_visual, 0);
 
@@ -377,8 +470,11 @@ int luaopen_tek_lib_visual(lua_State *L)
 		vis->vis_TimeBase = TOpenModule("time", 0, TNULL);
 		if (vis->vis_TimeBase == TNULL) break;
 
-		/* Create a timerequest: */
-		vis->vis_TimeRequest = TAllocTimeRequest(TNULL);
+		/* Create a timerequest on the monotonic clock: */
+		dtags[0].tti_Tag = TTimeRequest_Monotonic;
+		dtags[0].tti_Value = TTRUE;
+		dtags[1].tti_Tag = TTAG_DONE;
+		vis->vis_TimeRequest = TAllocTimeRequest(dtags);
 		if (vis->vis_TimeRequest == TNULL) break;
 
 		/* Open the Visual module: */
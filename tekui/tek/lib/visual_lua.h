@@ -39,6 +39,57 @@ typedef struct
 
 } TEKDrawdata;
 
+/* Display list operations: */
+#define DLOP_FONT		1
+#define DLOP_CLIP		2
+#define DLOP_UNCLIP		3
+#define DLOP_RECT		4
+#define DLOP_FRECT		5
+#define DLOP_LINE		6
+#define DLOP_PLOT		7
+#define DLOP_TEXT		8
+#define DLOP_PIXMAP		9
+#define DLOP_NINEPATCH	10
+#define DLOP_IMAGE		11
+
+typedef struct
+{
+	TINT op_Code;
+	/* Coordinates, with the shift applied: */
+	TINT op_Args[8];
+	TVPEN op_Pens[2];
+	/* Referenced object (font, pixmap, image), kept by the list: */
+	TAPTR op_Object;
+	/* Data owned by the operation (text, pens), and its length: */
+	TAPTR op_Data;
+	TINT op_Length;
+
+} TEKDisplayOp;
+
+typedef struct
+{
+	struct TEKVisual *dl_VisBase;
+	/* Visual the list was recorded in: */
+	struct TEKVisual *dl_Visual;
+	TINT dl_NumOps, dl_MaxOps;
+	TEKDisplayOp *dl_Ops;
+	/* An operation could not be recorded: */
+	TBOOL dl_Failed;
+
+} TEKDisplayList;
+
+/* Initial number of levels in a visual's cliprect stack: */
+#define VIS_MINCLIPS	16
+
+typedef struct
+{
+	/* Effective cliprect at this level (x0, y0, x1, y1): */
+	TINT clp_Rect[4];
+	/* Level is clipped: */
+	TBOOL clp_Clipped;
+
+} TEKClip;
+
 typedef struct TEKVisual
 {
 	/* Visualbase: */
@@ -75,6 +126,21 @@ typedef struct TEKVisual
 	TINT vis_RectBufferNum;
 	TINT *vis_RectBuffer;
 
+	/* Last serial number assigned to a compiled image (base only): */
+	TUINT vis_ImageSerial;
+
+	/* Current clipping rectangle (x, y, w, h), if set: */
+	TINT vis_ClipRect[4];
+	TBOOL vis_Clipped;
+
+	/* Stack of cliprects, see visual:pushcliprect(): */
+	TEKClip *vis_ClipStack;
+	TINT vis_ClipDepth, vis_ClipMax;
+
+	/* Display list being recorded, and its reference in the metatable: */
+	TEKDisplayList *vis_Record;
+	int vis_refRecord;
+
 } TEKVisual;
 
 typedef struct
@@ -86,6 +152,17 @@ typedef struct
 
 } TEKPen;
 
+typedef struct
+{
+	/* Pixmap object: */
+	TAPTR pxm_Pixmap;
+	/* Visual: */
+	TEKVisual *pxm_Visual;
+	/* Dimensions: */
+	TINT pxm_Width, pxm_Height;
+
+} TEKPixmap;
+
 typedef struct
 {
 	/* Visualbase: */
@@ -109,7 +186,11 @@ typedef struct
 #define TEK_LIB_VISUAL_BASECLASSNAME "tek.lib.visual.base*"
 #define TEK_LIB_VISUAL_CLASSNAME "tek.lib.visual*"
 #define TEK_LIB_VISUALPEN_CLASSNAME "tek.lib.visual.pen*"
+#define TEK_LIB_VISUALPIXMAP_CLASSNAME "tek.lib.visual.pixmap*"
 #define TEK_LIB_VISUALFONT_CLASSNAME "tek.lib.visual.font*"
+#define TEK_LIB_VISUALLAYOUT_CLASSNAME "tek.lib.visual.layout*"
+#define TEK_LIB_VISUALIMAGE_CLASSNAME "tek.lib.visual.image*"
+#define TEK_LIB_VISUALDISPLAYLIST_CLASSNAME "tek.lib.visual.displaylist*"
 
 /*****************************************************************************/
 
@@ -139,10 +220,45 @@ LOCAL LUACFUNC TINT tek_lib_visual_setattrs(lua_State *L);
 LOCAL LUACFUNC TINT tek_lib_visual_textsize_visual(lua_State *L);
 LOCAL LUACFUNC TINT tek_lib_visual_setfont(lua_State *L);
 LOCAL LUACFUNC TINT tek_lib_visual_copyarea(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_getexposures(lua_State *L);
 LOCAL LUACFUNC TINT tek_lib_visual_setcliprect(lua_State *L);
 LOCAL LUACFUNC TINT tek_lib_visual_unsetcliprect(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_pushcliprect(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_popcliprect(lua_State *L);
 LOCAL LUACFUNC TINT tek_lib_visual_setshift(lua_State *L);
 LOCAL LUACFUNC TINT tek_lib_visual_drawrgb(lua_State *L);
 LOCAL LUACFUNC TINT tek_lib_visual_getfontattrs(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_allocpixmap(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_freepixmap(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_collectpixmap(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_settarget(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_drawpixmap(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_drawninepatch(lua_State *L);
+
+LOCAL LUACFUNC TINT tek_lib_visual_textlayout(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_freelayout(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_settext(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_setfile(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_layout(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_getline(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_gettext(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_getnumlines(lua_State *L);
+
+LOCAL LUACFUNC TINT tek_lib_visual_compileimage(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_freeimage(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_drawcompiled(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_getimagecache(lua_State *L);
+LOCAL void tek_lib_visual_drawimagepens(TEKVisual *vis, TAPTR image,
+	TINT x0, TINT y0, TINT x1, TINT y1, TVPEN *pens);
+
+LOCAL LUACFUNC TINT tek_lib_visual_beginrecord(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_endrecord(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_replay(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_freedisplaylist(lua_State *L);
+LOCAL TEKDisplayOp *tek_lib_visual_record(lua_State *L, TEKVisual *vis,
+	TINT code, int obj);
+LOCAL TAPTR tek_lib_visual_recorddata(TEKVisual *vis, const void *data,
+	TINT len);
+LOCAL void tek_lib_visual_recordfail(TEKVisual *vis);
 
 #endif
@@ -0,0 +1,349 @@
+/*
+**	tek.lib.visual - display lists
+**
+**	While a visual is recording, the drawing operations issued through
+**	it are appended to a display list, in addition to being performed.
+**	Coordinates are stored with the shift applied, and pens, fonts,
+**	pixmaps and images in their resolved form; objects are referenced by
+**	the list, so that they remain valid for as long as the list exists.
+**	A display list can later be replayed in the visual it was recorded
+**	in, reproducing the same output without re-running the Lua code that
+**	produced it. Operations that cannot be recorded (such as copies or
+**	changes of the rendering target) cause the recording to fail.
+*/
+
+#include <string.h>
+#include "visual_lua.h"
+
+/* Initial number of operations in a display list: */
+#define DL_MINOPS		16
+
+#define checkdisplaylistptr(L, n) \
+	luaL_checkudata(L, n, TEK_LIB_VISUALDISPLAYLIST_CLASSNAME)
+
+/*****************************************************************************/
+
+static void
+freeops(TEKDisplayList *dl)
+{
+	TEKVisual *vis = dl->dl_VisBase;
+	TINT i;
+	for (i = 0; i < dl->dl_NumOps; ++i)
+		TFree(dl->dl_Ops[i].op_Data);
+	TFree(dl->dl_Ops);
+	dl->dl_Ops = TNULL;
+	dl->dl_NumOps = 0;
+	dl->dl_MaxOps = 0;
+}
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_freedisplaylist(lua_State *L)
+{
+	TEKDisplayList *dl = checkdisplaylistptr(L, 1);
+	if (dl->dl_VisBase)
+	{
+		freeops(dl);
+		dl->dl_VisBase = TNULL;
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+
+static void
+stoprecord(lua_State *L, TEKVisual *vis)
+{
+	if (vis->vis_refRecord >= 0)
+	{
+		lua_getmetatable(L, 1);
+		luaL_unref(L, -1, vis->vis_refRecord);
+		lua_pop(L, 1);
+		vis->vis_refRecord = -1;
+	}
+	vis->vis_Record = TNULL;
+}
+
+/*****************************************************************************/
+/*
+**	Mark the display list being recorded as incomplete.
+*/
+
+LOCAL void
+tek_lib_visual_recordfail(TEKVisual *vis)
+{
+	if (vis->vis_Record)
+		vis->vis_Record->dl_Failed = TTRUE;
+}
+
+/*****************************************************************************/
+/*
+**	op = tek_lib_visual_record(L, vis, code, obj): Append an operation to
+**	the display list being recorded in the visual at stack index 1. If
+**	obj is nonzero, the object at this stack index is referenced by the
+**	list. Returns TNULL if the operation cannot be recorded.
+*/
+
+LOCAL TEKDisplayOp *
+tek_lib_visual_record(lua_State *L, TEKVisual *vis, TINT code, int obj)
+{
+	TEKDisplayList *dl = vis->vis_Record;
+	TEKDisplayOp *op;
+
+	if (dl == TNULL || dl->dl_Failed)
+		return TNULL;
+
+	if (dl->dl_NumOps == dl->dl_MaxOps)
+	{
+		TINT n = TMAX(dl->dl_MaxOps * 2, DL_MINOPS);
+		TEKDisplayOp *ops = TRealloc(dl->dl_Ops, sizeof(TEKDisplayOp) * n);
+		if (ops == TNULL)
+		{
+			dl->dl_Failed = TTRUE;
+			return TNULL;
+		}
+		dl->dl_Ops = ops;
+		dl->dl_MaxOps = n;
+	}
+
+	op = &dl->dl_Ops[dl->dl_NumOps++];
+	memset(op, 0, sizeof(TEKDisplayOp));
+	op->op_Code = code;
+
+	if (obj)
+	{
+		op->op_Object = lua_touserdata(L, obj);
+		lua_getmetatable(L, 1);
+		lua_rawgeti(L, -1, vis->vis_refRecord);
+		/* s: vismeta, list */
+		lua_getfenv(L, -1);
+		/* s: vismeta, list, env */
+		lua_pushvalue(L, obj);
+		lua_rawseti(L, -2, lua_objlen(L, -2) + 1);
+		lua_pop(L, 3);
+	}
+
+	return op;
+}
+
+/*****************************************************************************/
+/*
+**	Allocate a copy of data to be owned by a recorded operation.
+*/
+
+LOCAL TAPTR
+tek_lib_visual_recorddata(TEKVisual *vis, const void *data, TINT len)
+{
+	TAPTR copy = TAlloc(TNULL, TMAX(len, 1));
+	if (copy)
+		memcpy(copy, data, len);
+	else
+		tek_lib_visual_recordfail(vis);
+	return copy;
+}
+
+/*****************************************************************************/
+/*
+**	visual:beginrecord(): Starts recording drawing operations into a new
+**	display list. The current font and clipping rectangle are recorded
+**	as the list's initial state.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_beginrecord(lua_State *L)
+{
+	TEKVisual *vis = luaL_checkudata(L, 1, TEK_LIB_VISUAL_CLASSNAME);
+	TEKDisplayList *dl;
+	TEKDisplayOp *op;
+
+	stoprecord(L, vis);
+
+	dl = lua_newuserdata(L, sizeof(TEKDisplayList));
+	/* s: list */
+	memset(dl, 0, sizeof(TEKDisplayList));
+	lua_getfield(L, LUA_REGISTRYINDEX, TEK_LIB_VISUAL_BASECLASSNAME);
+	dl->dl_VisBase = lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	dl->dl_Visual = vis;
+	luaL_getmetatable(L, TEK_LIB_VISUALDISPLAYLIST_CLASSNAME);
+	lua_setmetatable(L, -2);
+	/* referenced objects are kept in the environment: */
+	lua_newtable(L);
+	lua_setfenv(L, -2);
+
+	lua_getmetatable(L, 1);
+	/* s: list, vismeta */
+	lua_pushvalue(L, -2);
+	vis->vis_refRecord = luaL_ref(L, -2);
+	vis->vis_Record = dl;
+
+	/* initial font: */
+	if (vis->vis_refFont >= 0)
+	{
+		lua_rawgeti(L, -1, vis->vis_refFont);
+		/* s: list, vismeta, font */
+		tek_lib_visual_record(L, vis, DLOP_FONT, lua_gettop(L));
+		lua_pop(L, 1);
+	}
+	else
+		tek_lib_visual_record(L, vis, DLOP_FONT, 0);
+
+	/* initial clipping rectangle: */
+	if (vis->vis_Clipped)
+	{
+		op = tek_lib_visual_record(L, vis, DLOP_CLIP, 0);
+		if (op)
+			memcpy(op->op_Args, vis->vis_ClipRect, sizeof(TINT) * 4);
+	}
+	else
+		tek_lib_visual_record(L, vis, DLOP_UNCLIP, 0);
+
+	lua_pop(L, 2);
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	list = visual:endrecord(): Stops recording and returns the display
+**	list, or '''nil''' if an operation could not be recorded.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_endrecord(lua_State *L)
+{
+	TEKVisual *vis = luaL_checkudata(L, 1, TEK_LIB_VISUAL_CLASSNAME);
+	TEKDisplayList *dl = vis->vis_Record;
+	if (dl == TNULL)
+		return 0;
+	lua_getmetatable(L, 1);
+	lua_rawgeti(L, -1, vis->vis_refRecord);
+	/* s: vismeta, list */
+	lua_remove(L, -2);
+	/* s: list */
+	stoprecord(L, vis);
+	if (dl->dl_Failed)
+	{
+		freeops(dl);
+		return 0;
+	}
+	return 1;
+}
+
+/*****************************************************************************/
+
+static TBOOL
+checklist(TEKVisual *vis, TEKDisplayList *dl)
+{
+	TINT i;
+	if (dl->dl_VisBase == TNULL || dl->dl_Visual != vis)
+		return TFALSE;
+	for (i = 0; i < dl->dl_NumOps; ++i)
+	{
+		TEKDisplayOp *op = &dl->dl_Ops[i];
+		switch (op->op_Code)
+		{
+			case DLOP_FONT:
+				if (op->op_Object &&
+					((TEKFont *) op->op_Object)->font_Font == TNULL)
+					return TFALSE;
+				break;
+			case DLOP_PIXMAP:
+			case DLOP_NINEPATCH:
+				if (((TEKPixmap *) op->op_Object)->pxm_Pixmap == TNULL)
+					return TFALSE;
+				break;
+		}
+	}
+	return TTRUE;
+}
+
+/*****************************************************************************/
+/*
+**	success = visual:replay(list): Performs the operations recorded in a
+**	display list. Restores the visual's font and clipping rectangle
+**	afterwards. Returns '''false''' if the list was recorded in another
+**	visual, or if an object it references has been freed.
+*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_replay(lua_State *L)
+{
+	TEKVisual *vis = luaL_checkudata(L, 1, TEK_LIB_VISUAL_CLASSNAME);
+	TEKDisplayList *dl = checkdisplaylistptr(L, 2);
+	TAPTR v = vis->vis_Visual;
+	TAPTR font = vis->vis_Font;
+	TINT i;
+
+	if (!checklist(vis, dl))
+	{
+		lua_pushboolean(L, 0);
+		return 1;
+	}
+
+	for (i = 0; i < dl->dl_NumOps; ++i)
+	{
+		TEKDisplayOp *op = &dl->dl_Ops[i];
+		TINT *a = op->op_Args;
+		switch (op->op_Code)
+		{
+			case DLOP_FONT:
+			{
+				TAPTR f = op->op_Object ?
+					((TEKFont *) op->op_Object)->font_Font :
+					dl->dl_VisBase->vis_Font;
+				if (f != font)
+				{
+					TVisualSetFont(v, f);
+					font = f;
+				}
+				break;
+			}
+			case DLOP_CLIP:
+				TVisualSetClipRect(v, a[0], a[1], a[2], a[3], TNULL);
+				break;
+			case DLOP_UNCLIP:
+				TVisualUnsetClipRect(v);
+				break;
+			case DLOP_RECT:
+				TVisualRect(v, a[0], a[1], a[2], a[3], op->op_Pens[0]);
+				break;
+			case DLOP_FRECT:
+				TVisualFRect(v, a[0], a[1], a[2], a[3], op->op_Pens[0]);
+				break;
+			case DLOP_LINE:
+				TVisualLine(v, a[0], a[1], a[2], a[3], op->op_Pens[0]);
+				break;
+			case DLOP_PLOT:
+				TVisualPlot(v, a[0], a[1], op->op_Pens[0]);
+				break;
+			case DLOP_TEXT:
+				TVisualText(v, a[0], a[1], op->op_Data, op->op_Length,
+					op->op_Pens[0], op->op_Pens[1]);
+				break;
+			case DLOP_PIXMAP:
+				TVisualDrawPixmap(v,
+					((TEKPixmap *) op->op_Object)->pxm_Pixmap,
+					a[0], a[1], a[2], a[3], a[4], a[5]);
+				break;
+			case DLOP_NINEPATCH:
+				TVisualDrawNinePatch(v,
+					((TEKPixmap *) op->op_Object)->pxm_Pixmap, a, a + 4);
+				break;
+			case DLOP_IMAGE:
+				tek_lib_visual_drawimagepens(vis, op->op_Object,
+					a[0], a[1], a[2], a[3], op->op_Data);
+				break;
+		}
+	}
+
+	/* restore state: */
+	if (font != vis->vis_Font)
+		TVisualSetFont(v, vis->vis_Font);
+	if (vis->vis_Clipped)
+		TVisualSetClipRect(v, vis->vis_ClipRect[0], vis->vis_ClipRect[1],
+			vis->vis_ClipRect[2], vis->vis_ClipRect[3], TNULL);
+	else
+		TVisualUnsetClipRect(v);
+
+	lua_pushboolean(L, 1);
+	return 1;
+}
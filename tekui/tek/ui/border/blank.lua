@@ -9,7 +9,7 @@ local ui = require "tek.ui"
 local unpack = unpack
 
 module("tek.ui.border.blank", tek.ui.class.border)
-_VERSION = "BlankBorder 2.1"
+_VERSION = "BlankBorder 2.2"
 
 -------------------------------------------------------------------------------
 --	Constants & Class data:
@@ -39,8 +39,5 @@ function Blank:draw(element, border, r1, r2, r3, r4)
 			ui.PEN_AREABACK]
 		p2 = p1
 	end
-	d:fillRect(r1 - b1, r2 - b2, r3 + b3, r2 - 1, p1)
-	d:fillRect(r3 + 1, r2, r3 + b3, r4 + b4, p2)
-	d:fillRect(r1 - b1, r4 + 1, r3 + b3, r4 + b4, p1)
-	d:fillRect(r1 - b1, r2, r1 - 1, r4, p2)
+	self:drawPatch(element, b1, b2, b3, b4, r1, r2, r3, r4, p1, p2, p1, p2)
 end
@@ -9,7 +9,7 @@ local ui = require "tek.ui"
 local unpack = unpack
 
 module("tek.ui.border.cursor", tek.ui.class.border)
-_VERSION = "Cursor Border 2.1"
+_VERSION = "Cursor Border 2.2"
 
 -------------------------------------------------------------------------------
 --	Constants & Class data:
@@ -32,8 +32,5 @@ function Cursor:draw(element, border, r1, r2, r3, r4)
 	local b1, b2, b3, b4 = self:getBorder(element, border)
 	local d = element.Drawable
 	local p1 = d.Pens[ui.PEN_SHINE]
-	d:fillRect(r1 - b1, r2 - b2, r3 + b3, r2 - 1, p1)
-	d:fillRect(r3 + 1, r2, r3 + b3, r4 + b4, p1)
-	d:fillRect(r1 - b1, r4 + 1, r3 + b3, r4 + b4, p1)
-	d:fillRect(r1 - b1, r2, r1 - 1, r4, p1)
+	self:drawPatch(element, b1, b2, b3, b4, r1, r2, r3, r4, p1, p1, p1, p1)
 end
@@ -11,7 +11,7 @@ local Region = require "tek.lib.region"
 local floor = math.floor
 
 module("tek.ui.border.group", tek.ui.class.border)
-_VERSION = "GroupBorder 3.1"
+_VERSION = "GroupBorder 3.2"
 
 -------------------------------------------------------------------------------
 --	Constants & Class data:
@@ -50,10 +50,7 @@ function Group:draw(element, border, r1, r2, r3, r4)
 		p1, p2 = d.Pens[ui.PEN_HALFSHADOW], d.Pens[ui.PEN_SHADOW]
 	end
 
-	d:fillRect(r1 - b1, r2 - b2, r3 + b3, r2 - 1, p1)
-	d:fillRect(r3 + 1, r2, r3 + b3, r4 + b4, p2)
-	d:fillRect(r1 - b1, r4 + 1, r3 + b3, r4 + b4, p2)
-	d:fillRect(r1 - b1, r2, r1 - 1, r4, p1)
+	self:drawPatch(element, b1, b2, b3, b4, r1, r2, r3, r4, p1, p2, p2, p1)
 	if tw then
 		local w = r3 - r1 + 1
 		local tx = r1 + floor((w - tw) / 2)
@@ -9,7 +9,7 @@ local ui = require "tek.ui"
 local unpack = unpack
 
 module("tek.ui.border.tab", tek.ui.class.border)
-_VERSION = "TabBorder 1.0"
+_VERSION = "TabBorder 1.1"
 
 -------------------------------------------------------------------------------
 --	Constants & Class data:
@@ -37,8 +37,6 @@ function Tab:draw(element, border, r1, r2, r3, r4)
 	else
 		p1, p2 = d.Pens[ui.PEN_HALFSHADOW], d.Pens[ui.PEN_HALFSHINE]
 	end
-	d:fillRect(r1 - b1, r2 - b2, r3 + b3, r2 - 1, p1)
-	d:fillRect(r3 + 1, r2, r3 + b3, r4 + b4, p2)
-	d:fillRect(r1 - b1, r4 + 1, r3 + b3, r4 + b4, d.Pens[ui.PEN_GROUPBACK])
-	d:fillRect(r1 - b1, r2, r1 - 1, r4, p1)
+	self:drawPatch(element, b1, b2, b3, b4, r1, r2, r3, r4, p1, p2,
+		d.Pens[ui.PEN_GROUPBACK], p1)
 end
@@ -19,6 +19,8 @@
 --			A colored pen for painting the background of the element
 --		- {{DamageRegion [G]}} ([[#tek.lib.region : Region]])
 --			see {{TrackDamage}}
+--		- {{DisplayList [G]}} (userdata)
+--			see {{Retained}}
 --		- {{Disabled [ISG]}} (boolean)
 --			If '''true''', the element is in disabled state. This attribute is
 --			not handled by Area; see [[#tek.ui.class.gadget : Gadget]]
@@ -53,6 +55,13 @@
 --			Minimum height of the element, in pixels [default: 0]
 --		- {{MinWidth [IG]}} (number)
 --			Minimum width of the element, in pixels [default: 0]
+--		- {{Retained [IG]}} (boolean)
+--			If '''true''', the drawing operations performed by the element's
+--			draw method are recorded in a {{DisplayList}}, which is replayed
+--			when the element is only exposed, without calling the draw method
+--			again. This is suitable for elements whose appearance depends
+--			exclusively on the state that causes them to be redrawn.
+--			[Default: '''false''']
 --		- {{Selected [ISG]}} (boolean)
 --			If '''true''', the element is in selected state. This
 --			attribute is not handled by Area; see
@@ -83,6 +92,7 @@
 --
 --	IMPLEMENTS::
 --		- Area:askMinMax() - Query minimum and maximum dimensions
+--		- Area:checkRedraw() - Check if the element has drawing pending
 --		- Area:checkFocus() - Check if the element can receive the focus
 --		- Area:draw() - Draws the element
 --		- Area:getElement() - Returns an element's neighbours
@@ -122,7 +132,7 @@ local remove = table.remove
 local tonumber = tonumber
 
 module("tek.ui.class.area", tek.ui.class.element)
-_VERSION = "Area 9.0"
+_VERSION = "Area 9.2"
 local Area = _M
 
 -------------------------------------------------------------------------------
@@ -158,6 +168,8 @@ function Area.init(self)
 	self.BGPen = self.BGPen or false
 	-- Region to collect damages to this element:
 	self.DamageRegion = false
+	-- Recorded drawing operations, see Retained:
+	self.DisplayList = false
 	-- Disabled state of the element (defined, but not handled by Area):
 	self.Disabled = self.Disabled or false
 	-- The Display this element is connected to [internal]:
@@ -184,6 +196,8 @@ function Area.init(self)
 	self.MinWidth = self.MinWidth or 0
 	-- Indicates whether the element needs to be redrawn [internal]:
 	self.Redraw = false
+	-- Boolean to indicate whether drawing is to be recorded for exposures:
+	self.Retained = self.Retained or false
 	-- Selected state of the element (defined, but not handled by Area):
 	self.Selected = self.Selected or false
 	-- Boolean to indicate whether intra-area damages are to be collected:
@@ -241,6 +255,7 @@ end
 
 function Area:hide()
 	self.DamageRegion = false
+	self.DisplayList = false
 	self.Drawable = false
 	self.Display = false
 end
@@ -387,6 +402,7 @@ function Area:layout(x0, y0, x1, y1, markdamage)
 		end
 
 		r[1], r[2], r[3], r[4] = x0, y0, x1, y1
+		self.DisplayList = false
 		return true
 
 	else
@@ -422,16 +438,33 @@ function Area:punch(region)
 end
 
 -------------------------------------------------------------------------------
---	Area:markDamage(x0, y0, x1, y1): If the element overlaps with the given
---	rectangle, this function marks it as damaged.
+--	pending = Area:checkRedraw(): Returns '''true''' if the element will
+--	draw anything on the next call to Area:refresh(). Classes which draw
+--	in their refresh method on conditions other than {{Redraw}} should
+--	override this function accordingly.
 -------------------------------------------------------------------------------
 
-function Area:markDamage(r1, r2, r3, r4)
-	if self.TrackDamage or not self.Redraw then
+function Area:checkRedraw()
+	return self.Redraw
+end
+
+-------------------------------------------------------------------------------
+--	Area:markDamage(x0, y0, x1, y1[, expose]): If the element overlaps with
+--	the given rectangle, this function marks it as damaged. If {{expose}}
+--	is '''true''', the damage is caused by an exposure of the window only,
+--	and the element may be restored from its {{DisplayList}}.
+-------------------------------------------------------------------------------
+
+function Area:markDamage(r1, r2, r3, r4, expose)
+	if self.TrackDamage or self.Redraw ~= true then
 		local r = self.Rect
 		r1, r2, r3, r4 = overlap(r1, r2, r3, r4, r[1], r[2], r[3], r[4])
 		if r1 then
-			self.Redraw = true
+			if expose and self.DisplayList then
+				self.Redraw = self.Redraw or "expose"
+			else
+				self.Redraw = true
+			end
 			if self.DamageRegion then
 				self.DamageRegion:orRect(r1, r2, r3, r4)
 			elseif self.TrackDamage then
@@ -472,8 +505,19 @@ end
 -------------------------------------------------------------------------------
 
 function Area:refresh()
-	if self.Redraw then
-		self:draw()
+	local redraw = self.Redraw
+	if redraw then
+		local d = self.Drawable
+		local dl = self.DisplayList
+		if redraw == "expose" and dl and d:replayList(dl) then
+			self.DamageRegion = false
+		elseif self.Retained and not self.DamageRegion and d:beginRecord() then
+			self:draw()
+			self.DisplayList = d:endRecord()
+		else
+			self.DisplayList = false
+			self:draw()
+		end
 		self.Redraw = false
 	end
 end
@@ -16,6 +16,8 @@
 --
 --	IMPLEMENTS::
 --		- Border:draw() - Draw a border
+--		- Border:drawFrame() - Draw a border from four rectangles
+--		- Border:drawPatch() - Draw a border using a pixmap cache
 --		- Border:getBorder() - Get a border class' border thicknesses
 --		- Border:getRegion() - Get a region representing the border outline
 --		- Border.loadClass() - Load a border class
@@ -26,10 +28,11 @@ local ui = require "tek.ui"
 local Object = require "tek.class.object"
 local Region = require "tek.lib.region"
 local newRegion = Region.new
+local tostring = tostring
 local unpack = unpack
 
 module("tek.ui.class.border", tek.class.object)
-_VERSION = "Border 3.0"
+_VERSION = "Border 3.1"
 
 -------------------------------------------------------------------------------
 --	Class implementation:
@@ -37,6 +40,10 @@ _VERSION = "Border 3.0"
 
 local Border = _M
 
+-- size of a nine-patch's center, and max. number of cached patches:
+local PATCHSIZE = 64
+local MAXPATCHES = 64
+
 -------------------------------------------------------------------------------
 --	Border.loadClass(stylename): This function tries to load the named
 --	border class; if the class cannot be found, returns the base class.
@@ -70,6 +77,62 @@ end
 function Border:draw()
 end
 
+-------------------------------------------------------------------------------
+--	Border:drawFrame(drawable, b1, b2, b3, b4, x0, y0, x1, y1, ptop,
+--	pright, pbottom, pleft): Draws a border of the specified thicknesses
+--	around the given rectangle, using one pen for each of the four sides.
+--	The top and bottom sides cover the corners.
+-------------------------------------------------------------------------------
+
+function Border:drawFrame(d, b1, b2, b3, b4, r1, r2, r3, r4, p1, p2, p3, p4)
+	d:fillRect(r1 - b1, r2 - b2, r3 + b3, r2 - 1, p1)
+	d:fillRect(r3 + 1, r2, r3 + b3, r4 + b4, p2)
+	d:fillRect(r1 - b1, r4 + 1, r3 + b3, r4 + b4, p3)
+	d:fillRect(r1 - b1, r2, r1 - 1, r4, p4)
+end
+
+-------------------------------------------------------------------------------
+--	Border:drawPatch(element, b1, b2, b3, b4, x0, y0, x1, y1, ptop, pright,
+--	pbottom, pleft): Draws the same border as Border:drawFrame(), but
+--	renders it only once per combination of class, thicknesses and pens
+--	into an offscreen pixmap, from which it is subsequently drawn as a
+--	nine-patch in a single operation. The cache is kept in the element's
+--	[[#tek.ui.class.drawable : Drawable]]. Falls back to
+--	Border:drawFrame() if the display does not support offscreen pixmaps.
+-------------------------------------------------------------------------------
+
+function Border:drawPatch(e, b1, b2, b3, b4, r1, r2, r3, r4, p1, p2, p3, p4)
+	local d = e.Drawable
+	if b1 + b2 + b3 + b4 == 0 then
+		return
+	end
+	local cache = d.PatchCache
+	local key = ("%s:%d:%d:%d:%d:%s:%s:%s:%s"):format(self._NAME,
+		b1, b2, b3, b4, tostring(p1), tostring(p2), tostring(p3),
+		tostring(p4))
+	local pm = cache[key]
+	if pm == nil then
+		if d.NumPatches >= MAXPATCHES then
+			d:flushPatches()
+			cache = d.PatchCache
+		end
+		pm = d:allocPixmap(b1 + PATCHSIZE + b3, b2 + PATCHSIZE + b4) or false
+		if pm then
+			d:pushTarget(pm)
+			self:drawFrame(d, b1, b2, b3, b4, b1, b2, b1 + PATCHSIZE - 1,
+				b2 + PATCHSIZE - 1, p1, p2, p3, p4)
+			d:popTarget()
+		end
+		cache[key] = pm
+		d.NumPatches = d.NumPatches + 1
+	end
+	if pm then
+		d:drawNinePatch(pm, b1, b2, b3, b4, r1, r2, r3, r4)
+	else
+		self:drawFrame(d, b1, b2, b3, b4, r1, r2, r3, r4, p1, p2, p3, p4)
+	end
+end
+
 -------------------------------------------------------------------------------
 --	region = Border:getRegion(element, bordertab, x0, y0, x1, y1): Returns a
 --	[[#tek.lib.region : Region]] representing the outline of the specified
@@ -17,6 +17,17 @@
 --		for a child element. Currently, this class is used exclusively
 --		by the [[#tek.ui.class.scrollgroup : ScrollGroup]] class.
 --
+--		If {{TileCache}} is enabled, the Canvas keeps a backing store
+--		of its contents in fixed-size offscreen pixmaps (tiles), keyed by
+--		their position in canvas coordinates. Exposures, e.g. from
+--		scrolling back to a previously visible part of the canvas, are
+--		then served by copying from the tiles instead of redrawing the
+--		child. Tiles are invalidated when the elements overlapping them
+--		are redrawn, and the least recently used tiles are recycled when
+--		the memory budget given in {{TileCacheSize}} is exhausted. If the
+--		display driver does not support offscreen pixmaps, the Canvas
+--		silently falls back to redrawing.
+--
 --	ATTRIBUTES::
 --		- {{AutoHeight [IG]}} (boolean)
 --			The height of the canvas is automatically adapted to the height
@@ -40,16 +51,27 @@
 --		- {{KeepMinWidth [IG]}} (boolean)
 --			Report the minimum width of the Canvas's child object as the
 --			Canvas' minimum width on the display
+--		- {{TileCache [IG]}} (boolean)
+--			Keep a backing store of the canvas contents in offscreen
+--			tiles. [Default: '''false''']
+--		- {{TileCacheSize [IG]}} (number)
+--			Memory budget for the tile cache, in bytes (assuming four bytes
+--			per pixel). [Default: 4194304]
+--		- {{TileSize [IG]}} (number)
+--			Width and height of a tile, in pixels. [Default: 128]
 --		- {{UnusedRegion [G]}} ([[#tek.lib.region : Region]])
 --			Region of the Canvas which isn't covered by its {{Child}}
 --		- {{VScrollStep [IG]}} (number)
 --			Vertical scroll step (used for mousewheel)
 --
 --	IMPLEMENTS::
+--		- Canvas:freeTiles()
+--		- Canvas:invalidateTiles()
 --		- Canvas:updateUnusedRegion()
 --
 --	OVERRIDES::
 --		- Area:askMinMax()
+--		- Area:checkRedraw()
 --		- Element:cleanup()
 --		- Element:connect()
 --		- Element:disconnect()
@@ -72,16 +94,22 @@ local ui = require "tek.ui"
 local Region = require "tek.lib.region"
 local Area = ui.Area
 local assert = assert
+local floor = math.floor
 local max = math.max
 local min = math.min
+local pairs = pairs
 local unpack = unpack
 local overlap = Region.overlapCoords
 
 module("tek.ui.class.canvas", tek.ui.class.area)
-_VERSION = "Canvas 9.0"
+_VERSION = "Canvas 10.0"
 local Canvas = _M
 
 local DEF_MARGIN = { 0, 0, 0, 0 }
+local DEF_TILESIZE = 128
+local DEF_TILECACHESIZE = 4194304
+
+local checktree, invalidatetree
 
 -------------------------------------------------------------------------------
 --	init: overrides
@@ -96,6 +124,14 @@ function Canvas.init(self)
 	self.CanvasWidth = self.CanvasWidth or 0
 	self.KeepMinHeight = self.KeepMinHeight or false
 	self.KeepMinWidth = self.KeepMinWidth or false
+	self.TileCache = self.TileCache or false
+	self.TileCacheSize = self.TileCacheSize or DEF_TILECACHESIZE
+	self.TileSize = self.TileSize or DEF_TILESIZE
+	-- tile cache state, see show():
+	self.Tiles = false
+	self.NumTiles = 0
+	self.TileTick = 0
+	self.ExposeRegion = false
 	self.Margin = self.Margin or DEF_MARGIN
 	self.Child = self.Child or ui.Area:new { Margin = DEF_MARGIN }
 	self.VScrollStep = self.VScrollStep or 10
@@ -150,6 +186,7 @@ end
 function Canvas:show(display, drawable)
 	if self.Child:show(display, drawable) then
 		if Area.show(self, display, drawable) then
+			self.Tiles = self.TileCache and { } or false
 			return true
 		end
 		self.Child:hide()
@@ -161,6 +198,9 @@ end
 -------------------------------------------------------------------------------
 
 function Canvas:hide()
+	self:freeTiles()
+	self.Tiles = false
+	self.ExposeRegion = false
 	self.Child:hide()
 	Area.hide(self)
 end
@@ -237,6 +277,11 @@ function Canvas:layout(r1, r2, r3, r4, markdamage)
 	-- unset shift:
 	d:setShift(-sx, -sy)
 
+	-- cached tiles are invalid if the child has changed its size:
+	if sizechanged then
+		self:invalidateTiles()
+	end
+
 	-- propagate intra-area damages calculated in Area.layout to child object:
 	local dr = self.DamageRegion
 	if dr and markdamage ~= false then
@@ -245,7 +290,7 @@ function Canvas:layout(r1, r2, r3, r4, markdamage)
 		for _, r in dr:getRects() do
 			local r1, r2, r3, r4 = dr:getRect(r)
 			-- mark as damage shifted into canvas space:
-			self.Child:markDamage(r1 + sx, r2 + sy, r3 + sx, r4 + sy)
+			self:exposeChild(r1 + sx, r2 + sy, r3 + sx, r4 + sy)
 		end
 	end
 
@@ -324,11 +369,27 @@ function Canvas:refresh()
 	local sy = r[2] - self.CanvasTop
 	d:pushClipRect(r[1], r[2], r[3], r[4])
 	d:setShift(sx, sy)
+	if self.Tiles then
+		-- tiles under elements about to be redrawn are outdated:
+		invalidatetree(self, self.Child)
+	end
 	self.Child:refresh()
+	if self.ExposeRegion then
+		self:drawTiles()
+	end
 	d:setShift(-sx, -sy)
 	d:popClipRect()
 end
 
+-------------------------------------------------------------------------------
+--	checkRedraw: overrides - a Canvas also reports pending drawing in its
+--	child, as the child lives in a coordinate space of its own
+-------------------------------------------------------------------------------
+
+function Canvas:checkRedraw()
+	return Area.checkRedraw(self) or checktree(self.Child)
+end
+
 -------------------------------------------------------------------------------
 --	markDamage: overrides
 -------------------------------------------------------------------------------
@@ -342,7 +403,207 @@ function Canvas:markDamage(r1, r2, r3, r4)
 		-- shift into canvas space:
 		local sx = self.CanvasLeft - r[1]
 		local sy = self.CanvasTop - r[2]
-		self.Child:markDamage(r1 + sx, r2 + sy, r3 + sx, r4 + sy)
+		self:exposeChild(r1 + sx, r2 + sy, r3 + sx, r4 + sy)
+	end
+end
+
+-------------------------------------------------------------------------------
+--	exposeChild: internal - passes a damage in canvas coordinates to the
+--	child, or collects it for being served from the tile cache
+-------------------------------------------------------------------------------
+
+function Canvas:exposeChild(r1, r2, r3, r4)
+	if self.Tiles then
+		local er = self.ExposeRegion
+		if er then
+			er:orRect(r1, r2, r3, r4)
+		else
+			self.ExposeRegion = Region.new(r1, r2, r3, r4)
+		end
+	else
+		self.Child:markDamage(r1, r2, r3, r4)
+	end
+end
+
+-------------------------------------------------------------------------------
+--	checktree: internal - checks if an element or any of its children have
+--	drawing pending
+-------------------------------------------------------------------------------
+
+function checktree(e)
+	if e:checkRedraw() then
+		return true
+	end
+	local c = e.Children
+	if c then
+		for i = 1, #c do
+			if checktree(c[i]) then
+				return true
+			end
+		end
+	end
+	return false
+end
+
+-------------------------------------------------------------------------------
+--	invalidatetree: internal - invalidates the tiles under all elements in
+--	a tree which have drawing pending
+-------------------------------------------------------------------------------
+
+function invalidatetree(self, e)
+	if e:checkRedraw() then
+		local r, m = e.Rect, e.MarginAndBorder
+		if r[1] then
+			self:invalidateTiles(r[1] - m[1], r[2] - m[2], r[3] + m[3],
+				r[4] + m[4])
+		end
+	else
+		local c = e.Children
+		if c then
+			for i = 1, #c do
+				invalidatetree(self, c[i])
+			end
+		end
+	end
+end
+
+-------------------------------------------------------------------------------
+--	Canvas:invalidateTiles([x0, y0, x1, y1]): Marks the cached tiles
+--	overlapping the given rectangle (in canvas coordinates) as outdated.
+--	If no rectangle is specified, all tiles are invalidated.
+-------------------------------------------------------------------------------
+
+function Canvas:invalidateTiles(x0, y0, x1, y1)
+	local tiles = self.Tiles
+	if tiles then
+		local ts = self.TileSize
+		for _, tile in pairs(tiles) do
+			if not x0 or overlap(x0, y0, x1, y1, tile.X, tile.Y,
+				tile.X + ts - 1, tile.Y + ts - 1) then
+				tile.Valid = false
+			end
+		end
+	end
+end
+
+-------------------------------------------------------------------------------
+--	Canvas:freeTiles(): Frees all tiles held by the tile cache.
+-------------------------------------------------------------------------------
+
+function Canvas:freeTiles()
+	local tiles = self.Tiles
+	if tiles then
+		local d = self.Drawable
+		for key, tile in pairs(tiles) do
+			d:freePixmap(tile.Pixmap)
+			tiles[key] = nil
+		end
+	end
+	self.NumTiles = 0
+end
+
+-------------------------------------------------------------------------------
+--	getTile: internal - gets the tile at the given tile position, allocating
+--	or recycling a pixmap and rendering its contents as necessary. Returns
+--	'''nil''' if no pixmap is available.
+-------------------------------------------------------------------------------
+
+function Canvas:getTile(tx, ty)
+	local tiles = self.Tiles
+	local key = ty * 0x10000 + tx
+	local tile = tiles[key]
+	if not tile then
+		local ts = self.TileSize
+		local pm
+		if self.NumTiles < max(floor(self.TileCacheSize / (ts * ts * 4)), 1)
+		then
+			pm = self.Drawable:allocPixmap(ts, ts)
+			if pm then
+				self.NumTiles = self.NumTiles + 1
+			end
+		end
+		if not pm then
+			-- recycle the least recently used tile:
+			local lkey, lru
+			for k, t in pairs(tiles) do
+				if not lru or t.Tick < lru.Tick then
+					lkey, lru = k, t
+				end
+			end
+			if not lru then
+				return
+			end
+			tiles[lkey] = nil
+			pm = lru.Pixmap
+		end
+		tile = { Pixmap = pm, X = tx * ts, Y = ty * ts, Valid = false,
+			Tick = 0 }
+		tiles[key] = tile
+	end
+	self.TileTick = self.TileTick + 1
+	tile.Tick = self.TileTick
+	if not tile.Valid then
+		self:renderTile(tile)
+	end
+	return tile
+end
+
+-------------------------------------------------------------------------------
+--	renderTile: internal - renders the child into a tile, by redirecting
+--	drawing into the tile's pixmap
+-------------------------------------------------------------------------------
+
+function Canvas:renderTile(tile)
+	local d = self.Drawable
+	local c = self.Child
+	local x0, y0 = tile.X, tile.Y
+	local x1, y1 = x0 + self.TileSize - 1, y0 + self.TileSize - 1
+	d:pushTarget(tile.Pixmap)
+	d:setShift(-x0, -y0)
+	d:pushClipRect(x0, y0, x1, y1)
+	d:fillRect(x0, y0, x1, y1, d.Pens[c.Background])
+	c:markDamage(x0, y0, x1, y1)
+	c:refresh()
+	d:popClipRect()
+	d:setShift(x0, y0)
+	d:popTarget()
+	tile.Valid = true
+end
+
+-------------------------------------------------------------------------------
+--	drawTiles: internal - serves the collected exposures from the tile
+--	cache. Falls back to redrawing the child if no tiles can be allocated.
+-------------------------------------------------------------------------------
+
+function Canvas:drawTiles()
+	local er = self.ExposeRegion
+	self.ExposeRegion = false
+	local d = self.Drawable
+	local c = self.Child
+	local ts = self.TileSize
+	local fallback
+	for _, r in er:getRects() do
+		local r1, r2, r3, r4 = er:getRect(r)
+		for ty = floor(r2 / ts), floor(r4 / ts) do
+			for tx = floor(r1 / ts), floor(r3 / ts) do
+				local tile = self.Tiles and self:getTile(tx, ty)
+				local x0, y0 = tx * ts, ty * ts
+				local a1, a2, a3, a4 = overlap(r1, r2, r3, r4,
+					x0, y0, x0 + ts - 1, y0 + ts - 1)
+				if tile then
+					d:drawPixmap(tile.Pixmap, a1 - x0, a2 - y0, a3 - x0, a4 - y0,
+						a1, a2)
+				else
+					-- display has no offscreen pixmaps; stop caching:
+					self.Tiles = false
+					c:markDamage(a1, a2, a3, a4)
+					fallback = true
+				end
+			end
+		end
+	end
+	if fallback then
+		c:refresh()
 	end
 end
 
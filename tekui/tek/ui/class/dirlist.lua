@@ -54,7 +54,8 @@
 local lfs = require "lfs"
 local db = require "tek.lib.debug"
 local ui = require "tek.ui"
-local List = require "tek.class.list"
+local DirScan = require "tek.lib.dirscan"
+local ListModel = require "tek.lib.listmodel"
 
 local Group = ui.Group
 local ListGadget = ui.ListGadget
@@ -62,34 +63,22 @@ local ListView = ui.ListView
 local Text = ui.Text
 local TextInput = ui.TextInput
 
-local dir = lfs.dir
+local floor = math.floor
 local insert = table.insert
 local pairs = pairs
-local pcall = pcall
-local sort = table.sort
 local stat = lfs.attributes
 
 module("tek.ui.class.dirlist", tek.ui.class.group)
-_VERSION = "DirList 3.2"
+_VERSION = "DirList 4.0"
 
 local DirList = _M
 
--------------------------------------------------------------------------------
---	readDir: returns an iterator over entries in a directory
--------------------------------------------------------------------------------
+-- directories first, then by name, case-insensitive:
+local SORT_KEYS = { { Mode = "flag", Descending = true },
+	{ Column = 1, Mode = "nocase" } }
 
-local function readDir(path)
-	local success, dir = pcall(dir, path)
-	if success then
-		return function()
-			local e
-			repeat
-				e = dir()
-			until e ~= "." and e ~= ".."
-			return e
-		end
-	end
-end
+-- maximum number of entries to take from the scanner per update:
+local SCAN_READMAX = 2048
 
 -------------------------------------------------------------------------------
 --	splitPath: splits a path, returning a path and a path/file part
@@ -330,8 +319,9 @@ end
 
 -------------------------------------------------------------------------------
 --	DirList:abortScan(): This function aborts the coroutine which is
---	currently scanning the directory. The caller of this function must
---	be running in its own coroutine.
+--	currently scanning the directory, and the worker task reading the
+--	directory on its behalf. The caller of this function must be running
+--	in its own coroutine.
 -------------------------------------------------------------------------------
 
 function DirList:abortScan()
@@ -342,6 +332,13 @@ function DirList:abortScan()
 	end
 end
 
+-------------------------------------------------------------------------------
+--	scanDir: The directory is read by a worker task (see tek.lib.dirscan),
+--	while a coroutine collects its entries. New entries are merged into
+--	the sorted list, and the list is relayouted, at growing intervals, so
+--	that the total effort remains linear in the number of entries.
+-------------------------------------------------------------------------------
+
 function DirList:scanDir(path)
 	local app = self.Application
 
@@ -354,57 +351,55 @@ function DirList:scanDir(path)
 		local obj = self.ListGadget
 		path = path == "" and "." or path
 		obj:setValue("CursorLine", 0)
-		obj:setList(List:new())
 
-		diri = readDir(path)
-		if diri then
-			local list = { }
+		local model = ListModel.new(2)
+		obj:setList(model)
+
+		local scanner, msg = DirScan.open(path)
+		if scanner then
+			local pending = { }
 			local n = 0
+			local nextupdate = 1
 
-			for name in diri do
+			while true do
 
-				if n % 50 == 0 then
-					self:showStats(0, n)
-					app:suspend()
-					if self.ScanMode ~= "scanning" then
-						db.warn("scan aborted")
-						self.ScanMode = false
-						return
-					end
+				app:suspend()
+				if self.ScanMode ~= "scanning" then
+					scanner:close()
+					db.warn("scan aborted")
+					self.ScanMode = false
+					return
 				end
-				n = n + 1
-
-				local fullname = path .. "/" .. name
-				local isdir = stat(fullname, "mode") == "directory"
 
-				insert(list,
-				{
-					{
-						name,
-						isdir and "[Directory]" or stat(fullname, "size")
-					},
-					isdir
-				})
-			end
+				local items, err = scanner:read(SCAN_READMAX)
+				if items then
+					for i = 1, #items do
+						insert(pending, items[i])
+					end
+					n = n + #items
+				elseif err then
+					db.warn("%s", err)
+				end
 
-			sort(list, function(a, b)
-				if a[2] == b[2] then
-					return a[1][1]:lower() < b[1][1]:lower()
+				if #pending > 0 and (n >= nextupdate or not items) then
+					model:sort(SORT_KEYS, model:addItems(pending))
+					obj:repaint()
+					pending = { }
+					nextupdate = floor(n * 1.5) + 1
 				end
-				return a[2]
-			end)
 
-			self:showStats(0, n)
-			app:suspend()
+				self:showStats(0, n)
 
-			for i = 1, #list do
-				obj:addItem(list[i], nil, true)
+				if not items then
+					break
+				end
 			end
 
-			obj:prepare(true)
 			obj:setValue("CursorLine", 1)
 			obj:setValue("Focus", true)
 			self:showStats()
+		else
+			db.warn("%s", msg)
 		end
 
 		self.ScanMode = false
@@ -20,8 +20,9 @@
 --
 --	IMPLEMENTS::
 --		- Display:closeFont() - Close font
+--		- Display:createTextLayout() - Create a layout for breaking text
 --		- Display:getFontAttrs() - Get font attributes
---		- Display:getTime() - Get system time
+--		- Display:getTime() - Get time from a monotonic clock
 --		- Display:openFont() - Open a named font
 --		- Display:openVisual() - Open a visual
 --		- Display:sleep() - Sleep for a period of time
@@ -42,7 +43,7 @@ local Theme = ui.Theme
 local tonumber = tonumber
 
 module("tek.ui.class.display", tek.class)
-_VERSION = "Display 6.0"
+_VERSION = "Display 6.3"
 
 -------------------------------------------------------------------------------
 --	Class implementation:
@@ -66,6 +67,31 @@ function Display:getTextSize(...)
 	return Visual.textsize(...)
 end
 
+-------------------------------------------------------------------------------
+--	layout = Display:createTextLayout(font): Creates a text layout object
+--	for the given {{font}}. A text layout breaks a text into lines of a
+--	given width, caching the widths of words, and describes lines by their
+--	offsets into the text. Methods of the layout object are:
+--		- {{minwidth = layout:settext(text)}} - sets the text and returns
+--		the width of its longest word
+--		- {{success, errmsg = layout:setfile(path)}} - sets the text to the
+--		contents of a file, which is mapped into memory
+--		- {{numlines, first, done = layout:layout(width[, step])}} - breaks
+--		the text into lines, returns the number of lines, the first line
+--		that has changed, or '''false''', and whether the text is complete.
+--		If {{step}} is given, only this number of bytes of unprocessed text
+--		are added
+--		- {{offset, length, width = layout:getline(line)}} - returns the
+--		position of a line in the text, and its width in pixels
+--		- {{text = layout:gettext(line)}} - returns the text of a line,
+--		with words separated by single spaces
+--		- {{numlines = layout:getnumlines()}} - returns the number of lines
+-------------------------------------------------------------------------------
+
+function Display:createTextLayout(...)
+	return Visual.textlayout(...)
+end
+
 -------------------------------------------------------------------------------
 --	font = Display:openFont(fontname): Opens the named font. For a discussion
 --	of the fontname format, see [[#tek.ui.class.text : Text]].
@@ -27,6 +27,17 @@
 --		- Drawable:setShift() - Add coordinate displacement
 --		- Drawable:getShift() - Get current displacement
 --		- Drawable:copyArea() - Copy area
+--		- Drawable:getExposures() - Get exposures from previous copies
+--		- Drawable:allocPixmap() - Allocate an offscreen pixmap
+--		- Drawable:freePixmap() - Free an offscreen pixmap
+--		- Drawable:pushTarget() - Redirect drawing into a pixmap
+--		- Drawable:popTarget() - Restore the previous rendering target
+--		- Drawable:drawPixmap() - Copy from a pixmap to the drawable
+--		- Drawable:drawNinePatch() - Draw a border from a pixmap
+--		- Drawable:flushPatches() - Free cached border pixmaps
+--		- Drawable:beginRecord() - Start recording a display list
+--		- Drawable:endRecord() - Finish recording a display list
+--		- Drawable:replayList() - Replay a display list
 --
 --	OVERRIDES::
 --		- Object.init()
@@ -35,20 +46,18 @@
 
 local ui = require "tek.ui"
 local Object = require "tek.class.object"
-local Region = require "tek.lib.region"
 
 local assert = assert
 local ipairs = ipairs
+local pairs = pairs
 local unpack = unpack
 local insert = table.insert
 local remove = table.remove
 local min = math.min
 local max = math.max
-local overlap = Region.overlapCoords
-local HUGE = ui.HUGE
 
 module("tek.ui.class.drawable", tek.class.object)
-_VERSION = "Drawable 7.0"
+_VERSION = "Drawable 9.0"
 
 DELAY = 0.003
 
@@ -70,9 +79,11 @@ function Drawable.init(self)
 	self.AspectY = 1
 	self.ShiftX = 0
 	self.ShiftY = 0
-	self.ClipStack = { }
-	self.ClipRect = { }
-	self.RectPool = { }
+	self.Target = false
+	self.TargetStack = { }
+	-- pixmaps of pre-rendered borders, see Border:drawPatch():
+	self.PatchCache = { }
+	self.NumPatches = 0
 	self.DebugPen1 = false
 	self.DebugPen2 = false
 	return Object.init(self)
@@ -121,12 +132,17 @@ function Drawable:open(title, w, h, minw, minh, maxw, maxh, x, y, center,
 			self.Pens[i] = penalloc[pentab[i]]
 		end
 
+		-- cached borders were rendered with the previous pens:
+		self.PatchCache = { }
+		self.NumPatches = 0
+
 		return true
 	end
 end
 
 function Drawable:close()
 	if self.Visual then
+		self:flushPatches()
 		self:getAttrs()
 		self.Visual:close()
 		self.Visual = false
@@ -226,24 +242,7 @@ end
 -------------------------------------------------------------------------------
 
 function Drawable:pushClipRect(x0, y0, x1, y1)
-	local cr = self.ClipRect
-	local sx = self.ShiftX
-	local sy = self.ShiftY
-	x0 = x0 + sx
-	y0 = y0 + sy
-	x1 = x1 + sx
-	y1 = y1 + sy
-	local r = remove(self.RectPool) or { }
-	r[1], r[2], r[3], r[4] = x0, y0, x1, y1
-	insert(self.ClipStack, r)
-	if cr[1] then
-		x0, y0, x1, y1 = overlap(x0, y0, x1, y1, cr[1], cr[2], cr[3], cr[4])
-		if not x0 then
-			x0, y0, x1, y1 = -1, -1, -1, -1
-		end
-	end
-	cr[1], cr[2], cr[3], cr[4] = x0, y0, x1, y1
-	self.Visual:setcliprect(x0, y0, x1 - x0 + 1, y1 - y0 + 1)
+	self.Visual:pushcliprect(x0, y0, x1, y1)
 end
 
 -------------------------------------------------------------------------------
@@ -251,26 +250,7 @@ end
 -------------------------------------------------------------------------------
 
 function Drawable:popClipRect()
-	local cs = self.ClipStack
-	local cr = self.ClipRect
-	insert(self.RectPool, remove(cs))
-	local x0, y0, x1, y1
-	if #cs > 0 then
-		x0, y0, x1, y1 = 0, 0, HUGE, HUGE
-		for i = 1, #cs do
-			x0, y0, x1, y1 = overlap(x0, y0, x1, y1, unpack(cs[i]))
-			if not x0 then
-				x0, y0, x1, y1 = -1, -1, -1, -1
-				break
-			end
-		end
-	end
-	cr[1], cr[2], cr[3], cr[4] = x0, y0, x1, y1
-	if x0 then
-		self.Visual:setcliprect(x0, y0, x1 - x0 + 1, y1 - y0 + 1)
-	else
-		self.Visual:unsetcliprect()
-	end
+	self.Visual:popcliprect()
 end
 
 -------------------------------------------------------------------------------
@@ -296,15 +276,154 @@ end
 -------------------------------------------------------------------------------
 --	Drawable:copyArea(x0, y0, x1, y1, deltax, deltay, exposures): Copy the
 --	specified rectangle to the position determined by the relative
---	coordinates {{deltax}} and {{deltay}}. The {{exposures}} argument is a
---	table used for collecting the raw coordinates of rectangles which got
---	exposed as a result of the copy operation.
+--	coordinates {{deltax}} and {{deltay}}. If the {{exposures}} argument is
+--	a table, it is used for collecting the raw coordinates of rectangles
+--	which got exposed as a result of the copy operation; this requires a
+--	round trip to the display. If it is '''true''', the copy is performed
+--	asynchronously, and its exposures can be retrieved later using
+--	Drawable:getExposures().
 -------------------------------------------------------------------------------
 
 function Drawable:copyArea(x0, y0, x1, y1, dx, dy, t)
 	self.Visual:copyarea(x0, y0, x1 - x0 + 1, y1 - y0 + 1, dx, dy, t)
 end
 
+-------------------------------------------------------------------------------
+--	exposures = Drawable:getExposures(): Returns a table with the raw
+--	coordinates of rectangles that got exposed by asynchronous copies
+--	which have completed in the meantime, or '''nil''' if there are none.
+--	The coordinates already account for all copies issued since. The
+--	arrival of new exposures is signalled by an empty refresh message,
+--	which should be waited for instead of polling this function, as it
+--	requires a round trip to the display.
+-------------------------------------------------------------------------------
+
+function Drawable:getExposures()
+	return self.Visual:getexposures()
+end
+
+-------------------------------------------------------------------------------
+--	pixmap = Drawable:allocPixmap(width, height): Allocates an offscreen
+--	pixmap of the given size. Returns '''nil''' if the display driver does
+--	not support offscreen pixmaps.
+-------------------------------------------------------------------------------
+
+function Drawable:allocPixmap(w, h)
+	return self.Visual:allocpixmap(w, h)
+end
+
+-------------------------------------------------------------------------------
+--	Drawable:freePixmap(pixmap): Frees a pixmap allocated with
+--	Drawable:allocPixmap().
+-------------------------------------------------------------------------------
+
+function Drawable:freePixmap(pm)
+	self.Visual:freepixmap(pm)
+end
+
+-------------------------------------------------------------------------------
+--	Drawable:pushTarget(pixmap): Redirects all subsequent drawing into the
+--	specified pixmap. The coordinate displacement and cliprect stack are
+--	saved and reset, so that the pixmap's origin is at 0, 0 and nothing is
+--	clipped. Must be paired with Drawable:popTarget().
+-------------------------------------------------------------------------------
+
+function Drawable:pushTarget(pm)
+	insert(self.TargetStack, { self.ShiftX, self.ShiftY, self.Target })
+	self.Target = pm
+	self.Visual:setshift(-self.ShiftX, -self.ShiftY)
+	self.ShiftX, self.ShiftY = 0, 0
+	-- push an unclipped level:
+	self.Visual:pushcliprect()
+	self.Visual:settarget(pm)
+end
+
+-------------------------------------------------------------------------------
+--	Drawable:popTarget(): Restores the rendering target, displacement and
+--	cliprect that were in effect before the last Drawable:pushTarget().
+-------------------------------------------------------------------------------
+
+function Drawable:popTarget()
+	local t = remove(self.TargetStack)
+	self.Visual:settarget(t[3] or nil)
+	self.Visual:setshift(t[1] - self.ShiftX, t[2] - self.ShiftY)
+	self.ShiftX, self.ShiftY, self.Target = t[1], t[2], t[3]
+	self.Visual:popcliprect()
+end
+
+-------------------------------------------------------------------------------
+--	Drawable:drawPixmap(pixmap, x0, y0, x1, y1, destx, desty): Copies the
+--	rectangle {{x0}}, {{y0}}, {{x1}}, {{y1}} from the pixmap to the
+--	position {{destx}}, {{desty}} on the current rendering target.
+-------------------------------------------------------------------------------
+
+function Drawable:drawPixmap(pm, x0, y0, x1, y1, dx, dy)
+	self.Visual:drawpixmap(pm, x0, y0, x1 - x0 + 1, y1 - y0 + 1, dx, dy)
+end
+
+-------------------------------------------------------------------------------
+--	Drawable:drawNinePatch(pixmap, b1, b2, b3, b4, x0, y0, x1, y1): Draws a
+--	border around the rectangle {{x0}}, {{y0}}, {{x1}}, {{y1}} from a
+--	pixmap which contains a border of the thicknesses {{b1}}, {{b2}},
+--	{{b3}}, {{b4}} (left, top, right, bottom) around a fixed-size center.
+--	Edges longer than the center are assembled from several pieces.
+-------------------------------------------------------------------------------
+
+function Drawable:drawNinePatch(pm, b1, b2, b3, b4, x0, y0, x1, y1)
+	self.Visual:drawninepatch(pm, b1, b2, b3, b4, x0, y0, x1, y1)
+end
+
+-------------------------------------------------------------------------------
+--	Drawable:flushPatches(): Frees all pixmaps in the Drawable's cache of
+--	pre-rendered borders. This must be called when the pens used for
+--	rendering borders are changed.
+-------------------------------------------------------------------------------
+
+function Drawable:flushPatches()
+	for key, pm in pairs(self.PatchCache) do
+		if pm then
+			self.Visual:freepixmap(pm)
+		end
+	end
+	self.PatchCache = { }
+	self.NumPatches = 0
+end
+
+-------------------------------------------------------------------------------
+--	success = Drawable:beginRecord(): Starts recording the subsequent
+--	drawing operations in a display list. Returns '''false''' if the
+--	drawing cannot be recorded, which is the case if a displacement is in
+--	effect or the rendering target is a pixmap.
+-------------------------------------------------------------------------------
+
+function Drawable:beginRecord()
+	if self.Target or self.ShiftX ~= 0 or self.ShiftY ~= 0 then
+		return false
+	end
+	self.Visual:beginrecord()
+	return true
+end
+
+-------------------------------------------------------------------------------
+--	list = Drawable:endRecord(): Finishes recording and returns the display
+--	list, or '''false''' if an operation could not be recorded.
+-------------------------------------------------------------------------------
+
+function Drawable:endRecord()
+	return self.Visual:endrecord() or false
+end
+
+-------------------------------------------------------------------------------
+--	success = Drawable:replayList(list): Performs the drawing operations
+--	recorded in a display list. Returns '''false''' if the list is no longer
+--	valid, e.g. because the Drawable was reopened or a pixmap referenced by
+--	the list was freed.
+-------------------------------------------------------------------------------
+
+function Drawable:replayList(dl)
+	return self.Visual:replay(dl)
+end
+
 function Drawable:fillRect_debug(...)
 	local x0, y0, x1, y1, p = ...
 	self.Visual:frect(x0, y0, x1, y1, self.DebugPen1)
@@ -14,13 +14,19 @@
 --
 --	OVERVIEW::
 --		Implements a scrollable text display. This class is
---		normally the direct child of a [[#tek.ui.class.canvas : Canvas]]
+--		normally the direct child of a [[#tek.ui.class.canvas : Canvas]].
+--		Only the lines intersecting with the visible part of the canvas
+--		are drawn. The text can be read from a file, which is processed
+--		in steps, so that large files can be viewed while they are loading.
 --
 --	ATTRIBUTES::
 --		- {{BGPen [IG]}}
 --			Pen for filling the background
 --		- {{FGPen [IG]}}
 --			Pen for rendering the text
+--		- {{File [ISG]}}
+--			Name of a file to be displayed. If set, it takes precedence
+--			over {{Text}}
 --		- {{FontSpec [IG]}}
 --			Font specifier; see [[#tek.ui.class.text : Text]] for a
 --			format description
@@ -28,6 +34,7 @@
 --			The text to be displayed
 --
 --	IMPLEMENTS::
+--		- FloatText:onSetFile() - Handler called when {{File}} is changed
 --		- FloatText:onSetText() - Handler called when {{Text}} is changed
 --
 --	OVERRIDES::
@@ -41,20 +48,18 @@
 --
 -------------------------------------------------------------------------------
 
+local db = require "tek.lib.debug"
 local ui = require "tek.ui"
 local Region = require "tek.lib.region"
 local Area = ui.Area
 
-local concat = table.concat
-local insert = table.insert
-local ipairs = ipairs
+local floor = math.floor
 local max = math.max
+local min = math.min
 local overlap = Region.overlapCoords
-local remove = table.remove
-local unpack = unpack
 
 module("tek.ui.class.floattext", tek.ui.class.area)
-_VERSION = "FloatText 3.1"
+_VERSION = "FloatText 4.1"
 
 local FloatText = _M
 
@@ -64,6 +69,10 @@ local FloatText = _M
 
 local DEF_MARGIN = { 0, 0, 0, 0 }
 local NOTIFY_TEXT = { ui.NOTIFY_SELF, "onSetText" }
+local NOTIFY_FILE = { ui.NOTIFY_SELF, "onSetFile" }
+
+-- number of bytes of a file to be processed per layout step:
+local FILE_STEP = 1048576
 
 -------------------------------------------------------------------------------
 --	Class implementation:
@@ -75,15 +84,19 @@ function FloatText.init(self)
 	self.CanvasHeight = false
 	self.FGPen = self.FGPen or ui.PEN_BUTTONTEXT
 	self.FHeight = false
+	self.File = self.File or false
 	self.Font = false
 	self.FontSpec = self.FontSpec or false
 	self.FWidth = false
-	self.Lines = false
+	self.LayoutWidth = false
+	self.Loading = false
 	self.Margin = DEF_MARGIN
+	self.NumLines = 0
+	self.TextLayout = false
+	self.TextX = 0
+	self.TextY = 0
 	self.TrackDamage = self.TrackDamage or true
 	self.UnusedRegion = false
-	self.WordLengths = false
-	self.WordSpacing = false
 	return Area.init(self)
 end
 
@@ -95,6 +108,7 @@ function FloatText:setup(app, window)
 	self.Canvas = self.Parent
 	Area.setup(self, app, window)
 	self:addNotify("Text", ui.NOTIFY_CHANGE, NOTIFY_TEXT)
+	self:addNotify("File", ui.NOTIFY_CHANGE, NOTIFY_FILE)
 end
 
 -------------------------------------------------------------------------------
@@ -102,6 +116,7 @@ end
 -------------------------------------------------------------------------------
 
 function FloatText:cleanup()
+	self:remNotify("File", ui.NOTIFY_CHANGE, NOTIFY_FILE)
 	self:remNotify("Text", ui.NOTIFY_CHANGE, NOTIFY_TEXT)
 	Area.cleanup(self)
 	self.Canvas = false
@@ -115,6 +130,7 @@ function FloatText:show(display, drawable)
 	if Area.show(self, display, drawable) then
 		self.Font = display:openFont(self.FontSpec)
 		self.FWidth, self.FHeight = ui.Display:getTextSize(self.Font, "W")
+		self.TextLayout = display:createTextLayout(self.Font)
 		self:prepareText()
 		return true
 	end
@@ -125,6 +141,9 @@ end
 -------------------------------------------------------------------------------
 
 function FloatText:hide()
+	self.TextLayout = false
+	self.LayoutWidth = false
+	self.NumLines = 0
 	self.Display:closeFont(self.Font)
 	self.Font = false
 	Area.hide(self)
@@ -145,27 +164,51 @@ function FloatText:draw()
 	if dr then
 		-- determine visible rectangle:
 		local ca = self.Canvas
+		local r = self.Rect
 		local x0 = ca and ca.CanvasLeft or 0
-		local x1 = ca and x0 + ca.CanvasWidth - 1 or self.Rect[3]
+		local x1 = ca and x0 + ca.CanvasWidth - 1 or r[3]
+		local v2, v4 = r[2], r[4]
+		if ca then
+			local cr = ca.Rect
+			v2 = ca.CanvasTop
+			v4 = v2 + cr[4] - cr[2]
+		end
 
 		local fp = p[self.FGPen]
+		local tl = self.TextLayout
+		local fh = self.FHeight
+		local tx, ty = self.TextX, self.TextY
+		local n = self.NumLines
 		d:setFont(self.Font)
 		for _, r in dr:getRects() do
 			local r1, r2, r3, r4 = dr:getRect(r)
-			d:pushClipRect(r1, r2, r3, r4)
-			for lnr, t in ipairs(self.Lines) do
-				-- overlap between damage and line:
-				if overlap(r1, r2, r3, r4, x0, t[2], x1, t[4]) then
-					-- draw line background:
-					d:fillRect(x0, t[2], x1, t[4], bp)
-					-- overlap between damage and text:
-					if overlap(r1, r2, r3, r4, t[1], t[2], t[3], t[4]) then
-						-- draw text:
-						d:drawText(t[1], t[2], t[5], fp)
+			-- lines have equal heights; determine the damaged and visible
+			-- range of lines directly from their positions:
+			local l0 = max(floor((max(r2, v2) - ty) / fh) + 1, 1)
+			local l1 = min(floor((min(r4, v4) - ty) / fh) + 1, n)
+			if l0 <= l1 then
+				d:pushClipRect(r1, r2, r3, r4)
+				local y0 = ty + (l0 - 1) * fh
+				for lnr = l0, l1 do
+					local y1 = y0 + fh - 1
+					-- overlap between damage and line:
+					if overlap(r1, r2, r3, r4, x0, y0, x1, y1) then
+						-- draw line background:
+						d:fillRect(x0, y0, x1, y1, bp)
+						-- overlap between damage and text:
+						local _, _, w = tl:getline(lnr)
+						if overlap(r1, r2, r3, r4, tx, y0, tx + w - 1, y1) then
+							-- draw text:
+							local text = tl:gettext(lnr)
+							if text then
+								d:drawText(tx, y0, text, fp)
+							end
+						end
 					end
+					y0 = y1 + 1
 				end
+				d:popClipRect()
 			end
-			d:popClipRect()
 		end
 		self.DamageRegion = false
 	end
@@ -185,18 +228,21 @@ end
 -------------------------------------------------------------------------------
 
 function FloatText:prepareText()
-	local lw = 0 -- longest word in text
-	local w, h
-	local wl = { }
-	self.WordLengths = wl
-	local i = 0
-	for spc, word in self.Text:gmatch("(%s*)([^%s]*)") do
-		w, h = ui.Display:getTextSize(self.Font, word)
-		lw = max(lw, w)
-		i = i + 1
-		wl[i] = w
+	local tl = self.TextLayout
+	local lw
+	if self.File then
+		-- the longest word is not known before the file is processed:
+		local success, msg = tl:setfile(self.File)
+		if not success then
+			db.warn("%s", msg)
+			tl:settext("")
+		end
+		lw = self.FWidth
+	else
+		-- width of the longest word in text:
+		lw = tl:settext(self.Text)
 	end
-	self.WordSpacing = ui.Display:getTextSize(self.Font, " ")
+	local h = self.FHeight
 	self.MinWidth, self.MinHeight = lw, h
 	return lw, h
 end
@@ -217,56 +263,29 @@ end
 --	layoutText: internal
 -------------------------------------------------------------------------------
 
-local function insline(text, line, x, y, tw, so, fh)
-	line = line and concat(line, " ")
-	insert(text, { x, y, x + tw + so - 1, y + fh - 1, line })
-end
-
-function FloatText:layoutText(x, y, width, text)
-	text = text or { }
-
-	local line = false
-	local fh = self.FHeight
-	local tw = 0
-	local i = 0
-	local wl = self.WordLengths
-	local ws = self.WordSpacing
-	local so = 0
-
-	for spc, word in self.Text:gmatch("(%s*)([^%s]*)") do
-		for s in spc:gmatch("%s") do
-			if s == "\n" then
-				insline(text, line, x, y, tw, so, fh)
-				y = y + fh
-				line = false
-				so = 0
-				tw = 0
+-- Lines are broken by the text layout object, which retains the lines of
+-- unchanged paragraphs and only reflows the text if width or text changed.
+-- A file is processed in steps; as long as it is incomplete, another step
+-- is scheduled in a coroutine. Returns the height of the text and the
+-- first line that has changed, or false.
+
+function FloatText:layoutText(x, y, width)
+	local tl = self.TextLayout
+	local n, first, done = tl:layout(width, self.File and FILE_STEP)
+	self.NumLines = n
+	self.LayoutWidth = width
+	self.TextX, self.TextY = x, y
+	if not done and not self.Loading then
+		self.Loading = true
+		self.Application:addCoroutine(function()
+			self.Loading = false
+			if self.TextLayout == tl then
+				self.CanvasHeight = false
+				self:rethinkLayout(false)
 			end
-		end
-		if word then
-			line = line or { }
-			insert(line, word)
-			i = i + 1
-			tw = tw + wl[i]
-			if tw + so > width then
-				if #line > 0 then
-					remove(line)
-					insline(text, line, x, y, tw, so, fh)
-					y = y + fh
-				end
-				line = { word }
-				so = 0
-				tw = wl[i]
-			end
-			so = so + ws
-		end
-	end
-	if line and #line > 0 then
-		insline(text, line, x, y, tw, so, fh)
-		y = y + fh
+		end)
 	end
-
-	return text, y
+	return y + n * self.FHeight, first
 end
 
 -------------------------------------------------------------------------------
@@ -282,20 +301,33 @@ function FloatText:layout(r1, r2, r3, r4, markdamage)
 	local x0 = r1 + m[1]
 	local y0 = r2 + m[2]
 	local x1 = r3 - m[3]
-	if not ch or (r[1] and r[3] - r[1] + 1 ~= width) then
-		self.Lines, ch = self:layoutText(r1, r2, width)
+	local dy = false
+	local lw = self.LayoutWidth
+	if not ch or width ~= lw then
+		local first
+		ch, first = self:layoutText(r1, r2, width)
 		self.CanvasHeight = ch
-		redraw = true
+		if width ~= lw then
+			redraw = true
+		elseif first then
+			-- same width; only lines from the first changed one are damaged:
+			dy = max(y0, self.TextY + (first - 1) * self.FHeight)
+		end
 	end
 	local y1 = self.Canvas and r2 + ch - 1 - m[4] or r4 - m[4]
-	if redraw or markdamage or
+	if redraw or dy or markdamage or
 		r[1] ~= x0 or r[2] ~= y0 or r[3] ~= x1 or r[4] ~= y1 then
 		if self.Canvas then
 			self.Canvas:setValue("CanvasHeight", self.CanvasHeight)
 		end
-		self.DamageRegion = Region.new(x0, y0, x1, y1)
 		if not markdamage and not redraw and r[1] == x0 and r[2] == y0 then
+			self.DamageRegion = Region.new(x0, y0, x1, y1)
 			self.DamageRegion:subRect(r[1], r[2], r[3], r[4])
+			if dy and dy <= y1 then
+				self.DamageRegion:orRect(x0, dy, x1, y1)
+			end
+		else
+			self.DamageRegion = Region.new(x0, y0, x1, y1)
 		end
 		r[1], r[2], r[3], r[4] = x0, y0, x1, y1
 		self:updateUnusedRegion()
@@ -317,11 +349,21 @@ end
 -------------------------------------------------------------------------------
 
 function FloatText:onSetText()
-	self:prepareText()
+	if self.TextLayout then
+		self:prepareText()
+	end
 	self.CanvasHeight = false
 	self:rethinkLayout(2)
 end
 
+-------------------------------------------------------------------------------
+--	onSetFile(file): Handler called when a new {{File}} is set.
+-------------------------------------------------------------------------------
+
+function FloatText:onSetFile()
+	self:onSetText()
+end
+
 -------------------------------------------------------------------------------
 --	updateUnusedRegion: internal
 -------------------------------------------------------------------------------
@@ -58,6 +58,7 @@
 --
 --	OVERRIDES::
 --		- Area:askMinMax()
+--		- Area:checkRedraw()
 --		- Element:cleanup()
 --		- Area:draw()
 --		- Area:hide()
@@ -80,7 +81,7 @@ local max = math.max
 local unpack = unpack
 
 module("tek.ui.class.frame", tek.ui.class.area)
-_VERSION = "Frame 2.11"
+_VERSION = "Frame 2.13"
 
 local Frame = _M
 
@@ -234,8 +235,8 @@ end
 --	markDamage: overrides
 -------------------------------------------------------------------------------
 
-function Frame:markDamage(r1, r2, r3, r4)
-	Area.markDamage(self, r1, r2, r3, r4)
+function Frame:markDamage(r1, r2, r3, r4, expose)
+	Area.markDamage(self, r1, r2, r3, r4, expose)
 	if self.BorderRegion and
 		self.BorderRegion:checkOverlap(r1, r2, r3, r4) then
 		self.RedrawBorder = true
@@ -289,6 +290,14 @@ function Frame:draw()
 	self.IBorderClass:draw(self, self.IBorder, b1, b2, b3, b4)
 end
 
+-------------------------------------------------------------------------------
+--	checkRedraw: overrides
+-------------------------------------------------------------------------------
+
+function Frame:checkRedraw()
+	return self.RedrawBorder or Area.checkRedraw(self)
+end
+
 -------------------------------------------------------------------------------
 --	refresh: overrides
 -------------------------------------------------------------------------------
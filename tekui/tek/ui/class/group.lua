@@ -86,7 +86,7 @@ local floor = math.floor
 local ipairs = ipairs
 
 module("tek.ui.class.group", tek.ui.class.gadget)
-_VERSION = "Group 12.0"
+_VERSION = "Group 12.1"
 local Group = _M
 
 -------------------------------------------------------------------------------
@@ -301,11 +301,11 @@ end
 --	markDamage: overrides
 -------------------------------------------------------------------------------
 
-function Group:markDamage(r1, r2, r3, r4)
-	Gadget.markDamage(self, r1, r2, r3, r4)
+function Group:markDamage(r1, r2, r3, r4, expose)
+	Gadget.markDamage(self, r1, r2, r3, r4, expose)
 	self.Redraw = self.Redraw or self.FreeRegion:checkOverlap(r1, r2, r3, r4)
 	for _, c in ipairs(self.Children) do
-		c:markDamage(r1, r2, r3, r4)
+		c:markDamage(r1, r2, r3, r4, expose)
 	end
 end
 
@@ -54,7 +54,9 @@
 --			initial column widths.
 --		- {{ListObject [IG]}} ([[#tek.class.list : List]])
 --			The List object the ListGadget operates on; if none is specified,
---			the ListGadget creates an empty one.
+--			the ListGadget creates an empty one. Alternatively, a native list
+--			model created by {{tek.lib.listmodel.new()}} can be used, which
+--			stores large lists far more compactly.
 --		- {{NumSelectedLines [G]}} (number)
 --			The number of lines currently selected.
 --		- {{SelectedLines [G]}} (table)
@@ -72,6 +74,7 @@
 --
 --	IMPLEMENTS::
 --		- ListGadget:addItem(): Adds an item to the list
+--		- ListGadget:addItems(): Adds multiple items to the list
 --		- ListGadget:changeItem(): Overwrite item in the list
 --		- ListGadget:changeSelection(): Changes selection of the list
 --		- ListGadget:damageLine(): Marks line for repainting
@@ -81,6 +84,7 @@
 --		- ListGadget:onSetCursor(): Handler invoked for {{CursorLine}}
 --		- ListGadget:repaint(): Relayouts and repaints the list
 --		- ListGadget:remItem(): Removes an item from the list
+--		- ListGadget:remItems(): Removes multiple items from the list
 --		- ListGadget:setList(): Sets a new list object
 --
 --	OVERRIDES::
@@ -119,12 +123,13 @@ local min = math.min
 local overlap = Region.overlapCoords
 local pairs = pairs
 local remove = table.remove
+local select = select
 local tostring = tostring
 local type = type
 local unpack = unpack
 
 module("tek.ui.class.listgadget", tek.ui.class.gadget)
-_VERSION = "ListGadget 9.0"
+_VERSION = "ListGadget 10.1"
 local ListGadget = _M
 
 -------------------------------------------------------------------------------
@@ -164,6 +169,7 @@ function ListGadget.init(self)
 	self.FWidth = false
 	self.HeaderGroup = self.HeaderGroup or false
 	self.Margin = DEF_NULL
+	self.MeasuredWidths = { }
 	self.Mode = "button"
 	self.IBorder = DEF_NULL
 	self.IBorderStyle = false
@@ -191,8 +197,7 @@ function ListGadget:initSelectedLines()
 	local lo = self.ListObject
 	if lo then
 		for lnr = 1, lo:getN() do
-			local l = lo:getItem(lnr)
-			if l[3] then
+			if lo:isSelected(lnr) then
 				n = n + 1
 				s[lnr] = lnr
 			end
@@ -225,6 +230,10 @@ function ListGadget:show(display, drawable)
 		self.Font = display:openFont(self.FontSpec)
 		self.FWidth, self.FHeight = Display:getTextSize(self.Font, "x")
 		self.ColumnPadding = self.ColumnPadding or self.FWidth
+		-- cached widths may have been measured using another font:
+		if self.ListObject then
+			self.ListObject:clearCellWidths()
+		end
 		self:prepare(false)
 		return true
 	end
@@ -249,15 +258,16 @@ end
 -------------------------------------------------------------------------------
 
 function ListGadget:getLineOnScreen(lnr)
-	local l = self.ListObject and self.ListObject:getItem(lnr)
-	if l then
+	local lo = self.ListObject
+	if lo and lo:checkPosition(lnr) then
+		local y0, y1 = lo:getLineRange(lnr)
 		local c = self.Canvas
 		local r = c.Rect
 		local v1 = c.CanvasLeft
 		local v2 = c.CanvasTop
 		local v3 = v1 + r[3] - r[1]
 		local v4 = v2 + r[4] - r[2]
-		return overlap(v1, v2, v3, v4, 0, l[4], c.CanvasWidth - 1, l[5])
+		return overlap(v1, v2, v3, v4, 0, y0, c.CanvasWidth - 1, y1)
 	end
 end
 
@@ -347,6 +357,99 @@ function ListGadget:remItem(lnr, quick)
 	end
 end
 
+-------------------------------------------------------------------------------
+--	ListGadget:addItems(items[, line[, quick]]): Adds an array of items to
+--	the list in a single operation. If {{line}} is unspecified, the items
+--	are added at the end of the list. Entries in the array that are not
+--	tables are replaced by items containing their string representation.
+--	Unless the boolean {{quick}} is given, only the added items are
+--	measured, and only the lines from the insertion point are repainted.
+-------------------------------------------------------------------------------
+
+function ListGadget:addItems(entries, lnr, quick)
+	local lo = self.ListObject
+	local n = #entries
+	if lo and n > 0 then
+		for i = 1, n do
+			if type(entries[i]) ~= "table" then
+				entries[i] = { { tostring(entries[i]) } }
+			end
+		end
+		self:shiftSelection(lnr, n)
+		lnr = lo:addItems(entries, lnr)
+		local s = self.SelectedLines
+		for i = 1, n do
+			if entries[i][3] then
+				s[lnr + i - 1] = lnr + i - 1
+				self.NumSelectedLines = self.NumSelectedLines + 1
+			end
+		end
+		-- keep cursor and selected line on their items:
+		if self.CursorLine >= lnr then
+			self.CursorLine = self.CursorLine + n
+		end
+		if self.SelectedLine >= lnr then
+			self.SelectedLine = self.SelectedLine + n
+		end
+		if not quick then
+			self:prepare(true, lnr, n)
+		end
+	end
+end
+
+-------------------------------------------------------------------------------
+--	num = ListGadget:remItems(line, count[, quick]): Removes up to
+--	{{count}} items from the list, starting at the specified line, in a
+--	single operation. Returns the number of items removed. Unless the
+--	boolean {{quick}} is given, the lines from the removal point are
+--	relayouted and repainted; column widths are not reduced until the
+--	list is repainted as a whole (see ListGadget:repaint()).
+-------------------------------------------------------------------------------
+
+function ListGadget:remItems(lnr, num, quick)
+	local lo = self.ListObject
+	if lo then
+		local numl = lo:getN()
+		if lnr < 1 or lnr > numl or num <= 0 then
+			return 0
+		end
+		num = min(num, numl - lnr + 1)
+		local s = { }
+		local ns = 0
+		for line in pairs(self.SelectedLines) do
+			if line < lnr then
+				s[line] = line
+				ns = ns + 1
+			elseif line >= lnr + num then
+				s[line - num] = line - num
+				ns = ns + 1
+			end
+		end
+		self.SelectedLines, self.NumSelectedLines = s, ns
+		num = lo:remItems(lnr, num)
+		numl = numl - num
+		-- keep cursor and selected line on their items, if possible:
+		local cl = self.CursorLine
+		if cl >= lnr + num then
+			self.CursorLine = cl - num
+		elseif cl >= lnr then
+			self.CursorLine = min(lnr, numl)
+		end
+		local sl = self.SelectedLine
+		if sl >= lnr + num then
+			self.SelectedLine = sl - num
+		elseif sl >= lnr then
+			self.SelectedLine = 0
+		end
+		if not quick then
+			self:prepare(true, lnr, 0)
+			self:moveLine()
+		end
+		return num
+	end
+	return 0
+end
+
 -------------------------------------------------------------------------------
 --	ListGadget:changeItem(item, line[, quick]): Overwrites the item at the
 --	specified line in the list. The boolean {{quick}} indicates that the list
@@ -369,11 +472,18 @@ end
 
 -------------------------------------------------------------------------------
 --	ListGadget:setList(listobject): Sets a new [[#tek.class.list : List]]
---	object, and relayouts and repaints the list.
+--	object, and relayouts and repaints the list. Setting the current list
+--	object again re-examines its contents, e.g. after a native list model
+--	was sorted or filtered; only lines not measured before will then be
+--	measured.
 -------------------------------------------------------------------------------
 
 function ListGadget:setList(listobject)
-	assert(not listobject or listobject:checkDescend(List))
+	assert(not listobject or type(listobject) == "userdata" or
+		listobject:checkDescend(List))
+	if listobject and listobject ~= self.ListObject then
+		listobject:clearCellWidths()
+	end
 	self.ListObject = listobject
 	self:initSelectedLines()
 	self:prepare(true)
@@ -388,43 +498,70 @@ function ListGadget:repaint()
 end
 
 -------------------------------------------------------------------------------
---	prepare: internal
+--	prepare: internal. If {{first}} is specified, only the {{num}} lines
+--	starting at {{first}} are measured, lines following them are moved, and
+--	column widths from the previous run are retained.
 -------------------------------------------------------------------------------
 
-function ListGadget:prepare(damage)
+function ListGadget:prepare(damage, first, num)
 	local lo = self.ListObject
 	if lo and self.Display then
 		local b1, b2, b3, b4 =
 			self.CursorBorderClass:getBorder(self, self.CursorBorder)
 		local f = self.Font
-		local cw = { }
-		self.ColumnWidths = cw
+		local fh = self.FHeight
 		local cp = self.ColumnPositions
-		local nc = 0
-		local y = 0
+		local numl = lo:getN()
 		local hg = self.HeaderGroup
+		local mw, nc, y
 
-		-- initialize column widths with head item sizes:
-		if hg then
-			for i, e in ipairs(hg.Children) do
-				cw[i] = max(e:askMinMax(0, 0, 0, 0) - self.ColumnPadding, 0)
+		if first then
+			-- incremental:
+			mw = self.MeasuredWidths
+			nc = self.NumColumns
+			y = first > 1 and select(2, lo:getLineRange(first - 1)) + 1 or 0
+		else
+			first, num = 1, numl
+			mw = { }
+			nc = 0
+			y = 0
+			-- initialize column widths with head item sizes:
+			if hg then
+				for i, e in ipairs(hg.Children) do
+					mw[i] = max(e:askMinMax(0, 0, 0, 0) - self.ColumnPadding, 0)
+				end
 			end
 		end
-
-		for lnr = 1, lo:getN() do
-			local l = lo:getItem(lnr)
-			local columns = l[1]
-			nc = max(nc, #columns)
-			local h, w = 0
-			for i, t in ipairs(columns) do
-				w, h = Display:getTextSize(f, columns[i])
-				cw[i] = max(cw[i] or 0, w)
+		self.MeasuredWidths = mw
+
+		local y0 = y
+		local last = first + num - 1
+		for lnr = first, numl do
+			local ncl = lo:getNumColumns(lnr)
+			if lnr <= last then
+				nc = max(nc, ncl)
+				for i = 1, ncl do
+					-- widths are cached by the list, if it supports it:
+					local w = lo:getCellWidth(lnr, i)
+					if not w then
+						w = Display:getTextSize(f, lo:getCell(lnr, i) or "")
+						lo:setCellWidth(lnr, i, w)
+					end
+					mw[i] = max(mw[i] or 0, w)
+				end
 			end
-			h = h + b2 + b4
-			l[4], l[5] = y, y + h - 1
+			local h = (ncl > 0 and fh or 0) + b2 + b4
+			lo:setLineRange(lnr, y, y + h - 1)
 			y = y + h
 		end
 
+		-- layout columns using a copy of the measured widths:
+		local cw = { }
+		for i = 1, #mw do
+			cw[i] = mw[i]
+		end
+		self.ColumnWidths = cw
+
 
 		if self.AlignColumn then
 			local ae = self.AlignElement or self.Canvas
@@ -483,12 +620,25 @@ function ListGadget:prepare(damage)
 
 		c:setValue("CanvasWidth", cx + b1 + b3)
 
-		if self:layout(0, 0, c.CanvasWidth - 1, c.CanvasHeight - 1, damage)
-			and damage then
+		local incremental = damage and num ~= numl and not redraw
+		if self:layout(0, 0, c.CanvasWidth - 1, c.CanvasHeight - 1,
+			damage and not incremental) and damage then
 			c:rethinkLayout()
 			self.Redraw = true
 		end
 
+		if incremental then
+			-- damage the visible part of the list below the first change:
+			local r = c.Rect
+			local v1 = c.CanvasLeft
+			local v2 = c.CanvasTop
+			local r1, r2, r3, r4 = overlap(v1, v2, v1 + r[3] - r[1],
+				v2 + r[4] - r[2], 0, y0, c.CanvasWidth - 1, max(y, y0) - 1)
+			if r1 then
+				self:markDamage(r1, r2, r3, r4)
+			end
+		end
+
 		if damage then
 			c:updateUnusedRegion()
 		end
@@ -528,48 +678,54 @@ function ListGadget:draw()
 		local cl = self.CursorLine
 		local cp = self.ColumnPositions
 		local nc = #cp
+		local numl = lo:getN()
 
 		for _, r in dr:getRects() do
 			local r1, r2, r3, r4 = dr:getRect(r)
 			d:pushClipRect(r1, r2, r3, r4)
-			for lnr = 1, lo:getN() do
+			-- visit only the lines overlapping the damage vertically:
+			for lnr = lo:searchLine(r2), numl do
+				local y0, y1 = lo:getLineRange(lnr)
+				if y0 > r4 then
+					break
+				end
 				local bpen = bpens[(lnr - 1) % 2]
-				local l = lo:getItem(lnr)
+				local sel = lo:isSelected(lnr)
 				-- overlap between damage and line:
-				if overlap(r1, r2, r3, r4, 0, l[4], x1, l[5]) then
+				if overlap(r1, r2, r3, r4, 0, y0, x1, y1) then
 					if lnr == cl then
 						-- with cursor:
 						d:popClipRect()
-						d:fillRect(b1, l[4] + b2, x1 - b3, l[5] - b4,
-							l[3] and cpen or bpen)
+						d:fillRect(b1, y0 + b2, x1 - b3, y1 - b4,
+							sel and cpen or bpen)
 						for ci = 1, nc do
-							local text = l[1][ci]
+							local text = lo:getCell(lnr, ci)
 							if text then
 								local cx = cp[ci]
-								d:pushClipRect(b1 + cx, l[4] + b2,
-									b1 + cx + self.ColumnWidths[ci], l[5] - b4)
-								d:drawText(b1 + cx, l[4] + b2, l[1][ci],
-									l[3] and cfpen or fpen)
+								d:pushClipRect(b1 + cx, y0 + b2,
+									b1 + cx + self.ColumnWidths[ci], y1 - b4)
+								d:drawText(b1 + cx, y0 + b2, text,
+									sel and cfpen or fpen)
 								d:popClipRect()
 							end
 						end
-						cbc:draw(self, cb, b1, l[4] + b2, x1 - b3, l[5] - b4)
+						cbc:draw(self, cb, b1, y0 + b2, x1 - b3, y1 - b4)
 						d:pushClipRect(r1, r2, r3, r4)
 					else
 						-- without cursor:
-						d:fillRect(0, l[4], x1, l[5], l[3] and cpen or bpen)
+						d:fillRect(0, y0, x1, y1, sel and cpen or bpen)
 						for ci = 1, nc do
-							local text = l[1][ci]
+							local text = lo:getCell(lnr, ci)
 							if text then
 								local cx = cp[ci]
-								if overlap(r1, r2, r3, r4, cx, l[4],
-									cx + self.ColumnWidths[ci] - 1, l[5]) then
-									d:pushClipRect(b1 + cx, l[4] + b2,
+								if overlap(r1, r2, r3, r4, cx, y0,
+									cx + self.ColumnWidths[ci] - 1, y1) then
+									d:pushClipRect(b1 + cx, y0 + b2,
 										b1 + cx + self.ColumnWidths[ci],
-										l[5] - b4)
+										y1 - b4)
 									-- draw text:
-									d:drawText(b1 + cx, l[4] + b2, l[1][ci],
-										l[3] and cfpen or fpen)
+									d:drawText(b1 + cx, y0 + b2, text,
+										sel and cfpen or fpen)
 									d:popClipRect()
 								end
 							end
@@ -643,9 +799,8 @@ function ListGadget:onSelectLine(lnr, oldlnr)
 	if lo then
 		local m = self.SelectMode
 		if m == "single" and oldlnr ~= lnr then
-			local oe = lo:checkPosition(oldlnr) and lo:getItem(oldlnr)
-			if oe then
-				oe[3] = false
+			if lo:checkPosition(oldlnr) then
+				lo:setSelected(oldlnr, false)
 				if self.SelectedLines[oldlnr] then
 					self.SelectedLines[oldlnr] = nil
 					self.NumSelectedLines = self.NumSelectedLines - 1
@@ -654,10 +809,10 @@ function ListGadget:onSelectLine(lnr, oldlnr)
 			end
 		end
 		if m == "single" or m == "multi" then
-			local ne = lo:checkPosition(lnr) and lo:getItem(lnr)
-			if ne then
-				ne[3] = not ne[3]
-				if ne[3] then
+			if lo:checkPosition(lnr) then
+				local sel = not lo:isSelected(lnr)
+				lo:setSelected(lnr, sel)
+				if sel then
 					assert(not self.SelectedLines[lnr])
 					self.SelectedLines[lnr] = lnr
 					self.NumSelectedLines = self.NumSelectedLines + 1
@@ -685,16 +840,13 @@ function ListGadget:moveLine(lnr, follow)
 	local ca = self.Canvas
 	local x1 = ca.CanvasWidth - 1
 	local cl = self.CursorLine
-	if cl >= 0 then
-		local ol = lo:getItem(cl)
-		if ol then
-			self:markDamage(0, ol[4], x1, ol[5])
-		end
+	if lo:checkPosition(cl) then
+		local y0, y1 = lo:getLineRange(cl)
+		self:markDamage(0, y0, x1, y1)
 	end
 
-	local l = lnr and lo:getItem(lnr)
-	if l then
-		local y0, y1 = l[4], l[5]
+	if lo:checkPosition(lnr) then
+		local y0, y1 = lo:getLineRange(lnr)
 		self:markDamage(0, y0, x1, y1)
 		if y1 < ca.CanvasTop then
 			y = y0
@@ -720,11 +872,9 @@ end
 function ListGadget:findLine(y)
 	local lo = self.ListObject
 	if lo then
-		for lnr = 1, lo:getN() do
-			local l = lo:getItem(lnr)
-			if y >= l[4] and y <= l[5] then
-				return lnr
-			end
+		local lnr = lo:searchLine(y)
+		if lo:checkPosition(lnr) and y >= lo:getLineRange(lnr) then
+			return lnr
 		end
 	end
 end
@@ -740,8 +890,7 @@ function ListGadget:changeSelection(mode)
 	if lo then
 		if mode == "none" then
 			for lnr = 1, lo:getN() do
-				local l = lo:getItem(lnr)
-				if l[3] then
+				if lo:isSelected(lnr) then
 					self:setValue("SelectedLine", lnr)
 				end
 			end
@@ -772,7 +921,7 @@ function ListGadget:passMsg(msg)
 								s, e = e, s
 							end
 							for i = s, e do
-								if not self:getItem(i)[3] then
+								if not self.ListObject:isSelected(i) then
 									self:setValue("SelectedLine", i)
 								end
 							end
@@ -819,8 +968,8 @@ function ListGadget:handleInput(msg)
 					if qual == 4 or qual == 8 then
 						self:moveLine(numl, true)
 					else
-						local entry = self:getItem(lnr)
-						local y0 = entry and entry[4] or self.CanvasTop
+						local y0 = lo:checkPosition(lnr) and
+							lo:getLineRange(lnr) or self.CanvasTop
 						local l1 = self:findLine(y0 + getheight(self)) or numl
 						self:moveLine(l1, true)
 					end
@@ -828,8 +977,8 @@ function ListGadget:handleInput(msg)
 					if qual == 4 or qual == 8 then
 						self:moveLine(1, true)
 					else
-						local entry = self:getItem(lnr)
-						local y0 = entry and entry[4] or self.CanvasTop
+						local y0 = lo:checkPosition(lnr) and
+							lo:getLineRange(lnr) or self.CanvasTop
 						local l1 = self:findLine(y0 - getheight(self)) or 1
 						self:moveLine(l1, true)
 					end
@@ -51,7 +51,7 @@ local tostring = tostring
 local type = type
 
 module("tek.ui.class.pagegroup", tek.ui.class.group)
-_VERSION = "PageGroup 5.0"
+_VERSION = "PageGroup 5.1"
 local PageGroup = _M
 
 -------------------------------------------------------------------------------
@@ -197,10 +197,10 @@ end
 --	markDamage: mark damage in self and Children
 -------------------------------------------------------------------------------
 
-function PageGroup:markDamage(r1, r2, r3, r4)
-	Gadget.markDamage(self, r1, r2, r3, r4)
+function PageGroup:markDamage(r1, r2, r3, r4, expose)
+	Gadget.markDamage(self, r1, r2, r3, r4, expose)
 	self.Redraw = self.Redraw or self.FreeRegion:checkOverlap(r1, r2, r3, r4)
-	self.PageElement:markDamage(r1, r2, r3, r4)
+	self.PageElement:markDamage(r1, r2, r3, r4, expose)
 end
 
 -------------------------------------------------------------------------------
@@ -42,6 +42,7 @@
 --			Note: The use of the "auto" mode is currently (v8.0) discouraged.
 --
 --	OVERRIDES::
+--		- Area:checkRedraw()
 --		- Element:cleanup()
 --		- Area:layout()
 --		- Class.new()
@@ -67,7 +68,7 @@ local type = type
 local unpack = unpack
 
 module("tek.ui.class.scrollgroup", tek.ui.class.group)
-_VERSION = "ScrollGroup 8.2"
+_VERSION = "ScrollGroup 8.4"
 
 -------------------------------------------------------------------------------
 --	ScrollGroup:
@@ -283,6 +284,14 @@ function ScrollGroup:onSetCanvasTop(y, oy)
 	end
 end
 
+-------------------------------------------------------------------------------
+--	checkRedraw: overrides - pending scroll operations draw, too
+-------------------------------------------------------------------------------
+
+function ScrollGroup:checkRedraw()
+	return #self.CopyAreaList > 0 or Group.checkRedraw(self)
+end
+
 -------------------------------------------------------------------------------
 --	exposeArea:
 -------------------------------------------------------------------------------
@@ -390,17 +399,11 @@ function ScrollGroup:refresh()
 
 					d:pushClipRect(a1, a2, a3, a4)
 
-					-- copy area, collecting exposures from obscured regions:
-
-					local t = { }
+					-- copy area; exposures from obscured regions are
+					-- collected asynchronously and delivered to the window
+					-- as damage on the next refresh:
 
-					self:copyArea(a1, a2, a3, a4, a1 + dx, a2 + dy, t)
-
-					-- exposures resulting from obscured areas (make relative):
-					for i = 1, #t, 4 do
-						self:exposeArea(t[i] - sx, t[i+1] - sy,
-							t[i+2] - sx, t[i+3] - sy)
-					end
+					self:copyArea(a1, a2, a3, a4, a1 + dx, a2 + dy, true)
 
 					-- exposures resulting from areas shifting into canvas:
 					for _, r in dr:getRects() do
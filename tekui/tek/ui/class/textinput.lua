@@ -17,6 +17,10 @@
 --
 --	OVERVIEW::
 --		This class implements a gadget for editing and entering text.
+--		The text is held in a native gap buffer, {{tek.lib.textbuffer}}. Edits
+--		and cursor movements repaint only the characters from the first
+--		changed position, and the blinking cursor repaints only its own
+--		character cell.
 --
 --	ATTRIBUTES::
 --		- {{Enter [ISG]}} - Text that is being 'entered' (by pressing the
@@ -27,6 +31,7 @@
 --
 --	OVERRIDES::
 --		- Area:askMinMax()
+--		- Area:checkRedraw()
 --		- Element:cleanup()
 --		- Area:draw()
 --		- Element:hide()
@@ -35,6 +40,7 @@
 --		- Gadget:onSelect()
 --		- Text:onSetText()
 --		- Area:passMsg()
+--		- Area:refresh()
 --		- Area:setState()
 --		- Element:setup()
 --		- Element:show()
@@ -47,7 +53,7 @@ local Area = ui.Area
 local Display = ui.Display
 local Gadget = ui.Gadget
 local Text = ui.Text
-local UTF8String = require "tek.class.utf8string"
+local TextBuffer = require "tek.lib.textbuffer"
 
 local char = string.char
 local floor = math.floor
@@ -56,7 +62,7 @@ local max = math.max
 local unpack = unpack
 
 module("tek.ui.class.textinput", tek.ui.class.text)
-_VERSION = "TextInput 4.3"
+_VERSION = "TextInput 5.1"
 
 -------------------------------------------------------------------------------
 --	Constants & Class data:
@@ -76,17 +82,24 @@ function TextInput.init(self)
 	self.BlinkState = false
 	self.BlinkTick = false
 	self.BlinkTickInit = false
+	-- cursor damaged:
+	self.CursorDamage = false
+	-- offset and cursor position of the text when it was last drawn:
+	self.DrawnCursor = false
+	self.DrawnOffset = false
 	self.Editing = false
 	self.Enter = false
 	self.FHeight = false
 	self.FWidth = false
 	self.IntervalNotify = { self, "interval" }
 	self.Text = self.Text or ""
-	self.TextBuffer = UTF8String:new(self.Text)
+	self.TextBuffer = TextBuffer.new(self.Text)
 	self.Mode = "touch"
 	self.ShortcutMark = false
 	-- cursor position in characters:
 	self.TextCursor = self.TextCursor or self.TextBuffer:len() + 1
+	-- first changed character in the text, or false:
+	self.TextDamage = false
 	-- character offset in displayed text:
 	self.TextOffset = false
 	-- rectangle of text:
@@ -159,25 +172,18 @@ function TextInput:askMinMax(m1, m2, m3, m4)
 end
 
 -------------------------------------------------------------------------------
---	draw: overrides
+--	layoutText: internal - determines the visible part of the text and the
+--	cursor position. Returns the visible width in characters, including
+--	the cursor.
 -------------------------------------------------------------------------------
 
-function TextInput:draw()
-
-	Area.draw(self)
+function TextInput:layoutText()
 
 	local r = self.Rect
-	local d = self.Drawable
-	local pens = d.Pens
-	local bgpen = pens[self.Background]
-
 	local tr = self.TextRect
 	local to = self.TextOffset
 	local tc = self.TextCursor
 
-	local text = self.TextRecords[1]
-	d:setFont(text[2])
-
 	local fw, fh = self.FWidth, self.FHeight
 	local p = self.PaddingAndBorder
 	local w = r[3] - r[1] + 1 - p[1] - p[3]
@@ -208,37 +214,142 @@ function TextInput:draw()
 	-- actual visible TextWidth (including cursor) in characters:
 	local twc = min(tw, clen)
 
-	-- actual visible TextWidth in pixels:
-	tw = twc * fw
-
-	-- the visible text:
-	text = self.TextBuffer:sub(to + 1, to + twc)
-
 	-- visible text rect, left aligned:
 	tr[1] = r[1] + p[1] -- centered: + (w - tw) / 2
 	tr[2] = r[2] + p[2] + floor((h - fh) / 2)
-	tr[3] = tr[1] + tw - 1
+	tr[3] = tr[1] + twc * fw - 1
 	tr[4] = tr[2] + fh - 1
 
-	local x, y = tr[1], tr[2]
+	return twc
+end
 
-	if self.Disabled then
-		d:drawText(x + 1, y + 1, text, pens[ui.PEN_BUTTONDISABLEDSHINE])
-		d:drawText(x, y, text, pens[ui.PEN_BUTTONDISABLEDSHADOW])
+-------------------------------------------------------------------------------
+--	drawCell: internal - draws the character in a cell, as cursor or text
+-------------------------------------------------------------------------------
+
+function TextInput:drawCell(c, cursor)
+	local d = self.Drawable
+	local pens = d.Pens
+	local tr = self.TextRect
+	local to = self.TextOffset
+	local s = self.TextBuffer:sub(to + c + 1, to + c + 1)
+	s = s == "" and " " or s
+	if cursor then
+		d:drawText(tr[1] + c * self.FWidth, tr[2], s, pens[ui.PEN_CURSORTEXT],
+			pens[ui.PEN_CURSOR])
 	else
-		d:drawText(x, y, text, pens[ui.PEN_TEXTINPUTTEXT], bgpen)
-		if self.Window.FocusElement == self then
-			local s = self.TextBuffer:sub(tc + to + 1, tc + to + 1)
-			s = s == "" and " " or s
-			if self.BlinkState == 1 then
-				d:drawText(tr[1] + tc * fw, tr[2], s, pens[ui.PEN_CURSORTEXT],
-					pens[ui.PEN_CURSOR])
-			else
-				d:drawText(tr[1] + tc * fw, tr[2], s,
-					pens[ui.PEN_TEXTINPUTTEXT], bgpen)
-			end
+		d:drawText(tr[1] + c * self.FWidth, tr[2], s,
+			pens[ui.PEN_TEXTINPUTTEXT], pens[self.Background])
+	end
+end
+
+-------------------------------------------------------------------------------
+--	drawDamage: internal - draws the text from the first changed cell,
+--	and the cursor. If the visible part of the text was scrolled, the
+--	whole text is redrawn.
+-------------------------------------------------------------------------------
+
+function TextInput:drawDamage()
+
+	local d = self.Drawable
+	local twc = self:layoutText()
+	local to = self.TextOffset
+	local tc = self.TextCursor
+
+	local first = self.TextDamage
+	if to ~= self.DrawnOffset then
+		first = 0
+	elseif first then
+		first = max(first - to, 0)
+	end
+
+	d:setFont(self.TextRecords[1][2])
+
+	if first and first < self.TextWidth then
+		local pens = d.Pens
+		local bgpen = pens[self.Background]
+		local tr = self.TextRect
+		local x = tr[1] + first * self.FWidth
+		-- clear from the first changed cell to the end of the text area:
+		d:fillRect(x, tr[2], self.Rect[3] - self.PaddingAndBorder[3], tr[4],
+			bgpen)
+		if first < twc then
+			d:drawText(x, tr[2], self.TextBuffer:sub(to + first + 1, to + twc),
+				pens[ui.PEN_TEXTINPUTTEXT], bgpen)
 		end
 	end
+
+	local oc = self.DrawnCursor
+	if oc and oc ~= tc and oc < twc and (not first or oc < first) then
+		self:drawCell(oc, false)
+	end
+	self:drawCell(tc, self.Window.FocusElement == self and
+		self.BlinkState == 1)
+
+	self.DrawnOffset = to
+	self.DrawnCursor = tc
+	self.TextDamage = false
+	self.CursorDamage = false
+end
+
+-------------------------------------------------------------------------------
+--	draw: overrides
+-------------------------------------------------------------------------------
+
+function TextInput:draw()
+
+	Area.draw(self)
+
+	if self.Disabled then
+		local d = self.Drawable
+		local pens = d.Pens
+		local twc = self:layoutText()
+		local tr = self.TextRect
+		local text = self.TextBuffer:sub(self.TextOffset + 1,
+			self.TextOffset + twc)
+		d:setFont(self.TextRecords[1][2])
+		d:drawText(tr[1] + 1, tr[2] + 1, text,
+			pens[ui.PEN_BUTTONDISABLEDSHINE])
+		d:drawText(tr[1], tr[2], text, pens[ui.PEN_BUTTONDISABLEDSHADOW])
+		self.DrawnOffset = false
+		self.DrawnCursor = false
+		self.TextDamage = false
+		self.CursorDamage = false
+	else
+		self.DrawnOffset = false
+		self.DrawnCursor = false
+		self:drawDamage()
+	end
+end
+
+-------------------------------------------------------------------------------
+--	checkRedraw: overrides
+-------------------------------------------------------------------------------
+
+function TextInput:checkRedraw()
+	return self.TextDamage or self.CursorDamage or Text.checkRedraw(self)
+end
+
+-------------------------------------------------------------------------------
+--	refresh: overrides
+-------------------------------------------------------------------------------
+
+function TextInput:refresh()
+	if not self.Redraw and self.TextRect and
+		(self.TextDamage or self.CursorDamage) then
+		self:drawDamage()
+	end
+	Text.refresh(self)
+end
+
+-------------------------------------------------------------------------------
+--	damageText: internal - marks the text as changed from the given
+--	character position (counting from 0)
+-------------------------------------------------------------------------------
+
+function TextInput:damageText(pos)
+	local td = self.TextDamage
+	self.TextDamage = td and min(td, pos) or pos
 end
 
 -------------------------------------------------------------------------------
@@ -260,6 +371,7 @@ function TextInput:clickMouse(x, y)
 			self.TextCursor = tc
 			self.BlinkTick = 0
 			self.BlinkState = 0
+			self.CursorDamage = true
 		end
 	end
 end
@@ -311,7 +423,7 @@ function TextInput:interval()
 		local bs = ((self.BlinkState == 1) and 0) or 1
 		if bs ~= self.BlinkState then
 			self.BlinkState = bs
-			self.Redraw = true
+			self.CursorDamage = true
 		end
 	end
 end
@@ -374,10 +486,12 @@ function TextInput.handleInput(self, msg)
 			elseif code == 8 then -- backspace:
 				if crsrleft(self) then
 					t:erase(to + tc, to + tc)
+					self:damageText(to + tc - 1)
 				end
 			elseif code == 127 then -- del:
-				if t:len() > 0 then
+				if to + tc < t:len() then
 					t:erase(to + tc + 1, to + tc + 1)
+					self:damageText(to + tc)
 				end
 			elseif code == 27 or code == 13 then -- escape, return:
 				self.Window:setFocusElement()
@@ -394,6 +508,7 @@ function TextInput.handleInput(self, msg)
 				self.TextCursor = self.TextBuffer:len() + 1
 			elseif code > 31 and code < 256 then
 				t:insert(utf8code, to + tc + 1)
+				self:damageText(to + tc)
 				crsrright(self)
 			else
 				break
@@ -401,6 +516,7 @@ function TextInput.handleInput(self, msg)
 			-- something changed:
 			self.BlinkTick = 0
 			self.BlinkState = 0
+			self.CursorDamage = true
 
 			-- TODO: self:setValue("Text", t:get())
 
@@ -441,7 +557,7 @@ function TextInput:onSetText(text)
 	-- intercept notification and do not pass the control back
 	-- to Text, as it performs a rethinkLayout() on text changes
 	self:makeTextRecords(text)
-	self.TextBuffer = UTF8String:new(text)
+	self.TextBuffer = TextBuffer.new(text)
 	self.TextOffset = 0 -- TODO
 	self.Redraw = true
 end
@@ -5,11 +5,23 @@
 --	See copyright notice in COPYRIGHT
 --
 --	OVERVIEW::
---	Implements vector graphics rendering
+--	Implements vector graphics rendering. Image data is compiled into a
+--	native object when it is first rendered.
 --
 
+local Visual = require "tek.lib.visual"
+local compileimage = Visual.compileimage
+local setmetatable = setmetatable
+
 module("tek.ui.class.vectorimage", tek.class)
-_VERSION = "VectorImage 1.1"
+_VERSION = "VectorImage 2.0"
+
+-------------------------------------------------------------------------------
+--	Constants & Class data:
+-------------------------------------------------------------------------------
+
+-- compiled images, indexed by image data:
+local Compiled = setmetatable({ }, { __mode = "k" })
 
 -------------------------------------------------------------------------------
 --	Class implementation:
@@ -26,7 +38,11 @@ end
 -------------------------------------------------------------------------------
 
 function VectorImage.render(drawable, rect, data)
- 	data.PenTable = drawable.Pens
-	data.Rect = rect
-	drawable:drawImage(data) -- TODO: pass PenTable, Rect
+	local img = Compiled[data]
+	if not img then
+		img = compileimage(data)
+		Compiled[data] = img
+	end
+	drawable:drawImage(img, rect[1], rect[2], rect[3], rect[4],
+		drawable.Pens)
 end
@@ -89,7 +89,7 @@ local type = type
 local unpack = unpack
 
 module("tek.ui.class.window", tek.ui.class.group)
-_VERSION = "Window 6.2"
+_VERSION = "Window 6.5"
 
 -------------------------------------------------------------------------------
 --	Constants & Class data:
@@ -124,6 +124,8 @@ function Window.init(self)
 	self.DblClickCheckTime = false
 	self.DblClickCheckMouseX = false
 	self.DblClickCheckMouseY = false
+	-- Exposures from copies were reported by the display:
+	self.ExposuresPending = false
 	self.FocusElement = false
 	self.Fullscreen = self.Fullscreen or false
 	self.HiliteElement = false
@@ -398,7 +400,12 @@ local MsgHandlers =
 		return msg
 	end,
 	[ui.MSG_REFRESH] = function(self, msg)
-		self:markDamage(msg[7], msg[8], msg[9], msg[10])
+		if msg[9] < msg[7] then
+			-- empty refresh, sent when copies have left exposures:
+			self.ExposuresPending = true
+		else
+			self:markDamage(msg[7], msg[8], msg[9], msg[10], true)
+		end
 		return msg
 	end,
 	[ui.MSG_MOUSEOVER] = function(self, msg)
@@ -597,11 +604,19 @@ function Window:handleCopies()
 		sort(t, sortcopies)
 		local d = self.Drawable
 		for _, r in ipairs(t) do
-			local t = { }
-			d:copyArea(r[4], r[5], r[6], r[7], r[4] + r[2], r[5] + r[3], t)
-			for i = 1, #t, 4 do
-				self:markDamage(t[i], t[i + 1], t[i + 2], t[i + 3])
-			end
+			-- issue copies without waiting for their exposures, they are
+			-- picked up in handleExposures():
+			d:copyArea(r[4], r[5], r[6], r[7], r[4] + r[2], r[5] + r[3], true)
+		end
+	end
+end
+
+function Window:handleExposures()
+	self.ExposuresPending = false
+	local t = self.Drawable:getExposures()
+	if t then
+		for i = 1, #t, 4 do
+			self:markDamage(t[i], t[i + 1], t[i + 2], t[i + 3], true)
 		end
 	end
 end
@@ -657,6 +672,11 @@ function Window:update()
 
 		end
 
+		-- damages from obscured areas of previous copies:
+		if self.ExposuresPending then
+			self:handleExposures()
+		end
+
 		-- refresh everything that is damaged:
 		self:refresh()
 